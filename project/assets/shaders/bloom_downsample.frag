@@ -0,0 +1,68 @@
+#version 330 core
+layout (location = 0) out vec4 FragColor;
+
+in vec2 TexCoord;
+
+// The level above, twice the size of the target (the HDR scene colour for the first level)
+uniform sampler2D sourceTex;
+uniform vec2 sourceTexelSize;
+
+// Keywords (shader variants): BRIGHT_PASS, first level only
+// Soft knee threshold: threshold, threshold - knee, 2 * knee, 0.25 / knee
+uniform vec4 bloomThreshold;
+
+float luminance(vec3 color) {
+    return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
+
+vec3 sampleSource(float x, float y) {
+    // Negative or NaN texels would spread over the whole chain
+    vec3 color = texture(sourceTex, TexCoord + vec2(x, y) * sourceTexelSize).rgb;
+    return max(color, vec3(0.0));
+}
+
+#ifdef BRIGHT_PASS
+// Karis average: weighs each box by 1 / (1 + luma), so single very bright texels don't flicker
+vec3 weighBox(vec3 box, float weight, inout float totalWeight) {
+    float w = weight / (1.0 + luminance(box));
+    totalWeight += w;
+    return box * w;
+}
+
+vec3 brightPass(vec3 color) {
+    float brightness = max(color.r, max(color.g, color.b));
+    float soft = clamp(brightness - bloomThreshold.y, 0.0, bloomThreshold.z);
+    soft = soft * soft * bloomThreshold.w;
+    return color * max(soft, brightness - bloomThreshold.x) / max(brightness, 0.0001);
+}
+#endif
+
+void main() {
+    // 13 taps, each a bilinear average of 2x2 source texels, grouped into five overlapping boxes
+    // (centre box weighted half)
+    vec3 a = sampleSource(-2.0,  2.0), b = sampleSource(0.0,  2.0), c = sampleSource(2.0,  2.0);
+    vec3 d = sampleSource(-2.0,  0.0), e = sampleSource(0.0,  0.0), f = sampleSource(2.0,  0.0);
+    vec3 g = sampleSource(-2.0, -2.0), h = sampleSource(0.0, -2.0), i = sampleSource(2.0, -2.0);
+    vec3 j = sampleSource(-1.0,  1.0), k = sampleSource(1.0,  1.0);
+    vec3 l = sampleSource(-1.0, -1.0), m = sampleSource(1.0, -1.0);
+
+    vec3 centre = (j + k + l + m) * 0.25;
+    vec3 topLeft = (a + b + d + e) * 0.25;
+    vec3 topRight = (b + c + e + f) * 0.25;
+    vec3 bottomLeft = (d + e + g + h) * 0.25;
+    vec3 bottomRight = (e + f + h + i) * 0.25;
+
+#ifdef BRIGHT_PASS
+    float totalWeight = 0.0;
+    vec3 color = weighBox(centre, 0.5, totalWeight);
+    color += weighBox(topLeft, 0.125, totalWeight);
+    color += weighBox(topRight, 0.125, totalWeight);
+    color += weighBox(bottomLeft, 0.125, totalWeight);
+    color += weighBox(bottomRight, 0.125, totalWeight);
+    color = brightPass(color / totalWeight);
+#else
+    vec3 color = centre * 0.5 + (topLeft + topRight + bottomLeft + bottomRight) * 0.125;
+#endif
+
+    FragColor = vec4(color, 1.0);
+}
@@ -0,0 +1,23 @@
+#version 330 core
+layout (location = 0) out vec4 FragColor;
+
+in vec2 TexCoord;
+
+// The level below (half this target's size), and this level's downsample
+uniform sampler2D sourceTex;
+uniform sampler2D downsampleTex;
+uniform vec2 sourceTexelSize;
+uniform float bloomRadius;
+
+void main() {
+    // 3x3 tent, spread by the radius in source texels
+    vec2 o = sourceTexelSize * bloomRadius;
+
+    vec3 bloom = texture(sourceTex, TexCoord).rgb * 4.0;
+    bloom += (texture(sourceTex, TexCoord + vec2(-o.x, 0.0)).rgb + texture(sourceTex, TexCoord + vec2(o.x, 0.0)).rgb
+        + texture(sourceTex, TexCoord + vec2(0.0, -o.y)).rgb + texture(sourceTex, TexCoord + vec2(0.0, o.y)).rgb) * 2.0;
+    bloom += texture(sourceTex, TexCoord + vec2(-o.x, -o.y)).rgb + texture(sourceTex, TexCoord + vec2(o.x, -o.y)).rgb
+        + texture(sourceTex, TexCoord + vec2(-o.x, o.y)).rgb + texture(sourceTex, TexCoord + vec2(o.x, o.y)).rgb;
+
+    FragColor = vec4(texture(downsampleTex, TexCoord).rgb + bloom / 16.0, 1.0);
+}
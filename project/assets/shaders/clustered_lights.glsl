@@ -0,0 +1,80 @@
+// Clustered light lookup, shared by every lit fragment shader.
+// Data layout is documented in lighting/light_cluster.h
+// Requires: uniform mat4 view (set per draw by the renderer)
+
+uniform samplerBuffer clusterLightData;
+uniform usamplerBuffer clusterGrid;
+uniform usamplerBuffer clusterLightIndices;
+
+uniform vec3 clusterDims;
+uniform vec2 clusterTileSize;
+uniform vec2 clusterSliceScaleBias;
+
+uniform mat4 view;
+
+struct ClusterLight
+{
+    vec3 position;
+    float invRangeSqr;
+    vec3 colour;
+    bool isSpot;
+    vec3 direction;
+    vec2 spotAngles;
+    int shadowIndex;    // First face in the shadow atlas face buffer, -1 if unshadowed
+};
+
+// Returns (offset, count) into clusterLightIndices for the froxel containing this fragment
+uvec2 getClusterRange(vec3 worldPosition)
+{
+    float viewDepth = -(view * vec4(worldPosition, 1.0)).z;
+
+    ivec2 tile = ivec2(gl_FragCoord.xy / clusterTileSize);
+    int slice = int(log(max(viewDepth, 1e-4)) * clusterSliceScaleBias.x + clusterSliceScaleBias.y);
+
+    ivec3 dims = ivec3(clusterDims);
+    ivec3 cluster = clamp(ivec3(tile, slice), ivec3(0), dims - 1);
+
+    int index = cluster.x + cluster.y * dims.x + cluster.z * dims.x * dims.y;
+    return texelFetch(clusterGrid, index).rg;
+}
+
+ClusterLight getClusterLight(uvec2 clusterRange, uint i)
+{
+    int lightIndex = int(texelFetch(clusterLightIndices, int(clusterRange.x + i)).r);
+    int base = lightIndex * 4;
+
+    vec4 t0 = texelFetch(clusterLightData, base + 0);
+    vec4 t1 = texelFetch(clusterLightData, base + 1);
+    vec4 t2 = texelFetch(clusterLightData, base + 2);
+    vec4 t3 = texelFetch(clusterLightData, base + 3);
+
+    ClusterLight light;
+    light.position = t0.xyz;
+    light.invRangeSqr = t0.w;
+    light.colour = t1.rgb;
+    light.isSpot = t1.w > 0.5;
+    light.direction = t2.xyz;
+    light.spotAngles = vec2(t2.w, t3.x);
+    light.shadowIndex = int(t3.y);
+    return light;
+}
+
+// Range attenuation (Unity RP) times the spot cone falloff
+float getClusterLightAttenuation(ClusterLight light, vec3 worldPosition)
+{
+    vec3 toLight = light.position - worldPosition;
+    float dSqr = dot(toLight, toLight);
+    float d_iRSqrSqr = dSqr * light.invRangeSqr;
+    d_iRSqrSqr *= d_iRSqrSqr;
+    float rangeOne = max(0.0, 1.0 - d_iRSqrSqr);
+    float att = rangeOne * rangeOne;
+
+    if (light.isSpot)
+    {
+        float cosAngle = dot(normalize(-toLight), normalize(light.direction));
+        float spot = clamp(cosAngle * light.spotAngles.x + light.spotAngles.y, 0.0, 1.0);
+        att *= spot * spot;
+    }
+
+    return att;
+}
@@ -0,0 +1,65 @@
+// Combined-scene lighting model, shared by the forward (combined.frag) and deferred (deferred_lighting.frag) shaders.
+// Keywords (shader variants): DIRECTIONAL_LIGHT
+#include "surface.glsl"
+
+// Point and spot lights come from the light clusters
+#include "clustered_lights.glsl"
+
+// Directional light shadows
+#include "shadows.glsl"
+
+// Point and spot light shadows
+#include "point_shadows.glsl"
+
+// Light properties
+uniform vec3 dirLightColour;
+uniform vec3 dirLightDirection;
+uniform vec3 cameraPosition;
+
+vec3 calcDirectionalLight(Surface surf) 
+{
+#ifdef DIRECTIONAL_LIGHT
+    vec3 lightColour = dirLightColour;
+    vec3 lightDirection = normalize(dirLightDirection);
+
+    vec3 ambientContr = lightColour * 0.2;
+
+    vec3 N = surf.normal;
+    vec3 L = -lightDirection;
+    float diffEq = max(0, dot(L, N));
+    vec3 diffuseContr = lightColour * diffEq;
+
+    vec3 V = normalize(cameraPosition - surf.worldPosition);
+    vec3 H = normalize(V + L);
+    float specBPEq = pow(max(0, dot(N, H)), surf.shininess * 2.0);
+    vec3 specBPContr = lightColour * surf.specular * specBPEq;
+
+    float shadow = getDirectionalShadow(surf.worldPosition, surf.normal);
+
+    return ambientContr + (diffuseContr + specBPContr) * shadow;
+#else
+    return vec3(0.0);
+#endif
+}
+
+vec3 calcPointLight(Surface surf, ClusterLight light) 
+{
+    vec3 lightDirection = normalize(surf.worldPosition - light.position);
+
+    vec3 ambientContr = light.colour * 0.2;
+
+    vec3 N = surf.normal;
+    vec3 L = -lightDirection;
+    float diffEq = max(0, dot(L, N));
+    vec3 diffuseContr = light.colour * diffEq * 0.1;
+
+    vec3 V = normalize(cameraPosition - surf.worldPosition);
+    vec3 H = normalize(V + L);
+    float specBPEq = pow(max(0, dot(N, H)), surf.shininess * 2.0);
+    vec3 specBPContr = light.colour * surf.specular * specBPEq;
+
+    float att = getClusterLightAttenuation(light, surf.worldPosition);
+    float shadow = getPointShadow(light, surf.worldPosition, surf.normal);
+
+    return (ambientContr + (diffuseContr + specBPContr) * shadow) * att;
+}
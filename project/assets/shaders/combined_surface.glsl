@@ -0,0 +1,178 @@
+// Combined-scene surface inputs, shared by the forward (combined.frag) and G-buffer (gbuffer.frag) shaders.
+// Requires: in vec2 TexCoord; in vec3 Normal, FragWPos, Tangent;
+// SURFACE_TYPE picks the texture set at compile time (0 Floor, 1 House, 2 Fan, 3 Tree, 4 Rocks, 5 Horse),
+// from the surface keyword of the material's variant; none is the floor
+// TEXTURE_ARRAYS reads the set from texture array layers instead, for instanced batches
+// Shininess and specular scale come from the material (materials.glsl)
+
+#if defined(SURFACE_HOUSE)
+#define SURFACE_TYPE 1
+#elif defined(SURFACE_FAN)
+#define SURFACE_TYPE 2
+#elif defined(SURFACE_TREE)
+#define SURFACE_TYPE 3
+#elif defined(SURFACE_ROCKS)
+#define SURFACE_TYPE 4
+#elif defined(SURFACE_HORSE)
+#define SURFACE_TYPE 5
+#else
+#define SURFACE_TYPE 0
+#endif
+
+//_______________________________Textures______________________________//
+
+#include "materials.glsl"
+
+// Uniforms for textures
+#ifdef TEXTURE_ARRAYS
+// Same units as the textures they stand for; layers per instance
+uniform sampler2DArray materialDiffuse;
+uniform sampler2DArray materialSpecular;
+uniform sampler2DArray materialNormal;
+
+#define SAMPLE_DIFFUSE(tex) texture(materialDiffuse, vec3(TexCoord, InstanceMaterial.x))
+#define SAMPLE_SPECULAR(tex) texture(materialSpecular, vec3(TexCoord, InstanceMaterial.y))
+#define SAMPLE_NORMAL(tex) texture(materialNormal, vec3(TexCoord, InstanceMaterial.w))
+#else
+#define SAMPLE_DIFFUSE(tex) texture(tex, TexCoord)
+#define SAMPLE_SPECULAR(tex) texture(tex, TexCoord)
+#define SAMPLE_NORMAL(tex) texture(tex, TexCoord)
+#endif
+
+//Floor
+uniform sampler2D texture_floor_diffuse;
+uniform sampler2D texture_floor_normal;
+
+//House stand
+uniform sampler2D texture_house;
+uniform sampler2D texture_house2;
+
+//House fan
+uniform sampler2D texture_fan;
+uniform sampler2D texture_fan2;
+
+//Tree 
+uniform sampler2D texture_tree_diffuse;
+uniform sampler2D texture_tree_specular;
+
+//Rocks
+uniform sampler2D texture_rocks_diffuse;
+uniform sampler2D texture_rocks_specular;
+uniform sampler2D texture_rocks_normal;
+
+//Horse
+uniform sampler2D horse_texture_diffuse;
+uniform sampler2D horse_texture_specular;
+
+//Any surface, black unless the material sets one
+uniform sampler2D texture_emissive;
+
+//_______________________________Textures______________________________//
+
+#include "surface.glsl"
+
+Surface makeSurface(vec3 worldNormal) {
+    Surface surf;
+    vec4 material = getMaterialParams();
+
+#if SURFACE_TYPE == 0
+    { // Floor
+        vec4 sampledDiffuse = SAMPLE_DIFFUSE(texture_floor_diffuse);
+        surf.worldPosition = FragWPos;
+        surf.diffuse = sampledDiffuse.rgb;
+        surf.normal = normalize(worldNormal);
+        surf.alpha = sampledDiffuse.a;
+        surf.specular = sampledDiffuse.r * material.y;
+        surf.shininess = material.x;
+    } 
+#elif SURFACE_TYPE == 1
+    { // House stand
+        vec4 sampledDiffuse = SAMPLE_DIFFUSE(texture_house);
+        surf.worldPosition = FragWPos;
+        surf.diffuse = sampledDiffuse.rgb;
+        surf.normal = normalize(worldNormal); // Use normal directly for house
+        surf.alpha = sampledDiffuse.a;
+        surf.specular = SAMPLE_SPECULAR(texture_house2).r * material.y;
+        surf.shininess = material.x;
+    }
+#elif SURFACE_TYPE == 2
+    { // House fan
+        vec4 sampledDiffuse = SAMPLE_DIFFUSE(texture_fan);
+        surf.worldPosition = FragWPos;
+        surf.diffuse = sampledDiffuse.rgb;
+        surf.normal = normalize(worldNormal); // Use normal directly for house
+        surf.alpha = sampledDiffuse.a;
+        surf.specular = SAMPLE_SPECULAR(texture_fan2).r * material.y;
+        surf.shininess = material.x;
+    }
+#elif SURFACE_TYPE == 3
+    { // Tree 
+        vec4 sampledDiffuse = SAMPLE_DIFFUSE(texture_tree_diffuse);
+        surf.worldPosition = FragWPos;
+        surf.diffuse = sampledDiffuse.rgb;
+        surf.normal = normalize(worldNormal); // Use normal directly for tree
+        surf.alpha = sampledDiffuse.a;
+        surf.specular = SAMPLE_SPECULAR(texture_tree_specular).r * material.y;
+        surf.shininess = material.x;
+    }
+#elif SURFACE_TYPE == 4
+    { // Rocks
+        vec4 sampledDiffuse = SAMPLE_DIFFUSE(texture_rocks_diffuse);
+        surf.worldPosition = FragWPos;
+        surf.diffuse = sampledDiffuse.rgb;
+        surf.normal = normalize(worldNormal); // Use normal directly for rocks
+        surf.alpha = sampledDiffuse.a;
+        surf.specular = SAMPLE_SPECULAR(texture_rocks_specular).r * material.y;
+        surf.shininess = material.x;
+    }
+#elif SURFACE_TYPE == 5
+    { // Horse
+        vec4 sampledDiffuse = SAMPLE_DIFFUSE(horse_texture_diffuse);
+        surf.worldPosition = FragWPos;
+        surf.diffuse = sampledDiffuse.rgb;
+        surf.normal = normalize(worldNormal); // Use normal directly for rocks
+        surf.alpha = sampledDiffuse.a;
+        surf.specular = SAMPLE_SPECULAR(horse_texture_specular).r * material.y;
+        surf.shininess = material.x;
+    }
+#endif
+
+    return surf;
+}
+
+// Added unlit. Batched materials have none (isBatched() in the scene).
+vec3 getCombinedEmissive()
+{
+#ifdef TEXTURE_ARRAYS
+    return vec3(0.0);
+#else
+    return texture(texture_emissive, TexCoord).rgb;
+#endif
+}
+
+Surface getCombinedSurface()
+{
+    vec3 worldNormal;
+#if SURFACE_TYPE == 0
+    { // Floor
+        // Two-channel (BC5) normal map, Z rebuilt from XY
+        vec3 sampledNormal;
+        sampledNormal.xy = SAMPLE_NORMAL(texture_floor_normal).rg * 2.0 - 1.0;
+        sampledNormal.z = sqrt(max(1.0 - dot(sampledNormal.xy, sampledNormal.xy), 0.0));
+
+        // Interpolation skews the tangent off the normal, so make it orthogonal again
+        vec3 N = normalize(Normal);
+        vec3 T = normalize(Tangent - N * dot(N, Tangent));
+        vec3 B = cross(N, T);
+        mat3 TBN = mat3(T, B, N);
+
+        worldNormal = normalize(TBN * sampledNormal);
+    } 
+#else
+    { //1 House //2 Fan //3 Tree //4 Rocks //5 horse
+        worldNormal = normalize(Normal);
+    }
+#endif
+
+    return makeSurface(worldNormal);
+}
@@ -0,0 +1,53 @@
+#version 330 core
+layout (location = 0) out vec4 FragColor;
+
+in vec2 TexCoord;
+
+// G-buffer, see gbuffer_common.glsl
+uniform sampler2D gAlbedoSpecular;
+uniform sampler2D gNormalShininess;
+uniform sampler2D gEmissive;
+uniform sampler2D gDepth;
+
+uniform mat4 invViewProjection;
+
+#include "gbuffer_common.glsl"
+
+// Same lighting model as combined.frag
+#include "combined_lighting.glsl"
+
+void main() {
+    // Render target and G-buffer have the same size, so fetch texels directly
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+
+    float depth = texelFetch(gDepth, pixel, 0).r;
+    if(depth >= 1.0)
+    {discard;} // Nothing was drawn here, the skybox fills it afterwards
+
+    vec4 worldPos = invViewProjection * vec4(vec3(TexCoord, depth) * 2.0 - 1.0, 1.0);
+
+    vec4 albedoSpecular = texelFetch(gAlbedoSpecular, pixel, 0);
+    vec4 normalShininess = texelFetch(gNormalShininess, pixel, 0);
+
+    Surface surf;
+    surf.worldPosition = worldPos.xyz / worldPos.w;
+    surf.diffuse = albedoSpecular.rgb;
+    surf.normal = decodeNormal(normalShininess.xy);
+    surf.alpha = 1.0;
+    surf.specular = albedoSpecular.a;
+    surf.shininess = decodeShininess(normalShininess.z);
+
+    vec3 finalCol = (surf.diffuse * surf.shininess) * calcDirectionalLight(surf);
+
+    // Screen tile + depth slice lookup, same clusters as the forward path
+    uvec2 clusterRange = getClusterRange(surf.worldPosition);
+    for (uint i = 0u; i < clusterRange.y; i++)
+    {
+        finalCol += calcPointLight(surf, getClusterLight(clusterRange, i));
+    }
+
+    finalCol += texelFetch(gEmissive, pixel, 0).rgb;
+
+    // Linear HDR, resolved by screen.frag
+    FragColor = vec4(finalCol, 1.0);
+}
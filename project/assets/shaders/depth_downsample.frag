@@ -0,0 +1,19 @@
+#version 330 core
+
+// Full resolution scene depth, reduced to the nearest depth of each downscale x downscale
+// block. Nearest, so reduced resolution transparents are never drawn over foreground that
+// covers part of a block; the upsample fills those pixels instead of leaving halos.
+uniform sampler2D sceneDepth;
+uniform int downscale;
+
+void main() {
+    ivec2 base = ivec2(gl_FragCoord.xy) * downscale;
+    ivec2 maxPixel = textureSize(sceneDepth, 0) - 1;
+
+    float depth = 1.0;
+    for (int y = 0; y < downscale; y++)
+        for (int x = 0; x < downscale; x++)
+            depth = min(depth, texelFetch(sceneDepth, min(base + ivec2(x, y), maxPixel), 0).r);
+
+    gl_FragDepth = depth;
+}
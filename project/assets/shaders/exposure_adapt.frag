@@ -0,0 +1,23 @@
+#version 330 core
+layout (location = 0) out vec4 FragColor;
+
+// 1x1: average log luminance of this frame, adapted luminance of the last
+uniform sampler2D averageLogLuminance;
+uniform sampler2D previousLuminance;
+
+// Fraction of the way to the target covered this frame: brightening, darkening
+uniform vec2 adaptationRates;
+// Min and max adapted luminance
+uniform vec2 luminanceRange;
+
+void main() {
+    float target = clamp(exp(texelFetch(averageLogLuminance, ivec2(0), 0).r), luminanceRange.x, luminanceRange.y);
+    float previous = texelFetch(previousLuminance, ivec2(0), 0).r;
+
+    // Restart from the target rather than carry a NaN or an unset texture forever
+    if (!(previous > 0.0))
+        previous = target;
+
+    float rate = target > previous ? adaptationRates.x : adaptationRates.y;
+    FragColor = vec4(mix(previous, target, rate), 0.0, 0.0, 1.0);
+}
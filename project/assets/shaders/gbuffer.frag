@@ -0,0 +1,23 @@
+#version 330 core
+layout (location = 0) out vec4 GAlbedoSpecular;
+layout (location = 1) out vec4 GNormalShininess;
+layout (location = 2) out vec4 GEmissive;
+
+in vec2 TexCoord;
+in vec3 Normal, FragWPos;
+in vec3 Tangent; // For the floor
+
+// Same surface inputs as combined.frag
+#include "combined_surface.glsl"
+#include "gbuffer_common.glsl"
+
+void main() {
+    Surface surf = getCombinedSurface(); // Same SURFACE_TYPE as the material's combined.frag variant
+
+    if(surf.alpha < getMaterialParams().z)
+    {discard;}
+
+    GAlbedoSpecular = vec4(surf.diffuse, surf.specular);
+    GNormalShininess = vec4(encodeNormal(surf.normal), encodeShininess(surf.shininess), 0.0);
+    GEmissive = vec4(getCombinedEmissive(), 0.0);
+}
@@ -0,0 +1,42 @@
+// G-buffer layout, written by gbuffer.frag and read by deferred_lighting.frag.
+//
+//   attachment 0   RGBA8      albedo.rgb, specular
+//   attachment 1   RGB10_A2   octahedral normal.xy, log2 shininess, unused
+//   attachment 2   RGBA8      emissive.rgb, unused
+//   depth          DEPTH24    world position is rebuilt from it
+//
+// 16 bytes per pixel in total.
+
+vec2 octahedralWrap(vec2 v)
+{
+    return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// Unit normal -> [0,1]^2
+vec2 encodeNormal(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    n.xy = n.z >= 0.0 ? n.xy : octahedralWrap(n.xy);
+    return n.xy * 0.5 + 0.5;
+}
+
+vec3 decodeNormal(vec2 e)
+{
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = clamp(-n.z, 0.0, 1.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+// Shininess up to 255 in 10 bits, finer steps at the low end where they are visible
+float encodeShininess(float shininess)
+{
+    return clamp(log2(1.0 + shininess) / 8.0, 0.0, 1.0);
+}
+
+float decodeShininess(float e)
+{
+    return exp2(e * 8.0) - 1.0;
+}
@@ -0,0 +1,53 @@
+// HDR resolve, applied once per pixel by screen.frag to the linear scene colour.
+// Keywords (shader variants): TONEMAP, GRADING
+// Exposure, contrast, saturation and sepia are baked into the grading LUT (ColourGrading).
+
+uniform sampler3D gradingLut;
+uniform vec2 gradingLutScaleOffset;
+
+//---------------------------------Begin HDR---------------------------------//
+//Tone mapping
+vec3 filmicToneMap(vec3 color) {
+    
+    vec3 x = color * (1.0 + color / vec3(0.6));
+    return x / (x + vec3(1.0));
+    
+}
+
+vec3 acesToneMap(vec3 color) {
+    
+    vec3 A = color * (color + vec3(0.0245786));
+    vec3 B = vec3(0.000090537) * (color * color) + vec3(0.000129768) * color;
+    return (A - B) / (color + vec3(0.0001261));
+    
+}
+
+vec3 combinedToneMap(vec3 color) {
+    
+    // Apply Filmic tone mapping first
+    vec3 filmicColor = filmicToneMap(color);
+    
+    // Apply ACES tone mapping to the result of Filmic
+    return acesToneMap(filmicColor);
+}
+//End of Tone Mapping
+
+//---------------------------------End HDR---------------------------------//
+
+
+// One lookup however many operations are baked; trilinear between the texel centres
+vec3 applyGrading(vec3 color) {
+    vec3 uvw = clamp(color, 0.0, 1.0) * gradingLutScaleOffset.x + gradingLutScaleOffset.y;
+    return texture(gradingLut, uvw).rgb;
+}
+
+vec3 applyHDR(vec3 finalCol)
+{
+#ifdef TONEMAP
+    finalCol = combinedToneMap(finalCol);
+#endif
+#ifdef GRADING
+    finalCol = applyGrading(finalCol);
+#endif
+    return finalCol;
+}
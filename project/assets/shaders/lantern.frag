@@ -1,5 +1,6 @@
 #version 330 core
-layout (location = 0) out vec4 FragColor;
+// FragColor, or the OIT targets
+#include "oit.glsl"
 
 in vec2 TexCoord;
 in vec3 Normal, FragWPos;
@@ -8,23 +9,13 @@ uniform sampler2D texture_lantern;
 uniform sampler2D texture_roadllamp;
 uniform sampler2D texture_lantern_emissive;
 
-uniform vec3 pointLightColour1;
-uniform vec3 pointLightPosition1;
-uniform float pointLightRange1;
-
-uniform vec3 pointLightColour2;
-uniform vec3 pointLightPosition2;
-uniform float pointLightRange2;
-
-uniform vec3 pointLightColour3;
-uniform vec3 pointLightPosition3;
-uniform float pointLightRange3;
-
 uniform vec3 cameraPosition;
 
-uniform bool enableLanternLeft;
-uniform bool enableLanternMid;
-uniform bool enableLanternRight;
+// Shininess and specular scale
+#include "materials.glsl"
+
+// Point and spot lights come from the light clusters
+#include "clustered_lights.glsl"
 
 //Structure//
 struct Surface
@@ -41,6 +32,7 @@ struct Surface
 Surface makeSurface()
 {
     Surface surf;
+    vec4 material = getMaterialParams();
 
     vec4 sampledDiffuse = texture(texture_lantern, TexCoord);
     vec4 sampledEmissive = texture(texture_lantern_emissive, TexCoord);
@@ -48,8 +40,8 @@ Surface makeSurface()
     surf.diffuse = sampledDiffuse.rgb;
     surf.normal = Normal;
     surf.alpha = sampledDiffuse.a;
-    surf.specular = texture(texture_roadllamp,TexCoord).r;
-    surf.shininess = 1.0;
+    surf.specular = texture(texture_roadllamp,TexCoord).r * material.y;
+    surf.shininess = material.x;
     surf.emissive = sampledEmissive.rgb;
 
     return surf;
@@ -67,12 +59,10 @@ float saturate(float x)
 }
 //Reusable functions//
 
-vec3 calcPointLight01(Surface surf)
+vec3 calcPointLight(Surface surf, ClusterLight light)
 {
-    if(enableLanternLeft == true)
-    {
-    vec3 lightColour = pointLightColour1 ;
-    vec3 lightWorldPosition = pointLightPosition1;
+    vec3 lightColour = light.colour;
+    vec3 lightWorldPosition = light.position;
 
     vec3 lightDirection = normalize(FragWPos - lightWorldPosition);
 
@@ -92,90 +82,10 @@ vec3 calcPointLight01(Surface surf)
     vec3 specBPContr = lightColour * surf.specular *  specBPEq;
 
     //Attenuation (Unity RP) //Uses lightRange
-    float d = distance(lightWorldPosition, FragWPos);
-    float dSqr = square(d);
-    float invRSqr = pointLightRange1;
-    float d_iRSqrSqr = square(dSqr * invRSqr);
-    float rangeAtt = square(max(0.0, 1.0 - d_iRSqrSqr));
-    float att = rangeAtt;
+    float att = getClusterLightAttenuation(light, FragWPos);
 
     vec3 lightContribution = ambientContr + diffuseContr + specBPContr;
     return lightContribution * att;
-    }
-}
-
-vec3 calcPointLight02(Surface surf)
-{
-    if(enableLanternRight == true)
-    {
-    vec3 lightColour = pointLightColour2 ;
-    vec3 lightWorldPosition = pointLightPosition2;
-
-    vec3 lightDirection = normalize(FragWPos - lightWorldPosition);
-
-    //Ambient
-    vec3 ambientContr = lightColour * 0.2;
-
-    //Diffuse
-    vec3 N = surf.normal;
-    vec3 L = -lightDirection;
-    float diffEq = max(0,dot(L,N));
-    vec3 diffuseContr = lightColour * diffEq;
-
-    //Specular(Blinn-Phong)//Assignment can choose between phong or blinn-phong//End//
-    vec3 V = normalize(cameraPosition - surf.worldPosition);
-    vec3 H = normalize(V + L);
-    float specBPEq = pow(max(0,dot(N,H)), surf.shininess * 2.0);
-    vec3 specBPContr = lightColour * surf.specular *  specBPEq;
-
-    //Attenuation (Unity RP) //Uses lightRange
-    float d = distance(lightWorldPosition, FragWPos);
-    float dSqr = square(d);
-    float invRSqr = pointLightRange2;
-    float d_iRSqrSqr = square(dSqr * invRSqr);
-    float rangeAtt = square(max(0.0, 1.0 - d_iRSqrSqr));
-    float att = rangeAtt;
-
-    vec3 lightContribution = ambientContr + diffuseContr + specBPContr;
-    return lightContribution * att;
-    }
-}
-
-vec3 calcPointLight03(Surface surf)
-{
-    if(enableLanternMid == true)
-    {
-    vec3 lightColour = pointLightColour3 ;
-    vec3 lightWorldPosition = pointLightPosition3;
-
-    vec3 lightDirection = normalize(FragWPos - lightWorldPosition);
-
-    //Ambient
-    vec3 ambientContr = lightColour * 0.2;
-
-    //Diffuse
-    vec3 N = surf.normal;
-    vec3 L = -lightDirection;
-    float diffEq = max(0,dot(L,N));
-    vec3 diffuseContr = lightColour * diffEq;
-
-    //Specular(Blinn-Phong)//Assignment can choose between phong or blinn-phong//End//
-    vec3 V = normalize(cameraPosition - surf.worldPosition);
-    vec3 H = normalize(V + L);
-    float specBPEq = pow(max(0,dot(N,H)), surf.shininess * 2.0);
-    vec3 specBPContr = lightColour * surf.specular *  specBPEq;
-
-    //Attenuation (Unity RP) //Uses lightRange
-    float d = distance(lightWorldPosition, FragWPos);
-    float dSqr = square(d);
-    float invRSqr = pointLightRange3;
-    float d_iRSqrSqr = square(dSqr * invRSqr);
-    float rangeAtt = square(max(0.0, 1.0 - d_iRSqrSqr));
-    float att = rangeAtt;
-
-    vec3 lightContribution = ambientContr + diffuseContr + specBPContr;
-    return lightContribution * att;
-    }
 }
 
 void main()
@@ -186,10 +96,15 @@ void main()
 
     vec3 baseColor = surf.diffuse * 0.5; // Small ambient term for visibility
 
-    
-    vec3 finalCol =  (baseColor + surf.diffuse + surf.emissive) * calcPointLight01(surf) + calcPointLight02(surf) + calcPointLight03(surf);
-    
-    
+    // Only the lights whose range touches this fragment's cluster
+    vec3 lighting = vec3(0.0);
+    uvec2 clusterRange = getClusterRange(FragWPos);
+    for (uint i = 0u; i < clusterRange.y; i++)
+    {
+        lighting += calcPointLight(surf, getClusterLight(clusterRange, i));
+    }
+
+    vec3 finalCol = (baseColor + surf.diffuse + surf.emissive) * lighting;
 
-    FragColor = vec4(finalCol, surf.alpha);
+    writeTransparent(finalCol, surf.alpha);
 }
\ No newline at end of file
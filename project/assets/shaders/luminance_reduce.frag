@@ -0,0 +1,27 @@
+#version 330 core
+layout (location = 0) out vec4 FragColor;
+
+in vec2 TexCoord;
+
+// The level above (the HDR scene colour for the first level)
+uniform sampler2D sourceTex;
+uniform vec2 sourceTexelSize;
+
+// Keywords (shader variants): LOG_LUMINANCE, first level only; later levels average the logs
+
+vec4 sampleSource(float x, float y) {
+    vec4 texel = texture(sourceTex, TexCoord + vec2(x, y) * sourceTexelSize);
+#ifdef LOG_LUMINANCE
+    // Clamped so black pixels don't drag the average to -infinity
+    float luminance = dot(max(texel.rgb, vec3(0.0)), vec3(0.2126, 0.7152, 0.0722));
+    texel = vec4(log(max(luminance, 0.0001)));
+#endif
+    return texel;
+}
+
+void main() {
+    // Four bilinear taps, each averaging 2x2 texels: the 4x4 block under this output texel
+    // (AutoExposure::REDUCTION_FACTOR), so a whole level is read
+    float sum = sampleSource(-1.0, -1.0).r + sampleSource(1.0, -1.0).r + sampleSource(-1.0, 1.0).r + sampleSource(1.0, 1.0).r;
+    FragColor = vec4(sum * 0.25, 0.0, 0.0, 1.0);
+}
@@ -0,0 +1,20 @@
+// Material parameters, one entry per material (MaterialUtils on the C++ side)
+// x shininess, y specular scale, z alpha cutoff
+
+#define MAX_MATERIALS 256
+
+layout(std140) uniform MaterialBlock
+{
+    vec4 materialParams[MAX_MATERIALS];
+};
+
+#ifdef TEXTURE_ARRAYS
+// Per instance (see standard.vert): x diffuse layer, y specular layer, z material index, w normal layer
+flat in vec4 InstanceMaterial;
+
+vec4 getMaterialParams() { return materialParams[int(InstanceMaterial.z)]; }
+#else
+uniform int materialIndex;
+
+vec4 getMaterialParams() { return materialParams[materialIndex]; }
+#endif
@@ -0,0 +1,34 @@
+// Output of the alpha-blended shaders.
+// Keywords (shader variants): OIT
+//
+// Without OIT a colour for ordinary (sorted, src alpha) blending. With OIT weighted blended
+// order-independent transparency (McGuire and Bavoil 2013), blended by BlendMode::WEIGHTED_OIT:
+//   Accumulation (RGBA16F): rgb += premultiplied colour * weight, a *= 1 - alpha (revealage)
+//   AccumulationWeight (R16F): += alpha * weight
+// oit_composite.frag resolves both over the scene.
+
+#ifdef OIT
+layout (location = 0) out vec4 Accumulation;
+layout (location = 1) out vec4 AccumulationWeight;
+
+// Nearer surfaces dominate; view depth from gl_FragCoord.w = 1 / clip w
+float getOITWeight(float alpha) {
+    float viewDepth = 1.0 / gl_FragCoord.w;
+    float depthWeight = 10.0 / (0.00001 + pow(viewDepth / 5.0, 2.0) + pow(viewDepth / 200.0, 6.0));
+    return alpha * clamp(depthWeight, 0.01, 3000.0);
+}
+#else
+layout (location = 0) out vec4 FragColor;
+#endif
+
+void writeTransparent(vec3 colour, float alpha) {
+#ifdef OIT
+    // Bounded so many layers can't overflow the half floats
+    colour = min(colour, vec3(64.0));
+    float weight = getOITWeight(alpha);
+    Accumulation = vec4(colour * alpha * weight, alpha);
+    AccumulationWeight = vec4(alpha * weight);
+#else
+    FragColor = vec4(colour, alpha);
+#endif
+}
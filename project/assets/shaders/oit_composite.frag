@@ -0,0 +1,22 @@
+#version 330 core
+layout (location = 0) out vec4 FragColor;
+
+// Written by the OIT transparent pass, see oit.glsl. Same size as the target.
+uniform sampler2D accumulation;
+uniform sampler2D accumulationWeight;
+
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+
+    vec4 accum = texelFetch(accumulation, pixel, 0);
+    float revealage = accum.a;
+
+    // No transparent surface here
+    if (revealage >= 1.0)
+        discard;
+
+    // Weighted average colour, covering 1 - revealage of the scene behind it
+    float weight = texelFetch(accumulationWeight, pixel, 0).r;
+    vec3 average = accum.rgb / max(weight, 0.00001);
+    FragColor = vec4(average, 1.0 - revealage);
+}
@@ -0,0 +1,45 @@
+// Point and spot light shadows from the shadow atlas, see shadow/shadow_atlas.h
+// Requires: clustered_lights.glsl
+
+uniform sampler2DShadow pointShadowAtlas;
+uniform samplerBuffer pointShadowFaces;     // 5 texels per face: view-projection columns, tile rect
+uniform float pointShadowAtlasTexelSize;
+uniform bool enablePointShadows;
+
+// 1 = fully lit
+float getPointShadow(ClusterLight light, vec3 worldPosition, vec3 normal)
+{
+    if (!enablePointShadows || light.shadowIndex < 0)
+        return 1.0;
+
+    vec3 fromLight = worldPosition - light.position;
+
+    // Spot lights have one face, point lights pick the cube face (+X, -X, +Y, -Y, +Z, -Z)
+    int face = 0;
+    if (!light.isSpot)
+    {
+        vec3 a = abs(fromLight);
+        if (a.x >= a.y && a.x >= a.z) face = fromLight.x > 0.0 ? 0 : 1;
+        else if (a.y >= a.z)          face = fromLight.y > 0.0 ? 2 : 3;
+        else                          face = fromLight.z > 0.0 ? 4 : 5;
+    }
+
+    int base = (light.shadowIndex + face) * 5;
+    mat4 viewProjection = mat4(
+        texelFetch(pointShadowFaces, base + 0),
+        texelFetch(pointShadowFaces, base + 1),
+        texelFetch(pointShadowFaces, base + 2),
+        texelFetch(pointShadowFaces, base + 3));
+    vec4 tile = texelFetch(pointShadowFaces, base + 4); // origin.xy, size, world texel per unit distance
+
+    // Normal offset scaled by the texel footprint at this distance
+    float texelWorldSize = tile.w * length(fromLight);
+    vec4 lightClip = viewProjection * vec4(worldPosition + normal * texelWorldSize * 1.5, 1.0);
+    vec3 coords = lightClip.xyz / lightClip.w * 0.5 + 0.5;
+
+    // Keep the bilinear footprint inside the tile
+    float border = pointShadowAtlasTexelSize / tile.z;
+    vec2 uv = tile.xy + clamp(coords.xy, vec2(border), vec2(1.0 - border)) * tile.z;
+
+    return texture(pointShadowAtlas, vec3(uv, coords.z));
+}
@@ -1,5 +1,6 @@
 #version 330 core
-layout (location = 0) out vec4 FragColor;
+// FragColor, or the OIT targets
+#include "oit.glsl"
 
 in vec2 TexCoord;
 in vec3 Normal, FragWPos;
@@ -7,12 +8,13 @@ in vec3 Normal, FragWPos;
 uniform sampler2D texture_roadllamp;
 uniform sampler2D texture_specular;
 
-uniform vec3 pointLightColour0;
-uniform vec3 pointLightPosition0;
-uniform float pointLightRange0;
 uniform vec3 cameraPosition;
 
-uniform bool enableRoadlamp;
+// Shininess and specular scale
+#include "materials.glsl"
+
+// Point and spot lights come from the light clusters
+#include "clustered_lights.glsl"
 
 //Structure//
 struct Surface
@@ -28,14 +30,15 @@ struct Surface
 Surface makeSurface()
 {
     Surface surf;
+    vec4 material = getMaterialParams();
 
     vec4 sampledDiffuse = texture(texture_roadllamp, TexCoord);
     surf.worldPosition = FragWPos;
     surf.diffuse = sampledDiffuse.rgb;
     surf.normal = Normal;
     surf.alpha = sampledDiffuse.a;
-    surf.specular = texture(texture_specular,TexCoord).r;
-    surf.shininess = 128.0;
+    surf.specular = texture(texture_specular,TexCoord).r * material.y;
+    surf.shininess = material.x;
 
     return surf;
 }
@@ -52,12 +55,10 @@ float saturate(float x)
 }
 //Reusable functions//
 
-vec3 calcPointLight(Surface surf)
+vec3 calcPointLight(Surface surf, ClusterLight light)
 {
-    if(enableRoadlamp == true)
-    {
-    vec3 lightColour = pointLightColour0 ;
-    vec3 lightWorldPosition = pointLightPosition0;
+    vec3 lightColour = light.colour;
+    vec3 lightWorldPosition = light.position;
 
     //vec3 lightDirection = normalize(FragWPos - lightWorldPosition);
     vec3 lightDirection = normalize(lightWorldPosition - surf.worldPosition);
@@ -77,16 +78,10 @@ vec3 calcPointLight(Surface surf)
     vec3 specBPContr = lightColour * surf.specular *  specBPEq;
 
     //Attenuation (Unity RP) //Uses lightRange
-    float d = distance(lightWorldPosition, FragWPos);
-    float dSqr = square(d);
-    float invRSqr = pointLightRange0;
-    float d_iRSqrSqr = square(dSqr * invRSqr);
-    float rangeAtt = square(max(0.0, 1.0 - d_iRSqrSqr));
-    float att = rangeAtt;
+    float att = getClusterLightAttenuation(light, FragWPos);
 
     vec3 lightContribution = ambientContr + diffuseContr + specBPContr;
     return lightContribution * att;
-    }
 }
 
 void main()
@@ -97,8 +92,16 @@ void main()
 
     vec3 baseColor = surf.diffuse * 0.8; // Small ambient term for visibility
     
-    vec3 finalCol = baseColor + surf.diffuse * calcPointLight(surf);
+    // Only the lights whose range touches this fragment's cluster
+    vec3 lighting = vec3(0.0);
+    uvec2 clusterRange = getClusterRange(FragWPos);
+    for (uint i = 0u; i < clusterRange.y; i++)
+    {
+        lighting += calcPointLight(surf, getClusterLight(clusterRange, i));
+    }
+
+    vec3 finalCol = baseColor + surf.diffuse * lighting;
 
-    FragColor = vec4(finalCol, surf.alpha);
+    writeTransparent(finalCol, surf.alpha);
   
 }
\ No newline at end of file
@@ -3,14 +3,21 @@ layout (location = 0) out vec4 FragColor;
 
 in vec2 TexCoord;
 
+// Linear HDR scene colour
 uniform sampler2D mainTex;
 uniform vec2 cursor, resolution;
 uniform float time;
 
-uniform bool enableSepia;
-uniform bool enableFilmGrain;
-uniform bool enableBadTVSignal;
-uniform bool enableVignette;
+// Keywords (shader variants): TONEMAP, GRADING (hdr.glsl), BLOOM, AUTO_EXPOSURE, FILM_GRAIN, BAD_TV_SIGNAL, VIGNETTE
+#include "hdr.glsl"
+
+// Half size result of the bloom chain, linear HDR
+uniform sampler2D bloomTex;
+uniform float bloomIntensity;
+
+// 1x1 adapted scene luminance (AutoExposure), mapped to the key
+uniform sampler2D adaptedLuminance;
+uniform float exposureKey;
 
 uniform float filmGrainAmount;
 uniform float tvEffectStrength;
@@ -29,16 +36,6 @@ float vignette(float power)
     return vig;
 }
 
-//Sepia film grain post processing
-vec3 applySepia(vec3 color)
-{
-    vec3 sepia;
-    sepia.r = dot(color, vec3(0.393, 0.769, 0.189));
-    sepia.g = dot(color, vec3(0.349, 0.686, 0.168));
-    sepia.b = dot(color, vec3(0.272, 0.534, 0.131));
-    return sepia;
-}
-
 float random(vec2 uv)
 {
     return fract(sin(dot(uv.xy, vec2(12.9898, 78.233))) * 43758.5453);
@@ -89,27 +86,30 @@ void main()
 {   
     vec3 col = texture(mainTex, TexCoord).rgb;
 
-    if(enableSepia)
-    {
-        col = applySepia(col);
-    }
+#ifdef BLOOM
+    col += texture(bloomTex, TexCoord).rgb * bloomIntensity;
+#endif
 
-    if(enableFilmGrain)
-    {
-        col = applyFilmGrain(col, TexCoord);
-    }
+#ifdef AUTO_EXPOSURE
+    col *= exposureKey / max(texelFetch(adaptedLuminance, ivec2(0), 0).r, 0.0001);
+#endif
 
-    if(enableBadTVSignal)
-    {
-        col = applyBadTVSignal(col, TexCoord, tvEffectStrength);
-    }
+    // Tone mapping and grading (sepia included) first, the effects below work on display colour
+    col = applyHDR(col);
 
-    if(enableVignette)
-    {
-        float vig = vignette(vignettePower);
-        float ivig = 1.0 - vig;
-        col = vec3(0.0, 0.0, 0.0) * ivig + col * (1-ivig);
-    }
+#ifdef FILM_GRAIN
+    col = applyFilmGrain(col, TexCoord);
+#endif
+
+#ifdef BAD_TV_SIGNAL
+    col = applyBadTVSignal(col, TexCoord, tvEffectStrength);
+#endif
+
+#ifdef VIGNETTE
+    float vig = vignette(vignettePower);
+    float ivig = 1.0 - vig;
+    col = vec3(0.0, 0.0, 0.0) * ivig + col * (1-ivig);
+#endif
     
     FragColor = vec4(col, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,11 @@
+#version 330 core
+
+in vec2 TexCoord;
+
+// Alpha-tested casters (leaves) cut their shape out of the shadow
+uniform sampler2D alphaTexture;
+
+void main() {
+    if(texture(alphaTexture, TexCoord).a < 0.1)
+    {discard;}
+}
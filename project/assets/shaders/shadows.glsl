@@ -0,0 +1,47 @@
+// Directional light cascaded shadows, see shadow/cascaded_shadow_map.h
+// Requires: uniform mat4 view (declared in clustered_lights.glsl)
+
+uniform sampler2DShadow cascadeShadowMap;
+uniform mat4 cascadeViewProjection[4];
+uniform vec4 cascadeSplits;             // View depth where each cascade ends
+uniform vec4 cascadeTexelWorldSize;
+uniform float cascadeAtlasTexelSize;
+uniform bool enableCascadedShadows;
+
+// 1 = fully lit
+float getDirectionalShadow(vec3 worldPosition, vec3 normal)
+{
+    if (!enableCascadedShadows)
+        return 1.0;
+
+    float viewDepth = -(view * vec4(worldPosition, 1.0)).z;
+    if (viewDepth > cascadeSplits.w)
+        return 1.0;
+
+    int cascade = 3;
+    if (viewDepth <= cascadeSplits.z) cascade = 2;
+    if (viewDepth <= cascadeSplits.y) cascade = 1;
+    if (viewDepth <= cascadeSplits.x) cascade = 0;
+
+    // Normal offset of ~1.5 texels removes acne on slopes without visible peter-panning
+    vec3 offsetPosition = worldPosition + normal * cascadeTexelWorldSize[cascade] * 1.5;
+
+    vec4 lightClip = cascadeViewProjection[cascade] * vec4(offsetPosition, 1.0);
+    vec3 coords = lightClip.xyz / lightClip.w * 0.5 + 0.5;
+
+    // Cascades are packed 2x2 in the atlas; keep the filter footprint inside this tile
+    vec2 tileOrigin = vec2(cascade % 2, cascade / 2) * 0.5;
+    vec2 uv = clamp(tileOrigin + coords.xy * 0.5, tileOrigin + cascadeAtlasTexelSize * 1.5, tileOrigin + 0.5 - cascadeAtlasTexelSize * 1.5);
+
+    // 4 bilinear comparison taps
+    float shadow = 0.0;
+    shadow += texture(cascadeShadowMap, vec3(uv + vec2(-0.5, -0.5) * cascadeAtlasTexelSize, coords.z));
+    shadow += texture(cascadeShadowMap, vec3(uv + vec2( 0.5, -0.5) * cascadeAtlasTexelSize, coords.z));
+    shadow += texture(cascadeShadowMap, vec3(uv + vec2(-0.5,  0.5) * cascadeAtlasTexelSize, coords.z));
+    shadow += texture(cascadeShadowMap, vec3(uv + vec2( 0.5,  0.5) * cascadeAtlasTexelSize, coords.z));
+    shadow *= 0.25;
+
+    // Fade out over the last 10% of the shadow distance instead of a hard edge
+    float fade = clamp((cascadeSplits.w - viewDepth) / (cascadeSplits.w * 0.1), 0.0, 1.0);
+    return mix(1.0, shadow, fade);
+}
@@ -5,7 +5,15 @@ layout (location = 2) in vec2 aTexCoord;
 layout (location = 3) in vec3 aColor;
 layout (location = 4) in vec3 aTangent;
 
-uniform mat4 model, view, projection;
+#ifdef TEXTURE_ARRAYS
+// Per instance (SimpleRenderer::drawMeshInstanced)
+layout (location = 5) in mat4 aModel;
+layout (location = 9) in vec4 aInstanceMaterial;
+flat out vec4 InstanceMaterial;	// x diffuse layer, y specular layer, z material index, w normal layer
+#else
+uniform mat4 model;
+#endif
+uniform mat4 view, projection;
 
 out vec2 TexCoord;
 
@@ -15,6 +23,10 @@ out vec3 Tangent;
 
 void main()
 {
+#ifdef TEXTURE_ARRAYS
+	mat4 model = aModel;
+	InstanceMaterial = aInstanceMaterial;
+#endif
 	TexCoord = aTexCoord;
 
 	mat3 normalMatrix = mat3(transpose(inverse(model)));
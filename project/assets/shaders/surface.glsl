@@ -0,0 +1,10 @@
+// Lighting inputs of one shaded point.
+
+struct Surface {
+    vec3 worldPosition;
+    vec3 diffuse;
+    vec3 normal;
+    float alpha;
+    float specular;
+    float shininess;
+};
@@ -0,0 +1,22 @@
+#version 330 core
+layout (location = 0) out vec2 MotionVector;
+
+// Camera motion only: the entities' transforms do not change between frames
+uniform sampler2D sceneDepth;
+uniform mat4 invViewProjection;			// Jittered, as the depth was drawn
+uniform mat4 viewProjection;			// Unjittered, this frame
+uniform mat4 previousViewProjection;	// Unjittered, last frame
+
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec2 uv = gl_FragCoord.xy / vec2(textureSize(sceneDepth, 0));
+    float depth = texelFetch(sceneDepth, pixel, 0).r;
+
+    vec4 world = invViewProjection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+    world /= world.w;
+
+    // UV offset from last frame's position of this point to this frame's
+    vec4 current = viewProjection * world;
+    vec4 previous = previousViewProjection * world;
+    MotionVector = (current.xy / current.w - previous.xy / previous.w) * 0.5;
+}
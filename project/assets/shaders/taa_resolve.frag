@@ -0,0 +1,117 @@
+#version 330 core
+layout (location = 0) out vec4 FragColor;
+
+// Render size
+uniform sampler2D currentColour;
+uniform sampler2D sceneDepth;
+uniform sampler2D motionVectors;
+// Output size, last frame's result
+uniform sampler2D historyColour;
+
+uniform vec2 jitterUv;			// This frame's jitter in UV
+uniform float currentWeight;	// Of a current sample centred on the pixel
+uniform bool historyValid;
+
+// Blended compressed, so a few very bright HDR samples do not dominate or flicker
+vec3 compress(vec3 c) {
+    return c / (1.0 + max(c.r, max(c.g, c.b)));
+}
+
+vec3 decompress(vec3 c) {
+    return c / max(1.0 - max(c.r, max(c.g, c.b)), 0.0001);
+}
+
+// Catmull-Rom from 9 bilinear taps, sharper than bilinear so the history does not blur
+vec3 sampleHistory(vec2 uv) {
+    vec2 size = vec2(textureSize(historyColour, 0));
+    vec2 samplePos = uv * size;
+    vec2 texPos1 = floor(samplePos - 0.5) + 0.5;
+    vec2 f = samplePos - texPos1;
+
+    vec2 w0 = f * (-0.5 + f * (1.0 - 0.5 * f));
+    vec2 w1 = 1.0 + f * f * (-2.5 + 1.5 * f);
+    vec2 w2 = f * (0.5 + f * (2.0 - 1.5 * f));
+    vec2 w3 = f * f * (-0.5 + 0.5 * f);
+
+    vec2 w12 = w1 + w2;
+    vec2 pos0 = (texPos1 - 1.0) / size;
+    vec2 pos12 = (texPos1 + w2 / w12) / size;
+    vec2 pos3 = (texPos1 + 2.0) / size;
+
+    vec3 result = vec3(0.0);
+    result += texture(historyColour, vec2(pos0.x, pos0.y)).rgb * w0.x * w0.y;
+    result += texture(historyColour, vec2(pos12.x, pos0.y)).rgb * w12.x * w0.y;
+    result += texture(historyColour, vec2(pos3.x, pos0.y)).rgb * w3.x * w0.y;
+    result += texture(historyColour, vec2(pos0.x, pos12.y)).rgb * w0.x * w12.y;
+    result += texture(historyColour, vec2(pos12.x, pos12.y)).rgb * w12.x * w12.y;
+    result += texture(historyColour, vec2(pos3.x, pos12.y)).rgb * w3.x * w12.y;
+    result += texture(historyColour, vec2(pos0.x, pos3.y)).rgb * w0.x * w3.y;
+    result += texture(historyColour, vec2(pos12.x, pos3.y)).rgb * w12.x * w3.y;
+    result += texture(historyColour, vec2(pos3.x, pos3.y)).rgb * w3.x * w3.y;
+    return max(result, vec3(0.0));
+}
+
+// Moves colour towards the box centre until it is inside
+vec3 clipToBox(vec3 colour, vec3 centre, vec3 extent) {
+    vec3 offset = colour - centre;
+    vec3 units = abs(offset / max(extent, vec3(0.0001)));
+    float maxUnit = max(units.x, max(units.y, units.z));
+    return maxUnit > 1.0 ? centre + offset / maxUnit : colour;
+}
+
+void main() {
+    vec2 uv = gl_FragCoord.xy / vec2(textureSize(historyColour, 0));
+    ivec2 renderSize = textureSize(currentColour, 0);
+
+    // The rendered image is shifted by the jitter, so this pixel's unjittered position is
+    // found at uv + jitterUv in it
+    vec2 currentUv = uv + jitterUv;
+    if (!historyValid) {
+        FragColor = vec4(texture(currentColour, currentUv).rgb, 1.0);
+        return;
+    }
+
+    // Mean and deviation of the 3x3 render pixels around it, and the nearest depth among them
+    // so edges move with the foreground
+    vec2 renderPos = currentUv * vec2(renderSize);
+    ivec2 centre = clamp(ivec2(renderPos), ivec2(0), renderSize - 1);
+    vec3 m1 = vec3(0.0), m2 = vec3(0.0);
+    float nearestDepth = 1.0;
+    ivec2 nearestPixel = centre;
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            ivec2 pixel = clamp(centre + ivec2(x, y), ivec2(0), renderSize - 1);
+            vec3 c = compress(texelFetch(currentColour, pixel, 0).rgb);
+            m1 += c;
+            m2 += c * c;
+
+            float depth = texelFetch(sceneDepth, pixel, 0).r;
+            if (depth < nearestDepth) {
+                nearestDepth = depth;
+                nearestPixel = pixel;
+            }
+        }
+    }
+    vec3 mean = m1 / 9.0;
+    vec3 deviation = sqrt(max(m2 / 9.0 - mean * mean, vec3(0.0)));
+
+    vec3 current = compress(texelFetch(currentColour, centre, 0).rgb);
+
+    // Off screen last frame: nothing to reproject
+    vec2 historyUv = uv - texelFetch(motionVectors, nearestPixel, 0).rg;
+    if (any(lessThan(historyUv, vec2(0.0))) || any(greaterThan(historyUv, vec2(1.0)))) {
+        FragColor = vec4(decompress(current), 1.0);
+        return;
+    }
+
+    // History that no longer matches what is around this pixel (disocclusion, the fan's
+    // blades) is pulled into the neighbourhood's colour range
+    vec3 history = clipToBox(compress(sampleHistory(historyUv)), mean, deviation * 1.25);
+
+    // Below native resolution a render sample lands anywhere within a few output pixels, so it
+    // counts in proportion to how close it is (Gaussian of its distance in render pixels)
+    vec2 sampleOffset = vec2(centre) + 0.5 - renderPos;
+    float weight = clamp(currentWeight * 1.5 * exp(-2.29 * dot(sampleOffset, sampleOffset)), 0.0, 1.0);
+
+    FragColor = vec4(decompress(mix(history, current, weight)), 1.0);
+}
@@ -0,0 +1,48 @@
+#version 330 core
+layout (location = 0) out vec4 FragColor;
+
+// Reduced resolution transparents: rgb to add over the scene, a = transmittance of the
+// scene behind them (BlendMode::OFFSCREEN), and the depth they were tested against
+uniform sampler2D transparencyColour;
+uniform sampler2D transparencyDepth;
+uniform sampler2D sceneDepth;		// Full resolution
+uniform vec2 clipPlanes;			// Near, far
+
+float linearDepth(float depth) {
+    float z = depth * 2.0 - 1.0;
+    return 2.0 * clipPlanes.x * clipPlanes.y / (clipPlanes.y + clipPlanes.x - z * (clipPlanes.y - clipPlanes.x));
+}
+
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = linearDepth(texelFetch(sceneDepth, pixel, 0).r);
+
+    // The 2x2 reduced texels around this pixel and their bilinear weights
+    ivec2 lowSize = textureSize(transparencyColour, 0);
+    vec2 lowPos = gl_FragCoord.xy * vec2(lowSize) / vec2(textureSize(sceneDepth, 0)) - 0.5;
+    ivec2 base = ivec2(floor(lowPos));
+    vec2 f = lowPos - vec2(base);
+
+    // Bilateral: texels whose depth is far from this pixel's (across an edge) barely count,
+    // so a foreground pixel does not pick up the transparents behind it or the other way round
+    vec4 sum = vec4(0.0);
+    float totalWeight = 0.0;
+    for (int i = 0; i < 4; i++) {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        ivec2 texel = clamp(base + offset, ivec2(0), lowSize - 1);
+
+        vec2 bilinear = mix(1.0 - f, f, vec2(offset));
+        float lowDepth = linearDepth(texelFetch(transparencyDepth, texel, 0).r);
+        float weight = (bilinear.x * bilinear.y + 0.001) / (0.001 + abs(lowDepth - depth) / depth);
+
+        sum += texelFetch(transparencyColour, texel, 0) * weight;
+        totalWeight += weight;
+    }
+    vec4 result = sum / totalWeight;
+
+    // Nothing transparent here
+    if (result.a >= 0.999 && dot(result.rgb, result.rgb) < 0.000001)
+        discard;
+
+    FragColor = result;
+}
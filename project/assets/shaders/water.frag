@@ -1,6 +1,8 @@
 #version 330 core
-layout (location = 0) out vec4 FragColor;
+// FragColor, or the OIT targets
+#include "oit.glsl"
 
+// Scene colour behind the transparents (maybe downscaled), and the distortion from the material
 uniform sampler2D opaqueTex;
 uniform sampler2D distortTex;
 
@@ -16,12 +18,15 @@ void main()
 	vec2 distort = texture(distortTex, TexCoord + vec2(time * 0.5, 0.0)).xy;
 	vec2 DistortPower =  distort.xy * 0.05;
 
-	vec2 DistortedUV = TexCoord + DistortPower;
+	// Screen-space refraction: offset where this pixel samples the scene behind it
+	vec2 DistortedUV = gl_FragCoord.xy / resolution + DistortPower;
 
 	vec4 screenCol = texture(opaqueTex, DistortedUV);
 
-	FragColor = screenCol * col;
+	vec4 colour = screenCol * col;
 	
-	if (FragColor.a < 0.1)
+	if (colour.a < 0.1)
         discard;
+
+	writeTransparent(colour.rgb, colour.a);
 }
\ No newline at end of file
@@ -15,6 +15,11 @@ const glm::mat4 CameraBase::getProjectionMatrix() const
 	return projData.getProjectionMatrix();
 }
 
+const glm::mat4 CameraBase::getUnjitteredProjectionMatrix() const
+{
+	return projData.getUnjitteredProjectionMatrix();
+}
+
 const glm::mat4 CameraBase::getMatrixVP() const
 {
 	return vp;
@@ -89,6 +94,12 @@ void CameraBase::setViewportSize(unsigned int viewportWidth, unsigned int viewpo
 	isDirty = true;
 }
 
+void CameraBase::setJitter(const glm::vec2& offset)
+{
+	projData.setJitter(offset);
+	vp = getProjectionMatrix() * view;
+}
+
 void CameraBase::update(float deltaTime)
 {
 	if (processInput)
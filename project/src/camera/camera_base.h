@@ -29,6 +29,7 @@ public:
 	CameraBase() : position(0.0f, 0.0f, 0.0f), isDirty(true) {}
 
 	const glm::mat4 getProjectionMatrix() const;
+	const glm::mat4 getUnjitteredProjectionMatrix() const;
 	const glm::mat4 getMatrixVP() const;
 
 	const glm::vec3 getPosition() const;
@@ -48,6 +49,8 @@ public:
 	void setNearClip(float zNear);
 	void setFarClip(float zFar);
 	void setViewportSize(unsigned int viewportWidth, unsigned int viewportHeight);
+	// Projection jitter in NDC, applied to getProjectionMatrix() and getMatrixVP() right away
+	void setJitter(const glm::vec2& offset);
 
 	virtual inline const glm::mat4& getViewMatrix() const
 	{
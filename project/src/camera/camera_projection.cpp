@@ -2,6 +2,17 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 const glm::mat4 CameraProjectionData::getProjectionMatrix()
+{
+	glm::mat4 result = getUnjitteredProjectionMatrix();
+
+	// Translating clip space by jitter * w moves everything by jitter after the divide
+	if (jitter != glm::vec2(0.0f))
+		result = glm::translate(glm::mat4(1.0f), glm::vec3(jitter, 0.0f)) * result;
+
+	return result;
+}
+
+const glm::mat4 CameraProjectionData::getUnjitteredProjectionMatrix()
 {
 	if (isDirty)
 	{
@@ -59,6 +70,11 @@ void CameraProjectionData::setProjectionType(CameraProjectionType projType)
 	isDirty = true;
 }
 
+void CameraProjectionData::setJitter(const glm::vec2& offset)
+{
+	jitter = offset;
+}
+
 void CameraProjectionData::recalc()
 {
 	if (viewportHeight == 0) return;
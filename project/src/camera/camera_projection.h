@@ -12,7 +12,9 @@ class CameraProjectionData
 public:
 	friend class CameraBase;
 
+	// With the jitter applied
 	const glm::mat4 getProjectionMatrix();
+	const glm::mat4 getUnjitteredProjectionMatrix();
 
 	void setFieldOfView(float fovDegrees);
 	void setOrthoSize(float orthoSize);
@@ -20,6 +22,8 @@ public:
 	void setFarClip(float zFar);
 	void setViewportSize(unsigned int viewportWidth, unsigned int viewportHeight);
 	void setProjectionType(CameraProjectionType projType);
+	// Sub-pixel offset for temporal anti-aliasing, in NDC (2 / render size is one pixel)
+	void setJitter(const glm::vec2& offset);
 
 private:
 	glm::mat4 projection;
@@ -30,6 +34,7 @@ private:
 	float zNear = 0.1f;
 	float zFar = 400.0f;
 	unsigned int viewportWidth, viewportHeight;
+	glm::vec2 jitter = glm::vec2(0.0f);
 	bool isDirty = false;
 
 	void recalc();
@@ -31,6 +31,12 @@ static std::string to_string(ColourFormat fmt)
 	{
 	case ColourFormat::RGB: result = "RGB"; break;
 	case ColourFormat::RGBA: result = "RGBA"; break;
+	case ColourFormat::RGBA_8: result = "RGBA_8"; break;
+	case ColourFormat::RGB10_A2: result = "RGB10_A2"; break;
+	case ColourFormat::R11G11B10_F: result = "R11G11B10_F"; break;
+	case ColourFormat::R_16F: result = "R_16F"; break;
+	case ColourFormat::R_32F: result = "R_32F"; break;
+	case ColourFormat::RG_16F: result = "RG_16F"; break;
 	case ColourFormat::RGB_16F: result = "RGB_16F"; break;
 	case ColourFormat::RGBA_16F: result = "RGBA_16F"; break;
 	case ColourFormat::RGB_32F: result = "RGB_32F"; break;
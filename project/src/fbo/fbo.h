@@ -16,6 +16,12 @@ enum class ColourFormat
 {
 	RGB = GL_RGB,
 	RGBA = GL_RGBA,
+	RGBA_8 = GL_RGBA8,
+	RGB10_A2 = GL_RGB10_A2,
+	R11G11B10_F = GL_R11F_G11F_B10F,	// HDR colour without alpha at half the size of RGBA_16F
+	R_16F = GL_R16F,
+	R_32F = GL_R32F,
+	RG_16F = GL_RG16F,
 	RGB_16F = GL_RGB16F,
 	RGBA_16F = GL_RGBA16F,
 	RGB_32F = GL_RGB32F,
@@ -0,0 +1,298 @@
+#include "frame_graph.h"
+#include "../framework/simplerenderer.h"
+#include "../framework/gpu_profiler.h"
+#include <algorithm>
+#include <iostream>
+#include <set>
+
+#ifdef XBGT2094_ENABLE_IMGUI
+#include "imgui/imgui.h"
+#endif
+
+struct FrameGraphTarget
+{
+	std::string name;
+	RenderTargetDesc desc;
+	Texture2D* texture;
+	int firstUse, lastUse;		// Indices of the first and last kept pass using it, -1 if none
+	bool written;				// Cleared by its first write
+	bool imported;				// Texture owned outside the graph, kept across frames
+	bool hasClearColour;		// Else cleared to the GL clear colour
+	glm::vec4 clearColour;
+};
+
+struct FrameGraphPass
+{
+	std::string name;
+	std::vector<FrameGraphResource> reads, colourWrites;
+	FrameGraphResource depthWrite;
+	std::function<void()> execute;
+	bool culled;
+};
+
+static std::vector<FrameGraphTarget> targets;
+static std::vector<FrameGraphPass> passes;
+static size_t usedBytes, unsharedBytes;
+
+void FrameGraph::beginFrame()
+{
+	targets.clear();
+	passes.clear();
+
+	// BACKBUFFER, never backed by a pooled texture
+	FrameGraphTarget backbuffer = {};
+	backbuffer.name = "Backbuffer";
+	backbuffer.firstUse = backbuffer.lastUse = -1;
+	targets.push_back(backbuffer);
+}
+
+FrameGraphResource FrameGraph::createTarget(const std::string& name, const RenderTargetDesc& desc)
+{
+	FrameGraphTarget target = {};
+	target.name = name;
+	target.desc = desc;
+	target.firstUse = target.lastUse = -1;
+	targets.push_back(target);
+	return (FrameGraphResource)targets.size() - 1;
+}
+
+FrameGraphResource FrameGraph::importTexture(const std::string& name, const RenderTargetDesc& desc, Texture2D* texture)
+{
+	FrameGraphTarget target = {};
+	target.name = name;
+	target.desc = desc;
+	target.texture = texture;
+	target.firstUse = target.lastUse = -1;
+	target.written = true;
+	target.imported = true;
+	targets.push_back(target);
+	return (FrameGraphResource)targets.size() - 1;
+}
+
+void FrameGraph::setClearColour(FrameGraphResource resource, const glm::vec4& colour)
+{
+	targets[resource].hasClearColour = true;
+	targets[resource].clearColour = colour;
+}
+
+void FrameGraph::addPass(const std::string& name, const std::vector<FrameGraphResource>& reads,
+	const std::vector<FrameGraphResource>& colourWrites, FrameGraphResource depthWrite, std::function<void()> execute)
+{
+	passes.push_back({ name, reads, colourWrites, depthWrite, execute, false });
+}
+
+static std::vector<FrameGraphResource> getWrites(const FrameGraphPass& pass)
+{
+	std::vector<FrameGraphResource> writes = pass.colourWrites;
+	if (pass.depthWrite != FrameGraph::NO_RESOURCE)
+		writes.push_back(pass.depthWrite);
+	return writes;
+}
+
+// Walks back from the passes writing the backbuffer; a pass is kept if a kept pass after it
+// reads one of its writes. Writes stay needed too, as later passes draw over them.
+static void cullPasses()
+{
+	std::vector<bool> needed(targets.size(), false);
+	needed[FrameGraph::BACKBUFFER] = true;
+
+	for (int i = (int)passes.size() - 1; i >= 0; i--)
+	{
+		FrameGraphPass& pass = passes[i];
+
+		pass.culled = true;
+		for (FrameGraphResource write : getWrites(pass))
+			pass.culled = pass.culled && !needed[write];
+
+		if (pass.culled)
+			continue;
+
+		for (FrameGraphResource read : pass.reads)
+			needed[read] = true;
+	}
+}
+
+static void computeLifetimes()
+{
+	// Reported once per name, not every frame
+	static std::set<std::string> warned;
+
+	unsharedBytes = 0;
+	for (int i = 0; i < (int)passes.size(); i++)
+	{
+		const FrameGraphPass& pass = passes[i];
+		if (pass.culled)
+			continue;
+
+		for (FrameGraphResource read : pass.reads)
+		{
+			FrameGraphTarget& target = targets[read];
+			if (target.firstUse < 0 && !target.imported && warned.insert(pass.name + target.name).second)
+				std::cout << "FrameGraph: " << pass.name << " reads " << target.name << " before any pass writes it" << std::endl;
+		}
+
+		std::vector<FrameGraphResource> uses = pass.reads;
+		for (FrameGraphResource write : getWrites(pass))
+			uses.push_back(write);
+
+		for (FrameGraphResource use : uses)
+		{
+			if (use == FrameGraph::BACKBUFFER)
+				continue;
+
+			FrameGraphTarget& target = targets[use];
+			if (target.firstUse < 0 && !target.imported)
+				unsharedBytes += target.desc.getDataSize();
+			if (target.firstUse < 0)
+				target.firstUse = i;
+			target.lastUse = i;
+		}
+	}
+}
+
+// Binds the pass's framebuffer and viewport, and clears the targets it writes first
+static void bindPassTargets(FrameGraphPass& pass)
+{
+	if (pass.colourWrites.size() == 1 && pass.colourWrites[0] == FrameGraph::BACKBUFFER)
+	{
+		if (pass.depthWrite != FrameGraph::NO_RESOURCE)
+			std::cout << "FrameGraph: " << pass.name << " writes the backbuffer with a depth target" << std::endl;
+
+		SimpleRenderer::bindFBO_Default();
+		return;
+	}
+
+	std::vector<FrameGraphResource> writes = getWrites(pass);
+	if (writes.empty())
+		return;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, FrameGraph::getFramebuffer(pass.colourWrites, pass.depthWrite));
+	glm::uvec2 size = targets[writes[0]].desc.size;
+	glViewport(0, 0, size.x, size.y);
+
+	GLfloat clearColour[4];
+	glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColour);
+	for (int i = 0; i < (int)pass.colourWrites.size(); i++)
+	{
+		FrameGraphTarget& target = targets[pass.colourWrites[i]];
+		if (!target.written)
+			glClearBufferfv(GL_COLOR, i, target.hasClearColour ? &target.clearColour[0] : clearColour);
+		target.written = true;
+	}
+
+	if (pass.depthWrite != FrameGraph::NO_RESOURCE)
+	{
+		FrameGraphTarget& target = targets[pass.depthWrite];
+		GLfloat clearDepth = 1.0f;
+		if (!target.written)
+			glClearBufferfv(GL_DEPTH, 0, &clearDepth);
+		target.written = true;
+	}
+}
+
+void FrameGraph::execute()
+{
+	cullPasses();
+	computeLifetimes();
+
+	std::vector<Texture2D*> used;
+	usedBytes = 0;
+
+	for (int i = 0; i < (int)passes.size(); i++)
+	{
+		FrameGraphPass& pass = passes[i];
+		if (pass.culled)
+			continue;
+
+		for (FrameGraphTarget& target : targets)
+		{
+			if (target.firstUse != i || target.imported)
+				continue;
+
+			target.texture = RenderTargetPool::acquire(target.desc);
+			if (std::find(used.begin(), used.end(), target.texture) == used.end())
+			{
+				used.push_back(target.texture);
+				usedBytes += target.desc.getDataSize();
+			}
+		}
+
+		bindPassTargets(pass);
+
+		GPUProfiler::begin(pass.name);
+		pass.execute();
+		GPUProfiler::end();
+
+		for (FrameGraphTarget& target : targets)
+		{
+			if (target.lastUse == i && !target.imported)
+				RenderTargetPool::release(target.texture);
+		}
+	}
+
+	SimpleRenderer::bindFBO_Default();
+	RenderTargetPool::endFrame();
+}
+
+Texture2D* FrameGraph::getTexture(FrameGraphResource resource)
+{
+	Texture2D* texture = targets[resource].texture;
+	if (texture == nullptr)
+		std::cout << "FrameGraph: " << targets[resource].name << " has no texture outside its lifetime" << std::endl;
+	return texture;
+}
+
+unsigned int FrameGraph::getFramebuffer(const std::vector<FrameGraphResource>& colours, FrameGraphResource depth)
+{
+	std::vector<Texture2D*> colourTextures;
+	for (FrameGraphResource colour : colours)
+		colourTextures.push_back(getTexture(colour));
+
+	return RenderTargetPool::getFramebuffer(colourTextures, depth != NO_RESOURCE ? getTexture(depth) : nullptr);
+}
+
+size_t FrameGraph::getUsedBytes()
+{
+	return usedBytes;
+}
+
+size_t FrameGraph::getUnsharedBytes()
+{
+	return unsharedBytes;
+}
+
+#ifdef XBGT2094_ENABLE_IMGUI
+void FrameGraph::imgui_drawStats()
+{
+	const float MB = 1024.0f * 1024.0f;
+
+	unsigned int culled = 0;
+	for (const FrameGraphPass& pass : passes)
+		culled += pass.culled ? 1 : 0;
+
+	ImGui::Text("Frame graph: %u passes (%u culled), %u targets", (unsigned int)passes.size(), culled, (unsigned int)targets.size() - 1);
+	ImGui::Text("Targets: %.1f MB used vs %.1f MB unshared, pool %u textures %.1f MB", usedBytes / MB, unsharedBytes / MB,
+		RenderTargetPool::getTextureCount(), RenderTargetPool::getAllocatedBytes() / MB);
+
+	if (ImGui::TreeNode("Passes"))
+	{
+		for (const FrameGraphPass& pass : passes)
+			ImGui::Text("%s%s", pass.name.c_str(), pass.culled ? " (culled)" : "");
+		ImGui::TreePop();
+	}
+
+	if (ImGui::TreeNode("Targets"))
+	{
+		for (size_t i = 1; i < targets.size(); i++)
+		{
+			const FrameGraphTarget& target = targets[i];
+			if (target.firstUse < 0)
+				ImGui::Text("%s: unused", target.name.c_str());
+			else
+				ImGui::Text("%s %ux%u: passes %d-%d, texture %u", target.name.c_str(), target.desc.size.x, target.desc.size.y,
+					target.firstUse, target.lastUse, target.texture->getNativeHandle());
+		}
+		ImGui::TreePop();
+	}
+}
+#endif
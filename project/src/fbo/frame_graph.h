@@ -0,0 +1,60 @@
+#pragma once
+#include "render_target_pool.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+// A target declared to the frame graph this frame
+typedef int FrameGraphResource;
+
+// Per-frame graph of the render passes that draw into framebuffers.
+//
+// Each frame the scene declares its targets and its passes, in execution order, with the
+// targets every pass reads (as textures) and writes (as attachments). execute() then:
+// - culls the passes whose writes nothing later reads; passes writing the backbuffer are kept
+// - gives each target a pooled texture from its first to its last use by a kept pass, so
+//   targets that are never live at the same time share memory (RenderTargetPool)
+// - for each kept pass binds a framebuffer of its writes, clears the targets written for the
+//   first time this frame (their memory may have held another target) and times it with
+//   GPUProfiler under the pass name
+//
+// Targets are declared at the size they are wanted this frame, so resizes need no handling
+// beyond trimming the pool. Textures that must outlive the frame (e.g. history) are owned by
+// their system and imported every frame; they are never pooled or cleared.
+class FrameGraph
+{
+public:
+	FrameGraph() = delete;
+
+	static const FrameGraphResource NO_RESOURCE = -1;
+	// The default framebuffer. Only as a pass's single colour write.
+	static const FrameGraphResource BACKBUFFER = 0;
+
+	// Forgets last frame's targets and passes
+	static void beginFrame();
+
+	static FrameGraphResource createTarget(const std::string& name, const RenderTargetDesc& desc);
+	static FrameGraphResource importTexture(const std::string& name, const RenderTargetDesc& desc, Texture2D* texture);
+
+	// Colour a target is cleared to by its first write, instead of the GL clear colour
+	static void setClearColour(FrameGraphResource resource, const glm::vec4& colour);
+
+	// Writes are attachments in the given order; depthWrite may be NO_RESOURCE. A pass that
+	// depth tests against a target without writing it still lists it as depthWrite.
+	static void addPass(const std::string& name, const std::vector<FrameGraphResource>& reads,
+		const std::vector<FrameGraphResource>& colourWrites, FrameGraphResource depthWrite, std::function<void()> execute);
+
+	static void execute();
+
+	// While executing: the texture behind a target, and a framebuffer of targets (e.g. to blit)
+	static Texture2D* getTexture(FrameGraphResource resource);
+	static unsigned int getFramebuffer(const std::vector<FrameGraphResource>& colours, FrameGraphResource depth);
+
+	// Bytes of the textures used this frame, and what the targets would take unshared
+	static size_t getUsedBytes();
+	static size_t getUnsharedBytes();
+
+#ifdef XBGT2094_ENABLE_IMGUI
+	static void imgui_drawStats();
+#endif
+};
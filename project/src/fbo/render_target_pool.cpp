@@ -0,0 +1,231 @@
+#include "render_target_pool.h"
+#include <iostream>
+#include <algorithm>
+
+RenderTargetDesc RenderTargetDesc::colour(glm::uvec2 size, ColourFormat format, TextureFilterMode filter)
+{
+	RenderTargetDesc desc;
+	desc.size = size;
+	desc.colourFormat = format;
+	desc.depthFormat = DepthFormat::ZERO;
+	desc.filterMode = filter;
+	return desc;
+}
+
+RenderTargetDesc RenderTargetDesc::depth(glm::uvec2 size, DepthFormat format)
+{
+	RenderTargetDesc desc;
+	desc.size = size;
+	desc.colourFormat = ColourFormat::RGBA_8;
+	desc.depthFormat = format;
+	desc.filterMode = TextureFilterMode::NEAREST;
+	return desc;
+}
+
+bool RenderTargetDesc::isDepth() const
+{
+	return depthFormat != DepthFormat::ZERO;
+}
+
+GLint RenderTargetDesc::getInternalFormat() const
+{
+	return isDepth() ? (GLint)depthFormat : (GLint)colourFormat;
+}
+
+size_t RenderTargetDesc::getDataSize() const
+{
+	// As stored by typical drivers: RGB formats are padded to four channels, DEPTH24 to 32 bits
+	size_t bytesPerPixel = 4;
+	switch (getInternalFormat())
+	{
+	case GL_DEPTH_COMPONENT16: case GL_R16F: bytesPerPixel = 2; break;
+	case GL_RG16F: bytesPerPixel = 4; break;
+	case GL_RGB16F: case GL_RGBA16F: bytesPerPixel = 8; break;
+	case GL_RGB32F: bytesPerPixel = 12; break;
+	case GL_RGBA32F: bytesPerPixel = 16; break;
+	default: break;
+	}
+	return (size_t)size.x * size.y * bytesPerPixel;
+}
+
+struct PooledTexture
+{
+	Texture2D* texture;
+	GLint internalFormat;
+	glm::uvec2 size;
+	size_t bytes;
+	bool inUse;
+	unsigned int unusedFrames;
+};
+
+struct CachedFramebuffer
+{
+	std::vector<unsigned int> attachments;	// Colour handles, then the depth handle (0 without)
+	unsigned int handle;
+};
+
+static std::vector<PooledTexture> textures;
+static std::vector<CachedFramebuffer> framebuffers;
+
+Texture2D* RenderTargetPool::acquire(const RenderTargetDesc& desc)
+{
+	GLint internalFormat = desc.getInternalFormat();
+	GLint filter = desc.filterMode == TextureFilterMode::LINEAR ? GL_LINEAR : GL_NEAREST;
+
+	for (PooledTexture& pooled : textures)
+	{
+		if (pooled.inUse || pooled.internalFormat != internalFormat || pooled.size != desc.size)
+			continue;
+
+		pooled.inUse = true;
+		pooled.unusedFrames = 0;
+
+		glBindTexture(GL_TEXTURE_2D, pooled.texture->getNativeHandle());
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		return pooled.texture;
+	}
+
+	Texture2D* texture;
+	if (desc.isDepth())
+	{
+		texture = Texture2D::createDepthTexture(desc.size.x, desc.size.y, internalFormat, false);
+	}
+	else
+	{
+		TextureConfig cfg(TextureWrapMode::CLAMP, TextureWrapMode::CLAMP, desc.filterMode, false);
+		cfg.internalFormat = internalFormat;
+		texture = Texture2D::createColourTexture(desc.size.x, desc.size.y, cfg, GL_RGB, nullptr);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	textures.push_back({ texture, internalFormat, desc.size, desc.getDataSize(), true, 0 });
+	return texture;
+}
+
+void RenderTargetPool::release(Texture2D* texture)
+{
+	for (PooledTexture& pooled : textures)
+	{
+		if (pooled.texture == texture)
+		{
+			pooled.inUse = false;
+			return;
+		}
+	}
+	std::cout << "RenderTargetPool: released a texture it does not own" << std::endl;
+}
+
+static void deleteFramebuffersUsing(unsigned int textureHandle)
+{
+	for (size_t i = 0; i < framebuffers.size();)
+	{
+		const std::vector<unsigned int>& attachments = framebuffers[i].attachments;
+		if (std::find(attachments.begin(), attachments.end(), textureHandle) == attachments.end())
+		{
+			i++;
+			continue;
+		}
+
+		glDeleteFramebuffers(1, &framebuffers[i].handle);
+		framebuffers.erase(framebuffers.begin() + i);
+	}
+}
+
+static void deleteFreeTextures(unsigned int minUnusedFrames)
+{
+	for (size_t i = 0; i < textures.size();)
+	{
+		if (textures[i].inUse || textures[i].unusedFrames < minUnusedFrames)
+		{
+			i++;
+			continue;
+		}
+
+		deleteFramebuffersUsing(textures[i].texture->getNativeHandle());
+		delete textures[i].texture;
+		textures.erase(textures.begin() + i);
+	}
+}
+
+void RenderTargetPool::endFrame()
+{
+	for (PooledTexture& pooled : textures)
+	{
+		if (!pooled.inUse)
+			pooled.unusedFrames++;
+	}
+	deleteFreeTextures(MAX_UNUSED_FRAMES);
+}
+
+void RenderTargetPool::trim()
+{
+	deleteFreeTextures(0);
+}
+
+unsigned int RenderTargetPool::getFramebuffer(const std::vector<Texture2D*>& colours, Texture2D* depth)
+{
+	std::vector<unsigned int> attachments;
+	for (Texture2D* colour : colours)
+		attachments.push_back(colour->getNativeHandle());
+	attachments.push_back(depth ? depth->getNativeHandle() : 0);
+
+	for (const CachedFramebuffer& cached : framebuffers)
+	{
+		if (cached.attachments == attachments)
+			return cached.handle;
+	}
+
+	// Created while a pass may have its own framebuffer bound, so put that back afterwards
+	GLint drawBinding = 0, readBinding = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawBinding);
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readBinding);
+
+	unsigned int handle;
+	glGenFramebuffers(1, &handle);
+	glBindFramebuffer(GL_FRAMEBUFFER, handle);
+
+	std::vector<GLenum> drawBuffers;
+	for (size_t i = 0; i < colours.size(); i++)
+	{
+		drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + (GLenum)i);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, drawBuffers.back(), GL_TEXTURE_2D, colours[i]->getNativeHandle(), 0);
+	}
+	if (depth)
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth->getNativeHandle(), 0);
+
+	// Depth-only framebuffers must not name a colour buffer to be complete on GL 3.3
+	if (drawBuffers.empty())
+	{
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+	}
+	else
+	{
+		glDrawBuffers((GLsizei)drawBuffers.size(), drawBuffers.data());
+		glReadBuffer(GL_COLOR_ATTACHMENT0);
+	}
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "RenderTargetPool: framebuffer not complete!" << std::endl;
+
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawBinding);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, readBinding);
+
+	framebuffers.push_back({ attachments, handle });
+	return handle;
+}
+
+unsigned int RenderTargetPool::getTextureCount()
+{
+	return (unsigned int)textures.size();
+}
+
+size_t RenderTargetPool::getAllocatedBytes()
+{
+	size_t total = 0;
+	for (const PooledTexture& pooled : textures)
+		total += pooled.bytes;
+	return total;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "fbo.h"
+#include <vector>
+
+// Size and format of a frame graph target
+struct RenderTargetDesc
+{
+	glm::uvec2 size;
+	ColourFormat colourFormat;
+	DepthFormat depthFormat;		// Not ZERO for depth targets, which ignore colourFormat
+	TextureFilterMode filterMode;	// Sampler state only, targets differing in it share textures
+
+	static RenderTargetDesc colour(glm::uvec2 size, ColourFormat format, TextureFilterMode filter);
+	static RenderTargetDesc depth(glm::uvec2 size, DepthFormat format);
+
+	bool isDepth() const;
+	GLint getInternalFormat() const;
+	size_t getDataSize() const;
+};
+
+// Textures for the frame graph's transient targets, and framebuffers to render into them.
+//
+// A released texture goes back to the pool and the next target of the same format and size
+// takes it over, so targets whose lifetimes don't overlap share memory. GL 3.3 has no way to
+// alias memory between different formats, so those always get their own textures. Textures
+// free for MAX_UNUSED_FRAMES are deleted, which is also how targets of an old size go away
+// after a resize.
+class RenderTargetPool
+{
+public:
+	RenderTargetPool() = delete;
+
+	static const unsigned int MAX_UNUSED_FRAMES = 8;
+
+	static Texture2D* acquire(const RenderTargetDesc& desc);
+	static void release(Texture2D* texture);
+
+	// Ages the free textures; call once per frame after the last release()
+	static void endFrame();
+	// Deletes every free texture now, e.g. after a resize
+	static void trim();
+
+	// Framebuffer with these attachments (depth may be null), created on first use and kept
+	// until one of them is deleted. Draw buffers cover every colour attachment in order.
+	static unsigned int getFramebuffer(const std::vector<Texture2D*>& colours, Texture2D* depth);
+
+	static unsigned int getTextureCount();
+	static size_t getAllocatedBytes();
+};
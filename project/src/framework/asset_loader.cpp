@@ -0,0 +1,184 @@
+#include "asset_loader.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static std::vector<std::thread> loaders;
+static std::deque<AssetLoader::DecodeFunc> decodeQueue;
+static std::mutex decodeMutex;
+static std::condition_variable decodeCondition;
+static bool stopping = false;
+
+static std::deque<AssetLoader::UploadFunc> uploadQueue;
+static std::mutex uploadMutex;
+
+static std::atomic<unsigned int> submitted(0);
+static std::atomic<unsigned int> finished(0);			// Decoded and uploaded, or failed
+static std::atomic<long long> decodeMicroseconds(0);	// Summed over the loader threads
+static double uploadMs = 0.0;
+
+static Clock::time_point startTime;
+static bool firstFrameLogged = false;
+static bool fullyLoadedLogged = true;
+
+static double getMsSince(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static void loaderLoop()
+{
+	while (true)
+	{
+		AssetLoader::DecodeFunc decode;
+		{
+			std::unique_lock<std::mutex> lock(decodeMutex);
+			decodeCondition.wait(lock, [] { return stopping || !decodeQueue.empty(); });
+
+			if (stopping)
+				return;
+
+			decode = std::move(decodeQueue.front());
+			decodeQueue.pop_front();
+		}
+
+		Clock::time_point start = Clock::now();
+		AssetLoader::UploadFunc upload = decode();
+		decodeMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+
+		if (upload)
+		{
+			std::lock_guard<std::mutex> lock(uploadMutex);
+			uploadQueue.push_back(upload);
+		}
+		else
+		{
+			finished++;
+		}
+	}
+}
+
+void AssetLoader::init(unsigned int threadCount)
+{
+	if (!loaders.empty()) return;
+
+	startTime = Clock::now();
+
+	if (threadCount == 0)
+	{
+		unsigned int hw = std::thread::hardware_concurrency();
+		threadCount = std::max(hw / 2, 1u);
+	}
+
+	stopping = false;
+	for (unsigned int i = 0; i < threadCount; i++)
+	{
+		loaders.emplace_back(loaderLoop);
+	}
+}
+
+void AssetLoader::shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(decodeMutex);
+		stopping = true;
+		decodeQueue.clear();
+	}
+	decodeCondition.notify_all();
+
+	for (auto& loader : loaders)
+	{
+		loader.join();
+	}
+
+	loaders.clear();
+	uploadQueue.clear();
+}
+
+void AssetLoader::submit(DecodeFunc decode)
+{
+	init();
+
+	submitted++;
+	fullyLoadedLogged = false;
+
+	{
+		std::lock_guard<std::mutex> lock(decodeMutex);
+		decodeQueue.push_back(decode);
+	}
+	decodeCondition.notify_one();
+}
+
+void AssetLoader::update(float budgetMs)
+{
+	Clock::time_point start = Clock::now();
+	unsigned int uploads = 0;
+	std::vector<UploadFunc> unfinished;
+
+	while (true)
+	{
+		UploadFunc upload;
+		{
+			std::lock_guard<std::mutex> lock(uploadMutex);
+			if (uploadQueue.empty())
+				break;
+
+			upload = std::move(uploadQueue.front());
+			uploadQueue.pop_front();
+		}
+
+		uploads++;
+		if (upload())
+			finished++;
+		else
+			unfinished.push_back(std::move(upload));
+
+		if (getMsSince(start) >= budgetMs)
+			break;
+	}
+
+	// Streaming uploads go to the back so the rest of the queue keeps moving
+	if (!unfinished.empty())
+	{
+		std::lock_guard<std::mutex> lock(uploadMutex);
+		for (auto& upload : unfinished)
+			uploadQueue.push_back(std::move(upload));
+	}
+
+	if (uploads > 0)
+		uploadMs += getMsSince(start);
+}
+
+void AssetLoader::frameDisplayed()
+{
+	if (!firstFrameLogged)
+	{
+		firstFrameLogged = true;
+		printf("Time to first frame: %.1f ms (%u assets still loading)\n", getMsSince(startTime), getPendingCount());
+	}
+
+	if (!fullyLoadedLogged && getPendingCount() == 0)
+	{
+		fullyLoadedLogged = true;
+		printf("Time to fully loaded: %.1f ms (%u assets, %.1f ms decoding on %u loader threads, %.1f ms uploading)\n",
+			getMsSince(startTime), (unsigned int)submitted, decodeMicroseconds / 1000.0, (unsigned int)loaders.size(), uploadMs);
+	}
+}
+
+unsigned int AssetLoader::getPendingCount()
+{
+	return submitted - finished;
+}
+
+unsigned int AssetLoader::getLoadedCount()
+{
+	return finished;
+}
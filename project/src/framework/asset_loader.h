@@ -0,0 +1,40 @@
+#pragma once
+#include <functional>
+
+// Loads assets in the background.
+//
+// File reads and decoding run on a few loader threads of their own (a long decode queued on
+// the JobSystem would stall whoever is waiting in parallelFor). Each decode returns an upload
+// function, which update() runs on the render thread within a per-frame time budget. An upload
+// that streams over several frames (see texture/texture_upload.h) returns false until it is done.
+//
+// The *Async loaders in TextureUtils and MeshUtils hand out their Texture2D*/Mesh* straight
+// away holding a placeholder; the upload fills the same object in place.
+class AssetLoader
+{
+public:
+	AssetLoader() = delete;
+
+	// Runs on the render thread; returns false to be called again next frame
+	typedef std::function<bool()> UploadFunc;
+	// Runs on a loader thread; returns nullptr if there is nothing to upload
+	typedef std::function<UploadFunc()> DecodeFunc;
+
+	// Call first thing in main(), load times are measured from here.
+	// threadCount == 0 uses half the hardware threads (at least 1).
+	static void init(unsigned int threadCount = 0);
+	static void shutdown();
+
+	static void submit(DecodeFunc decode);
+
+	// Once per frame. At least one upload runs even over budget so loading always progresses.
+	// The time to fully loaded includes uploads still streaming.
+	static void update(float budgetMs);
+
+	// Call after each frame is presented; logs the time to the first frame and, once
+	// everything submitted is uploaded, the time to fully loaded
+	static void frameDisplayed();
+
+	static unsigned int getPendingCount();
+	static unsigned int getLoadedCount();
+};
@@ -0,0 +1,124 @@
+#include "gpu_profiler.h"
+#include <glad/glad.h>
+#include <vector>
+#include <map>
+#include <iostream>
+
+#ifdef XBGT2094_ENABLE_IMGUI
+#include "imgui/imgui.h"
+#endif
+
+struct GPUProfilerScope
+{
+	std::string name;
+	unsigned int depth = 0;
+
+	// [frame slot][0 = begin, 1 = end]
+	unsigned int queries[GPUProfiler::QUERY_LATENCY][2];
+	bool pending[GPUProfiler::QUERY_LATENCY] = {};
+
+	float lastMs = 0.0f;
+	float smoothedMs = 0.0f;
+};
+
+// Scopes are kept in first-use order so the stats read like the frame.
+static std::vector<GPUProfilerScope> SCOPES;
+static std::map<std::string, unsigned int> SCOPE_INDEX;
+static std::vector<unsigned int> SCOPE_STACK;
+
+static unsigned int FRAME_SLOT = 0;
+
+static unsigned int findOrCreateScope(const std::string& name)
+{
+	auto it = SCOPE_INDEX.find(name);
+	if (it != SCOPE_INDEX.end())
+		return it->second;
+
+	GPUProfilerScope scope;
+	scope.name = name;
+	glGenQueries(GPUProfiler::QUERY_LATENCY * 2, &scope.queries[0][0]);
+
+	unsigned int index = (unsigned int)SCOPES.size();
+	SCOPES.push_back(scope);
+	SCOPE_INDEX[name] = index;
+	return index;
+}
+
+void GPUProfiler::beginFrame()
+{
+	if (!SCOPE_STACK.empty())
+	{
+		std::cout << "GPUProfiler: " << SCOPE_STACK.size() << " scope(s) not ended last frame" << std::endl;
+		SCOPE_STACK.clear();
+	}
+
+	FRAME_SLOT = (FRAME_SLOT + 1) % QUERY_LATENCY;
+
+	// The queries in this slot were issued QUERY_LATENCY frames ago
+	for (auto& scope : SCOPES)
+	{
+		if (!scope.pending[FRAME_SLOT])
+			continue;
+
+		scope.pending[FRAME_SLOT] = false;
+
+		GLint available = 0;
+		glGetQueryObjectiv(scope.queries[FRAME_SLOT][1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			continue; // GPU is more than QUERY_LATENCY frames behind, drop this sample
+
+		GLuint64 beginNs = 0, endNs = 0;
+		glGetQueryObjectui64v(scope.queries[FRAME_SLOT][0], GL_QUERY_RESULT, &beginNs);
+		glGetQueryObjectui64v(scope.queries[FRAME_SLOT][1], GL_QUERY_RESULT, &endNs);
+
+		scope.lastMs = (float)((double)(endNs - beginNs) * 1e-6);
+		scope.smoothedMs = scope.smoothedMs == 0.0f ? scope.lastMs : scope.smoothedMs * 0.9f + scope.lastMs * 0.1f;
+	}
+}
+
+void GPUProfiler::begin(const std::string& name)
+{
+	unsigned int index = findOrCreateScope(name);
+	auto& scope = SCOPES[index];
+
+	scope.depth = (unsigned int)SCOPE_STACK.size();
+	SCOPE_STACK.push_back(index);
+
+	glQueryCounter(scope.queries[FRAME_SLOT][0], GL_TIMESTAMP);
+}
+
+void GPUProfiler::end()
+{
+	if (SCOPE_STACK.empty())
+	{
+		std::cout << "GPUProfiler: end() without begin()" << std::endl;
+		return;
+	}
+
+	auto& scope = SCOPES[SCOPE_STACK.back()];
+	SCOPE_STACK.pop_back();
+
+	glQueryCounter(scope.queries[FRAME_SLOT][1], GL_TIMESTAMP);
+	scope.pending[FRAME_SLOT] = true;
+}
+
+float GPUProfiler::getTimeMs(const std::string& name)
+{
+	auto it = SCOPE_INDEX.find(name);
+	if (it == SCOPE_INDEX.end())
+		return 0.0f;
+
+	return SCOPES[it->second].smoothedMs;
+}
+
+#ifdef XBGT2094_ENABLE_IMGUI
+void GPUProfiler::imgui_drawStats()
+{
+	ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "GPU Timings (ms)");
+
+	for (auto& scope : SCOPES)
+	{
+		ImGui::Text("%*s%-20s %6.3f", (int)scope.depth * 2, "", scope.name.c_str(), scope.smoothedMs);
+	}
+}
+#endif
@@ -0,0 +1,28 @@
+#pragma once
+#include <string>
+
+// GPU timings of render passes, measured with GL_TIMESTAMP queries.
+//
+// Wrap a pass with begin()/end(); scopes may nest. Each scope keeps QUERY_LATENCY
+// query pairs and results are read back that many frames later, so reading them
+// never stalls the CPU on the GPU.
+class GPUProfiler
+{
+public:
+	GPUProfiler() = delete;
+
+	static const unsigned int QUERY_LATENCY = 4;
+
+	// Collects finished results. Call once per frame before the first begin().
+	static void beginFrame();
+
+	static void begin(const std::string& name);
+	static void end();
+
+	// Smoothed GPU time of the scope in milliseconds, 0 if it has not been measured yet.
+	static float getTimeMs(const std::string& name);
+
+#ifdef XBGT2094_ENABLE_IMGUI
+	static void imgui_drawStats();
+#endif
+};
@@ -0,0 +1,216 @@
+#include "hot_reload.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <unordered_map>
+#include <vector>
+#include <cstdio>
+#include <sys/stat.h>
+
+// Modification time and size, so a save within the same second still shows up
+struct FileStamp
+{
+	long long time;
+	long long size;
+
+	bool operator==(const FileStamp& other) const { return time == other.time && size == other.size; }
+	bool operator!=(const FileStamp& other) const { return !(*this == other); }
+};
+
+struct Watch
+{
+	const void* owner;
+	HotReload::ImportFunc import;
+};
+
+struct WatchedFile
+{
+	FileStamp stamp;
+	bool changing;		// Stamp moved on the last poll; imported once it holds still
+	std::vector<Watch> watches;
+};
+
+static std::unordered_map<std::string, WatchedFile> files;
+static std::mutex filesMutex;
+
+static std::vector<HotReload::CommitFunc> commits;
+static std::mutex commitsMutex;
+
+static std::thread watcher;
+static std::mutex stopMutex;
+static std::condition_variable stopCondition;
+static bool stopping = false;
+
+static unsigned int reloadCount = 0;
+
+static FileStamp getFileStamp(const std::string& path)
+{
+#ifdef _WIN32
+	struct _stat64 info;
+	if (_stat64(path.c_str(), &info) != 0)
+		return { -1, -1 };
+#else
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0)
+		return { -1, -1 };
+#endif
+	return { (long long)info.st_mtime, (long long)info.st_size };
+}
+
+// One pass over the watched files; returns the imports to run, at most one per owner
+static std::vector<Watch> pollFiles()
+{
+	std::vector<Watch> imports;
+	std::lock_guard<std::mutex> lock(filesMutex);
+
+	for (auto& it : files)
+	{
+		WatchedFile& file = it.second;
+		FileStamp stamp = getFileStamp(it.first);
+
+		// Editors often write in several steps (or delete and rename), so wait for one quiet poll
+		if (stamp != file.stamp)
+		{
+			file.stamp = stamp;
+			file.changing = true;
+			continue;
+		}
+
+		if (!file.changing || stamp.time < 0)
+			continue;
+
+		file.changing = false;
+		printf("Hot reload: %s changed\n", it.first.c_str());
+
+		for (auto& watch : file.watches)
+		{
+			bool queued = false;
+			for (auto& other : imports)
+				queued |= other.owner == watch.owner;
+
+			if (!queued)
+				imports.push_back(watch);
+		}
+	}
+
+	return imports;
+}
+
+static void watcherLoop(unsigned int pollIntervalMs)
+{
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(stopMutex);
+			if (stopCondition.wait_for(lock, std::chrono::milliseconds(pollIntervalMs), [] { return stopping; }))
+				return;
+		}
+
+		for (auto& watch : pollFiles())
+		{
+			HotReload::CommitFunc commit = watch.import();
+			if (commit)
+			{
+				std::lock_guard<std::mutex> lock(commitsMutex);
+				commits.push_back(commit);
+			}
+		}
+	}
+}
+
+void HotReload::init(unsigned int pollIntervalMs)
+{
+	if (watcher.joinable()) return;
+
+	stopping = false;
+	watcher = std::thread(watcherLoop, pollIntervalMs);
+
+	printf("Hot reload: watching %u files\n", getWatchedFileCount());
+}
+
+void HotReload::shutdown()
+{
+	if (!watcher.joinable()) return;
+
+	{
+		std::lock_guard<std::mutex> lock(stopMutex);
+		stopping = true;
+	}
+	stopCondition.notify_all();
+	watcher.join();
+}
+
+void HotReload::watch(const std::string& path, const void* owner, ImportFunc import)
+{
+	std::lock_guard<std::mutex> lock(filesMutex);
+
+	auto it = files.find(path);
+	if (it == files.end())
+	{
+		WatchedFile file;
+		file.stamp = getFileStamp(path);
+		file.changing = false;
+		it = files.emplace(path, file).first;
+	}
+
+	for (auto& watch : it->second.watches)
+	{
+		if (watch.owner == owner)
+		{
+			watch.import = import;
+			return;
+		}
+	}
+
+	it->second.watches.push_back({ owner, import });
+}
+
+void HotReload::unwatch(const void* owner)
+{
+	std::lock_guard<std::mutex> lock(filesMutex);
+
+	for (auto it = files.begin(); it != files.end();)
+	{
+		auto& watches = it->second.watches;
+		for (size_t i = 0; i < watches.size();)
+		{
+			if (watches[i].owner == owner)
+				watches.erase(watches.begin() + i);
+			else
+				i++;
+		}
+
+		if (watches.empty())
+			it = files.erase(it);
+		else
+			++it;
+	}
+}
+
+unsigned int HotReload::update()
+{
+	std::vector<CommitFunc> ready;
+	{
+		std::lock_guard<std::mutex> lock(commitsMutex);
+		ready.swap(commits);
+	}
+
+	// Commits may register watches again (e.g. a reloaded shader picking up a new #include)
+	for (auto& commit : ready)
+		commit();
+
+	reloadCount += (unsigned int)ready.size();
+	return (unsigned int)ready.size();
+}
+
+unsigned int HotReload::getWatchedFileCount()
+{
+	std::lock_guard<std::mutex> lock(filesMutex);
+	return (unsigned int)files.size();
+}
+
+unsigned int HotReload::getReloadCount()
+{
+	return reloadCount;
+}
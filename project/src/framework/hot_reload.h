@@ -0,0 +1,37 @@
+#pragma once
+#include <string>
+#include <functional>
+
+// Re-imports asset files that change on disk while the app is running.
+//
+// Loaders register every file they read with watch(). A background thread polls the watched
+// files and, once a changed file has stopped changing, runs the import function of each owner
+// watching it on that thread (e.g. decoding an image). The import returns a commit function
+// which update() runs on the render thread to swap the GPU objects in place, so Shader*,
+// Texture2D* and Mesh* handed out earlier stay valid.
+//
+// One owner may watch several files (a shader program and every file it #includes), and one
+// file may be watched by several owners; each owner is re-imported once per batch of changes.
+class HotReload
+{
+public:
+	HotReload() = delete;
+
+	// Runs on the render thread
+	typedef std::function<void()> CommitFunc;
+	// Runs on the watcher thread; returns nullptr if there is nothing to swap in
+	typedef std::function<CommitFunc()> ImportFunc;
+
+	static void init(unsigned int pollIntervalMs = 250);
+	static void shutdown();
+
+	// Replaces an earlier watch of the same file by the same owner
+	static void watch(const std::string& path, const void* owner, ImportFunc import);
+	static void unwatch(const void* owner);
+
+	// Once per frame. Returns the number of assets swapped in.
+	static unsigned int update();
+
+	static unsigned int getWatchedFileCount();
+	static unsigned int getReloadCount();
+};
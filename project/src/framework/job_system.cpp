@@ -0,0 +1,142 @@
+#include "job_system.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <algorithm>
+
+typedef std::function<void()> Job;
+
+static std::vector<std::thread> workers;
+static std::deque<Job> jobQueue;
+static std::mutex queueMutex;
+static std::condition_variable queueCondition;
+static bool stopping = false;
+
+static void workerLoop()
+{
+	while (true)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			queueCondition.wait(lock, [] { return stopping || !jobQueue.empty(); });
+
+			if (stopping && jobQueue.empty())
+				return;
+
+			job = std::move(jobQueue.front());
+			jobQueue.pop_front();
+		}
+
+		job();
+	}
+}
+
+// Runs one queued job on the calling thread, if any.
+static bool tryRunOneJob()
+{
+	Job job;
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		if (jobQueue.empty())
+			return false;
+
+		job = std::move(jobQueue.front());
+		jobQueue.pop_front();
+	}
+
+	job();
+	return true;
+}
+
+void JobSystem::init(unsigned int workerCount)
+{
+	if (!workers.empty()) return;
+
+	if (workerCount == 0)
+	{
+		unsigned int hw = std::thread::hardware_concurrency();
+		workerCount = hw > 1 ? hw - 1 : 1;
+	}
+
+	stopping = false;
+	for (unsigned int i = 0; i < workerCount; i++)
+	{
+		workers.emplace_back(workerLoop);
+	}
+}
+
+void JobSystem::shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		stopping = true;
+	}
+	queueCondition.notify_all();
+
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+
+	workers.clear();
+}
+
+unsigned int JobSystem::getWorkerCount()
+{
+	return (unsigned int)workers.size();
+}
+
+void JobSystem::parallelFor(unsigned int count, unsigned int minChunkSize, const RangeFunc& func)
+{
+	if (count == 0) return;
+
+	init();
+
+	minChunkSize = std::max(minChunkSize, 1u);
+
+	// One chunk per thread (workers + caller), but never smaller than minChunkSize.
+	unsigned int threads = getWorkerCount() + 1;
+	unsigned int chunkSize = std::max(minChunkSize, (count + threads - 1) / threads);
+	unsigned int chunkCount = (count + chunkSize - 1) / chunkSize;
+
+	if (chunkCount <= 1)
+	{
+		func(0, count);
+		return;
+	}
+
+	std::atomic<unsigned int> remaining(chunkCount);
+	std::mutex doneMutex;
+	std::condition_variable doneCondition;
+
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		for (unsigned int c = 0; c < chunkCount; c++)
+		{
+			unsigned int begin = c * chunkSize;
+			unsigned int end = std::min(begin + chunkSize, count);
+
+			jobQueue.push_back([&, begin, end]()
+				{
+					func(begin, end);
+
+					// Under the lock, so the caller (waiting on it) cannot return and destroy
+					// the mutex and condition before this notify is done with them
+					std::lock_guard<std::mutex> doneLock(doneMutex);
+					if (--remaining == 0)
+						doneCondition.notify_all();
+				});
+		}
+	}
+	queueCondition.notify_all();
+
+	// Help out instead of idling, then wait for the chunks picked up by workers.
+	while (remaining > 0 && tryRunOneJob()) {}
+
+	std::unique_lock<std::mutex> lock(doneMutex);
+	doneCondition.wait(lock, [&] { return remaining == 0; });
+}
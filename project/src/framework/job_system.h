@@ -0,0 +1,24 @@
+#pragma once
+#include <functional>
+
+// Small pool of worker threads shared by the engine systems.
+//
+// parallelFor() splits [0, count) into contiguous chunks and blocks until every
+// chunk has run. The calling thread helps with the work, so it is safe to use
+// even when the pool has a single worker.
+class JobSystem
+{
+public:
+	JobSystem() = delete;
+
+	typedef std::function<void(unsigned int begin, unsigned int end)> RangeFunc;
+
+	// workerCount == 0 picks hardware_concurrency() - 1 (at least 1).
+	// Called lazily by the first parallelFor() if not called explicitly.
+	static void init(unsigned int workerCount = 0);
+	static void shutdown();
+
+	static unsigned int getWorkerCount();
+
+	static void parallelFor(unsigned int count, unsigned int minChunkSize, const RangeFunc& func);
+};
@@ -51,11 +51,23 @@ void SceneBase::draw_debug(CameraBase* camera)
 
 void SceneBase::step_init()
 {
+	// preload() may load shaders too, so the startup report covers both
+	ShaderUtils::beginLoadReport();
 	preload();
-	step_loadShaders();
+	loadShaders();
+	ShaderUtils::finishPendingPrograms();	// Nothing to fall back to yet
+	ShaderUtils::endLoadReport("Startup");
+
 	load();
 }
 
+void SceneBase::step_loadShaders()
+{
+	ShaderUtils::beginLoadReport();
+	loadShaders();
+	ShaderUtils::endLoadReport("Reload");
+}
+
 void SceneBase::step_update()
 {
 	update();
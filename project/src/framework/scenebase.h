@@ -39,11 +39,8 @@ public:
 
 	void step_init();
 
-	// inlined because called in step_init()
-	inline void step_loadShaders()
-	{
-		loadShaders();
-	}
+	// Also called on F1; logs the load time and program binary cache hits
+	void step_loadShaders();
 
 	void step_update();
 	void step_draw(CameraBase* camera);
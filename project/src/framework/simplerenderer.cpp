@@ -2,9 +2,11 @@
 #include "simpleapp.h"
 #include <glad/glad.h>
 #include <iostream>
+#include <cstddef>
 
 static Shader* currentShader;
 static unsigned int handle;
+static unsigned int instanceBuffer;
 
 void SimpleRenderer::bindShader(Shader* shader)
 {
@@ -147,6 +149,12 @@ void SimpleRenderer::setTexture_skybox(Cubemap* cubemap)
 	glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap->getNativeHandle());
 }
 
+void SimpleRenderer::setTextureArray(unsigned int unit, TextureArray* array)
+{
+	glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, array->getNativeHandle());
+}
+
 void SimpleRenderer::drawMesh(Mesh* mesh)
 {
 	unsigned int VAO = 0;
@@ -167,6 +175,48 @@ void SimpleRenderer::drawMesh(Mesh* mesh)
 	}
 }
 
+void SimpleRenderer::setInstances(const std::vector<MeshInstance>& instances)
+{
+	if (instanceBuffer == 0)
+		glGenBuffers(1, &instanceBuffer);
+
+	// Orphaned every time, so the previous pass's draws never stall the upload
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(MeshInstance), instances.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void SimpleRenderer::drawMeshInstanced(Mesh* mesh, unsigned int firstInstance, unsigned int count)
+{
+	if (mesh == nullptr || mesh->VAO == 0 || count == 0)
+		return;
+
+	glBindVertexArray(mesh->VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+
+	// No base instance in GL 3.3, so the attributes point at the range instead. Set up
+	// every draw, which also covers VAOs re-created by async loads and hot reload.
+	size_t offset = firstInstance * sizeof(MeshInstance);
+	for (int i = 0; i < 4; i++)
+	{
+		glEnableVertexAttribArray(5 + i);
+		glVertexAttribPointer(5 + i, 4, GL_FLOAT, GL_FALSE, sizeof(MeshInstance), (void*)(offset + sizeof(glm::vec4) * i));
+		glVertexAttribDivisor(5 + i, 1);
+	}
+	glEnableVertexAttribArray(9);
+	glVertexAttribPointer(9, 4, GL_FLOAT, GL_FALSE, sizeof(MeshInstance), (void*)(offset + offsetof(MeshInstance, material)));
+	glVertexAttribDivisor(9, 1);
+
+	glDrawArraysInstanced(GL_TRIANGLES, 0, (GLsizei)mesh->vertices.size(), count);
+
+	// drawMesh() of the same VAO mustn't find them enabled
+	for (int i = 5; i <= 9; i++)
+		glDisableVertexAttribArray(i);
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+}
+
 void SimpleRenderer::bindFBO(FBO* fbo)
 {
 	if (fbo != 0)
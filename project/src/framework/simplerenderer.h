@@ -3,6 +3,8 @@
 #include "../mesh/mesh.h"
 #include "../texture/texture2d.h"
 #include "../texture/cubemap.h"
+#include "../texture/texture_array.h"
+#include <vector>
 #include "../fbo/fbo.h"
 
 class SimpleRenderer
@@ -38,9 +40,15 @@ public:
 	static void setTexture_7(Texture2D* texture);
 
 	static void setTexture_skybox(Cubemap* cubemap);
+	static void setTextureArray(unsigned int unit, TextureArray* array);
 
 	static void drawMesh(Mesh* mesh);
 
+	// Uploads the instances of a pass into one buffer; drawMeshInstanced() then draws a range
+	// of them in a single call
+	static void setInstances(const std::vector<MeshInstance>& instances);
+	static void drawMeshInstanced(Mesh* mesh, unsigned int firstInstance, unsigned int count);
+
 	static void bindFBO(FBO* fbo);
 	static void bindFBO_Default();
 };
@@ -22,6 +22,8 @@ void LightUtils::internal_imgui_drawControls(PointLight* light)
 
 	ImGui::Text("Intensity");
 	ImGui::SliderFloat("##intensity", &light->intensity, 0.0f, 10.0f);
+
+	ImGui::Checkbox("Cast Shadows", &light->castShadows);
 }
 
 void LightUtils::internal_imgui_drawControls(DirectionalLight* light)
@@ -0,0 +1,413 @@
+#include <glad/glad.h>
+#include "light_cluster.h"
+#include "lights.h"
+#include "../camera/camera_base.h"
+#include "../framework/simplerenderer.h"
+#include "../framework/job_system.h"
+#include "../shadow/shadow_atlas.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cfloat>
+
+#ifdef XBGT2094_ENABLE_IMGUI
+#include "../imgui/imgui.h"
+#endif
+
+std::vector<PointLight*> LightCluster::CURRENT_LIGHTS;
+
+// Per-light data used during assignment
+struct ClusterLightBounds
+{
+	glm::vec3 viewPosition;
+	float radius;
+	glm::ivec2 tileMin, tileMax;
+	int sliceMin, sliceMax;
+	bool visible;
+};
+
+static unsigned int buffers[3];		// light data, grid, indices
+static unsigned int textures[3];
+static bool glCreated = false;
+
+static float maxClusterDistance = 100.0f;
+static glm::vec2 sliceScaleBias(0.0f);
+static glm::vec2 tileSize(1.0f);
+
+// Cached view-space AABBs of all clusters, rebuilt when the projection changes
+static std::vector<glm::vec3> clusterMin(LightCluster::CLUSTER_COUNT);
+static std::vector<glm::vec3> clusterMax(LightCluster::CLUSTER_COUNT);
+static glm::mat4 cachedProjection(0.0f);
+static float cachedClusterFar = 0.0f;
+
+static std::vector<PointLight*> activeLights;
+static std::vector<ClusterLightBounds> lightBounds;
+static std::vector<float> lightData;
+// Lights intersecting each cluster; only the first MAX_LIGHTS_PER_CLUSTER are listed
+static std::vector<unsigned int> clusterCounts(LightCluster::CLUSTER_COUNT);
+static std::vector<unsigned int> clusterLists(LightCluster::CLUSTER_COUNT * LightCluster::MAX_LIGHTS_PER_CLUSTER);
+static std::vector<unsigned int> gridData(LightCluster::CLUSTER_COUNT * 2);
+static std::vector<unsigned int> indexData;
+
+// Stats
+static unsigned int statVisibleLights = 0;
+static unsigned int statMaxPerCluster = 0;
+static unsigned int statOverflowClusters = 0;
+static float statAverageNonEmpty = 0.0f;
+static float statAssignMs = 0.0f;
+
+static inline unsigned int clusterIndex(unsigned int x, unsigned int y, unsigned int z)
+{
+	return x + y * LightCluster::CLUSTER_X + z * LightCluster::CLUSTER_X * LightCluster::CLUSTER_Y;
+}
+
+static void createBuffers()
+{
+	if (glCreated) return;
+
+	glGenBuffers(3, buffers);
+	glGenTextures(3, textures);
+
+	GLenum formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+	for (int i = 0; i < 3; i++)
+	{
+		// Texture buffers must have storage before they are sampled.
+		glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+		glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+
+		glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+		glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+	}
+
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	glCreated = true;
+}
+
+static void uploadBuffer(unsigned int buffer, const void* data, size_t size)
+{
+	// Orphan the previous storage so the upload does not wait on in-flight draws.
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+	glBufferData(GL_TEXTURE_BUFFER, std::max(size, (size_t)16), nullptr, GL_STREAM_DRAW);
+	if (size > 0)
+	{
+		glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+	}
+}
+
+// Intersects the view ray through (ndc.x, ndc.y) with the plane z = -depth.
+static glm::vec3 viewPointAtDepth(const glm::mat4& invProjection, const glm::vec2& ndc, float depth)
+{
+	glm::vec4 a = invProjection * glm::vec4(ndc, -1.0f, 1.0f);
+	glm::vec4 b = invProjection * glm::vec4(ndc, 1.0f, 1.0f);
+	glm::vec3 pa = glm::vec3(a) / a.w;
+	glm::vec3 pb = glm::vec3(b) / b.w;
+
+	float t = (-depth - pa.z) / (pb.z - pa.z);
+	return pa + (pb - pa) * t;
+}
+
+static void rebuildClusterBounds(const glm::mat4& projection, float zNear, float clusterFar, float zFar)
+{
+	glm::mat4 invProjection = glm::inverse(projection);
+
+	JobSystem::parallelFor(LightCluster::CLUSTER_Z, 1, [&](unsigned int begin, unsigned int end)
+		{
+			for (unsigned int z = begin; z < end; z++)
+			{
+				float sliceNear = zNear * powf(clusterFar / zNear, (float)z / LightCluster::CLUSTER_Z);
+				float sliceFar = zNear * powf(clusterFar / zNear, (float)(z + 1) / LightCluster::CLUSTER_Z);
+
+				// Last slice catches everything up to the far clip plane
+				if (z == LightCluster::CLUSTER_Z - 1)
+					sliceFar = std::max(sliceFar, zFar);
+
+				for (unsigned int y = 0; y < LightCluster::CLUSTER_Y; y++)
+				{
+					for (unsigned int x = 0; x < LightCluster::CLUSTER_X; x++)
+					{
+						glm::vec2 ndcMin(-1.0f + 2.0f * x / LightCluster::CLUSTER_X, -1.0f + 2.0f * y / LightCluster::CLUSTER_Y);
+						glm::vec2 ndcMax(-1.0f + 2.0f * (x + 1) / LightCluster::CLUSTER_X, -1.0f + 2.0f * (y + 1) / LightCluster::CLUSTER_Y);
+
+						glm::vec3 bMin(FLT_MAX), bMax(-FLT_MAX);
+						glm::vec2 corners[4] = { ndcMin, { ndcMax.x, ndcMin.y }, { ndcMin.x, ndcMax.y }, ndcMax };
+						for (const auto& c : corners)
+						{
+							glm::vec3 pn = viewPointAtDepth(invProjection, c, sliceNear);
+							glm::vec3 pf = viewPointAtDepth(invProjection, c, sliceFar);
+							bMin = glm::min(bMin, glm::min(pn, pf));
+							bMax = glm::max(bMax, glm::max(pn, pf));
+						}
+
+						unsigned int index = clusterIndex(x, y, z);
+						clusterMin[index] = bMin;
+						clusterMax[index] = bMax;
+					}
+				}
+			}
+		});
+}
+
+static inline bool sphereIntersectsAABB(const glm::vec3& centre, float radius, const glm::vec3& bMin, const glm::vec3& bMax)
+{
+	glm::vec3 closest = glm::clamp(centre, bMin, bMax);
+	glm::vec3 d = closest - centre;
+	return glm::dot(d, d) <= radius * radius;
+}
+
+static inline int sliceFromDepth(float depth)
+{
+	int slice = (int)floorf(logf(depth) * sliceScaleBias.x + sliceScaleBias.y);
+	return glm::clamp(slice, 0, (int)LightCluster::CLUSTER_Z - 1);
+}
+
+// Conservative tile range covered by the light's view-space bounding box.
+static void computeTileRange(const glm::mat4& projection, float zNear, ClusterLightBounds& b)
+{
+	glm::vec2 ndcMin(FLT_MAX), ndcMax(-FLT_MAX);
+
+	for (int i = 0; i < 8; i++)
+	{
+		glm::vec3 corner = b.viewPosition + glm::vec3(
+			(i & 1) ? b.radius : -b.radius,
+			(i & 2) ? b.radius : -b.radius,
+			(i & 4) ? b.radius : -b.radius);
+
+		// Corners behind the near plane are clamped onto it, which keeps the projection conservative.
+		corner.z = std::min(corner.z, -zNear);
+
+		glm::vec4 clip = projection * glm::vec4(corner, 1.0f);
+		glm::vec2 ndc = glm::vec2(clip) / clip.w;
+		ndcMin = glm::min(ndcMin, ndc);
+		ndcMax = glm::max(ndcMax, ndc);
+	}
+
+	glm::vec2 dims((float)LightCluster::CLUSTER_X, (float)LightCluster::CLUSTER_Y);
+	glm::ivec2 tMin = glm::ivec2(glm::floor((ndcMin * 0.5f + 0.5f) * dims));
+	glm::ivec2 tMax = glm::ivec2(glm::floor((ndcMax * 0.5f + 0.5f) * dims));
+
+	b.tileMin = glm::clamp(tMin, glm::ivec2(0), glm::ivec2(dims) - 1);
+	b.tileMax = glm::clamp(tMax, glm::ivec2(0), glm::ivec2(dims) - 1);
+
+	if (tMax.x < 0 || tMax.y < 0 || tMin.x >= (int)dims.x || tMin.y >= (int)dims.y)
+		b.visible = false;
+}
+
+void LightCluster::add(PointLight* light)
+{
+	CURRENT_LIGHTS.push_back(light);
+}
+
+void LightCluster::remove(PointLight* light)
+{
+	CURRENT_LIGHTS.erase(std::remove(CURRENT_LIGHTS.begin(), CURRENT_LIGHTS.end(), light), CURRENT_LIGHTS.end());
+}
+
+void LightCluster::clear()
+{
+	CURRENT_LIGHTS.clear();
+}
+
+void LightCluster::setMaxClusterDistance(float distance)
+{
+	maxClusterDistance = std::max(distance, 1.0f);
+}
+
+void LightCluster::update(CameraBase* camera, const glm::ivec2& viewportSize)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	createBuffers();
+
+	// Unjittered: the temporal AA jitter changes every frame and is well below a tile
+	glm::mat4 projection = camera->getUnjitteredProjectionMatrix();
+	const glm::mat4& view = camera->getViewMatrix();
+	float zNear = camera->getNearClip();
+	float zFar = camera->getFarClip();
+	float clusterFar = std::min(zFar, maxClusterDistance);
+
+	float logRatio = logf(clusterFar / zNear);
+	sliceScaleBias.x = CLUSTER_Z / logRatio;
+	sliceScaleBias.y = -(float)CLUSTER_Z * logf(zNear) / logRatio;
+	tileSize = glm::vec2(viewportSize) / glm::vec2(CLUSTER_X, CLUSTER_Y);
+
+	if (projection != cachedProjection || clusterFar != cachedClusterFar)
+	{
+		rebuildClusterBounds(projection, zNear, clusterFar, zFar);
+		cachedProjection = projection;
+		cachedClusterFar = clusterFar;
+	}
+
+	// 1. Gather enabled lights and pack their GPU data
+	activeLights.clear();
+	for (PointLight* light : CURRENT_LIGHTS)
+	{
+		if (light->isEnabled() && light->getIntensity() > 0.0f && light->getRange() > 0.0f)
+			activeLights.push_back(light);
+	}
+
+	unsigned int lightCount = (unsigned int)activeLights.size();
+	lightBounds.resize(lightCount);
+	lightData.resize(lightCount * LIGHT_TEXELS * 4);
+
+	JobSystem::parallelFor(lightCount, 64, [&](unsigned int begin, unsigned int end)
+		{
+			for (unsigned int i = begin; i < end; i++)
+			{
+				PointLight* light = activeLights[i];
+				glm::vec3 position = light->getPosition();
+				glm::vec3 colour = light->getColour() * light->getIntensity();
+
+				bool isSpot = light->getType() == LightType::SPOT;
+				glm::vec3 direction(0.0f, 0.0f, 1.0f);
+				glm::vec2 spotAngles(0.0f, 1.0f);
+				if (isSpot)
+				{
+					SpotLight* spot = static_cast<SpotLight*>(light);
+					direction = spot->getDirection();
+					spotAngles = spot->getCalculatedAngles();
+				}
+
+				float* d = &lightData[i * LIGHT_TEXELS * 4];
+				d[0] = position.x; d[1] = position.y; d[2] = position.z; d[3] = light->getInverseSquaredRange();
+				d[4] = colour.r; d[5] = colour.g; d[6] = colour.b; d[7] = isSpot ? 1.0f : 0.0f;
+				d[8] = direction.x; d[9] = direction.y; d[10] = direction.z; d[11] = spotAngles.x;
+				d[12] = spotAngles.y; d[13] = (float)ShadowAtlas::getShadowIndex(light); d[14] = 0.0f; d[15] = 0.0f;
+
+				// Range attenuation reaches zero at d == range, so the range is the bounding radius.
+				ClusterLightBounds& b = lightBounds[i];
+				b.viewPosition = glm::vec3(view * glm::vec4(position, 1.0f));
+				b.radius = light->getRange();
+				b.visible = true;
+
+				float depth = -b.viewPosition.z;
+				if (depth + b.radius < zNear || depth - b.radius > zFar)
+				{
+					b.visible = false;
+					continue;
+				}
+
+				b.sliceMin = sliceFromDepth(std::max(depth - b.radius, zNear));
+				b.sliceMax = sliceFromDepth(std::max(depth + b.radius, zNear));
+				computeTileRange(projection, zNear, b);
+			}
+		});
+
+	// 2. Assign lights to clusters, one depth slice per job. Slices own disjoint clusters, so no locking.
+	JobSystem::parallelFor(CLUSTER_Z, 1, [&](unsigned int begin, unsigned int end)
+		{
+			for (unsigned int z = begin; z < end; z++)
+			{
+				for (unsigned int c = clusterIndex(0, 0, z); c < clusterIndex(0, 0, z + 1); c++)
+					clusterCounts[c] = 0;
+
+				for (unsigned int i = 0; i < lightCount; i++)
+				{
+					const ClusterLightBounds& b = lightBounds[i];
+					if (!b.visible || (int)z < b.sliceMin || (int)z > b.sliceMax) continue;
+
+					for (int y = b.tileMin.y; y <= b.tileMax.y; y++)
+					{
+						for (int x = b.tileMin.x; x <= b.tileMax.x; x++)
+						{
+							unsigned int c = clusterIndex(x, y, z);
+							if (sphereIntersectsAABB(b.viewPosition, b.radius, clusterMin[c], clusterMax[c]))
+							{
+								if (clusterCounts[c] < MAX_LIGHTS_PER_CLUSTER)
+									clusterLists[c * MAX_LIGHTS_PER_CLUSTER + clusterCounts[c]] = i;
+								clusterCounts[c]++;
+							}
+						}
+					}
+				}
+			}
+		});
+
+	// 3. Compact the fixed-size per-cluster lists into one index list
+	indexData.clear();
+	statVisibleLights = 0;
+	statMaxPerCluster = 0;
+	statOverflowClusters = 0;
+	unsigned int nonEmpty = 0;
+
+	for (unsigned int c = 0; c < CLUSTER_COUNT; c++)
+	{
+		unsigned int count = std::min(clusterCounts[c], (unsigned int)MAX_LIGHTS_PER_CLUSTER);
+		gridData[c * 2 + 0] = (unsigned int)indexData.size();
+		gridData[c * 2 + 1] = count;
+
+		indexData.insert(indexData.end(), &clusterLists[c * MAX_LIGHTS_PER_CLUSTER], &clusterLists[c * MAX_LIGHTS_PER_CLUSTER] + count);
+
+		statMaxPerCluster = std::max(statMaxPerCluster, count);
+		if (count > 0) nonEmpty++;
+		if (clusterCounts[c] > MAX_LIGHTS_PER_CLUSTER) statOverflowClusters++;
+	}
+
+	for (const auto& b : lightBounds)
+	{
+		if (b.visible) statVisibleLights++;
+	}
+	statAverageNonEmpty = nonEmpty > 0 ? (float)indexData.size() / nonEmpty : 0.0f;
+
+	// 4. Upload
+	uploadBuffer(buffers[0], lightData.data(), lightData.size() * sizeof(float));
+	uploadBuffer(buffers[1], gridData.data(), gridData.size() * sizeof(unsigned int));
+	uploadBuffer(buffers[2], indexData.data(), indexData.size() * sizeof(unsigned int));
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+	statAssignMs = std::chrono::duration<float, std::milli>(endTime - startTime).count();
+}
+
+void LightCluster::bindTextures()
+{
+	createBuffers();
+
+	glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT_LIGHT_DATA);
+	glBindTexture(GL_TEXTURE_BUFFER, textures[0]);
+	glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT_GRID);
+	glBindTexture(GL_TEXTURE_BUFFER, textures[1]);
+	glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT_INDICES);
+	glBindTexture(GL_TEXTURE_BUFFER, textures[2]);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+void LightCluster::setShaderProps(const glm::vec2& targetScale)
+{
+	SimpleRenderer::setShaderProp_Integer("clusterLightData", TEXTURE_UNIT_LIGHT_DATA);
+	SimpleRenderer::setShaderProp_Integer("clusterGrid", TEXTURE_UNIT_GRID);
+	SimpleRenderer::setShaderProp_Integer("clusterLightIndices", TEXTURE_UNIT_INDICES);
+
+	SimpleRenderer::setShaderProp_Vec3("clusterDims", (float)CLUSTER_X, (float)CLUSTER_Y, (float)CLUSTER_Z);
+	SimpleRenderer::setShaderProp_Vec2("clusterTileSize", tileSize * targetScale);
+	SimpleRenderer::setShaderProp_Vec2("clusterSliceScaleBias", sliceScaleBias);
+}
+
+const std::vector<PointLight*>& LightCluster::getLights()
+{
+	return CURRENT_LIGHTS;
+}
+
+unsigned int LightCluster::getLightCount()
+{
+	return (unsigned int)CURRENT_LIGHTS.size();
+}
+
+unsigned int LightCluster::getVisibleLightCount()
+{
+	return statVisibleLights;
+}
+
+#ifdef XBGT2094_ENABLE_IMGUI
+void LightCluster::imgui_drawStats()
+{
+	ImGui::Text("Clusters       : %ux%ux%u", CLUSTER_X, CLUSTER_Y, CLUSTER_Z);
+	ImGui::Text("Lights         : %u (%u visible)", getLightCount(), statVisibleLights);
+	ImGui::Text("Max per cluster: %u", statMaxPerCluster);
+	ImGui::Text("Avg per cluster: %.2f", statAverageNonEmpty);
+	if (statOverflowClusters > 0)
+		ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.0f, 1.0f), "Overflowing    : %u clusters (lights dropped)", statOverflowClusters);
+	ImGui::Text("Assign + upload: %.3f ms", statAssignMs);
+}
+#endif
@@ -0,0 +1,70 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+class CameraBase;
+class PointLight;
+
+// Clustered forward lighting.
+//
+// The view frustum is split into CLUSTER_X * CLUSTER_Y screen tiles and CLUSTER_Z
+// exponential depth slices ("froxels"). Every frame, update() assigns the range
+// sphere of each enabled PointLight/SpotLight to the froxels it touches (in parallel
+// over depth slices) and uploads three texture buffer objects:
+//
+//		clusterLightData	RGBA32F,	LIGHT_TEXELS texels per light
+//		clusterGrid			RG32UI,		(offset, count) into clusterLightIndices per froxel
+//		clusterLightIndices	R32UI,		light indices, grouped per froxel
+//
+// Shaders include "clustered_lights.glsl" and loop only over the lights of their froxel.
+class LightCluster
+{
+	friend class LightUtils;
+
+	LightCluster() = delete;
+
+	static std::vector<PointLight*> CURRENT_LIGHTS;
+
+	static void add(PointLight* light);
+
+public:
+	static const unsigned int CLUSTER_X = 16;
+	static const unsigned int CLUSTER_Y = 9;
+	static const unsigned int CLUSTER_Z = 24;
+	static const unsigned int CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+
+	// Caps the per-froxel list so pixel cost stays bounded in very dense areas.
+	static const unsigned int MAX_LIGHTS_PER_CLUSTER = 64;
+
+	static const unsigned int LIGHT_TEXELS = 4;
+
+	// Texture units used by the light buffers. Units 0-7 are left to materials.
+	static const int TEXTURE_UNIT_LIGHT_DATA = 13;
+	static const int TEXTURE_UNIT_GRID = 14;
+	static const int TEXTURE_UNIT_INDICES = 15;
+
+	static void remove(PointLight* light);
+	static void clear();
+
+	// Depth slices stop at min(camera far clip, this); anything further falls in the last slice.
+	static void setMaxClusterDistance(float distance);
+
+	// Assigns lights to clusters and uploads the buffers. Call once per frame before drawing.
+	static void update(CameraBase* camera, const glm::ivec2& viewportSize);
+
+	// Binds the light buffers to their texture units. Call once per frame after update().
+	static void bindTextures();
+
+	// Sets the cluster uniforms on the currently bound shader. targetScale is the size of the
+	// target drawn into relative to the viewport given to update(), below 1 for reduced
+	// resolution passes, so their gl_FragCoord still finds its tile.
+	static void setShaderProps(const glm::vec2& targetScale = glm::vec2(1.0f));
+
+	static const std::vector<PointLight*>& getLights();
+	static unsigned int getLightCount();
+	static unsigned int getVisibleLightCount();
+
+#ifdef XBGT2094_ENABLE_IMGUI
+	static void imgui_drawStats();
+#endif
+};
@@ -121,6 +121,8 @@ void LightDebug::draw(CameraBase* camera)
 
 	for (LightBase* light : CURRENT_LIGHTS)
 	{
+		if (!light->isEnabled()) continue;
+
 		SimpleRenderer::setShaderProp_Vec3("c", light->getColour());
 		drawDebug(light);
 	}
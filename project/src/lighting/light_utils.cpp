@@ -1,11 +1,13 @@
 #include "light_utils.h"
 #include "light_debug.h"
+#include "light_cluster.h"
 
 PointLight* LightUtils::createPointLight(std::string name)
 {
 	PointLight* light = new PointLight(name);
 
 	LightDebug::add(light);
+	LightCluster::add(light);
 	return light;
 }
 
@@ -22,6 +24,7 @@ SpotLight* LightUtils::createSpotLight(std::string name)
 	SpotLight* light = new SpotLight(name);
 
 	LightDebug::add(light);
+	LightCluster::add(light);
 	return light;
 }
 
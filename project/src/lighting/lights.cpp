@@ -46,6 +46,16 @@ const glm::vec3& LightBase::getColorIntensified()
 	return this->colour * this->intensity;
 }
 
+void LightBase::setEnabled(bool enabled)
+{
+	this->enabled = enabled;
+}
+
+const bool LightBase::isEnabled() const
+{
+	return this->enabled;
+}
+
 const std::string& LightBase::getName()
 {
 	return this->name;
@@ -83,6 +93,16 @@ const float PointLight::getInverseSquaredRange() const
 	return 1.0f / std::max(range * range, 0.0001f);
 }
 
+void PointLight::setCastShadows(bool castShadows)
+{
+	this->castShadows = castShadows;
+}
+
+const bool PointLight::getCastShadows() const
+{
+	return castShadows;
+}
+
 void SpotLight::setInputAngles(float inner, float outer)
 {
 	angles.x = inner;
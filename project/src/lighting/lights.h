@@ -15,11 +15,12 @@ protected:
 	glm::vec3 colour;
 	float intensity;
 	std::string name;
+	bool enabled;
 
 public:
 
 	virtual LightType getType() = 0;
-	LightBase(std::string name) : name(name), colour(1.0f), intensity(1.0f) {}
+	LightBase(std::string name) : name(name), colour(1.0f), intensity(1.0f), enabled(true) {}
 
 	void setColour(const glm::vec3& colour);
 	void setColor(const glm::vec3& color); // Alias of setColour(...)
@@ -34,6 +35,10 @@ public:
 
 	const float getIntensity();
 
+	// Disabled lights are skipped by the light cluster and the debug drawer
+	void setEnabled(bool enabled);
+	const bool isEnabled() const;
+
 	const std::string& getName();
 };
 
@@ -56,9 +61,10 @@ private:
 
 protected:
 
-	PointLight(std::string name) : LightBase(name), range(5) {}
+	PointLight(std::string name) : LightBase(name), range(5), castShadows(false) {}
 
 	float range;
+	bool castShadows;
 
 public:
 	LightType getType() override;
@@ -68,6 +74,10 @@ public:
 
 	// This is the range to be sent to shader
 	const float getInverseSquaredRange() const;
+
+	// Opt-in; the shadow atlas decides each frame which casting lights get a tile
+	void setCastShadows(bool castShadows);
+	const bool getCastShadows() const;
 };
 
 class SpotLight : public PointLight, public Directional
@@ -7,11 +7,21 @@
 #include <iostream>
 
 #include "camera/camera_flying.h"
+#include "framework/job_system.h"
+#include "framework/gpu_profiler.h"
+#include "framework/hot_reload.h"
+#include "framework/asset_loader.h"
+#include "texture/texture_upload.h"
+#include "texture/texture_streamer.h"
+#include "shader/shader_utils.h"
 #include "scene_asgn.h"
 
 const unsigned int SCREEN_WIDTH = 1024;
 const unsigned int SCREEN_HEIGHT = 768;
 const char* WINDOW_TITLE = "XBGT2094 Assignment";
+const float ASSET_UPLOAD_BUDGET_MS = 2.0f;
+const size_t TEXTURE_UPLOAD_BUDGET_BYTES = 4 << 20;
+const size_t TEXTURE_STREAMING_BUDGET_BYTES = 32 << 20;
 
 CameraBase* camera;
 SceneBase* scene;
@@ -23,6 +33,9 @@ void key_callback(int key, int scancode, int action);
 
 int main(void)
 {
+	// Starts the loader threads and the time-to-first-frame clock
+	AssetLoader::init();
+
 	int result = App::init(SCREEN_WIDTH, SCREEN_HEIGHT, WINDOW_TITLE);
 
 	if (!result)
@@ -33,6 +46,12 @@ int main(void)
 	App::setScrollCallback(scroll_callback);
 	App::setKeyCallback(key_callback);
 
+	// PBO_RING or SHARED_CONTEXT, see texture/texture_upload.h
+	TextureUpload::init(TextureUploadMode::PBO_RING);
+
+	// Mip residency within a fixed amount of texture memory, see texture/texture_streamer.h
+	TextureStreamer::init(TEXTURE_STREAMING_BUDGET_BYTES);
+
 	// Scene initialization
 	// ------------------------------------------------------------
 	scene = new Scene_ASGN();
@@ -64,6 +83,9 @@ int main(void)
 	glEnable(GL_CULL_FACE);							// Cull Back Faces
 	glFrontFace(GL_CCW);							// Set Front Face as Counter Clockwise
 
+	// Assets registered themselves while loading; edits to them now reload on their own
+	HotReload::init();
+
 	std::cout << "Press F1 to reload shaders" << std::endl;
 
 	// Application Loop
@@ -76,6 +98,21 @@ int main(void)
 		camera->update(App::getDeltaTime());
 		scene->step_update();
 
+		// Swap in shader programs that finished compiling in the background
+		ShaderUtils::updatePendingPrograms();
+
+		// Swap in textures and meshes re-imported by the file watcher
+		HotReload::update();
+
+		// Upload assets decoded in the background, replacing their placeholders
+		AssetLoader::update(ASSET_UPLOAD_BUDGET_MS);
+		TextureUpload::update(TEXTURE_UPLOAD_BUDGET_BYTES);
+
+		// Grow or shrink texture residency for what the last frame drew
+		TextureStreamer::update(TEXTURE_UPLOAD_BUDGET_BYTES);
+
+		GPUProfiler::beginFrame();
+
 		// Clear the colour and depth buffers before drawing this frame
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -89,8 +126,14 @@ int main(void)
 		App::endGUI();
 
 		App::display();
+		AssetLoader::frameDisplayed();
 	}
 
+	HotReload::shutdown();
+	AssetLoader::shutdown();
+	TextureUpload::shutdown();
+	TextureStreamer::shutdown();
+	JobSystem::shutdown();
 	App::cleanup();
 
 	exit(EXIT_SUCCESS);
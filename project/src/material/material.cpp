@@ -0,0 +1,51 @@
+#include "material.h"
+#include "../texture/texture_utils.h"
+
+MaterialRenderState MaterialRenderState::alphaBlended()
+{
+	MaterialRenderState state;
+	state.cullBackFaces = false;
+	state.blend = true;
+	state.depthWrite = false;
+	return state;
+}
+
+MaterialDesc::MaterialDesc() : shaderVariants(0), shader(0), gbufferVariants(0), shadowShader(0), keywordMask(0), diffuseLayer(0), readsOpaqueTexture(false)
+{
+	textures[(int)MaterialSlot::DIFFUSE] = TextureUtils::checkerTexture2D();
+	textures[(int)MaterialSlot::SPECULAR] = TextureUtils::whiteTexture2D();
+	textures[(int)MaterialSlot::NORMAL] = TextureUtils::whiteTexture2D();
+	textures[(int)MaterialSlot::EMISSIVE] = TextureUtils::blackTexture2D();
+	specularLayer = TextureUtils::whiteTextureLayer();
+	normalLayer = TextureUtils::whiteTextureLayer();
+}
+
+void MaterialDesc::setTexture(MaterialSlot slot, Texture2D* texture)
+{
+	textures[(int)slot] = texture;
+}
+
+Material::Material(const MaterialDesc& desc, unsigned int index, unsigned long long sortKey)
+	: desc(desc), index(index), sortKey(sortKey)
+{
+}
+
+const MaterialDesc& Material::getDesc() const
+{
+	return desc;
+}
+
+Texture2D* Material::getTexture(MaterialSlot slot) const
+{
+	return desc.textures[(int)slot];
+}
+
+unsigned int Material::getIndex() const
+{
+	return index;
+}
+
+unsigned long long Material::getSortKey() const
+{
+	return sortKey;
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include "../shader/shader.h"
+#include "../shader/shader_variants.h"
+#include "../texture/texture2d.h"
+#include "../texture/texture_array.h"
+
+// Texture slots. A material's texture in slot i is bound to texture unit i.
+enum class MaterialSlot
+{
+	DIFFUSE,
+	SPECULAR,
+	NORMAL,
+	EMISSIVE,
+	COUNT
+};
+
+// Scalars the shaders read from the material uniform block (materials.glsl)
+struct MaterialParams
+{
+	float shininess;		// 5 is what combined.frag used for every surface before
+	float specularScale;
+	float alphaCutoff;		// Fragments with less alpha are discarded
+
+	MaterialParams() : shininess(5.0f), specularScale(1.0f), alphaCutoff(0.1f) {}
+};
+
+struct MaterialRenderState
+{
+	bool cullBackFaces;
+	bool blend;				// As set by MaterialUtils::setBlendMode(), src alpha, 1 - src alpha by default
+	bool depthWrite;
+
+	MaterialRenderState() : cullBackFaces(true), blend(false), depthWrite(true) {}
+
+	static MaterialRenderState alphaBlended();		// Two sided, no depth writes
+};
+
+// Everything about how an entity is drawn apart from its mesh and transform
+struct MaterialDesc
+{
+	ShaderVariants* shaderVariants;	// Forward program; the scene picks the variant for its keywords
+	Shader* shader;					// Forward program when there are no variants
+	ShaderVariants* gbufferVariants;	// Deferred path; materials without it are always drawn forward
+	Shader* shadowShader;			// Depth-only program; materials without one cast no shadows
+
+	// Keywords of the material itself (e.g. its surface type), added to the scene's when it
+	// picks the forward and deferred variants
+	unsigned int keywordMask;
+
+	Texture2D* textures[(int)MaterialSlot::COUNT];
+
+	// Diffuse, specular and normal as texture array layers, for the instanced batches (standard.vert
+	// programs only). The Texture2Ds above still serve shadows and the unbatched path.
+	TextureLayer* diffuseLayer;		// Null to never batch
+	TextureLayer* specularLayer;	// White by default, like the textures
+	TextureLayer* normalLayer;
+
+	MaterialParams params;
+	MaterialRenderState state;
+
+	// Samples the opaque scene colour (opaqueTex) for refraction or distortion; alpha-blended
+	// materials only. The scene copies it only while a visible entity has such a material.
+	bool readsOpaqueTexture;
+
+	// Checker diffuse, white specular and normal, black emissive
+	MaterialDesc();
+
+	void setTexture(MaterialSlot slot, Texture2D* texture);
+};
+
+// Made by MaterialUtils::createMaterial(), which hands out one Material per distinct
+// description. Immutable, so identical entities share the pointer and the sort key stays valid.
+class Material
+{
+public:
+	const MaterialDesc& getDesc() const;
+	Texture2D* getTexture(MaterialSlot slot) const;
+	// Entry in the material uniform block
+	unsigned int getIndex() const;
+	// Materials with the same forward program sort next to each other
+	unsigned long long getSortKey() const;
+
+private:
+	friend class MaterialUtils;
+	MaterialDesc desc;
+	unsigned int index;
+	unsigned long long sortKey;
+
+	Material(const MaterialDesc& desc, unsigned int index, unsigned long long sortKey);
+};
@@ -0,0 +1,181 @@
+#include "material_utils.h"
+#include "../framework/simplerenderer.h"
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <unordered_map>
+#include <map>
+#include <cstdio>
+
+static std::vector<Material*> materials;
+static std::unordered_map<unsigned long long, std::vector<Material*>> materialsByHash;
+static std::map<std::pair<const void*, unsigned int>, unsigned int> programOrder;
+static unsigned int uniformBuffer;
+
+// GL state as last set by applyRenderState()/resetRenderState()
+static MaterialRenderState currentState;
+static BlendMode blendMode = BlendMode::ALPHA;
+
+static unsigned long long hashDesc(const MaterialDesc& desc)
+{
+	unsigned long long hash = 14695981039346656037ull;
+	auto hashBytes = [&hash](const void* data, size_t size)
+	{
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= ((const unsigned char*)data)[i];
+			hash *= 1099511628211ull;
+		}
+	};
+
+	const void* pointers[] = { desc.shaderVariants, desc.shader, desc.gbufferVariants, desc.shadowShader, desc.diffuseLayer, desc.specularLayer, desc.normalLayer };
+	hashBytes(pointers, sizeof(pointers));
+	hashBytes(desc.textures, sizeof(desc.textures));
+	hashBytes(&desc.keywordMask, sizeof(desc.keywordMask));
+
+	float params[] = { desc.params.shininess, desc.params.specularScale, desc.params.alphaCutoff };
+	hashBytes(params, sizeof(params));
+
+	bool state[] = { desc.state.cullBackFaces, desc.state.blend, desc.state.depthWrite, desc.readsOpaqueTexture };
+	hashBytes(state, sizeof(state));
+	return hash;
+}
+
+static void applyBlendFunc()
+{
+	switch (blendMode)
+	{
+	case BlendMode::WEIGHTED_OIT: glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA); break;
+	case BlendMode::OFFSCREEN: glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA); break;
+	case BlendMode::TRANSMITTANCE: glBlendFunc(GL_ONE, GL_SRC_ALPHA); break;
+	default: glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA); break;
+	}
+}
+
+static bool isSameState(const MaterialRenderState& a, const MaterialRenderState& b)
+{
+	return a.cullBackFaces == b.cullBackFaces && a.blend == b.blend && a.depthWrite == b.depthWrite;
+}
+
+static bool isSameDesc(const MaterialDesc& a, const MaterialDesc& b)
+{
+	for (int i = 0; i < (int)MaterialSlot::COUNT; i++)
+	{
+		if (a.textures[i] != b.textures[i])
+			return false;
+	}
+
+	return a.shaderVariants == b.shaderVariants && a.shader == b.shader && a.gbufferVariants == b.gbufferVariants && a.shadowShader == b.shadowShader
+		&& a.keywordMask == b.keywordMask
+		&& a.diffuseLayer == b.diffuseLayer && a.specularLayer == b.specularLayer && a.normalLayer == b.normalLayer
+		&& a.params.shininess == b.params.shininess && a.params.specularScale == b.params.specularScale && a.params.alphaCutoff == b.params.alphaCutoff
+		&& isSameState(a.state, b.state) && a.readsOpaqueTexture == b.readsOpaqueTexture;
+}
+
+const Material* MaterialUtils::createMaterial(const MaterialDesc& desc)
+{
+	unsigned long long hash = hashDesc(desc);
+	for (Material* material : materialsByHash[hash])
+	{
+		if (isSameDesc(material->desc, desc))
+			return material;
+	}
+
+	// The uniform block is a fixed array in materials.glsl, so it cannot grow
+	if (materials.size() >= MAX_MATERIALS)
+	{
+		printf("\x1b[31mMaterials: ERROR, all %u materials in use, no material created\x1b[0m\n", MAX_MATERIALS);
+		return nullptr;
+	}
+
+	if (uniformBuffer == 0)
+	{
+		glGenBuffers(1, &uniformBuffer);
+		glBindBuffer(GL_UNIFORM_BUFFER, uniformBuffer);
+		glBufferData(GL_UNIFORM_BUFFER, MAX_MATERIALS * sizeof(glm::vec4), nullptr, GL_STATIC_DRAW);
+		glBindBufferBase(GL_UNIFORM_BUFFER, UNIFORM_BLOCK_BINDING, uniformBuffer);
+	}
+
+	// Programs (variants and material keywords) numbered in order of first use, so materials sharing one sort together
+	const void* variants = desc.shaderVariants ? (const void*)desc.shaderVariants : (const void*)desc.shader;
+	auto order = programOrder.insert({ { variants, desc.keywordMask }, (unsigned int)programOrder.size() }).first->second;
+
+	unsigned int index = (unsigned int)materials.size();
+	Material* material = new Material(desc, index, ((unsigned long long)order << 32) | index);
+	materials.push_back(material);
+	materialsByHash[hash].push_back(material);
+
+	glm::vec4 params(desc.params.shininess, desc.params.specularScale, desc.params.alphaCutoff, 0.0f);
+	glBindBuffer(GL_UNIFORM_BUFFER, uniformBuffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, index * sizeof(glm::vec4), sizeof(glm::vec4), &params);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	return material;
+}
+
+void MaterialUtils::setShaderSlots(Shader* shader, const std::vector<std::pair<std::string, MaterialSlot>>& samplers)
+{
+	SimpleRenderer::bindShader(shader);
+	for (const auto& sampler : samplers)
+		SimpleRenderer::setShaderProp_Integer(sampler.first, (int)sampler.second);
+
+	unsigned int block = glGetUniformBlockIndex(shader->getNativeHandle(), "MaterialBlock");
+	if (block != GL_INVALID_INDEX)
+		glUniformBlockBinding(shader->getNativeHandle(), block, UNIFORM_BLOCK_BINDING);
+}
+
+void MaterialUtils::bind(const Material* material)
+{
+	for (int i = 0; i < (int)MaterialSlot::COUNT; i++)
+	{
+		glActiveTexture(GL_TEXTURE0 + i);
+		glBindTexture(GL_TEXTURE_2D, material->desc.textures[i]->getNativeHandle());
+	}
+	glActiveTexture(GL_TEXTURE0);
+
+	SimpleRenderer::setShaderProp_Integer("materialIndex", (int)material->index);
+	applyRenderState(material->desc.state);
+}
+
+void MaterialUtils::applyRenderState(const MaterialRenderState& state)
+{
+	if (state.cullBackFaces != currentState.cullBackFaces)
+		state.cullBackFaces ? glEnable(GL_CULL_FACE) : glDisable(GL_CULL_FACE);
+
+	if (state.blend != currentState.blend)
+	{
+		if (state.blend)
+		{
+			glEnable(GL_BLEND);
+			applyBlendFunc();
+		}
+		else
+		{
+			glDisable(GL_BLEND);
+		}
+	}
+
+	if (state.depthWrite != currentState.depthWrite)
+		glDepthMask(state.depthWrite ? GL_TRUE : GL_FALSE);
+
+	currentState = state;
+}
+
+void MaterialUtils::resetRenderState()
+{
+	glEnable(GL_CULL_FACE);
+	glDisable(GL_BLEND);
+	glDepthMask(GL_TRUE);
+	currentState = MaterialRenderState();
+}
+
+void MaterialUtils::setBlendMode(BlendMode mode)
+{
+	blendMode = mode;
+	if (currentState.blend)
+		applyBlendFunc();
+}
+
+unsigned int MaterialUtils::getMaterialCount()
+{
+	return (unsigned int)materials.size();
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "material.h"
+#include <string>
+#include <vector>
+#include <utility>
+
+// What MaterialRenderState::blend means
+enum class BlendMode
+{
+	ALPHA,			// src alpha, 1 - src alpha
+	WEIGHTED_OIT,	// Colour added, alpha multiplied by 1 - src alpha (oit.glsl)
+	OFFSCREEN,		// As ALPHA, but the target's alpha (cleared to 1) keeps the transmittance
+	TRANSMITTANCE	// Colour added over dst times src alpha: composites an OFFSCREEN target
+};
+
+// Creates the materials and binds them.
+//
+// The parameters of every material live in one uniform buffer, one vec4 per material at its
+// index (layout in materials.glsl), written once at creation. Shaders pick their entry with the
+// materialIndex uniform, or per instance in the batched path. Binding a material only sets its
+// textures, index and the render state that differs from the last one applied.
+class MaterialUtils
+{
+public:
+	MaterialUtils() = delete;
+
+	// Matches MAX_MATERIALS in materials.glsl
+	static const unsigned int MAX_MATERIALS = 256;
+	static const unsigned int UNIFORM_BLOCK_BINDING = 0;
+
+	// Render thread. Returns the material made earlier from an identical description, if any,
+	// and null once MAX_MATERIALS distinct materials exist; callers must not draw with it.
+	static const Material* createMaterial(const MaterialDesc& desc);
+
+	// For onCompiled callbacks: points the program's samplers at their slots' texture units and
+	// its MaterialBlock (if it has one) at the material buffer
+	static void setShaderSlots(Shader* shader, const std::vector<std::pair<std::string, MaterialSlot>>& samplers);
+
+	// With the material's program bound
+	static void bind(const Material* material);
+	static void applyRenderState(const MaterialRenderState& state);
+	// Back to the defaults (back faces culled, no blending, depth writes) after a pass
+	static void resetRenderState();
+
+	// For the blending materials drawn from now on; resetRenderState() keeps it
+	static void setBlendMode(BlendMode mode);
+
+	static unsigned int getMaterialCount();
+};
@@ -1,12 +1,10 @@
 #include "mesh.h"
 #include <glad/glad.h>
 #include <iostream>
+#include <cmath>
 #include "mikktspace.h"
 #include <glm/gtx/string_cast.hpp>
 
-static SMikkTSpaceContext context;
-static SMikkTSpaceInterface iface;
-
 static int get_num_faces_fn(const SMikkTSpaceContext* context);
 static int get_num_vertices_of_face_fn(const SMikkTSpaceContext* context, int iFace);
 static void get_position_fn(const SMikkTSpaceContext* context, float outpos[], int iFace, int iVert);
@@ -14,8 +12,10 @@ static void get_normal_fn(const SMikkTSpaceContext* context, float outnormal[],
 static void get_uv_fn(const SMikkTSpaceContext* context, float outuv[], int iFace, int iVert);
 static void set_tspace_basic_fn(const SMikkTSpaceContext* context, const float tangentu[], float fSign, int iFace, int iVert);
 
-static void calcTangents(Mesh* mesh)
+// Context and interface are locals so loader threads can generate tangents at the same time
+void Mesh::calcTangents(std::vector<Vertex>& vertices)
 {
+	SMikkTSpaceInterface iface = {};
 	iface.m_getNumFaces = get_num_faces_fn;
 	iface.m_getNumVerticesOfFace = get_num_vertices_of_face_fn;
 	iface.m_getNormal = get_normal_fn;
@@ -24,8 +24,9 @@ static void calcTangents(Mesh* mesh)
 
 	iface.m_setTSpaceBasic = set_tspace_basic_fn;
 
+	SMikkTSpaceContext context = {};
 	context.m_pInterface = &iface;
-	context.m_pUserData = mesh;
+	context.m_pUserData = &vertices;
 
 	genTangSpaceDefault(&context);
 }
@@ -43,11 +44,11 @@ Vertex::Vertex(glm::vec3 position, glm::vec3 normal, glm::vec2 uv, glm::vec3 col
 
 Mesh::Mesh(std::vector<Vertex> vertices) : vertices(vertices)
 {
-	calcTangents(this);
+	calcTangents(this->vertices);
 	setup();
 }
 
-Mesh::Mesh()
+Mesh::Mesh() : boundsMin(0.0f), boundsMax(0.0f), worldUnitsPerUV(0.0f)
 {
 }
 
@@ -59,6 +60,26 @@ Mesh::~Mesh()
 
 void Mesh::setup()
 {
+	boundsMin = boundsMax = vertices.empty() ? glm::vec3(0.0f) : vertices[0].position;
+	for (auto& v : vertices)
+	{
+		boundsMin = glm::min(boundsMin, v.position);
+		boundsMax = glm::max(boundsMax, v.position);
+	}
+
+	// Ratio of the triangles' total area to their total UV area
+	double area = 0.0, uvArea = 0.0;
+	for (size_t i = 0; i + 2 < vertices.size(); i += 3)
+	{
+		const Vertex& a = vertices[i];
+		const Vertex& b = vertices[i + 1];
+		const Vertex& c = vertices[i + 2];
+		area += glm::length(glm::cross(b.position - a.position, c.position - a.position)) * 0.5;
+		glm::vec2 uvB = b.uv - a.uv, uvC = c.uv - a.uv;
+		uvArea += std::abs(uvB.x * uvC.y - uvB.y * uvC.x) * 0.5;
+	}
+	worldUnitsPerUV = uvArea > 0.0 ? (float)std::sqrt(area / uvArea) : 0.0f;
+
 	// Create VAO and VBO
 	// VAO: Vertex Array Object
 	// VBO: Vertex Buffer Object
@@ -69,7 +90,7 @@ void Mesh::setup()
 	glBindBuffer(GL_ARRAY_BUFFER, VBO);
 
 	// Upload mesh data to the GPU
-	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
 
 	// Specify the layout of the vertices we just uploaded
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
@@ -90,10 +111,10 @@ void Mesh::setup()
 
 static int get_num_faces_fn(const SMikkTSpaceContext* context)
 {
-	Mesh* mesh = static_cast<Mesh*>(context->m_pUserData);
+	std::vector<Vertex>& vertices = *static_cast<std::vector<Vertex>*>(context->m_pUserData);
 
-	float f_size = (float)mesh->vertices.size() / 3.f;
-	int i_size = (int)mesh->vertices.size() / 3;
+	float f_size = (float)vertices.size() / 3.f;
+	int i_size = (int)vertices.size() / 3;
 
 	assert((f_size - (float)i_size) == 0.f);
 
@@ -109,10 +130,10 @@ static int get_num_vertices_of_face_fn(const SMikkTSpaceContext* context, int iF
 
 static void get_position_fn(const SMikkTSpaceContext* context, float outpos[], int iFace, int iVert)
 {
-	Mesh* mesh = static_cast<Mesh*>(context->m_pUserData);
+	std::vector<Vertex>& vertices = *static_cast<std::vector<Vertex>*>(context->m_pUserData);
 
 	auto index = iFace * 3 + iVert;
-	auto vertex = mesh->vertices[index];
+	auto vertex = vertices[index];
 
 	outpos[0] = vertex.position.x;
 	outpos[1] = vertex.position.y;
@@ -121,10 +142,10 @@ static void get_position_fn(const SMikkTSpaceContext* context, float outpos[], i
 
 static void get_normal_fn(const SMikkTSpaceContext* context, float outnormal[], int iFace, int iVert)
 {
-	Mesh* mesh = static_cast<Mesh*>(context->m_pUserData);
+	std::vector<Vertex>& vertices = *static_cast<std::vector<Vertex>*>(context->m_pUserData);
 
 	auto index = iFace * 3 + iVert;
-	auto vertex = mesh->vertices[index];
+	auto vertex = vertices[index];
 
 	outnormal[0] = vertex.normal.x;
 	outnormal[1] = vertex.normal.y;
@@ -133,10 +154,10 @@ static void get_normal_fn(const SMikkTSpaceContext* context, float outnormal[],
 
 static void get_uv_fn(const SMikkTSpaceContext* context, float outuv[], int iFace, int iVert)
 {
-	Mesh* mesh = static_cast<Mesh*>(context->m_pUserData);
+	std::vector<Vertex>& vertices = *static_cast<std::vector<Vertex>*>(context->m_pUserData);
 
 	auto index = iFace * 3 + iVert;
-	auto vertex = mesh->vertices[index];
+	auto vertex = vertices[index];
 
 	outuv[0] = vertex.uv.x;
 	outuv[1] = vertex.uv.y;
@@ -144,10 +165,10 @@ static void get_uv_fn(const SMikkTSpaceContext* context, float outuv[], int iFac
 
 static void set_tspace_basic_fn(const SMikkTSpaceContext* context, const float tangentu[], float fSign, int iFace, int iVert)
 {
-	Mesh* mesh = static_cast<Mesh*>(context->m_pUserData);
+	std::vector<Vertex>& vertices = *static_cast<std::vector<Vertex>*>(context->m_pUserData);
 
 	auto index = iFace * 3 + iVert;
-	auto* vertex = &mesh->vertices[index];
+	auto* vertex = &vertices[index];
 
 	vertex->tangent.x = tangentu[0];
 	vertex->tangent.y = tangentu[1];
@@ -18,6 +18,14 @@ struct Vertex {
 	Vertex(glm::vec3 position, glm::vec3 normal, glm::vec2 uv, glm::vec3 colour);
 };
 
+// Per-instance vertex attributes of SimpleRenderer::drawMeshInstanced(): locations 5-8 hold
+// the model matrix, 9 the material (see standard.vert)
+struct MeshInstance
+{
+	glm::mat4 model;
+	glm::vec4 material;	// x diffuse layer, y specular layer, z material index, w normal layer
+};
+
 class Mesh
 {
 	friend class SimpleRenderer;
@@ -25,6 +33,11 @@ class Mesh
 public:
 	std::vector<Vertex> vertices;
 
+	// Object-space bounding box, filled in when the mesh is uploaded
+	glm::vec3 boundsMin, boundsMax;
+	// Average object-space length one UV unit spans (0 without UVs), for texture streaming
+	float worldUnitsPerUV;
+
 	~Mesh();
 
 private:
@@ -33,4 +46,7 @@ private:
 	Mesh();
 	Mesh(std::vector<Vertex> vertices);
 	void setup();
+
+	// MikkTSpace tangents. CPU only, so it can run on a loader thread.
+	static void calcTangents(std::vector<Vertex>& vertices);
 };
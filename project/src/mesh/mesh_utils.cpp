@@ -4,6 +4,10 @@
 #include <tinyobjloader/tiny_obj_loader.h>
 #include <iostream>
 #include <glm/gtc/constants.hpp>
+#include <memory>
+#include <unordered_map>
+#include "../framework/hot_reload.h"
+#include "../framework/asset_loader.h"
 
 Mesh* MeshUtils::makeQuad(float size)
 {
@@ -153,6 +157,69 @@ Mesh* MeshUtils::makePlane(glm::vec2 size, glm::ivec2 partitions, glm::ivec2 til
 }
 
 Mesh* MeshUtils::loadObjFile(const std::string& filePath)
+{
+	std::vector<Vertex> vertices;
+	if (!readObjFile(filePath, vertices))
+		return 0;
+
+	// Tangents are already generated
+	Mesh* mesh = new Mesh();
+	mesh->vertices.swap(vertices);
+	mesh->setup();
+
+	watchObjFile(mesh, filePath);
+	return mesh;
+}
+
+// Render thread only
+static std::unordered_map<std::string, Mesh*> asyncMeshes;
+
+Mesh* MeshUtils::loadObjFileAsync(const std::string& filePath)
+{
+	auto it = asyncMeshes.find(filePath);
+	if (it != asyncMeshes.end())
+		return it->second;
+
+	// Draws nothing until the upload
+	Mesh* mesh = new Mesh();
+	mesh->setup();
+	asyncMeshes[filePath] = mesh;
+
+	AssetLoader::submit([=]() -> AssetLoader::UploadFunc
+	{
+		std::shared_ptr<std::vector<Vertex>> vertices = std::make_shared<std::vector<Vertex>>();
+		if (!readObjFile(filePath, *vertices))
+			return nullptr;
+
+		return [=]()
+		{
+			replaceVertices(mesh, *vertices);
+			std::cout << "Loaded mesh: " << filePath << std::endl;
+			return true;
+		};
+	});
+
+	watchObjFile(mesh, filePath);
+	return mesh;
+}
+
+void MeshUtils::watchObjFile(Mesh* mesh, const std::string& filePath)
+{
+	HotReload::watch(filePath, mesh, [=]() -> HotReload::CommitFunc
+	{
+		std::shared_ptr<std::vector<Vertex>> fresh = std::make_shared<std::vector<Vertex>>();
+		if (!readObjFile(filePath, *fresh))
+			return nullptr;
+
+		return [=]()
+		{
+			replaceVertices(mesh, *fresh);
+			std::cout << "Reloaded mesh: " << filePath << std::endl;
+		};
+	});
+}
+
+bool MeshUtils::readObjFile(const std::string& filePath, std::vector<Vertex>& vertices)
 {
 	tinyobj::ObjReaderConfig reader_config;
 	reader_config.mtl_search_path = "";
@@ -163,7 +230,7 @@ Mesh* MeshUtils::loadObjFile(const std::string& filePath)
 			std::cerr << "TinyObjReader: " << reader.Error();
 		}
 
-		return 0;
+		return false;
 	}
 	if (!reader.Warning().empty()) {
 		std::cout << "TinyObjReader: " << reader.Warning();
@@ -173,7 +240,7 @@ Mesh* MeshUtils::loadObjFile(const std::string& filePath)
 	auto& shapes = reader.GetShapes();
 	auto& materials = reader.GetMaterials();
 
-	std::vector<Vertex> vertices;
+	vertices.clear();
 
 	// Loop over shapes
 	for (size_t s = 0; s < shapes.size(); s++)
@@ -227,8 +294,20 @@ Mesh* MeshUtils::loadObjFile(const std::string& filePath)
 		}
 	}
 
-	Mesh* mesh = new Mesh(vertices);
-	return mesh;
+	Mesh::calcTangents(vertices);
+	return true;
+}
+
+void MeshUtils::replaceVertices(Mesh* mesh, std::vector<Vertex>& vertices)
+{
+	unsigned int oldVAO = mesh->VAO;
+	unsigned int oldVBO = mesh->VBO;
+
+	mesh->vertices.swap(vertices);
+	mesh->setup();
+
+	glDeleteBuffers(1, &oldVBO);
+	glDeleteVertexArrays(1, &oldVAO);
 }
 
 Mesh* MeshUtils::makeSkybox()
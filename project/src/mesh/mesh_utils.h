@@ -5,6 +5,16 @@
 
 class MeshUtils
 {
+private:
+	// Parses the file and generates tangents. CPU only, so hot reload runs it on its own thread.
+	static bool readObjFile(const std::string& filePath, std::vector<Vertex>& vertices);
+
+	// New GPU buffers for the mesh in place, so every Mesh* to it stays valid
+	static void replaceVertices(Mesh* mesh, std::vector<Vertex>& vertices);
+
+	// Re-imports the mesh in place when the file changes, see framework/hot_reload.h
+	static void watchObjFile(Mesh* mesh, const std::string& filePath);
+
 public:
 	static Mesh* makeQuad(float size);
 	static Mesh* makeQuad(float width, float height);
@@ -12,5 +22,9 @@ public:
 	static Mesh* makeDisk(float radius, int slices);
 	static Mesh* makePlane(glm::vec2 size, glm::ivec2 partitions, glm::ivec2 tiling);
 	static Mesh* loadObjFile(const std::string& filePath);
+
+	// Returns at once with an empty mesh; the file is parsed on the AssetLoader threads and
+	// uploaded into the same Mesh later. Repeated requests share one mesh.
+	static Mesh* loadObjFileAsync(const std::string& filePath);
 	static Mesh* makeSkybox();
 };
@@ -0,0 +1,253 @@
+#include <glad/glad.h>
+#include "auto_exposure.h"
+#include "../framework/simpleapp.h"
+#include "../framework/simplerenderer.h"
+#include "../shader/shader_utils.h"
+#include "../mesh/mesh_utils.h"
+#include <string>
+#include <cmath>
+
+#ifdef XBGT2094_ENABLE_IMGUI
+#include "../imgui/imgui.h"
+#endif
+
+struct ReadbackSlot
+{
+	unsigned int buffer;
+	GLsync fence;		// Pixels are in the buffer once signalled
+	unsigned int frame;
+};
+
+static ShaderVariants* variants_reduce = nullptr;
+static Shader* shader_adapt = nullptr;
+
+static bool enabled = false;
+static float exposureKey = 0.18f;
+static float speedUp = 3.0f;
+static float speedDown = 1.0f;
+static float minLuminance = 0.03f;
+static float maxLuminance = 8.0f;
+
+// Adapted luminance, written to one and read from the other, swapped every frame
+static Texture2D* adapted[2] = { nullptr, nullptr };
+static unsigned int current = 0;
+static bool reset = true;
+
+static ReadbackSlot readbacks[AutoExposure::READBACK_LATENCY];
+static unsigned int frameIndex = 0;
+
+// Stats
+static float readbackLuminance = 0.0f;
+static unsigned int readbackAge = 0;
+static unsigned int readbacksSkipped = 0;
+
+static Mesh* getQuad()
+{
+	static Mesh* fsQuad = MeshUtils::makeQuad(2.0f);
+	return fsQuad;
+}
+
+static RenderTargetDesc getLuminanceDesc(glm::uvec2 size, ColourFormat format)
+{
+	return RenderTargetDesc::colour(size, format, TextureFilterMode::LINEAR);
+}
+
+static void init()
+{
+	if (adapted[0])
+		return;
+
+	for (Texture2D*& texture : adapted)
+	{
+		TextureConfig cfg(TextureWrapMode::CLAMP, TextureWrapMode::CLAMP, TextureFilterMode::NEAREST, false);
+		cfg.internalFormat = GL_R32F;
+		texture = Texture2D::createColourTexture(1, 1, cfg, GL_RGB, nullptr);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	for (ReadbackSlot& slot : readbacks)
+	{
+		glGenBuffers(1, &slot.buffer);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, sizeof(float), nullptr, GL_STREAM_READ);
+		slot.fence = 0;
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+static bool isSignalled(GLsync fence)
+{
+	GLenum result = glClientWaitSync(fence, 0, 0);
+	return result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED || result == GL_WAIT_FAILED;
+}
+
+static void reduce(Texture2D* source, glm::uvec2 sourceSize, bool first)
+{
+	SimpleRenderer::bindShader(ShaderUtils::getShaderVariant(variants_reduce, first ? 1u : 0u));
+	SimpleRenderer::setTexture_0(source);
+	SimpleRenderer::setShaderProp_Vec2("sourceTexelSize", glm::vec2(1.0f / sourceSize.x, 1.0f / sourceSize.y));
+	SimpleRenderer::drawMesh(getQuad());
+}
+
+// Reads the slot written READBACK_LATENCY frames ago if it is ready, then queues this frame's
+// value into it. Runs with the adaptation pass's framebuffer bound for reading.
+static void readBack()
+{
+	ReadbackSlot& slot = readbacks[frameIndex % AutoExposure::READBACK_LATENCY];
+	if (slot.fence)
+	{
+		if (!isSignalled(slot.fence))
+		{
+			readbacksSkipped++;
+			return;
+		}
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+		float* value = (float*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, sizeof(float), GL_MAP_READ_BIT);
+		if (value)
+		{
+			readbackLuminance = *value;
+			readbackAge = frameIndex - slot.frame;
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		glDeleteSync(slot.fence);
+		slot.fence = 0;
+	}
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+	glReadPixels(0, 0, 1, 1, GL_RED, GL_FLOAT, (void*)0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	slot.frame = frameIndex;
+}
+
+static void adapt(Texture2D* average, Texture2D* previous)
+{
+	// Frame rate independent: 1 - e^(-speed * dt) of the remaining difference per frame
+	float dt = App::getDeltaTime();
+	glm::vec2 rates(1.0f - std::exp(-speedUp * dt), 1.0f - std::exp(-speedDown * dt));
+	if (reset)
+		rates = glm::vec2(1.0f);
+	reset = false;
+
+	SimpleRenderer::bindShader(shader_adapt);
+	SimpleRenderer::setTexture_0(average);
+	SimpleRenderer::setTexture_1(previous);
+	SimpleRenderer::setShaderProp_Vec2("adaptationRates", rates);
+	SimpleRenderer::setShaderProp_Vec2("luminanceRange", glm::vec2(minLuminance, maxLuminance));
+	SimpleRenderer::drawMesh(getQuad());
+
+	readBack();
+}
+
+void AutoExposure::loadShaders()
+{
+	ShaderUtils::loadShaderVariants(&variants_reduce, "LUMINANCE_REDUCE", "../assets/shaders/screen.vert", "../assets/shaders/luminance_reduce.frag", { "LOG_LUMINANCE" },
+		[](Shader* shader)
+		{
+			SimpleRenderer::bindShader(shader);
+			SimpleRenderer::setShaderProp_Integer("sourceTex", 0);
+		});
+	ShaderUtils::loadShader(&shader_adapt, "EXPOSURE_ADAPT", "../assets/shaders/screen.vert", "../assets/shaders/exposure_adapt.frag",
+		[](Shader* shader)
+		{
+			SimpleRenderer::bindShader(shader);
+			SimpleRenderer::setShaderProp_Integer("averageLogLuminance", 0);
+			SimpleRenderer::setShaderProp_Integer("previousLuminance", 1);
+		});
+
+	ShaderUtils::getShaderVariant(variants_reduce, 0u);
+	ShaderUtils::getShaderVariant(variants_reduce, 1u);
+}
+
+void AutoExposure::setEnabled(bool value)
+{
+	// Snap to the scene on re-enabling instead of adapting from a stale value
+	if (value && !enabled)
+		reset = true;
+	enabled = value;
+}
+
+bool AutoExposure::isEnabled()
+{
+	return enabled;
+}
+
+FrameGraphResource AutoExposure::addPasses(FrameGraphResource source, glm::uvec2 size)
+{
+	if (!enabled)
+		return FrameGraph::NO_RESOURCE;
+
+	init();
+
+	FrameGraphResource from = source;
+	glm::uvec2 fromSize = glm::max(size, glm::uvec2(1));
+	for (unsigned int level = 0; fromSize != glm::uvec2(1); level++)
+	{
+		// Never more than REDUCTION_FACTOR per step, so the 4x4 blocks cover the whole level above
+		glm::uvec2 levelSize = (fromSize + REDUCTION_FACTOR - 1u) / REDUCTION_FACTOR;
+		FrameGraphResource to = FrameGraph::createTarget("Luminance " + std::to_string(level), getLuminanceDesc(levelSize, ColourFormat::R_16F));
+		bool first = level == 0;
+
+		FrameGraph::addPass("Luminance Reduce " + std::to_string(level), { from }, { to }, FrameGraph::NO_RESOURCE,
+			[from, fromSize, first]() { reduce(FrameGraph::getTexture(from), fromSize, first); });
+
+		from = to;
+		fromSize = levelSize;
+	}
+
+	// Last frame's result is read, this frame's written
+	FrameGraphResource previous = FrameGraph::importTexture("Adapted luminance (previous)", getLuminanceDesc(glm::uvec2(1), ColourFormat::R_32F), adapted[current]);
+	current = 1 - current;
+	FrameGraphResource result = FrameGraph::importTexture("Adapted luminance", getLuminanceDesc(glm::uvec2(1), ColourFormat::R_32F), adapted[current]);
+
+	FrameGraphResource average = from;
+	FrameGraph::addPass("Exposure Adapt", { average, previous }, { result }, FrameGraph::NO_RESOURCE,
+		[average, previous]() { adapt(FrameGraph::getTexture(average), FrameGraph::getTexture(previous)); });
+
+	frameIndex++;
+	return result;
+}
+
+void AutoExposure::bindTexture(FrameGraphResource luminance)
+{
+	glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT_LUMINANCE);
+	glBindTexture(GL_TEXTURE_2D, FrameGraph::getTexture(luminance)->getNativeHandle());
+	glActiveTexture(GL_TEXTURE0);
+}
+
+void AutoExposure::setShaderProps()
+{
+	SimpleRenderer::setShaderProp_Integer("adaptedLuminance", TEXTURE_UNIT_LUMINANCE);
+	SimpleRenderer::setShaderProp_Float("exposureKey", exposureKey);
+}
+
+float AutoExposure::getReadbackLuminance()
+{
+	return readbackLuminance;
+}
+
+#ifdef XBGT2094_ENABLE_IMGUI
+void AutoExposure::imgui_drawControls()
+{
+	bool value = enabled;
+	if (ImGui::Checkbox("Auto Exposure", &value))
+		setEnabled(value);
+	ImGui::TextColored(ImVec4(0.0f, 0.8f, 1.0f, 1.0f), "   Key (middle grey)");
+	ImGui::SliderFloat("SliderA1", &exposureKey, 0.05f, 0.5f);
+	ImGui::TextColored(ImVec4(0.0f, 0.8f, 1.0f, 1.0f), "   Adaptation speed (brighter, darker)");
+	ImGui::SliderFloat("SliderA2", &speedUp, 0.1f, 10.0f);
+	ImGui::SliderFloat("SliderA3", &speedDown, 0.1f, 10.0f);
+}
+
+void AutoExposure::imgui_drawStats()
+{
+	if (!enabled)
+		return;
+
+	float exposure = readbackLuminance > 0.0f ? exposureKey / readbackLuminance : 0.0f;
+	ImGui::Text("Adapted luminance: %.3f (exposure %.2f), %u frames late", readbackLuminance, exposure, readbackAge);
+	ImGui::Text("Readbacks skipped (not ready): %u", readbacksSkipped);
+}
+#endif
@@ -0,0 +1,47 @@
+#pragma once
+#include "../fbo/frame_graph.h"
+
+// Eye adaptation computed on the GPU.
+//
+// The HDR scene colour is reduced to its average log luminance by a chain of 4x4 reductions
+// (each level a quarter of the one above per side, rounded up, from the viewport down to 1x1,
+// so every source texel is read). An adaptation pass moves a
+// persistent 1x1 luminance towards it, exponentially over time, ping-ponging between two
+// textures imported into the frame graph. The post pass reads that texture directly and
+// scales by exposureKey / adapted luminance before tone mapping, so nothing waits on the CPU.
+//
+// The CPU only sees the value through a ring of READBACK_LATENCY pixel pack buffers, read
+// once their fences have signalled; a readback still in flight is skipped, never waited on.
+class AutoExposure
+{
+	AutoExposure() = delete;
+
+public:
+	// Per side and level; luminance_reduce.frag averages a block of this size
+	static const unsigned int REDUCTION_FACTOR = 4;
+	static const unsigned int READBACK_LATENCY = 3;
+
+	// Post pass units: 0 scene colour, 1 grading LUT, 2 bloom
+	static const int TEXTURE_UNIT_LUMINANCE = 3;
+
+	static void loadShaders();
+
+	static void setEnabled(bool enabled);
+	static bool isEnabled();
+
+	// Adds the reduction and adaptation passes reading source and returns the adapted
+	// luminance (1x1), NO_RESOURCE when disabled
+	static FrameGraphResource addPasses(FrameGraphResource source, glm::uvec2 size);
+
+	// For the pass applying the exposure
+	static void bindTexture(FrameGraphResource luminance);
+	static void setShaderProps();
+
+	// Adapted luminance from the latest readback, 0 before the first
+	static float getReadbackLuminance();
+
+#ifdef XBGT2094_ENABLE_IMGUI
+	static void imgui_drawControls();
+	static void imgui_drawStats();
+#endif
+};
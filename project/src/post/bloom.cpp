@@ -0,0 +1,182 @@
+#include <glad/glad.h>
+#include "bloom.h"
+#include "../framework/simplerenderer.h"
+#include "../framework/gpu_profiler.h"
+#include "../shader/shader_utils.h"
+#include "../mesh/mesh_utils.h"
+#include <string>
+
+#ifdef XBGT2094_ENABLE_IMGUI
+#include "../imgui/imgui.h"
+#endif
+
+static ShaderVariants* variants_downsample = nullptr;
+static Shader* shader_upsample = nullptr;
+
+static bool enabled = true;
+static float threshold = 1.0f;
+static float knee = 0.5f;
+static float intensity = 0.15f;
+static float radius = 1.0f;
+
+// Levels in the chain last frame, for the stats
+static unsigned int levelCount = 0;
+
+static Mesh* getQuad()
+{
+	static Mesh* fsQuad = MeshUtils::makeQuad(2.0f);
+	return fsQuad;
+}
+
+static void setSource(Texture2D* texture, glm::uvec2 size)
+{
+	SimpleRenderer::setTexture_0(texture);
+	SimpleRenderer::setShaderProp_Vec2("sourceTexelSize", glm::vec2(1.0f / size.x, 1.0f / size.y));
+}
+
+static void downsample(Texture2D* source, glm::uvec2 sourceSize, bool brightPass)
+{
+	SimpleRenderer::bindShader(ShaderUtils::getShaderVariant(variants_downsample, brightPass ? 1u : 0u));
+	setSource(source, sourceSize);
+
+	if (brightPass)
+	{
+		// Quadratic curve from threshold - knee up to threshold, linear above
+		float k = glm::max(knee, 0.0001f);
+		SimpleRenderer::setShaderProp_Vec4("bloomThreshold", glm::vec4(threshold, threshold - k, 2.0f * k, 0.25f / k));
+	}
+
+	SimpleRenderer::drawMesh(getQuad());
+}
+
+static void upsample(Texture2D* source, glm::uvec2 sourceSize, Texture2D* level)
+{
+	SimpleRenderer::bindShader(shader_upsample);
+	setSource(source, sourceSize);
+	SimpleRenderer::setTexture_1(level);
+	SimpleRenderer::setShaderProp_Float("bloomRadius", radius);
+
+	SimpleRenderer::drawMesh(getQuad());
+}
+
+void Bloom::loadShaders()
+{
+	ShaderUtils::loadShaderVariants(&variants_downsample, "BLOOM_DOWNSAMPLE", "../assets/shaders/screen.vert", "../assets/shaders/bloom_downsample.frag", { "BRIGHT_PASS" },
+		[](Shader* shader)
+		{
+			SimpleRenderer::bindShader(shader);
+			SimpleRenderer::setShaderProp_Integer("sourceTex", 0);
+		});
+	ShaderUtils::loadShader(&shader_upsample, "BLOOM_UPSAMPLE", "../assets/shaders/screen.vert", "../assets/shaders/bloom_upsample.frag",
+		[](Shader* shader)
+		{
+			SimpleRenderer::bindShader(shader);
+			SimpleRenderer::setShaderProp_Integer("sourceTex", 0);
+			SimpleRenderer::setShaderProp_Integer("downsampleTex", 1);
+		});
+
+	// Both downsample variants are used every frame
+	ShaderUtils::getShaderVariant(variants_downsample, 0u);
+	ShaderUtils::getShaderVariant(variants_downsample, 1u);
+}
+
+void Bloom::setEnabled(bool value)
+{
+	enabled = value;
+}
+
+bool Bloom::isEnabled()
+{
+	return enabled;
+}
+
+FrameGraphResource Bloom::addPasses(FrameGraphResource source, glm::uvec2 size)
+{
+	levelCount = 0;
+	if (!enabled)
+		return FrameGraph::NO_RESOURCE;
+
+	glm::uvec2 sizes[MAX_LEVELS];
+	FrameGraphResource down[MAX_LEVELS];
+
+	glm::uvec2 levelSize = size / 2u;
+	while (levelCount < MAX_LEVELS && levelSize.x >= MIN_LEVEL_SIZE && levelSize.y >= MIN_LEVEL_SIZE)
+	{
+		sizes[levelCount] = levelSize;
+		down[levelCount] = FrameGraph::createTarget("Bloom down " + std::to_string(levelCount),
+			RenderTargetDesc::colour(levelSize, ColourFormat::R11G11B10_F, TextureFilterMode::LINEAR));
+		levelCount++;
+		levelSize /= 2u;
+	}
+
+	if (levelCount == 0)
+		return FrameGraph::NO_RESOURCE;
+
+	for (unsigned int i = 0; i < levelCount; i++)
+	{
+		FrameGraphResource from = i == 0 ? source : down[i - 1];
+		glm::uvec2 fromSize = i == 0 ? size : sizes[i - 1];
+		bool brightPass = i == 0;
+
+		FrameGraph::addPass("Bloom Down " + std::to_string(i), { from }, { down[i] }, FrameGraph::NO_RESOURCE,
+			[from, fromSize, brightPass]() { downsample(FrameGraph::getTexture(from), fromSize, brightPass); });
+	}
+
+	// Each upsample writes its own target so nothing is read and written in one pass;
+	// the pool shares them with the downsample levels no longer needed
+	FrameGraphResource result = down[levelCount - 1];
+	for (int i = (int)levelCount - 2; i >= 0; i--)
+	{
+		FrameGraphResource up = FrameGraph::createTarget("Bloom up " + std::to_string(i),
+			RenderTargetDesc::colour(sizes[i], ColourFormat::R11G11B10_F, TextureFilterMode::LINEAR));
+		FrameGraphResource from = result, level = down[i];
+		glm::uvec2 fromSize = sizes[i + 1];
+
+		FrameGraph::addPass("Bloom Up " + std::to_string(i), { from, level }, { up }, FrameGraph::NO_RESOURCE,
+			[from, fromSize, level]() { upsample(FrameGraph::getTexture(from), fromSize, FrameGraph::getTexture(level)); });
+		result = up;
+	}
+
+	return result;
+}
+
+void Bloom::bindTexture(FrameGraphResource bloom)
+{
+	glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT_BLOOM);
+	glBindTexture(GL_TEXTURE_2D, FrameGraph::getTexture(bloom)->getNativeHandle());
+	glActiveTexture(GL_TEXTURE0);
+}
+
+void Bloom::setShaderProps()
+{
+	SimpleRenderer::setShaderProp_Integer("bloomTex", TEXTURE_UNIT_BLOOM);
+	SimpleRenderer::setShaderProp_Float("bloomIntensity", intensity);
+}
+
+#ifdef XBGT2094_ENABLE_IMGUI
+void Bloom::imgui_drawControls()
+{
+	ImGui::Checkbox("Bloom", &enabled);
+	ImGui::TextColored(ImVec4(0.0f, 0.8f, 1.0f, 1.0f), "   Threshold");
+	ImGui::SliderFloat("SliderB1", &threshold, 0.0f, 4.0f);
+	ImGui::TextColored(ImVec4(0.0f, 0.8f, 1.0f, 1.0f), "   Knee");
+	ImGui::SliderFloat("SliderB2", &knee, 0.0f, 1.0f);
+	ImGui::TextColored(ImVec4(0.0f, 0.8f, 1.0f, 1.0f), "   Intensity");
+	ImGui::SliderFloat("SliderB3", &intensity, 0.0f, 1.0f);
+	ImGui::TextColored(ImVec4(0.0f, 0.8f, 1.0f, 1.0f), "   Radius");
+	ImGui::SliderFloat("SliderB4", &radius, 0.5f, 2.0f);
+}
+
+void Bloom::imgui_drawStats()
+{
+	float totalMs = 0.0f;
+	for (unsigned int i = 0; i < levelCount; i++)
+	{
+		totalMs += GPUProfiler::getTimeMs("Bloom Down " + std::to_string(i));
+		if (i + 1 < levelCount)
+			totalMs += GPUProfiler::getTimeMs("Bloom Up " + std::to_string(i));
+	}
+
+	ImGui::Text("Bloom: %u levels, %.3f ms (per level in the GPU profiler)", levelCount, totalMs);
+}
+#endif
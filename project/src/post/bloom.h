@@ -0,0 +1,40 @@
+#pragma once
+#include "../fbo/frame_graph.h"
+
+// Bloom from a mip-chain pyramid of the HDR scene colour.
+//
+// The first downsample (half size) applies a soft-knee bright pass to a Karis average of the
+// 13-tap filter; each further one halves the size again. The upsamples then walk back up,
+// adding a 3x3 tent of the level below to each level's downsample, which gives a wide,
+// smooth glow while every pass stays cheap. All levels are pooled frame graph targets and
+// each pass shows in the GPU profiler as "Bloom Down n" / "Bloom Up n".
+class Bloom
+{
+	Bloom() = delete;
+
+public:
+	static const unsigned int MAX_LEVELS = 6;
+	// Levels stop before either side gets smaller than this
+	static const unsigned int MIN_LEVEL_SIZE = 8;
+
+	// Post pass units: 0 scene colour, 1 grading LUT
+	static const int TEXTURE_UNIT_BLOOM = 2;
+
+	static void loadShaders();
+
+	static void setEnabled(bool enabled);
+	static bool isEnabled();
+
+	// Adds the passes reading source (of the given size) and returns the half-size result,
+	// NO_RESOURCE when disabled
+	static FrameGraphResource addPasses(FrameGraphResource source, glm::uvec2 size);
+
+	// For the pass compositing the result
+	static void bindTexture(FrameGraphResource bloom);
+	static void setShaderProps();
+
+#ifdef XBGT2094_ENABLE_IMGUI
+	static void imgui_drawControls();
+	static void imgui_drawStats();
+#endif
+};
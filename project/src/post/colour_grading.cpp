@@ -0,0 +1,136 @@
+#include <glad/glad.h>
+#include "colour_grading.h"
+#include "../framework/simplerenderer.h"
+#include <vector>
+#include <chrono>
+
+#ifdef XBGT2094_ENABLE_IMGUI
+#include "../imgui/imgui.h"
+#endif
+
+static unsigned int lutTexture = 0;
+static ColourGradingParams currentParams;
+
+// Stats
+static unsigned int statBakes = 0;
+static float statBakeMs = 0.0f;
+
+static bool isSameParams(const ColourGradingParams& a, const ColourGradingParams& b)
+{
+	return a.exposure == b.exposure && a.exposureValue == b.exposureValue
+		&& a.contrast == b.contrast && a.contrastValue == b.contrastValue
+		&& a.saturation == b.saturation && a.saturationValue == b.saturationValue
+		&& a.sepia == b.sepia;
+}
+
+glm::vec3 ColourGrading::grade(const glm::vec3& colour, const ColourGradingParams& params)
+{
+	glm::vec3 result = colour;
+
+	if (params.exposure)
+		result *= params.exposureValue;
+
+	if (params.contrast)
+		result = (result - 0.5f) * params.contrastValue + 0.5f;
+
+	if (params.saturation)
+	{
+		float gray = glm::dot(result, glm::vec3(0.299f, 0.587f, 0.114f));
+		result = glm::mix(glm::vec3(gray), result, params.saturationValue);
+	}
+
+	if (params.sepia)
+	{
+		result = glm::vec3(
+			glm::dot(result, glm::vec3(0.393f, 0.769f, 0.189f)),
+			glm::dot(result, glm::vec3(0.349f, 0.686f, 0.168f)),
+			glm::dot(result, glm::vec3(0.272f, 0.534f, 0.131f)));
+	}
+
+	return result;
+}
+
+static void bake(const ColourGradingParams& params)
+{
+	auto timeStart = std::chrono::high_resolution_clock::now();
+
+	const unsigned int size = ColourGrading::LUT_SIZE;
+	std::vector<glm::vec3> texels(size * size * size);
+
+	// Texel centres sample the input at exactly i / (size - 1)
+	for (unsigned int b = 0; b < size; b++)
+	{
+		for (unsigned int g = 0; g < size; g++)
+		{
+			for (unsigned int r = 0; r < size; r++)
+			{
+				glm::vec3 input = glm::vec3((float)r, (float)g, (float)b) / (float)(size - 1);
+				texels[(b * size + g) * size + r] = ColourGrading::grade(input, params);
+			}
+		}
+	}
+
+	if (lutTexture == 0)
+	{
+		glGenTextures(1, &lutTexture);
+		glBindTexture(GL_TEXTURE_3D, lutTexture);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+		glTexImage3D(GL_TEXTURE_3D, 0, GL_RGB16F, size, size, size, 0, GL_RGB, GL_FLOAT, texels.data());
+	}
+	else
+	{
+		glBindTexture(GL_TEXTURE_3D, lutTexture);
+		glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, size, size, size, GL_RGB, GL_FLOAT, texels.data());
+	}
+	glBindTexture(GL_TEXTURE_3D, 0);
+
+	auto timeEnd = std::chrono::high_resolution_clock::now();
+	statBakeMs = std::chrono::duration<float, std::milli>(timeEnd - timeStart).count();
+	statBakes++;
+}
+
+void ColourGrading::update(const ColourGradingParams& params)
+{
+	if (lutTexture != 0 && isSameParams(params, currentParams))
+		return;
+
+	// Nothing to bake while the lookup is skipped
+	currentParams = params;
+	if (isActive())
+		bake(params);
+}
+
+bool ColourGrading::isActive()
+{
+	return currentParams.exposure || currentParams.contrast || currentParams.saturation || currentParams.sepia;
+}
+
+void ColourGrading::bindTexture()
+{
+	glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT_LUT);
+	glBindTexture(GL_TEXTURE_3D, lutTexture);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+void ColourGrading::setShaderProps()
+{
+	SimpleRenderer::setShaderProp_Integer("gradingLut", TEXTURE_UNIT_LUT);
+
+	// Maps [0, 1] onto the first to last texel centre
+	float scale = (LUT_SIZE - 1.0f) / LUT_SIZE;
+	float offset = 0.5f / LUT_SIZE;
+	SimpleRenderer::setShaderProp_Vec2("gradingLutScaleOffset", glm::vec2(scale, offset));
+}
+
+#ifdef XBGT2094_ENABLE_IMGUI
+void ColourGrading::imgui_drawStats()
+{
+	const unsigned int bytes = LUT_SIZE * LUT_SIZE * LUT_SIZE * 6;
+	ImGui::Text("Grading LUT: %u^3 RGB16F, %.0f KB, %s", LUT_SIZE, bytes / 1024.0f, isActive() ? "active" : "skipped");
+	ImGui::Text("LUT bakes: %u, last %.2f ms CPU", statBakes, statBakeMs);
+}
+#endif
@@ -0,0 +1,47 @@
+#pragma once
+#include <glm/glm.hpp>
+
+// The grading operations, in the order they apply to the tone mapped colour
+struct ColourGradingParams
+{
+	bool exposure = false;
+	float exposureValue = 1.0f;
+	bool contrast = false;
+	float contrastValue = 1.0f;
+	bool saturation = false;
+	float saturationValue = 1.0f;
+	bool sepia = false;
+};
+
+// Colour grading baked into a LUT_SIZE^3 RGB16F 3D texture.
+//
+// The post pass tone maps analytically (its input is unbounded HDR), then grades with one
+// trilinear lookup of the LUT, so the per-pixel cost doesn't grow with the operations
+// stacked here. The LUT is re-baked on the CPU only when the params change. Its input is
+// the tone mapped colour clamped to [0, 1]; the output is not clamped.
+class ColourGrading
+{
+	ColourGrading() = delete;
+
+public:
+	static const unsigned int LUT_SIZE = 32;
+
+	// Unit 0 is the post pass's scene colour
+	static const int TEXTURE_UNIT_LUT = 1;
+
+	// Re-bakes the LUT if the params differ from the baked ones
+	static void update(const ColourGradingParams& params);
+
+	// False with every operation off; the post pass then skips the lookup
+	static bool isActive();
+
+	static void bindTexture();
+	static void setShaderProps();
+
+	// Applies the operations directly, as baked into each LUT texel
+	static glm::vec3 grade(const glm::vec3& colour, const ColourGradingParams& params);
+
+#ifdef XBGT2094_ENABLE_IMGUI
+	static void imgui_drawStats();
+#endif
+};
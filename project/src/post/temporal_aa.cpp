@@ -0,0 +1,225 @@
+#include <glad/glad.h>
+#include "temporal_aa.h"
+#include "../framework/simplerenderer.h"
+#include "../framework/gpu_profiler.h"
+#include "../shader/shader_utils.h"
+#include "../mesh/mesh_utils.h"
+#include <cmath>
+
+#ifdef XBGT2094_ENABLE_IMGUI
+#include "../imgui/imgui.h"
+#endif
+
+static Shader* shader_motion = nullptr;
+static Shader* shader_resolve = nullptr;
+
+static bool enabled = false;
+static float renderScale = 0.67f;
+static float currentWeight = 0.1f;		// Of the current frame in the resolve, the rest is history
+
+// Resolved colour, written to one and read from the other, swapped every frame
+static Texture2D* history[2] = { nullptr, nullptr };
+static glm::uvec2 historySize = glm::uvec2(0);
+static unsigned int current = 0;
+static bool reset = true;
+
+static unsigned int frameIndex = 0;
+static glm::vec2 jitter = glm::vec2(0.0f);		// NDC, as set on the camera
+static glm::mat4 previousViewProjection;
+
+// Stats
+static glm::uvec2 lastRenderSize = glm::uvec2(0);
+static unsigned int jitterPhases = 0;
+
+static Mesh* getQuad()
+{
+	static Mesh* fsQuad = MeshUtils::makeQuad(2.0f);
+	return fsQuad;
+}
+
+static RenderTargetDesc getHistoryDesc(glm::uvec2 size)
+{
+	return RenderTargetDesc::colour(size, ColourFormat::RGBA_16F, TextureFilterMode::LINEAR);
+}
+
+// Element index (from 1) of the Halton sequence in the given base, in [0, 1)
+static float halton(unsigned int index, unsigned int base)
+{
+	float result = 0.0f;
+	float fraction = 1.0f;
+	while (index > 0)
+	{
+		fraction /= base;
+		result += fraction * (index % base);
+		index /= base;
+	}
+	return result;
+}
+
+// (Re)creates the history textures at the output size; their contents are invalid until written
+static void initHistory(glm::uvec2 size)
+{
+	if (history[0] && historySize == size)
+		return;
+
+	for (Texture2D*& texture : history)
+	{
+		delete texture;
+
+		TextureConfig cfg(TextureWrapMode::CLAMP, TextureWrapMode::CLAMP, TextureFilterMode::LINEAR, false);
+		cfg.internalFormat = GL_RGBA16F;
+		texture = Texture2D::createColourTexture(size.x, size.y, cfg, GL_RGB, nullptr);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	historySize = size;
+	reset = true;
+}
+
+static void writeMotionVectors(Texture2D* depth, const glm::mat4& invViewProjection, const glm::mat4& viewProjection, const glm::mat4& previous)
+{
+	SimpleRenderer::bindShader(shader_motion);
+	SimpleRenderer::setTexture_0(depth);
+	SimpleRenderer::setShaderProp_Mat4("invViewProjection", invViewProjection);
+	SimpleRenderer::setShaderProp_Mat4("viewProjection", viewProjection);
+	SimpleRenderer::setShaderProp_Mat4("previousViewProjection", previous);
+	SimpleRenderer::drawMesh(getQuad());
+}
+
+static void resolve(Texture2D* colour, Texture2D* depth, Texture2D* motion, Texture2D* previous, glm::vec2 jitterUv, bool historyValid)
+{
+	SimpleRenderer::bindShader(shader_resolve);
+	SimpleRenderer::setTexture_0(colour);
+	SimpleRenderer::setTexture_1(depth);
+	SimpleRenderer::setTexture_2(motion);
+	SimpleRenderer::setTexture_3(previous);
+	SimpleRenderer::setShaderProp_Vec2("jitterUv", jitterUv);
+	SimpleRenderer::setShaderProp_Float("currentWeight", currentWeight);
+	SimpleRenderer::setShaderProp_Integer("historyValid", historyValid ? 1 : 0);
+	SimpleRenderer::drawMesh(getQuad());
+}
+
+void TemporalAA::loadShaders()
+{
+	ShaderUtils::loadShader(&shader_motion, "TAA_MOTION", "../assets/shaders/screen.vert", "../assets/shaders/taa_motion.frag",
+		[](Shader* shader)
+		{
+			SimpleRenderer::bindShader(shader);
+			SimpleRenderer::setShaderProp_Integer("sceneDepth", 0);
+		});
+	ShaderUtils::loadShader(&shader_resolve, "TAA_RESOLVE", "../assets/shaders/screen.vert", "../assets/shaders/taa_resolve.frag",
+		[](Shader* shader)
+		{
+			SimpleRenderer::bindShader(shader);
+			SimpleRenderer::setShaderProp_Integer("currentColour", 0);
+			SimpleRenderer::setShaderProp_Integer("sceneDepth", 1);
+			SimpleRenderer::setShaderProp_Integer("motionVectors", 2);
+			SimpleRenderer::setShaderProp_Integer("historyColour", 3);
+		});
+}
+
+void TemporalAA::setEnabled(bool value)
+{
+	// The history is stale after being off
+	if (value && !enabled)
+		reset = true;
+	enabled = value;
+}
+
+bool TemporalAA::isEnabled()
+{
+	return enabled;
+}
+
+glm::uvec2 TemporalAA::getRenderSize(glm::uvec2 outputSize)
+{
+	if (!enabled)
+		return outputSize;
+
+	glm::vec2 size = glm::vec2(outputSize) * renderScale;
+	return glm::max(glm::uvec2(size + 0.5f), glm::uvec2(1));
+}
+
+void TemporalAA::beginFrame(CameraBase* camera, glm::uvec2 renderSize)
+{
+	if (!enabled)
+	{
+		jitter = glm::vec2(0.0f);
+		camera->setJitter(jitter);
+		return;
+	}
+
+	// Index 0 of the sequence is (0, 0), so start at 1
+	jitterPhases = (unsigned int)std::ceil(JITTER_PHASES / (renderScale * renderScale));
+	unsigned int index = frameIndex % jitterPhases + 1;
+	glm::vec2 offset = glm::vec2(halton(index, 2), halton(index, 3)) - 0.5f;
+
+	jitter = 2.0f * offset / glm::vec2(renderSize);
+	camera->setJitter(jitter);
+}
+
+FrameGraphResource TemporalAA::addPasses(CameraBase* camera, FrameGraphResource colour, FrameGraphResource depth,
+	glm::uvec2 renderSize, glm::uvec2 outputSize)
+{
+	if (!enabled)
+		return colour;
+
+	initHistory(outputSize);
+	lastRenderSize = renderSize;
+
+	// Depth was drawn jittered; motion is measured between the unjittered projections
+	glm::mat4 viewProjection = camera->getUnjitteredProjectionMatrix() * camera->getViewMatrix();
+	glm::mat4 invViewProjection = glm::inverse(camera->getMatrixVP());
+	if (reset)
+		previousViewProjection = viewProjection;
+
+	FrameGraphResource motion = FrameGraph::createTarget("Motion vectors", RenderTargetDesc::colour(renderSize, ColourFormat::RG_16F, TextureFilterMode::NEAREST));
+	glm::mat4 previous = previousViewProjection;
+	FrameGraph::addPass("Motion Vectors", { depth }, { motion }, FrameGraph::NO_RESOURCE,
+		[depth, invViewProjection, viewProjection, previous]()
+		{
+			writeMotionVectors(FrameGraph::getTexture(depth), invViewProjection, viewProjection, previous);
+		});
+	previousViewProjection = viewProjection;
+
+	// Last frame's result is read, this frame's written
+	FrameGraphResource historyRead = FrameGraph::importTexture("TAA history (previous)", getHistoryDesc(outputSize), history[current]);
+	current = 1 - current;
+	FrameGraphResource result = FrameGraph::importTexture("TAA history", getHistoryDesc(outputSize), history[current]);
+
+	glm::vec2 jitterUv = jitter * 0.5f;
+	bool historyValid = !reset;
+	reset = false;
+
+	FrameGraph::addPass("TAA Resolve", { colour, depth, motion, historyRead }, { result }, FrameGraph::NO_RESOURCE,
+		[colour, depth, motion, historyRead, jitterUv, historyValid]()
+		{
+			resolve(FrameGraph::getTexture(colour), FrameGraph::getTexture(depth), FrameGraph::getTexture(motion),
+				FrameGraph::getTexture(historyRead), jitterUv, historyValid);
+		});
+
+	frameIndex++;
+	return result;
+}
+
+#ifdef XBGT2094_ENABLE_IMGUI
+void TemporalAA::imgui_drawControls()
+{
+	bool value = enabled;
+	if (ImGui::Checkbox("Temporal AA (upscaling)", &value))
+		setEnabled(value);
+	ImGui::TextColored(ImVec4(0.0f, 0.8f, 1.0f, 1.0f), "   Render scale");
+	ImGui::SliderFloat("SliderU1", &renderScale, 0.5f, 1.0f);
+	ImGui::TextColored(ImVec4(0.0f, 0.8f, 1.0f, 1.0f), "   Current frame weight");
+	ImGui::SliderFloat("SliderU2", &currentWeight, 0.02f, 0.5f);
+}
+
+void TemporalAA::imgui_drawStats()
+{
+	if (!enabled)
+		return;
+
+	ImGui::Text("TAA: %ux%u -> %ux%u, %u jitter phases", lastRenderSize.x, lastRenderSize.y, historySize.x, historySize.y, jitterPhases);
+	ImGui::Text("Motion %.3f ms, resolve %.3f ms", GPUProfiler::getTimeMs("Motion Vectors"), GPUProfiler::getTimeMs("TAA Resolve"));
+}
+#endif
@@ -0,0 +1,43 @@
+#pragma once
+#include "../fbo/frame_graph.h"
+#include "../camera/camera_base.h"
+
+// Temporal anti-aliasing with upscaling.
+//
+// While enabled the scene renders at renderScale of the output, its projection jittered by a
+// Halton(2, 3) sub-pixel offset that changes every frame. A motion vector pass reprojects
+// each pixel's depth with last frame's unjittered view projection (the entities' transforms
+// are static, so camera motion is all there is). The resolve then samples the history at
+// the reprojected position, clips it to the variance box of the current frame's 3x3
+// neighbourhood and blends the current frame in, writing an output-size history that is
+// ping-ponged between two textures imported into the frame graph.
+class TemporalAA
+{
+	TemporalAA() = delete;
+
+public:
+	// Jitter sequence length at native resolution; scaled up by the pixel ratio so every
+	// output pixel still sees as many distinct samples
+	static const unsigned int JITTER_PHASES = 8;
+
+	static void loadShaders();
+
+	static void setEnabled(bool enabled);
+	static bool isEnabled();
+
+	// Size the scene renders at: the output times the render scale while enabled
+	static glm::uvec2 getRenderSize(glm::uvec2 outputSize);
+
+	// Before the scene passes: this frame's jitter on the camera, none while disabled
+	static void beginFrame(CameraBase* camera, glm::uvec2 renderSize);
+
+	// Adds the motion vector and resolve passes and returns the resolved colour (output size),
+	// colour itself when disabled
+	static FrameGraphResource addPasses(CameraBase* camera, FrameGraphResource colour, FrameGraphResource depth,
+		glm::uvec2 renderSize, glm::uvec2 outputSize);
+
+#ifdef XBGT2094_ENABLE_IMGUI
+	static void imgui_drawControls();
+	static void imgui_drawStats();
+#endif
+};
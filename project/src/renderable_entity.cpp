@@ -1,12 +1,7 @@
 #include "renderable_entity.h"
 #include <glm/gtc/matrix_transform.hpp>
 
-RenderableEntity::RenderableEntity() : mesh(0), shader(0) {
-	diffuseTex = TextureUtils::checkerTexture2D();
-	specularTex = TextureUtils::whiteTexture2D();
-	normalTex = TextureUtils::whiteTexture2D();
-	emissiveTex = TextureUtils::blackTexture2D();	// Set blank texture for safety
-
+RenderableEntity::RenderableEntity() : mesh(0), material(0), isStatic(true) {
 }
 
 glm::mat4 RenderableEntity::getModelMatrix() const {
@@ -3,32 +3,61 @@
 #include "scene_asgn.h"
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/quaternion.hpp>
+#include <glm/gtc/constants.hpp>
 #include "framework/framework.h"
 #include "renderable_entity.h"
 #include <vector>
 #include <algorithm>
 #include <map>
+#include <tuple>
+#include <chrono>
+#include <iostream>
 
 #ifdef XBGT2094_ENABLE_IMGUI
 #include "imgui/imgui.h"
 #endif
 #include "lighting/light_debug.h"
+#include "lighting/light_cluster.h"
+#include "framework/gpu_profiler.h"
+#include "shadow/shadow_casters.h"
+#include "shadow/cascaded_shadow_map.h"
+#include "shadow/shadow_atlas.h"
+#include "framework/hot_reload.h"
+#include "framework/asset_loader.h"
+#include "texture/texture_upload.h"
+#include "texture/texture_streamer.h"
+#include "material/material_utils.h"
+#include "fbo/frame_graph.h"
+#include "post/colour_grading.h"
+#include "post/bloom.h"
+#include "post/auto_exposure.h"
+#include "post/temporal_aa.h"
 
 
 static Mesh* mesh_skybox;
 static Shader* shader_skybox;
 static Cubemap* cubemap_skybox;
 
-static Shader* shader_floor;
-static Shader* shader_house;
-static Shader* shader_fan;
-static Shader* shader_tree;
-static Shader* shader_rocks;
-static Shader* shader_water;
-static Shader* shader_roadlamp;
-static Shader* shader_lantern;
-static Shader* shader_horse;
-static Shader* shader_screen;
+// combined.frag entities (floor, house, fan, tree, rocks, horse), one program per keyword mask
+static ShaderVariants* variants_combined;
+static ShaderVariants* variants_combined_fan;
+// Alpha-blended programs (water, roadlamp, lantern), with the transparentKeywords
+static ShaderVariants* variants_water;
+static ShaderVariants* variants_roadlamp;
+static ShaderVariants* variants_lantern;
+static ShaderVariants* variants_screen;
+static Shader* shader_oit_composite;
+static Shader* shader_depth_downsample;
+static Shader* shader_transparency_upsample;
+
+// Deferred shading: gbuffer.frag with the combinedKeywords, as for the forward programs
+static ShaderVariants* variants_gbuffer;
+static ShaderVariants* variants_gbuffer_fan;
+static ShaderVariants* variants_deferred_lighting;
+
+// Shadow casters
+static Shader* shader_shadow_depth;
+static Shader* shader_shadow_depth_fan;
 
 static DirectionalLight* dLight;
 static PointLight* pLight;
@@ -37,10 +66,36 @@ static PointLight* pLight_Lantern02;
 static PointLight* pLight_Lantern03;
 static PointLight* pLight_rainbow;
 
+// Extra lanterns scattered over the village to stress the light clusters
+static std::vector<PointLight*> pLights_extra;
+static int extraLanternCount = 0;
+
 static std::vector<RenderableEntity*> entities_opaque;
 static std::vector<RenderableEntity*> entities_alphatest;
 static std::vector<RenderableEntity*> entities_alphablend;
 
+// Weighted blended order-independent transparency instead of sorting the alpha-blended
+// entities back to front. Needs no order, so intersecting transparents blend correctly.
+static bool enableOIT = false;
+
+// Alpha-blended entities drawn at reduced resolution (0 = full, 1 = half, 2 = quarter) against
+// a downsampled depth, then upsampled over the scene colour with depth-aware weights
+static int transparencyDownscale = 0;
+// Size of the target the transparents of this frame draw into
+static glm::uvec2 transparencyResolution;
+
+// Extra (transparent) lanterns to benchmark the sorted and OIT paths, drawn after entities_alphablend
+static std::vector<RenderableEntity*> entities_alphablend_extra;
+static int extraTransparentCount = 0;
+static RenderableEntity* extraTransparentTemplate;
+
+struct TransparencyStats
+{
+	unsigned int entities;
+	float sortMs;
+};
+static TransparencyStats transparencyStats;
+
 //Lighting debug checkbox//
 static bool enableDebug = false; //lighting debug
 
@@ -63,6 +118,10 @@ static float exposure = 1.0f;
 static float contrast = 1.5f;
 static float saturation = 1.0f;
 
+// The scene is lit into a linear HDR target and resolved once per pixel in the post pass.
+// R11G11B10_F has no alpha, which blending (source alpha only) doesn't need.
+static bool enableSceneRGBA16F = false;
+
 //Booleans post processing
 static bool enablePostProcessing = false; //Post-processing
 static bool enableSepia = true;
@@ -70,8 +129,260 @@ static bool enableFilmGrain = true;
 static bool enableBadTVSignal = true;
 static bool enableVignette = true;
 
-//ColourDepthFBO
-static ColourDepthFBO* fbo;
+// Shader keywords, in bit order. The toggles above select a program instead of setting uniform bools.
+static const std::vector<std::string> litKeywords = { "DIRECTIONAL_LIGHT" };
+// The HDR resolve and the effects share the post pass. GRADING is the LUT lookup (sepia, exposure, contrast, saturation).
+static const std::vector<std::string> screenKeywords = { "TONEMAP", "GRADING", "BLOOM", "AUTO_EXPOSURE", "FILM_GRAIN", "BAD_TV_SIGNAL", "VIGNETTE" };
+// combined.frag also has the instanced texture array path, one bit past the lit keywords, and
+// the surface types past that. A material sets its surface in MaterialDesc::keywordMask (none is the floor).
+static const std::vector<std::string> combinedKeywords = { "DIRECTIONAL_LIGHT", "TEXTURE_ARRAYS",
+	"SURFACE_HOUSE", "SURFACE_FAN", "SURFACE_TREE", "SURFACE_ROCKS", "SURFACE_HORSE" };
+static const unsigned int TEXTURE_ARRAYS_KEYWORD = 1u << 1;
+static const unsigned int SURFACE_HOUSE_KEYWORD = 1u << 2;
+static const unsigned int SURFACE_FAN_KEYWORD = 1u << 3;
+static const unsigned int SURFACE_TREE_KEYWORD = 1u << 4;
+static const unsigned int SURFACE_ROCKS_KEYWORD = 1u << 5;
+static const unsigned int SURFACE_HORSE_KEYWORD = 1u << 6;
+// Alpha-blended programs (oit.glsl)
+static const std::vector<std::string> transparentKeywords = { "OIT" };
+
+static unsigned int getLitKeywordMask()
+{
+	bool keywords[] = { enableDirectionalLight };
+
+	unsigned int mask = 0;
+	for (unsigned int i = 0; i < sizeof(keywords) / sizeof(keywords[0]); i++)
+		mask |= keywords[i] ? (1u << i) : 0u;
+	return mask;
+}
+
+// The effects only with post processing on; the HDR resolve always runs
+static ColourGradingParams getColourGradingParams()
+{
+	ColourGradingParams params;
+	// Auto exposure replaces the manual one, applied before tone mapping
+	params.exposure = enableHDR && enableExposure && !AutoExposure::isEnabled();
+	params.exposureValue = exposure;
+	params.contrast = enableHDR && enableContrast;
+	params.contrastValue = contrast;
+	params.saturation = enableHDR && enableSaturation;
+	params.saturationValue = saturation;
+	params.sepia = enablePostProcessing && enableSepia;
+	return params;
+}
+
+// Expects ColourGrading::update() with this frame's params first
+static unsigned int getScreenKeywordMask(bool bloom, bool autoExposure)
+{
+	bool effects = enablePostProcessing;
+	bool keywords[] = { enableHDR && enableTonemap, ColourGrading::isActive(), bloom, autoExposure,
+		effects && enableFilmGrain, effects && enableBadTVSignal, effects && enableVignette };
+
+	unsigned int mask = 0;
+	for (unsigned int i = 0; i < sizeof(keywords) / sizeof(keywords[0]); i++)
+		mask |= keywords[i] ? (1u << i) : 0u;
+	return mask;
+}
+
+// Forward program of a material: its keyword variant if it has variants
+static Shader* getForwardShader(const Material* material)
+{
+	const MaterialDesc& desc = material->getDesc();
+	if (desc.shaderVariants != 0)
+		return ShaderUtils::getShaderVariant(desc.shaderVariants, getLitKeywordMask() | desc.keywordMask);
+	return desc.shader;
+}
+
+static Shader* getGBufferShader(const Material* material)
+{
+	const MaterialDesc& desc = material->getDesc();
+	return ShaderUtils::getShaderVariant(desc.gbufferVariants, desc.keywordMask);
+}
+
+// Scene targets of this frame's graph, declared in draw() and read by the passes added in postDraw()
+static FrameGraphResource sceneColour;
+static FrameGraphResource sceneDepth;
+// Their size: the viewport, or below it while temporal AA upscales
+static glm::uvec2 renderSize;
+
+// Copy of the scene colour after the opaques and skybox, for materials with readsOpaqueTexture.
+// Downscale 0 = full, 1 = half, 2 = quarter resolution.
+static const int OPAQUE_TEXTURE_UNIT = 4;	// After the material slots
+static int opaqueTextureDownscale = 1;
+static bool opaqueTextureCopied = false;
+
+// Deferred shading. Opaque entities with gbufferVariants are written to the G-buffer
+// and lit in one fullscreen pass; everything else stays forward.
+static bool enableDeferred = false;
+
+// G-buffer targets, layout documented in gbuffer_common.glsl
+struct GBufferTargets
+{
+	FrameGraphResource albedoSpecular, normalShininess, emissive, depth;
+};
+
+static bool isDeferred(const RenderableEntity& entity)
+{
+	return enableDeferred && entity.material->getDesc().gbufferVariants != 0;
+}
+
+// Texture array batching. Opaque entities with material layers are sorted by their material
+// keywords, arrays and mesh; each run of one mesh on the same arrays is one instanced draw, and
+// the program and arrays are only rebound when they change. Each instance carries its material
+// index for the parameters.
+static bool enableTextureArrays = true;
+
+struct EntityBatch
+{
+	unsigned int keywordMask;	// Of the material
+	Mesh* mesh;
+	TextureArray* diffuse;
+	TextureArray* specular;
+	TextureArray* normal;
+	unsigned int firstInstance, instanceCount;
+};
+
+struct BatchStats
+{
+	unsigned int entities, draws, arrayBinds;
+};
+static BatchStats batchStats;
+
+// Batches are drawn with the default render state and have no emissive layer
+static bool isBatched(const RenderableEntity& entity)
+{
+	const MaterialDesc& desc = entity.material->getDesc();
+	return enableTextureArrays && desc.diffuseLayer != 0 && desc.state.cullBackFaces && !desc.state.blend
+		&& desc.textures[(int)MaterialSlot::EMISSIVE] == TextureUtils::blackTexture2D();
+}
+
+// Uploads the instances of the batched entities drawn by this pass (forward or deferred)
+static void buildBatches(const std::vector<RenderableEntity*>& entities, bool deferred, std::vector<EntityBatch>& batches)
+{
+	std::vector<const RenderableEntity*> batched;
+	for (auto it : entities)
+	{
+		if (isBatched(*it) && isDeferred(*it) == deferred && it->mesh != nullptr)
+			batched.push_back(it);
+	}
+
+	std::sort(batched.begin(), batched.end(), [](const RenderableEntity* a, const RenderableEntity* b)
+	{
+		const MaterialDesc& descA = a->material->getDesc();
+		const MaterialDesc& descB = b->material->getDesc();
+		return std::make_tuple(descA.keywordMask, descA.diffuseLayer->array, descA.specularLayer->array, descA.normalLayer->array, a->mesh)
+			< std::make_tuple(descB.keywordMask, descB.diffuseLayer->array, descB.specularLayer->array, descB.normalLayer->array, b->mesh);
+	});
+
+	std::vector<MeshInstance> instances;
+	for (const RenderableEntity* entity : batched)
+	{
+		const MaterialDesc& desc = entity->material->getDesc();
+		TextureArray* diffuse = desc.diffuseLayer->array;
+		TextureArray* specular = desc.specularLayer->array;
+		TextureArray* normal = desc.normalLayer->array;
+		if (batches.empty() || batches.back().keywordMask != desc.keywordMask || batches.back().mesh != entity->mesh
+			|| batches.back().diffuse != diffuse || batches.back().specular != specular || batches.back().normal != normal)
+			batches.push_back({ desc.keywordMask, entity->mesh, diffuse, specular, normal, (unsigned int)instances.size(), 0 });
+		batches.back().instanceCount++;
+
+		MeshInstance instance;
+		instance.model = entity->getModelMatrix();
+		instance.material = glm::vec4((float)desc.diffuseLayer->layer, (float)desc.specularLayer->layer, (float)entity->material->getIndex(), (float)desc.normalLayer->layer);
+		instances.push_back(instance);
+	}
+
+	if (!instances.empty())
+		SimpleRenderer::setInstances(instances);
+}
+
+// Binds the variant for keywordMask and each batch's material keywords (setting its per-pass
+// uniforms with setProps) as it changes
+static void drawBatches(const std::vector<EntityBatch>& batches, ShaderVariants* variants, unsigned int keywordMask,
+	CameraBase* camera, void (*setProps)(CameraBase*))
+{
+	Shader* boundProgram = nullptr;
+	TextureArray* boundDiffuse = nullptr;
+	TextureArray* boundSpecular = nullptr;
+	TextureArray* boundNormal = nullptr;
+	for (const EntityBatch& batch : batches)
+	{
+		Shader* program = ShaderUtils::getShaderVariant(variants, keywordMask | batch.keywordMask);
+		if (program != boundProgram)
+		{
+			SimpleRenderer::bindShader(program);
+			setProps(camera);
+			boundProgram = program;
+		}
+
+		if (batch.diffuse != boundDiffuse)
+		{
+			SimpleRenderer::setTextureArray(0, batch.diffuse);
+			boundDiffuse = batch.diffuse;
+			batchStats.arrayBinds++;
+		}
+		if (batch.specular != boundSpecular)
+		{
+			SimpleRenderer::setTextureArray(1, batch.specular);
+			boundSpecular = batch.specular;
+			batchStats.arrayBinds++;
+		}
+		if (batch.normal != boundNormal)
+		{
+			SimpleRenderer::setTextureArray(2, batch.normal);
+			boundNormal = batch.normal;
+			batchStats.arrayBinds++;
+		}
+
+		SimpleRenderer::drawMeshInstanced(batch.mesh, batch.firstInstance, batch.instanceCount);
+		batchStats.draws++;
+		batchStats.entities += batch.instanceCount;
+	}
+}
+
+// Material-sorted submission. The entity lists are sorted by material once at load, so
+// consecutive entities usually share a program and a material and each is only bound once.
+struct SubmitStats
+{
+	unsigned int programBinds, materialBinds;
+};
+static SubmitStats submitStats;
+
+// Program and material bound by the current pass
+struct SubmitState
+{
+	Shader* program;
+	const Material* material;
+};
+
+static void sortByMaterial(std::vector<RenderableEntity*>& entities)
+{
+	std::stable_sort(entities.begin(), entities.end(), [](const RenderableEntity* a, const RenderableEntity* b)
+	{
+		return a->material->getSortKey() < b->material->getSortKey();
+	});
+}
+
+// Binds a program (setting its per-pass uniforms with setProps) and a material, each only if
+// it differs from the one already bound
+static void bindEntityMaterial(SubmitState& bound, Shader* program, const Material* material, CameraBase* camera, void (*setProps)(CameraBase*))
+{
+	if (program != bound.program)
+	{
+		SimpleRenderer::bindShader(program);
+		setProps(camera);
+		bound.program = program;
+		bound.material = nullptr;	// materialIndex is per program
+		submitStats.programBinds++;
+	}
+
+	if (material != bound.material)
+	{
+		MaterialUtils::bind(material);
+		bound.material = material;
+		submitStats.materialBinds++;
+	}
+}
 
 static void renderSkybox(CameraBase* camera)
 {
@@ -91,168 +402,425 @@ static void renderSkybox(CameraBase* camera)
 	glDepthFunc(GL_LESS);
 }
 
+// Camera, light and grading uniforms of the forward opaque programs
+static void setForwardShaderProps(CameraBase* camera)
+{
+	SimpleRenderer::setShaderProp_Mat4("projection", camera->getProjectionMatrix());
+	SimpleRenderer::setShaderProp_Mat4("view", camera->getViewMatrix());
+	SimpleRenderer::setShaderProp_Vec3("cameraPosition", camera->getPosition());
+
+	SimpleRenderer::setShaderProp_Vec2("resolution", renderSize);
+	SimpleRenderer::setShaderProp_Float("time", App::getTime());
+
+	SimpleRenderer::setShaderProp_Vec3("dirLightColour", dLight->getColorIntensified());
+	SimpleRenderer::setShaderProp_Vec3("dirLightDirection", dLight->getDirection());
+
+	// Point and spot lights
+	LightCluster::setShaderProps();
+	CascadedShadowMap::setShaderProps();
+	ShadowAtlas::setShaderProps();
+}
+
+static void renderOpaqueBatches(CameraBase* camera)
+{
+	std::vector<EntityBatch> batches;
+	buildBatches(entities_opaque, false, batches);
+	if (batches.empty())
+		return;
+
+	drawBatches(batches, variants_combined, getLitKeywordMask() | TEXTURE_ARRAYS_KEYWORD, camera, setForwardShaderProps);
+}
+
 static void renderOpaques(CameraBase* camera)
 {
+	SubmitState bound = {};
+
 	// Iterate through all opaque entities
 	for (auto it : entities_opaque)
 	{
 		auto& entity = *it; // Alias *it as entity for readability purposes
 
-		// 1. Bind the shader for this entity
-		SimpleRenderer::bindShader(entity.shader);
+		// Already lit by the deferred pass, or drawn in a batch
+		if (isDeferred(entity) || isBatched(entity))
+			continue;
+
+		// 1. Bind the program and material of this entity, if not bound already
+		bindEntityMaterial(bound, getForwardShader(entity.material), entity.material, camera, setForwardShaderProps);
 
 		// 2. Set shader properties
-		SimpleRenderer::setShaderProp_Mat4("projection", camera->getProjectionMatrix());
-		SimpleRenderer::setShaderProp_Mat4("view", camera->getViewMatrix());
 		SimpleRenderer::setShaderProp_Mat4("model", entity.getModelMatrix());
-		SimpleRenderer::setShaderProp_Vec3("cameraPosition", camera->getPosition());
 
-		SimpleRenderer::setShaderProp_Vec2("resolution", App::getViewportSize());
-		SimpleRenderer::setShaderProp_Float("time", App::getTime());
+		// 3. draw the mesh of this entity
+		SimpleRenderer::drawMesh(entity.mesh);
+	}
+	MaterialUtils::resetRenderState();
 
-		SimpleRenderer::setShaderProp_Vec3("dirLightColour", dLight->getColorIntensified());
-		SimpleRenderer::setShaderProp_Vec3("dirLightDirection", dLight->getDirection());
+	renderOpaqueBatches(camera);
+}
 
-		SimpleRenderer::setShaderProp_Vec3("pointLightColourRainbow", pLight_rainbow->getColorIntensified());
-		SimpleRenderer::setShaderProp_Vec3("pointLightPositionRainbow", pLight_rainbow->getPosition());
-		SimpleRenderer::setShaderProp_Float("pointLightRangeRainbow", pLight_rainbow->getInverseSquaredRange());
+static void renderAlphaTest(CameraBase* camera)
+{
+	SubmitState bound = {};
 
-		SimpleRenderer::setShaderProp_Vec3("pointLightColour0", pLight->getColorIntensified());
-		SimpleRenderer::setShaderProp_Vec3("pointLightPosition0", pLight->getPosition());
-		SimpleRenderer::setShaderProp_Float("pointLightRange0", pLight->getInverseSquaredRange());
+	// Iterate through all alpha-tested entities
+	for (auto it : entities_alphatest)
+	{
+		auto& entity = *it; // Alias *it as entity for readability purposes
 
-		SimpleRenderer::setShaderProp_Bool("enableDirectionalLight", enableDirectionalLight);
-		SimpleRenderer::setShaderProp_Bool("enableRainbowLight", enableRainbowLight);
+		// Already lit by the deferred pass
+		if (isDeferred(entity))
+			continue;
 
-		SimpleRenderer::setShaderProp_Bool("enableHDR", enableHDR);
-		SimpleRenderer::setShaderProp_Bool("enableTonemap", enableTonemap);
-		SimpleRenderer::setShaderProp_Bool("enableExposure", enableExposure);
-		SimpleRenderer::setShaderProp_Bool("enableContrast", enableContrast);
-		SimpleRenderer::setShaderProp_Bool("enableSaturation", enableSaturation);
+		bindEntityMaterial(bound, getForwardShader(entity.material), entity.material, camera, setForwardShaderProps);
+		SimpleRenderer::setShaderProp_Mat4("model", entity.getModelMatrix());
+		SimpleRenderer::drawMesh(entity.mesh);
+	}
+	MaterialUtils::resetRenderState();
+}
 
-		SimpleRenderer::setShaderProp_Float("exposure", exposure);
-		SimpleRenderer::setShaderProp_Float("contrast", contrast);
-		SimpleRenderer::setShaderProp_Float("saturation", saturation);
+static Shader* getTransparentShader(const Material* material, bool oit)
+{
+	return ShaderUtils::getShaderVariant(material->getDesc().shaderVariants, oit ? 1u : 0u);
+}
 
-		// 3. Set material properties of this entity
-		SimpleRenderer::setTexture_0(entity.diffuseTex);
-		SimpleRenderer::setTexture_1(entity.specularTex);
+// Camera and light uniforms of the alpha-blended programs
+static void setBlendShaderProps(CameraBase* camera)
+{
+	SimpleRenderer::setShaderProp_Mat4("projection", camera->getProjectionMatrix());
+	SimpleRenderer::setShaderProp_Mat4("view", camera->getViewMatrix());
 
-		// 4. draw the mesh of this entity
-		SimpleRenderer::drawMesh(entity.mesh);
+	SimpleRenderer::setShaderProp_Vec2("resolution", transparencyResolution);
+	SimpleRenderer::setShaderProp_Float("time", App::getTime());
+	SimpleRenderer::setShaderProp_Vec3("cameraPosition", camera->getPosition());
 
-	}
+	// Point and spot lights; the tiles shrink with a reduced resolution transparency target
+	LightCluster::setShaderProps(glm::vec2(transparencyResolution) / glm::vec2(renderSize));
 }
 
-static void renderAlphaTest(CameraBase* camera)
+// Sorted: back to front into the scene colour, or the reduced resolution target (offscreen).
+// OIT: in material order (as sorted at load) into the OIT targets, with BlendMode::WEIGHTED_OIT.
+static void renderAlphaBlends(CameraBase* camera, bool oit, bool offscreen)
 {
-	// Iterate through all alpha-tested entities
-	glDisable(GL_CULL_FACE);
+	std::vector<RenderableEntity*> transparents = entities_alphablend;
+	transparents.insert(transparents.end(), entities_alphablend_extra.begin(), entities_alphablend_extra.begin() + extraTransparentCount);
+	transparencyStats.entities = (unsigned int)transparents.size();
+	transparencyStats.sortMs = 0.0f;
 
-	// Iterate through all alpha-tested entities
-	for (auto it : entities_alphatest)
+	if (!oit)
+	{
+		auto timeStart = std::chrono::high_resolution_clock::now();
+
+		// Iterate through all alpha-blended entities
+		std::sort(transparents.begin(), transparents.end(),
+			[&camera](const RenderableEntity* el1, const RenderableEntity* el2)
+			{
+				//Calculate distance of et1 to the camera (et1_dist)
+				float el1_dist = glm::length2(el1->position - camera->getPosition());
+
+				//Calculate distance of et2 to the camera (et1_dist)
+				float el2_dist = glm::length2(el2->position - camera->getPosition());
+
+				return el1_dist > el2_dist;
+			}
+		);
+
+		auto timeEnd = std::chrono::high_resolution_clock::now();
+		transparencyStats.sortMs = std::chrono::duration<float, std::milli>(timeEnd - timeStart).count();
+	}
+
+	MaterialUtils::setBlendMode(oit ? BlendMode::WEIGHTED_OIT : offscreen ? BlendMode::OFFSCREEN : BlendMode::ALPHA);
+
+	// Sorted back to front, materials are only shared between neighbours; blending and depth
+	// writes come from each material's render state
+	SubmitState bound = {};
+
+	// Iterate through all alpha-blended entities
+	for (auto it : transparents)
 	{
 		auto& entity = *it; // Alias *it as entity for readability purposes
 
-		// 1. Bind the shader for this entity
-		SimpleRenderer::bindShader(entity.shader);
+		// 1. Bind the program and material of this entity, if not bound already
+		bindEntityMaterial(bound, getTransparentShader(entity.material, oit), entity.material, camera, setBlendShaderProps);
 
 		// 2. Set shader properties
-		SimpleRenderer::setShaderProp_Mat4("projection", camera->getProjectionMatrix());
-		SimpleRenderer::setShaderProp_Mat4("view", camera->getViewMatrix());
 		SimpleRenderer::setShaderProp_Mat4("model", entity.getModelMatrix());
-		SimpleRenderer::setShaderProp_Vec3("cameraPosition", camera->getPosition());
 
-		SimpleRenderer::setShaderProp_Vec2("resolution", App::getViewportSize());
-		SimpleRenderer::setShaderProp_Float("time", App::getTime());
+		// 3. draw the mesh of this entity
+		SimpleRenderer::drawMesh(entity.mesh);
+	}
+	MaterialUtils::resetRenderState();
+	MaterialUtils::setBlendMode(BlendMode::ALPHA);
+}
 
-		SimpleRenderer::setShaderProp_Vec3("dirLightColour", dLight->getColorIntensified());
-		SimpleRenderer::setShaderProp_Vec3("dirLightDirection", dLight->getDirection());
+// Blends the OIT result over the scene colour, or the reduced resolution target (bound)
+static void compositeOIT(FrameGraphResource accumulation, FrameGraphResource accumulationWeight, bool offscreen)
+{
+	static Mesh* fsQuad = MeshUtils::makeQuad(2.0f);
 
-		// 3. Set material properties of this entity
-		SimpleRenderer::setTexture_0(entity.diffuseTex);
-		SimpleRenderer::setTexture_1(entity.specularTex);
-	
+	SimpleRenderer::bindShader(shader_oit_composite);
+	SimpleRenderer::setTexture_0(FrameGraph::getTexture(accumulation));
+	SimpleRenderer::setTexture_1(FrameGraph::getTexture(accumulationWeight));
+
+	MaterialUtils::setBlendMode(offscreen ? BlendMode::OFFSCREEN : BlendMode::ALPHA);
+	MaterialUtils::applyRenderState(MaterialRenderState::alphaBlended());
+	SimpleRenderer::drawMesh(fsQuad);
+	MaterialUtils::resetRenderState();
+	MaterialUtils::setBlendMode(BlendMode::ALPHA);
+}
+
+// Nearest depth of each block of the scene depth into the reduced depth target (bound)
+static void downsampleDepth(FrameGraphResource fullDepth, int downscale)
+{
+	static Mesh* fsQuad = MeshUtils::makeQuad(2.0f);
+
+	SimpleRenderer::bindShader(shader_depth_downsample);
+	SimpleRenderer::setTexture_0(FrameGraph::getTexture(fullDepth));
+	SimpleRenderer::setShaderProp_Integer("downscale", 1 << downscale);
+
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_ALWAYS);
+	SimpleRenderer::drawMesh(fsQuad);
+	glDepthFunc(GL_LESS);
+}
+
+// Composites the reduced resolution transparents over the scene colour (bound): its colour
+// is added over the scene scaled by the transmittance, with BlendMode::TRANSMITTANCE
+static void upsampleTransparency(CameraBase* camera, FrameGraphResource colour, FrameGraphResource depth, FrameGraphResource fullDepth)
+{
+	static Mesh* fsQuad = MeshUtils::makeQuad(2.0f);
+
+	SimpleRenderer::bindShader(shader_transparency_upsample);
+	SimpleRenderer::setTexture_0(FrameGraph::getTexture(colour));
+	SimpleRenderer::setTexture_1(FrameGraph::getTexture(depth));
+	SimpleRenderer::setTexture_2(FrameGraph::getTexture(fullDepth));
+	SimpleRenderer::setShaderProp_Vec2("clipPlanes", glm::vec2(camera->getNearClip(), camera->getFarClip()));
+
+	MaterialUtils::setBlendMode(BlendMode::TRANSMITTANCE);
+	MaterialUtils::applyRenderState(MaterialRenderState::alphaBlended());
+	SimpleRenderer::drawMesh(fsQuad);
+	MaterialUtils::resetRenderState();
+	MaterialUtils::setBlendMode(BlendMode::ALPHA);
+}
+
+static void setGBufferShaderProps(CameraBase* camera)
+{
+	SimpleRenderer::setShaderProp_Mat4("projection", camera->getProjectionMatrix());
+	SimpleRenderer::setShaderProp_Mat4("view", camera->getViewMatrix());
+	SimpleRenderer::setShaderProp_Float("time", App::getTime());
+}
+
+static void renderGBufferEntities(CameraBase* camera, const std::vector<RenderableEntity*>& entities, bool batchable)
+{
+	SubmitState bound = {};
+	for (auto it : entities)
+	{
+		auto& entity = *it;
+
+		if (!isDeferred(entity) || (batchable && isBatched(entity)))
+			continue;
 
-		// 4. draw the mesh of this entity
+		bindEntityMaterial(bound, getGBufferShader(entity.material), entity.material, camera, setGBufferShaderProps);
+		SimpleRenderer::setShaderProp_Mat4("model", entity.getModelMatrix());
 		SimpleRenderer::drawMesh(entity.mesh);
+	}
+	MaterialUtils::resetRenderState();
+}
 
-		
+// Into the G-buffer targets, bound and cleared by the frame graph
+static void renderGBuffer(CameraBase* camera)
+{
+	glEnable(GL_DEPTH_TEST);
+
+	renderGBufferEntities(camera, entities_opaque, true);
+
+	std::vector<EntityBatch> batches;
+	buildBatches(entities_opaque, true, batches);
+	if (!batches.empty())
+		drawBatches(batches, variants_gbuffer, TEXTURE_ARRAYS_KEYWORD, camera, setGBufferShaderProps);
+
+	renderGBufferEntities(camera, entities_alphatest, false);
+}
+
+static void submitShadowCasters(const std::vector<RenderableEntity*>& entities)
+{
+	for (auto it : entities)
+	{
+		auto& entity = *it;
+
+		const MaterialDesc& desc = entity.material->getDesc();
+		if (desc.shadowShader != 0)
+			ShadowCasters::add(entity.mesh, desc.shadowShader, entity.material->getTexture(MaterialSlot::DIFFUSE), entity.getModelMatrix(), entity.isStatic);
 	}
+}
+
+static void renderShadows(CameraBase* camera)
+{
+	ShadowCasters::clear();
+	submitShadowCasters(entities_opaque);
+	submitShadowCasters(entities_alphatest);
+	submitShadowCasters(entities_alphablend);
+
+	if (enableDirectionalLight)
+		CascadedShadowMap::update(camera, dLight);
 
-	glEnable(GL_CULL_FACE);
+	CascadedShadowMap::bindTexture();
+
+	// Point/spot shadows first, the cluster upload reads their atlas indices
+	ShadowAtlas::update(camera, App::getViewportSize());
+	ShadowAtlas::bindTextures();
 }
 
-static void renderAlphaBlends(CameraBase* camera)
+// Frustum planes from the view-projection rows, normalised so the sphere test is in world units
+static void getFrustumPlanes(CameraBase* camera, glm::vec4* planes)
 {
-	// Iterate through all alpha-blended entities
-	std::sort(entities_alphablend.begin(), entities_alphablend.end(),
-		[&camera](const RenderableEntity* el1, const RenderableEntity* el2)
-		{
-			//Calculate distance of et1 to the camera (et1_dist)
-			float el1_dist = glm::length2(el1->position - camera->getPosition());
+	glm::mat4 vp = glm::transpose(camera->getMatrixVP());
+	glm::vec4 rows[6] = { vp[3] + vp[0], vp[3] - vp[0], vp[3] + vp[1], vp[3] - vp[1], vp[3] + vp[2], vp[3] - vp[2] };
+	for (int i = 0; i < 6; i++)
+		planes[i] = rows[i] / glm::length(glm::vec3(rows[i]));
+}
 
-			//Calculate distance of et2 to the camera (et1_dist)
-			float el2_dist = glm::length2(el2->position - camera->getPosition());
+// World-space bounding sphere of the entity's mesh; returns the largest axis scale
+static float getBoundingSphere(const RenderableEntity& entity, glm::vec3& centre, float& radius)
+{
+	glm::mat4 model = entity.getModelMatrix();
+	glm::vec3 localCentre = (entity.mesh->boundsMin + entity.mesh->boundsMax) * 0.5f;
+	float localRadius = glm::length(entity.mesh->boundsMax - entity.mesh->boundsMin) * 0.5f;
+	float maxScale = glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+
+	centre = glm::vec3(model * glm::vec4(localCentre, 1.0f));
+	radius = localRadius * maxScale;
+	return maxScale;
+}
 
-			return el1_dist > el2_dist;
+static bool isSphereInFrustum(const glm::vec4* planes, const glm::vec3& centre, float radius)
+{
+	for (int i = 0; i < 6; i++)
+	{
+		if (glm::dot(glm::vec3(planes[i]), centre) + planes[i].w < -radius)
+			return false;
+	}
+	return true;
+}
+
+// Tells the streamer how densely each visible entity's textures land on screen
+static void requestEntityTextures(const std::vector<RenderableEntity*>& entities, CameraBase* camera, const glm::vec4* planes, float pixelsPerUnit)
+{
+	glm::vec3 cameraPos = camera->getPosition();
+	float nearClip = camera->getNearClip();
+
+	for (auto it : entities)
+	{
+		auto& entity = *it;
+		if (entity.mesh == nullptr || entity.mesh->worldUnitsPerUV <= 0.0f)
+			continue;
+
+		glm::vec3 centre;
+		float radius;
+		float maxScale = getBoundingSphere(entity, centre, radius);
+		if (!isSphereInFrustum(planes, centre, radius))
+			continue;
+
+		// Densest at the nearest point of the bounds
+		float distance = glm::max(glm::length(centre - cameraPos) - radius, nearClip);
+		float pixelsPerUV = pixelsPerUnit * entity.mesh->worldUnitsPerUV * maxScale / distance;
+
+		// Batched entities read diffuse and specular from their (fully resident) array layers
+		const Material* material = entity.material;
+		if (!isBatched(entity))
+		{
+			TextureStreamer::request(material->getTexture(MaterialSlot::DIFFUSE), pixelsPerUV);
+			TextureStreamer::request(material->getTexture(MaterialSlot::SPECULAR), pixelsPerUV);
 		}
-	);
+		TextureStreamer::request(material->getTexture(MaterialSlot::NORMAL), pixelsPerUV);
+		TextureStreamer::request(material->getTexture(MaterialSlot::EMISSIVE), pixelsPerUV);
+	}
+}
 
-	glDisable(GL_CULL_FACE);
-	glDepthMask(GL_FALSE);
+static void requestTextureMips(CameraBase* camera)
+{
+	if (!TextureStreamer::isEnabled())
+		return;
 
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glm::vec4 planes[6];
+	getFrustumPlanes(camera, planes);
+
+	// Screen pixels covered by one world unit at distance 1
+	float pixelsPerUnit = App::getViewportSize().y / (2.0f * tanf(glm::radians(camera->getFieldOfView()) * 0.5f));
+
+	requestEntityTextures(entities_opaque, camera, planes, pixelsPerUnit);
+	requestEntityTextures(entities_alphatest, camera, planes, pixelsPerUnit);
+	requestEntityTextures(entities_alphablend, camera, planes, pixelsPerUnit);
+}
+
+static bool isOpaqueTextureNeeded(CameraBase* camera)
+{
+	glm::vec4 planes[6];
+	getFrustumPlanes(camera, planes);
 
-	// Iterate through all alpha-blended entities
 	for (auto it : entities_alphablend)
 	{
-		auto& entity = *it; // Alias *it as entity for readability purposes
+		auto& entity = *it;
+		if (!entity.material->getDesc().readsOpaqueTexture || entity.mesh == nullptr)
+			continue;
+
+		glm::vec3 centre;
+		float radius;
+		getBoundingSphere(entity, centre, radius);
+		if (isSphereInFrustum(planes, centre, radius))
+			return true;
+	}
+	return false;
+}
+
+// Blits the scene colour into the pass's (bound) opaque texture, filtered when downscaling
+static void copyOpaqueTexture(FrameGraphResource source, glm::uvec2 sourceSize, glm::uvec2 size)
+{
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, FrameGraph::getFramebuffer({ source }, FrameGraph::NO_RESOURCE));
+	glBlitFramebuffer(0, 0, sourceSize.x, sourceSize.y, 0, 0, size.x, size.y, GL_COLOR_BUFFER_BIT, size == sourceSize ? GL_NEAREST : GL_LINEAR);
+}
 
-		// 1. Bind the shader for this entity
-		SimpleRenderer::bindShader(entity.shader);
+// Lights the G-buffer into the currently bound target, then copies the G-buffer depth
+// into it so the skybox and the forward passes depth test against the deferred geometry.
+static void renderDeferredLighting(CameraBase* camera, const GBufferTargets& gbuffer)
+{
+	static Mesh* fsQuad = MeshUtils::makeQuad(2.0f);
 
-		// 2. Set shader properties
-		SimpleRenderer::setShaderProp_Mat4("projection", camera->getProjectionMatrix());
-		SimpleRenderer::setShaderProp_Mat4("view", camera->getViewMatrix());
-		SimpleRenderer::setShaderProp_Mat4("model", entity.getModelMatrix());
+	glDisable(GL_DEPTH_TEST);
+	glDepthMask(GL_FALSE);
 
-		SimpleRenderer::setShaderProp_Vec2("resolution", App::getViewportSize());
-		SimpleRenderer::setShaderProp_Float("time", App::getTime());
-		SimpleRenderer::setShaderProp_Vec3("cameraPosition", camera->getPosition());
+	SimpleRenderer::bindShader(ShaderUtils::getShaderVariant(variants_deferred_lighting, getLitKeywordMask()));
 
-		SimpleRenderer::setShaderProp_Vec3("pointLightColour0", pLight->getColorIntensified());
-		SimpleRenderer::setShaderProp_Vec3("pointLightPosition0", pLight->getPosition());
-		SimpleRenderer::setShaderProp_Float("pointLightRange0", pLight->getInverseSquaredRange());
+	SimpleRenderer::setShaderProp_Mat4("view", camera->getViewMatrix());
+	SimpleRenderer::setShaderProp_Mat4("invViewProjection", glm::inverse(camera->getMatrixVP()));
+	SimpleRenderer::setShaderProp_Vec3("cameraPosition", camera->getPosition());
 
-		SimpleRenderer::setShaderProp_Vec3("pointLightColour1", pLight_Lantern01->getColorIntensified());
-		SimpleRenderer::setShaderProp_Vec3("pointLightPosition1", pLight_Lantern01->getPosition());
-		SimpleRenderer::setShaderProp_Float("pointLightRange1", pLight_Lantern01->getInverseSquaredRange());
+	SimpleRenderer::setShaderProp_Vec3("dirLightColour", dLight->getColorIntensified());
+	SimpleRenderer::setShaderProp_Vec3("dirLightDirection", dLight->getDirection());
 
-		SimpleRenderer::setShaderProp_Vec3("pointLightColour2", pLight_Lantern02->getColorIntensified());
-		SimpleRenderer::setShaderProp_Vec3("pointLightPosition2", pLight_Lantern02->getPosition());
-		SimpleRenderer::setShaderProp_Float("pointLightRange2", pLight_Lantern02->getInverseSquaredRange());
+	// Point and spot lights
+	LightCluster::setShaderProps();
+	CascadedShadowMap::setShaderProps();
+	ShadowAtlas::setShaderProps();
 
-		SimpleRenderer::setShaderProp_Vec3("pointLightColour3", pLight_Lantern03->getColorIntensified());
-		SimpleRenderer::setShaderProp_Vec3("pointLightPosition3", pLight_Lantern03->getPosition());
-		SimpleRenderer::setShaderProp_Float("pointLightRange3", pLight_Lantern03->getInverseSquaredRange());
+	SimpleRenderer::setTexture_0(FrameGraph::getTexture(gbuffer.albedoSpecular));
+	SimpleRenderer::setTexture_1(FrameGraph::getTexture(gbuffer.normalShininess));
+	SimpleRenderer::setTexture_2(FrameGraph::getTexture(gbuffer.emissive));
+	SimpleRenderer::setTexture_3(FrameGraph::getTexture(gbuffer.depth));
 
-		SimpleRenderer::setShaderProp_Bool("enableRoadlamp", enableRoadlamp);
-		SimpleRenderer::setShaderProp_Bool("enableLanternLeft", enableLanternLeft);
-		SimpleRenderer::setShaderProp_Bool("enableLanternMid", enableLanternMid);
-		SimpleRenderer::setShaderProp_Bool("enableLanternRight", enableLanternRight);
+	SimpleRenderer::drawMesh(fsQuad);
 
-		// 3. Set material properties of this entity
-		SimpleRenderer::setTexture_0(entity.diffuseTex);
-		// 4. draw the mesh of this entity
-		SimpleRenderer::drawMesh(entity.mesh);
-	}
-	glDisable(GL_BLEND);
-	glEnable(GL_CULL_FACE);
 	glDepthMask(GL_TRUE);
-}
+	glEnable(GL_DEPTH_TEST);
+
+	// Both depth attachments are DEPTH24 of the same size, so a depth blit is allowed
+	GLint target = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+	glm::ivec2 size = renderSize;
 
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, FrameGraph::getFramebuffer({}, gbuffer.depth));
+	glBlitFramebuffer(0, 0, size.x, size.y, 0, 0, size.x, size.y, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, target);
+}
 
 // preload() runs before loadShaders()
 // Shader* variables are NOT initialized yet, referencing will not work!
@@ -267,58 +835,122 @@ void Scene_ASGN::preload()
 	cubemap_skybox = TextureUtils::loadCubemap("../assets/textures/skybox/galaxy", "jpg");
 }
 
+// Forward, deferred and (for batchable ones) texture array variants of the entities' materials
+static void submitMaterialVariants(const std::vector<RenderableEntity*>& entities)
+{
+	for (auto it : entities)
+	{
+		const MaterialDesc& desc = it->material->getDesc();
+		getForwardShader(it->material);
+		if (desc.gbufferVariants != 0)
+			getGBufferShader(it->material);
+		if (desc.diffuseLayer != 0)
+		{
+			ShaderUtils::getShaderVariant(variants_combined, getLitKeywordMask() | TEXTURE_ARRAYS_KEYWORD | desc.keywordMask);
+			ShaderUtils::getShaderVariant(variants_gbuffer, TEXTURE_ARRAYS_KEYWORD | desc.keywordMask);
+		}
+	}
+}
+
+// Every combined.frag program serves all of its entities, so all of its samplers map to
+// material slots the same way. The array samplers take the units of their slots too.
+static const std::vector<std::pair<std::string, MaterialSlot>> combinedSamplers = {
+	{ "texture_floor_diffuse", MaterialSlot::DIFFUSE }, { "texture_floor_normal", MaterialSlot::NORMAL },
+	{ "texture_house", MaterialSlot::DIFFUSE }, { "texture_house2", MaterialSlot::SPECULAR },
+	{ "texture_fan", MaterialSlot::DIFFUSE }, { "texture_fan2", MaterialSlot::SPECULAR },
+	{ "texture_tree_diffuse", MaterialSlot::DIFFUSE }, { "texture_tree_specular", MaterialSlot::SPECULAR },
+	{ "texture_rocks_diffuse", MaterialSlot::DIFFUSE }, { "texture_rocks_specular", MaterialSlot::SPECULAR }, { "texture_rocks_normal", MaterialSlot::NORMAL },
+	{ "horse_texture_diffuse", MaterialSlot::DIFFUSE }, { "horse_texture_specular", MaterialSlot::SPECULAR },
+	{ "texture_emissive", MaterialSlot::EMISSIVE },
+	{ "materialDiffuse", MaterialSlot::DIFFUSE }, { "materialSpecular", MaterialSlot::SPECULAR }, { "materialNormal", MaterialSlot::NORMAL },
+};
+
+static void setCombinedSamplers(Shader* shader)
+{
+	MaterialUtils::setShaderSlots(shader, combinedSamplers);
+}
+
 // loadShaders() run AFTER preload()
 // It is also called when reload shader key is pressed (default F1)
 void Scene_ASGN::loadShaders()
 {
-	ShaderUtils::loadShader(&shader_floor, "FLOOR", "../assets/shaders/standard.vert", "../assets/shaders/combined.frag");//original floor.frag-
-	ShaderUtils::loadShader(&shader_house, "HOUSE", "../assets/shaders/standard.vert", "../assets/shaders/combined.frag");//original house.frag-
-	ShaderUtils::loadShader(&shader_fan, "FAN", "../assets/shaders/house.vert", "../assets/shaders/combined.frag");//original house.frag-
-	ShaderUtils::loadShader(&shader_tree, "TREE", "../assets/shaders/standard.vert", "../assets/shaders/combined.frag");//original tree.frag-
-	ShaderUtils::loadShader(&shader_rocks, "ROCKS", "../assets/shaders/standard.vert", "../assets/shaders/combined.frag");//original rocks.frag-
-	ShaderUtils::loadShader(&shader_water, "WATER", "../assets/shaders/standard.vert", "../assets/shaders/water.frag");//original water.frag
-	ShaderUtils::loadShader(&shader_roadlamp, "ROADLAMP", "../assets/shaders/standard.vert", "../assets/shaders/roadlamp.frag");//original roadlamp.frag
-	ShaderUtils::loadShader(&shader_lantern, "LANTERN", "../assets/shaders/standard.vert", "../assets/shaders/lantern.frag");//original lantern.frag
-	ShaderUtils::loadShader(&shader_horse, "HORSE", "../assets/shaders/standard.vert", "../assets/shaders/combined.frag");//original horse.frag-
-	ShaderUtils::loadShader(&shader_screen, "SCREEN", "../assets/shaders/screen.vert", "../assets/shaders/screen.frag");//original screen.frag
-
-	SimpleRenderer::bindShader(shader_floor);
-	SimpleRenderer::setShaderProp_Integer("texture_floor_diffuse", 0);
-	SimpleRenderer::setShaderProp_Integer("texture_floor_normal", 1);
-
-	SimpleRenderer::bindShader(shader_house);
-	SimpleRenderer::setShaderProp_Integer("texture_house", 0);
-	SimpleRenderer::setShaderProp_Integer("texture_house2", 1);
-
-	SimpleRenderer::bindShader(shader_fan);
-	SimpleRenderer::setShaderProp_Integer("texture_fan", 0);
-	SimpleRenderer::setShaderProp_Integer("texture_fan2", 1);
-
-	SimpleRenderer::bindShader(shader_tree);
-	SimpleRenderer::setShaderProp_Integer("texture_tree_diffuse", 0);
-	SimpleRenderer::setShaderProp_Integer("texture_tree_specular", 1);
-
-	SimpleRenderer::bindShader(shader_rocks);
-	SimpleRenderer::setShaderProp_Integer("texture_rocks_diffuse", 0);
-	SimpleRenderer::setShaderProp_Integer("texture_rocks_specular", 1);
-	SimpleRenderer::setShaderProp_Integer("texture_rocks_normal", 2);
-
-	SimpleRenderer::bindShader(shader_water);
-	SimpleRenderer::setShaderProp_Integer("opaqueTexture", 0);
-
-	SimpleRenderer::bindShader(shader_roadlamp);
-	SimpleRenderer::setShaderProp_Integer("texture_roadlamp_diffuse", 0);
-	SimpleRenderer::setShaderProp_Integer("texture_roadlamp_specular", 1);
-
-	SimpleRenderer::bindShader(shader_lantern);
-	SimpleRenderer::setShaderProp_Integer("lantern_texture", 0);
-	SimpleRenderer::setShaderProp_Integer("lantern_nouse", 1);
-	SimpleRenderer::setShaderProp_Integer("lantern_texture_emissive", 2);
-
-	SimpleRenderer::bindShader(shader_horse);
-	SimpleRenderer::setShaderProp_Integer("horse_texture_diffuse", 0);
-	SimpleRenderer::setShaderProp_Integer("horse_texture_specular", 1);
+	// Programs compile in the background and may be swapped in frames later (or on first use for
+	// variants), so sampler slots and the material block are set from the onCompiled callbacks
+	ShaderUtils::loadShaderVariants(&variants_combined, "COMBINED", "../assets/shaders/standard.vert", "../assets/shaders/combined.frag", combinedKeywords, setCombinedSamplers);//original floor/house/tree/rocks/horse.frag-
+	ShaderUtils::loadShaderVariants(&variants_combined_fan, "COMBINED_FAN", "../assets/shaders/house.vert", "../assets/shaders/combined.frag", combinedKeywords, setCombinedSamplers);//original house.frag-
+	ShaderUtils::loadShaderVariants(&variants_water, "WATER", "../assets/shaders/standard.vert", "../assets/shaders/water.frag", transparentKeywords,//original water.frag
+		[](Shader* shader)
+		{
+			MaterialUtils::setShaderSlots(shader, { { "distortTex", MaterialSlot::DIFFUSE } });
+			SimpleRenderer::setShaderProp_Integer("opaqueTex", OPAQUE_TEXTURE_UNIT);
+		});
+	ShaderUtils::loadShaderVariants(&variants_roadlamp, "ROADLAMP", "../assets/shaders/standard.vert", "../assets/shaders/roadlamp.frag", transparentKeywords,//original roadlamp.frag
+		[](Shader* shader)
+		{
+			MaterialUtils::setShaderSlots(shader, { { "texture_roadllamp", MaterialSlot::DIFFUSE }, { "texture_specular", MaterialSlot::SPECULAR } });
+		});
+	ShaderUtils::loadShaderVariants(&variants_lantern, "LANTERN", "../assets/shaders/standard.vert", "../assets/shaders/lantern.frag", transparentKeywords,//original lantern.frag
+		[](Shader* shader)
+		{
+			MaterialUtils::setShaderSlots(shader, { { "texture_lantern", MaterialSlot::DIFFUSE }, { "texture_roadllamp", MaterialSlot::SPECULAR },
+				{ "texture_lantern_emissive", MaterialSlot::EMISSIVE } });
+		});
+	ShaderUtils::loadShaderVariants(&variants_screen, "SCREEN", "../assets/shaders/screen.vert", "../assets/shaders/screen.frag", screenKeywords);//original screen.frag
+
+	ShaderUtils::loadShaderVariants(&variants_gbuffer, "GBUFFER", "../assets/shaders/standard.vert", "../assets/shaders/gbuffer.frag", combinedKeywords, setCombinedSamplers);
+	ShaderUtils::loadShaderVariants(&variants_gbuffer_fan, "GBUFFER_FAN", "../assets/shaders/house.vert", "../assets/shaders/gbuffer.frag", combinedKeywords, setCombinedSamplers);
+	ShaderUtils::loadShaderVariants(&variants_deferred_lighting, "DEFERRED_LIGHTING", "../assets/shaders/screen.vert", "../assets/shaders/deferred_lighting.frag", litKeywords,
+		[](Shader* shader)
+		{
+			SimpleRenderer::bindShader(shader);
+			SimpleRenderer::setShaderProp_Integer("gAlbedoSpecular", 0);
+			SimpleRenderer::setShaderProp_Integer("gNormalShininess", 1);
+			SimpleRenderer::setShaderProp_Integer("gEmissive", 2);
+			SimpleRenderer::setShaderProp_Integer("gDepth", 3);
+		});
+
+	auto setAlphaTexture = [](Shader* shader)
+	{
+		MaterialUtils::setShaderSlots(shader, { { "alphaTexture", MaterialSlot::DIFFUSE } });
+	};
+	ShaderUtils::loadShader(&shader_shadow_depth, "SHADOW_DEPTH", "../assets/shaders/standard.vert", "../assets/shaders/shadow_depth.frag", setAlphaTexture);
+	ShaderUtils::loadShader(&shader_shadow_depth_fan, "SHADOW_DEPTH_FAN", "../assets/shaders/house.vert", "../assets/shaders/shadow_depth.frag", setAlphaTexture);
 
+	ShaderUtils::loadShader(&shader_oit_composite, "OIT_COMPOSITE", "../assets/shaders/screen.vert", "../assets/shaders/oit_composite.frag",
+		[](Shader* shader)
+		{
+			SimpleRenderer::bindShader(shader);
+			SimpleRenderer::setShaderProp_Integer("accumulation", 0);
+			SimpleRenderer::setShaderProp_Integer("accumulationWeight", 1);
+		});
+	ShaderUtils::loadShader(&shader_depth_downsample, "DEPTH_DOWNSAMPLE", "../assets/shaders/screen.vert", "../assets/shaders/depth_downsample.frag",
+		[](Shader* shader)
+		{
+			SimpleRenderer::bindShader(shader);
+			SimpleRenderer::setShaderProp_Integer("sceneDepth", 0);
+		});
+	ShaderUtils::loadShader(&shader_transparency_upsample, "TRANSPARENCY_UPSAMPLE", "../assets/shaders/screen.vert", "../assets/shaders/transparency_upsample.frag",
+		[](Shader* shader)
+		{
+			SimpleRenderer::bindShader(shader);
+			SimpleRenderer::setShaderProp_Integer("transparencyColour", 0);
+			SimpleRenderer::setShaderProp_Integer("transparencyDepth", 1);
+			SimpleRenderer::setShaderProp_Integer("sceneDepth", 2);
+		});
+
+	Bloom::loadShaders();
+	AutoExposure::loadShaders();
+	TemporalAA::loadShaders();
+
+	// Submit the variants for the current toggles now instead of on the first frame
+	// (the materials' ones only once load() has made them)
+	submitMaterialVariants(entities_opaque);
+	submitMaterialVariants(entities_alphatest);
+	ShaderUtils::getShaderVariant(variants_deferred_lighting, getLitKeywordMask());
+	for (ShaderVariants* variants : { variants_water, variants_roadlamp, variants_lantern })
+		ShaderUtils::getShaderVariant(variants, enableOIT ? 1u : 0u);
+	ColourGrading::update(getColourGradingParams());
+	ShaderUtils::getShaderVariant(variants_screen, getScreenKeywordMask(Bloom::isEnabled(), AutoExposure::isEnabled()));
 }
 
 // load() runs AFTER loadShaders()
@@ -342,6 +974,9 @@ void Scene_ASGN::load()
 	dLight->setColour(glm::vec3(1.0f));
 	dLight->setDirection({ 0.0, -1.0, -1.0 });
 	dLight->setIntensity(1.0f);
+
+	CascadedShadowMap::init();
+	ShadowAtlas::init();
 	
 	pLight = LightUtils::createPointLight("Roadlamp_Point_Light");
 	pLight->setColour({ 1.0f, 1.0f, 1.0f });
@@ -372,43 +1007,65 @@ void Scene_ASGN::load()
 	pLight_rainbow->setRange(10.0f);
 	pLight_rainbow->setPosition({ -3.0f, 2.0f, 4.8f });
 	pLight_rainbow->setIntensity(1.0f);
+	pLight_rainbow->setCastShadows(true);
 
 	// 3. Create renderable entities for the scene.
 	//
 	//		Entity creation flow:
 	//		1. Create new RenderableEntity
 	//		2. Assign mesh
-	//		3. Assign shader (shaders in loadShaders() are safe to use here!)
-	//		4. Set material properties
-	//		5. Set transformation properties
-	//		6. Push to the relevant collection (opaque, alpha-test or alpha-blend)
+	//		3. Assign a material (MaterialUtils::createMaterial; shaders in loadShaders() are safe to use here!)
+	//		4. Set transformation properties
+	//		5. Push to the relevant collection (opaque, alpha-test or alpha-blend)
 	//
+	// Entities with identical material descriptions share one Material.
 	// Note: it is your own responsibility to not insert the same entity multiple times.
 
 	//----------------------Entities Separator----------------------//
 
+	MaterialDesc floorMaterial;
+	floorMaterial.shaderVariants = variants_combined;
+	floorMaterial.gbufferVariants = variants_gbuffer;
+	floorMaterial.setTexture(MaterialSlot::DIFFUSE, TextureUtils::loadTexture2DCompressedAsync("../assets/textures/rocky_dirt_diffuse.png", TextureRole::ALBEDO));
+	floorMaterial.setTexture(MaterialSlot::NORMAL, TextureUtils::loadTexture2DCompressedAsync("../assets/textures/HPST 96 normal.png", TextureRole::NORMAL));
+	floorMaterial.diffuseLayer = TextureUtils::loadTextureLayerAsync("../assets/textures/rocky_dirt_diffuse.png", TextureRole::ALBEDO);
+	floorMaterial.normalLayer = TextureUtils::loadTextureLayerAsync("../assets/textures/HPST 96 normal.png", TextureRole::NORMAL);
+
 	RenderableEntity* floorEntity = new RenderableEntity();
 	floorEntity->mesh = MeshUtils::makePlane({ 20,20 }, { 10,10 }, { 5,5 });
-	floorEntity->shader = shader_floor;
-	floorEntity->diffuseTex = TextureUtils::loadTexture2D("../assets/textures/rocky_dirt_diffuse.png");
-	floorEntity->normalTex = TextureUtils::loadTexture2D("../assets/textures/HPST 96 normal.png");
+	floorEntity->material = MaterialUtils::createMaterial(floorMaterial);
 	entities_opaque.push_back(floorEntity);
 
 	//----------------------Entities Separator----------------------//
 
+	MaterialDesc houseMaterial;
+	houseMaterial.shaderVariants = variants_combined;
+	houseMaterial.shadowShader = shader_shadow_depth;
+	houseMaterial.gbufferVariants = variants_gbuffer;
+	houseMaterial.keywordMask = SURFACE_HOUSE_KEYWORD;
+	houseMaterial.setTexture(MaterialSlot::DIFFUSE, TextureUtils::loadTexture2DCompressedAsync("../assets/textures/windMill-text.jpg", TextureRole::ALBEDO));
+	houseMaterial.diffuseLayer = TextureUtils::loadTextureLayerAsync("../assets/textures/windMill-text.jpg", TextureRole::ALBEDO);
+
 	RenderableEntity* houseEntity = new RenderableEntity();
-	houseEntity->mesh = MeshUtils::loadObjFile("../assets/models/Windmill Stand.obj");
-	houseEntity->shader = shader_house;
-	houseEntity->diffuseTex = TextureUtils::loadTexture2D("../assets/textures/windMill-text.jpg");
+	houseEntity->mesh = MeshUtils::loadObjFileAsync("../assets/models/Windmill Stand.obj");
+	houseEntity->material = MaterialUtils::createMaterial(houseMaterial);
 	houseEntity->position = glm::vec3(-5.0f, 0.0f, -5.0f);//Position 
 	houseEntity->rotation = glm::vec3(0.0f, 20.0f, 0.0f);//Rotation
 	houseEntity->scale = glm::vec3(0.01f, 0.01f, 0.01f);//Scale
 	entities_opaque.push_back(houseEntity);
 
+	// Rotates in house.vert, so its own programs and no batching
+	MaterialDesc houseFanMaterial;
+	houseFanMaterial.shaderVariants = variants_combined_fan;
+	houseFanMaterial.shadowShader = shader_shadow_depth_fan;
+	houseFanMaterial.gbufferVariants = variants_gbuffer_fan;
+	houseFanMaterial.keywordMask = SURFACE_FAN_KEYWORD;
+	houseFanMaterial.setTexture(MaterialSlot::DIFFUSE, TextureUtils::loadTexture2DCompressedAsync("../assets/textures/windMill-text.jpg", TextureRole::ALBEDO));
+
 	RenderableEntity* houseFanEntity = new RenderableEntity();
-	houseFanEntity->mesh = MeshUtils::loadObjFile("../assets/models/Windmill Fan.obj");
-	houseFanEntity->shader = shader_fan;
-	houseFanEntity->diffuseTex = TextureUtils::loadTexture2D("../assets/textures/windMill-text.jpg");
+	houseFanEntity->mesh = MeshUtils::loadObjFileAsync("../assets/models/Windmill Fan.obj");
+	houseFanEntity->material = MaterialUtils::createMaterial(houseFanMaterial);
+	houseFanEntity->isStatic = false;	// Rotates in house.vert
 	houseFanEntity->position = glm::vec3(-5.0f, 0.0f, -5.0f);//Position 
 	houseFanEntity->rotation = glm::vec3(0.0f, 20.0f, 0.0f);//Rotation
 	houseFanEntity->scale = glm::vec3(0.01f, 0.01f, 0.01f);//Scale
@@ -416,11 +1073,19 @@ void Scene_ASGN::load()
 
 	//----------------------Entities Separator----------------------//
 
+	MaterialDesc treeMaterial;
+	treeMaterial.shaderVariants = variants_combined;
+	treeMaterial.shadowShader = shader_shadow_depth;
+	treeMaterial.gbufferVariants = variants_gbuffer;
+	treeMaterial.keywordMask = SURFACE_TREE_KEYWORD;
+	treeMaterial.setTexture(MaterialSlot::DIFFUSE, TextureUtils::loadTexture2DCompressedAsync("../assets/textures/oakbark.jpg", TextureRole::ALBEDO));
+	treeMaterial.setTexture(MaterialSlot::SPECULAR, TextureUtils::loadTexture2DCompressedAsync("../assets/textures/oakbark_burnt.jpg", TextureRole::MASK));
+	treeMaterial.diffuseLayer = TextureUtils::loadTextureLayerAsync("../assets/textures/oakbark.jpg", TextureRole::ALBEDO);
+	treeMaterial.specularLayer = TextureUtils::loadTextureLayerAsync("../assets/textures/oakbark_burnt.jpg", TextureRole::MASK);
+
 	RenderableEntity* treeEntity = new RenderableEntity();
-	treeEntity->mesh = MeshUtils::loadObjFile("../assets/models/oak_leafless.obj");
-	treeEntity->shader = shader_tree;
-	treeEntity->diffuseTex = TextureUtils::loadTexture2D("../assets/textures/oakbark.jpg");
-	treeEntity->specularTex = TextureUtils::loadTexture2D("../assets/textures/oakbark_burnt.jpg");
+	treeEntity->mesh = MeshUtils::loadObjFileAsync("../assets/models/oak_leafless.obj");
+	treeEntity->material = MaterialUtils::createMaterial(treeMaterial);
 	treeEntity->position = glm::vec3(4.5f, 0.0f, -3.0f);//Position 
 	treeEntity->rotation = glm::vec3(0.0f, -40.0f, 0.0f);//Rotation
 	treeEntity->scale = glm::vec3(0.06f, 0.06f, 0.06f);//Scale
@@ -428,10 +1093,17 @@ void Scene_ASGN::load()
 
 	//----------------------Entities Separator----------------------//
 
+	MaterialDesc treeLeavesMaterial;
+	treeLeavesMaterial.shaderVariants = variants_combined;
+	treeLeavesMaterial.shadowShader = shader_shadow_depth;
+	treeLeavesMaterial.gbufferVariants = variants_gbuffer;
+	treeLeavesMaterial.keywordMask = SURFACE_TREE_KEYWORD;
+	treeLeavesMaterial.setTexture(MaterialSlot::DIFFUSE, TextureUtils::loadTexture2DCompressedAsync("../assets/textures/oakleaf_fall.png", TextureRole::ALBEDO_ALPHA));
+	treeLeavesMaterial.diffuseLayer = TextureUtils::loadTextureLayerAsync("../assets/textures/oakleaf_fall.png", TextureRole::ALBEDO_ALPHA);
+
 	RenderableEntity* treeLeavesEntity = new RenderableEntity();
-	treeLeavesEntity->mesh = MeshUtils::loadObjFile("../assets/models/oak.obj");
-	treeLeavesEntity->shader = shader_tree;
-	treeLeavesEntity->diffuseTex = TextureUtils::loadTexture2D("../assets/textures/oakleaf_fall.png");
+	treeLeavesEntity->mesh = MeshUtils::loadObjFileAsync("../assets/models/oak.obj");
+	treeLeavesEntity->material = MaterialUtils::createMaterial(treeLeavesMaterial);
 	treeLeavesEntity->position = glm::vec3(4.5f, 0.0f, -3.0f);//Position 
 	treeLeavesEntity->rotation = glm::vec3(0.0f, -40.0f, 0.0f);//Rotation
 	treeLeavesEntity->scale = glm::vec3(0.06f, 0.06f, 0.06f);//Scale
@@ -449,6 +1121,18 @@ void Scene_ASGN::load()
 		45.0f, 30.0f, 47.0f, 55.0f, 66.0f,
 	};
 
+	// One material for all of the rocks
+	MaterialDesc rocksMaterial;
+	rocksMaterial.shaderVariants = variants_combined;
+	rocksMaterial.shadowShader = shader_shadow_depth;
+	rocksMaterial.gbufferVariants = variants_gbuffer;
+	rocksMaterial.keywordMask = SURFACE_ROCKS_KEYWORD;
+	rocksMaterial.setTexture(MaterialSlot::DIFFUSE, TextureUtils::loadTexture2DCompressedAsync("../assets/textures/diffuse.png", TextureRole::ALBEDO));
+	rocksMaterial.setTexture(MaterialSlot::SPECULAR, TextureUtils::loadTexture2DCompressedAsync("../assets/textures/specular.png", TextureRole::MASK));
+	rocksMaterial.diffuseLayer = TextureUtils::loadTextureLayerAsync("../assets/textures/diffuse.png", TextureRole::ALBEDO);
+	rocksMaterial.specularLayer = TextureUtils::loadTextureLayerAsync("../assets/textures/specular.png", TextureRole::MASK);
+	const Material* rocks = MaterialUtils::createMaterial(rocksMaterial);
+
 	for (int i = 0; i < numRocks; ++i) {
 		float angle = glm::radians(i * angleIncrement);
 		float x = radius * cos(angle);
@@ -458,10 +1142,8 @@ void Scene_ASGN::load()
 		float presetRotationY = presetRotations[i % presetRotations.size()];
 
 		RenderableEntity* rocksEntity = new RenderableEntity();
-		rocksEntity->mesh = MeshUtils::loadObjFile("../assets/models/rock_02.obj");
-		rocksEntity->shader = shader_rocks;
-		rocksEntity->diffuseTex = TextureUtils::loadTexture2D("../assets/textures/diffuse.png");
-		rocksEntity->specularTex = TextureUtils::loadTexture2D("../assets/textures/specular.png");
+		rocksEntity->mesh = MeshUtils::loadObjFileAsync("../assets/models/rock_02.obj");
+		rocksEntity->material = rocks;
 		rocksEntity->position = glm::vec3(x - 3, 0.0f, z + 5); // Position in a circle
 		rocksEntity->rotation = glm::vec3(0.0f, presetRotationY, 0.0f); // Rotation
 		rocksEntity->scale = glm::vec3(0.015f, 0.015f, 0.015f); // Scale
@@ -470,66 +1152,89 @@ void Scene_ASGN::load()
 
 	//----------------------Entities Separator----------------------//
 
+	MaterialDesc waterMaterial;
+	waterMaterial.shaderVariants = variants_water;
+	waterMaterial.setTexture(MaterialSlot::DIFFUSE, TextureUtils::loadTexture2DAsync("../assets/textures/distort.png"));
+	waterMaterial.state = MaterialRenderState::alphaBlended();
+	waterMaterial.readsOpaqueTexture = true;
+
 	RenderableEntity* waterEntity = new RenderableEntity();
 	waterEntity->mesh = MeshUtils::makeDisk(2.2f, 30.0f);
-	waterEntity->shader = shader_water;
-	waterEntity->diffuseTex = TextureUtils::loadTexture2D("../assets/textures/distort.png");
+	waterEntity->material = MaterialUtils::createMaterial(waterMaterial);
 	waterEntity->rotation = glm::vec3(-90.0f, 0.0f, 0.0f);//Rotation
 	waterEntity->position = glm::vec3(-3.0f, 0.2f, 5.0f); // Position in a circle
 	entities_alphablend.push_back(waterEntity);
 
 	//----------------------Entities Separator----------------------//
 
+	MaterialDesc roadlampMaterial;
+	roadlampMaterial.shaderVariants = variants_roadlamp;
+	roadlampMaterial.shadowShader = shader_shadow_depth;
+	roadlampMaterial.setTexture(MaterialSlot::DIFFUSE, TextureUtils::loadTexture2DCompressedAsync("../assets/textures/lamp.png", TextureRole::ALBEDO));
+	roadlampMaterial.params.shininess = 128.0f;
+	roadlampMaterial.state = MaterialRenderState::alphaBlended();
+
 	RenderableEntity* roadlampEntity = new RenderableEntity();
-	roadlampEntity->mesh = MeshUtils::loadObjFile("../assets/models/StreetLamp.obj");
-	roadlampEntity->shader = shader_roadlamp;
-	roadlampEntity->diffuseTex = TextureUtils::loadTexture2D("../assets/textures/lamp.png");
+	roadlampEntity->mesh = MeshUtils::loadObjFileAsync("../assets/models/StreetLamp.obj");
+	roadlampEntity->material = MaterialUtils::createMaterial(roadlampMaterial);
 	roadlampEntity->position = glm::vec3(-8.0f, 1.7f, 0.0f);//Position 
 	roadlampEntity->rotation = glm::vec3(0.0f, 0.0f, 0.0f);//Rotation
 	roadlampEntity->scale = glm::vec3(0.4f, 0.4f, 0.4f);//Scale
 	entities_alphablend.push_back(roadlampEntity);
 
 	//----------------------Entities Separator----------------------//
+
+	// One material for all of the lanterns
+	MaterialDesc lanternMaterial;
+	lanternMaterial.shaderVariants = variants_lantern;
+	lanternMaterial.shadowShader = shader_shadow_depth;
+	lanternMaterial.setTexture(MaterialSlot::DIFFUSE, TextureUtils::loadTexture2DCompressedAsync("../assets/textures/mat3-seed_2755070454-albedo-re_2kYGC2nxUvNbRbI3YYB1xQ41YuI.png", TextureRole::ALBEDO));
+	lanternMaterial.setTexture(MaterialSlot::EMISSIVE, TextureUtils::loadTexture2DCompressedAsync("../assets/textures/mat3-seed_1312867562-albedo-re_2kPjetQ92ldoK0XmZarNCW0SIuN.png", TextureRole::ALBEDO));
+	lanternMaterial.params.shininess = 1.0f;
+	lanternMaterial.state = MaterialRenderState::alphaBlended();
+	const Material* lantern = MaterialUtils::createMaterial(lanternMaterial);
 	
 	RenderableEntity* lantern01Entity = new RenderableEntity();
-	lantern01Entity->mesh = MeshUtils::loadObjFile("../assets/models/FabConvert.com_lamp.obj-re_2kPjeweheJb8nWtNllnHejl4oz1.obj");
-	lantern01Entity->shader = shader_lantern;
-	lantern01Entity->diffuseTex = TextureUtils::loadTexture2D("../assets/textures/mat3-seed_2755070454-albedo-re_2kYGC2nxUvNbRbI3YYB1xQ41YuI.png");
-	lantern01Entity->emissiveTex = TextureUtils::loadTexture2D("../assets/textures/mat3-seed_1312867562-albedo-re_2kPjetQ92ldoK0XmZarNCW0SIuN.png");
+	lantern01Entity->mesh = MeshUtils::loadObjFileAsync("../assets/models/FabConvert.com_lamp.obj-re_2kPjeweheJb8nWtNllnHejl4oz1.obj");
+	lantern01Entity->material = lantern;
 	lantern01Entity->position = glm::vec3(1.9f, 4.5f, -3.5);//Position 
 	lantern01Entity->rotation = glm::vec3(-90.0f, 0.0f, 0.0f);//Rotation
 	lantern01Entity->scale = glm::vec3(0.5f,0.5f, 0.5f);//Scale
 	entities_alphablend.push_back(lantern01Entity);
 	
 	RenderableEntity* lantern02Entity = new RenderableEntity();
-	lantern02Entity->mesh = MeshUtils::loadObjFile("../assets/models/FabConvert.com_lamp.obj-re_2kPjeweheJb8nWtNllnHejl4oz1.obj");
-	lantern02Entity->shader = shader_lantern;
-	lantern02Entity->diffuseTex = TextureUtils::loadTexture2D("../assets/textures/mat3-seed_2755070454-albedo-re_2kYGC2nxUvNbRbI3YYB1xQ41YuI.png");
-	lantern02Entity->emissiveTex = TextureUtils::loadTexture2D("../assets/textures/mat3-seed_1312867562-albedo-re_2kPjetQ92ldoK0XmZarNCW0SIuN.png");
+	lantern02Entity->mesh = MeshUtils::loadObjFileAsync("../assets/models/FabConvert.com_lamp.obj-re_2kPjeweheJb8nWtNllnHejl4oz1.obj");
+	lantern02Entity->material = lantern;
 	lantern02Entity->position = glm::vec3(9.0f, 4.7f, -5.1);//Position 
 	lantern02Entity->rotation = glm::vec3(-90.0f, 0.0f, 0.0f);//Rotation
 	lantern02Entity->scale = glm::vec3(0.5f, 0.5f, 0.5f);//Scale
 	entities_alphablend.push_back(lantern02Entity);
 
 	RenderableEntity* lantern03Entity = new RenderableEntity();
-	lantern03Entity->mesh = MeshUtils::loadObjFile("../assets/models/FabConvert.com_lamp.obj-re_2kPjeweheJb8nWtNllnHejl4oz1.obj");
-	lantern03Entity->shader = shader_lantern;
-	lantern03Entity->diffuseTex = TextureUtils::loadTexture2D("../assets/textures/mat3-seed_2755070454-albedo-re_2kYGC2nxUvNbRbI3YYB1xQ41YuI.png");
-	lantern03Entity->emissiveTex = TextureUtils::loadTexture2D("../assets/textures/mat3-seed_1312867562-albedo-re_2kPjetQ92ldoK0XmZarNCW0SIuN.png");
+	lantern03Entity->mesh = MeshUtils::loadObjFileAsync("../assets/models/FabConvert.com_lamp.obj-re_2kPjeweheJb8nWtNllnHejl4oz1.obj");
+	lantern03Entity->material = lantern;
 	lantern03Entity->position = glm::vec3(5.2f, 4.3f, 1.0);//Position 
 	lantern03Entity->rotation = glm::vec3(-90.0f, 0.0f, 0.0f);//Rotation
 	lantern03Entity->scale = glm::vec3(0.4f, 0.4f, 0.4f);//Scale
 	entities_alphablend.push_back(lantern03Entity);
+	extraTransparentTemplate = lantern03Entity;
 
 	//----------------------Entities Separator----------------------//
 
+	MaterialDesc horseMaterial;
+	horseMaterial.shaderVariants = variants_combined;
+	horseMaterial.shadowShader = shader_shadow_depth;
+	horseMaterial.gbufferVariants = variants_gbuffer;
+	horseMaterial.keywordMask = SURFACE_HORSE_KEYWORD;
+	horseMaterial.setTexture(MaterialSlot::DIFFUSE, TextureUtils::loadTexture2DCompressedAsync("../assets/textures/HorseMain2k00.png", TextureRole::ALBEDO));
+	horseMaterial.setTexture(MaterialSlot::SPECULAR, TextureUtils::loadTexture2DCompressedAsync("../assets/textures/HorseMain2k00AO00.png", TextureRole::MASK));
+	horseMaterial.diffuseLayer = TextureUtils::loadTextureLayerAsync("../assets/textures/HorseMain2k00.png", TextureRole::ALBEDO);
+	horseMaterial.specularLayer = TextureUtils::loadTextureLayerAsync("../assets/textures/HorseMain2k00AO00.png", TextureRole::MASK);
+	//horseMaterial.setTexture(MaterialSlot::SPECULAR, TextureUtils::loadTexture2DAsync("../assets/textures/eye_texture.png"));
+
 	RenderableEntity* horseEntity = new RenderableEntity();
-	horseEntity->mesh = MeshUtils::loadObjFile("../assets/models/LD_HorseRtime02.obj");
-	horseEntity->shader = shader_horse;
-	horseEntity->diffuseTex = TextureUtils::loadTexture2D("../assets/textures/HorseMain2k00.png");
-	horseEntity->specularTex = TextureUtils::loadTexture2D("../assets/textures/HorseMain2k00AO00.png");
-	//horseEntity->specularTex = TextureUtils::loadTexture2D("../assets/textures/eye_texture.png");
-	
+	horseEntity->mesh = MeshUtils::loadObjFileAsync("../assets/models/LD_HorseRtime02.obj");
+	horseEntity->material = MaterialUtils::createMaterial(horseMaterial);
 	horseEntity->position = glm::vec3(6.0f, 2.15f, 5.0);//Position 
 	horseEntity->rotation = glm::vec3(0.0f, -90.0f, 0.0f);//Rotation
 	horseEntity->scale = glm::vec3(0.45f, 0.45f, 0.45f);//Scale
@@ -537,26 +1242,111 @@ void Scene_ASGN::load()
 
 	//----------------------Entities Separator----------------------//
 
+	// Entities whose material could not be created (past MaterialUtils::MAX_MATERIALS) are dropped
+	for (std::vector<RenderableEntity*>* entities : { &entities_opaque, &entities_alphatest, &entities_alphablend })
+	{
+		for (size_t i = 0; i < entities->size();)
+		{
+			if ((*entities)[i]->material != nullptr)
+			{
+				i++;
+				continue;
+			}
+
+			std::cout << "Scene: " << (*entities)[i]->name << " has no material and is not drawn" << std::endl;
+			entities->erase(entities->begin() + i);
+		}
+	}
+
+	// Submission binds each program and material once per run
+	sortByMaterial(entities_opaque);
+	sortByMaterial(entities_alphatest);
+
+	submitMaterialVariants(entities_opaque);
+	submitMaterialVariants(entities_alphatest);
+
 	// Example
+	// MaterialDesc desc;
+	// desc.shaderVariants = ...;
+	// desc.setTexture(MaterialSlot::DIFFUSE, TextureUtils::loadTexture2DAsync("...", ...));
+	// desc.setTexture(MaterialSlot::SPECULAR, TextureUtils::loadTexture2DAsync("...", ...));
+	// desc.setTexture(MaterialSlot::NORMAL, TextureUtils::loadTexture2DAsync("...", ...));
+	// desc.setTexture(MaterialSlot::EMISSIVE, TextureUtils::loadTexture2DAsync("...", ...));
+	// desc.params.shininess = ...;
+	//
 	// RenderableEntity* et1 = new RenderableEntity();
 	// et1->mesh = ...;
-	// et1->shader = ...;
-	// et1->diffuseTex = TextureUtils::loadTexture2D("...", ...);
-	// et1->specularTex = TextureUtils::loadTexture2D("...", ...);
-	// et1->normalTex = TextureUtils::loadTexture2D("...", ...);
-	// et1->emissiveTex = TextureUtils::loadTexture2D("...", ...);
-	// et1->shininess = ...;
+	// et1->material = MaterialUtils::createMaterial(desc);
 	// 
 	// entities_opaque.push_back(et1);
 	// 
-	//Buffers
-	ColourDepthFrameBufferConfig cfg;
-	cfg.size = App::getViewportSize();
-	cfg.depthFormat = DepthFormat::FLOAT24;
+	// Render targets are declared per frame to the frame graph, see draw()
+}
 
-	cfg.colourAttachments.push_back(ColourAttachmentData(ColourFormat::RGBA, TextureFilterMode::LINEAR));
+// Moves along the sides of a square, one side every sideLength / speed seconds
+static glm::vec3 animatePositionSquare(const glm::vec3& initialPosition, float sideLength, float speed, float time)
+{
+	float sideTime = sideLength / speed;
+	float timeInCycle = fmodf(time, 4.0f * sideTime);
+
+	if (timeInCycle < sideTime)
+		return initialPosition + glm::vec3(timeInCycle * speed, 0.0f, 0.0f);
+	else if (timeInCycle < 2.0f * sideTime)
+		return initialPosition + glm::vec3(sideLength, 0.0f, (timeInCycle - sideTime) * speed);
+	else if (timeInCycle < 3.0f * sideTime)
+		return initialPosition + glm::vec3(sideLength - (timeInCycle - 2.0f * sideTime) * speed, 0.0f, sideLength);
+	else
+		return initialPosition + glm::vec3(0.0f, 0.0f, sideLength - (timeInCycle - 3.0f * sideTime) * speed);
+}
 
-	fbo = FBOUtils::createColourDepthFBO(cfg);
+static glm::vec3 rainbowColour(float t)
+{
+	const float third = 2.0f * glm::pi<float>() / 3.0f;
+	return glm::vec3(fabsf(sinf(t)), fabsf(sinf(t + third)), fabsf(sinf(t + 2.0f * third)));
+}
+
+static void updateExtraLanterns()
+{
+	// Lights are created on demand and kept around; the slider only enables the first N.
+	while ((int)pLights_extra.size() < extraLanternCount)
+	{
+		int i = (int)pLights_extra.size();
+
+		// Deterministic scatter over the 20x20 floor
+		float x = fmodf(i * 7.31f, 19.0f) - 9.5f;
+		float z = fmodf(i * 3.97f + (i / 19) * 1.37f, 19.0f) - 9.5f;
+		float y = 0.5f + fmodf(i * 0.61f, 2.5f);
+
+		PointLight* light = LightUtils::createPointLight("Extra_Lantern_" + std::to_string(i));
+		light->setColour({ 1.0f, 0.8f, 0.3f });
+		light->setRange(1.2f);
+		light->setPosition({ x, y, z });
+		light->setIntensity(1.5f);
+		pLights_extra.push_back(light);
+	}
+
+	for (int i = 0; i < (int)pLights_extra.size(); i++)
+	{
+		pLights_extra[i]->setEnabled(i < extraLanternCount);
+	}
+}
+
+static void updateExtraTransparents()
+{
+	// Created on demand and kept around; only the first extraTransparentCount are drawn
+	if (extraTransparentTemplate->material == nullptr)
+		extraTransparentCount = 0;
+	while ((int)entities_alphablend_extra.size() < extraTransparentCount)
+	{
+		int i = (int)entities_alphablend_extra.size();
+
+		// Deterministic scatter, dense enough that many of them intersect
+		RenderableEntity* entity = new RenderableEntity(*extraTransparentTemplate);
+		entity->name = "Extra_Transparent_" + std::to_string(i);
+		entity->position = glm::vec3(fmodf(i * 5.17f, 15.0f) - 7.5f, 1.0f + fmodf(i * 0.37f, 3.0f), fmodf(i * 2.93f + (i / 15) * 1.11f, 15.0f) - 7.5f);
+		entity->rotation = glm::vec3(-90.0f, fmodf(i * 47.0f, 360.0f), 0.0f);
+		entities_alphablend_extra.push_back(entity);
+	}
 }
 
 void Scene_ASGN::update()
@@ -566,31 +1356,163 @@ void Scene_ASGN::update()
 	//
 	//auto& et = entities_opaque[0];
 	//et->position.x = ...;
-	
+
+	pLight->setEnabled(enableRoadlamp);
+	pLight_Lantern01->setEnabled(enableLanternLeft);
+	pLight_Lantern02->setEnabled(enableLanternRight);
+	pLight_Lantern03->setEnabled(enableLanternMid);
+	pLight_rainbow->setEnabled(enableRainbowLight);
+
+	// Rainbow light circles the floor
+	pLight_rainbow->setPosition(animatePositionSquare({ -5.0f, 2.0f, -6.0f }, 11.0f, 5.0f, App::getTime()));
+	pLight_rainbow->setColour(rainbowColour(App::getTime()));
+
+	updateExtraLanterns();
+	updateExtraTransparents();
+
+	// A mesh or alpha texture that was reloaded, or replaced its placeholder, keeps its pointer,
+	// so the cached shadows can't tell
+	static unsigned int lastAssetChanges = 0;
+	unsigned int assetChanges = HotReload::getReloadCount() + AssetLoader::getLoadedCount();
+	if (assetChanges != lastAssetChanges)
+	{
+		lastAssetChanges = assetChanges;
+		CascadedShadowMap::invalidate();
+		ShadowAtlas::invalidate();
+	}
 }
 
 
 
 void Scene_ASGN::draw(CameraBase* camera)
 {
-	if (enablePostProcessing)
+	requestTextureMips(camera);
+	batchStats = BatchStats();
+	submitStats = SubmitStats();
+
+	GPUProfiler::begin("Shadows");
+	renderShadows(camera);
+	GPUProfiler::end();
+
+	// Everything from here on is drawn at the render size, jittered while temporal AA is on
+	renderSize = TemporalAA::getRenderSize(App::getViewportSize());
+	TemporalAA::beginFrame(camera, renderSize);
+
+	// Assign point/spot lights to clusters for this view
+	LightCluster::update(camera, renderSize);
+	LightCluster::bindTextures();
+
+	// Shadow maps are cached across frames, so they stay outside the graph. The scene passes
+	// are declared here and run by FrameGraph::execute() at the end of postDraw().
+	FrameGraph::beginFrame();
+	glm::uvec2 size = renderSize;
+
+	// Linear HDR. The deferred path copies the G-buffer depth in, so both are DEPTH24.
+	ColourFormat sceneFormat = enableSceneRGBA16F ? ColourFormat::RGBA_16F : ColourFormat::R11G11B10_F;
+	sceneColour = FrameGraph::createTarget("Scene colour", RenderTargetDesc::colour(size, sceneFormat, TextureFilterMode::LINEAR));
+	sceneDepth = FrameGraph::createTarget("Scene depth", RenderTargetDesc::depth(size, DepthFormat::FLOAT24));
+
+	if (enableDeferred)
 	{
-		//Use the custom fbo
-		SimpleRenderer::bindFBO(fbo);
-		//Clear the custom fbo before drawing scene, otherwise drawing may fail because depth test fails
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		GBufferTargets gbuffer;
+		gbuffer.albedoSpecular = FrameGraph::createTarget("G-Buffer albedo", RenderTargetDesc::colour(size, ColourFormat::RGBA_8, TextureFilterMode::NEAREST));
+		gbuffer.normalShininess = FrameGraph::createTarget("G-Buffer normal", RenderTargetDesc::colour(size, ColourFormat::RGB10_A2, TextureFilterMode::NEAREST));
+		gbuffer.emissive = FrameGraph::createTarget("G-Buffer emissive", RenderTargetDesc::colour(size, ColourFormat::RGBA_8, TextureFilterMode::NEAREST));
+		gbuffer.depth = FrameGraph::createTarget("G-Buffer depth", RenderTargetDesc::depth(size, DepthFormat::FLOAT24));
+
+		FrameGraph::addPass("G-Buffer", {}, { gbuffer.albedoSpecular, gbuffer.normalShininess, gbuffer.emissive }, gbuffer.depth,
+			[camera]() { renderGBuffer(camera); });
+		FrameGraph::addPass("Deferred Lighting", { gbuffer.albedoSpecular, gbuffer.normalShininess, gbuffer.emissive, gbuffer.depth }, { sceneColour }, sceneDepth,
+			[camera, gbuffer]() { renderDeferredLighting(camera, gbuffer); });
 	}
-	
-	glEnable(GL_DEPTH_TEST);
 
-	renderOpaques(camera);
-	renderSkybox(camera);
-	renderAlphaTest(camera);
-	renderAlphaBlends(camera);
+	FrameGraph::addPass("Forward Opaques", {}, { sceneColour }, sceneDepth, [camera]()
+	{
+		glEnable(GL_DEPTH_TEST);
+		renderOpaques(camera);
+		renderSkybox(camera);
+		renderAlphaTest(camera);
+	});
+
+	// Only copied while something on screen samples it; otherwise the transparents read nothing
+	opaqueTextureCopied = isOpaqueTextureNeeded(camera);
+	std::vector<FrameGraphResource> transparentReads;
+	if (opaqueTextureCopied)
+	{
+		glm::uvec2 opaqueSize = glm::max(size >> (unsigned int)opaqueTextureDownscale, glm::uvec2(1));
+		FrameGraphResource opaqueTexture = FrameGraph::createTarget("Opaque texture", RenderTargetDesc::colour(opaqueSize, sceneFormat, TextureFilterMode::LINEAR));
+		FrameGraphResource source = sceneColour;
+
+		FrameGraph::addPass("Opaque Texture", { source }, { opaqueTexture }, FrameGraph::NO_RESOURCE,
+			[source, size, opaqueSize]() { copyOpaqueTexture(source, size, opaqueSize); });
+		transparentReads.push_back(opaqueTexture);
+	}
+
+	auto bindOpaqueTexture = [transparentReads]()
+	{
+		if (!transparentReads.empty())
+		{
+			glActiveTexture(GL_TEXTURE0 + OPAQUE_TEXTURE_UNIT);
+			glBindTexture(GL_TEXTURE_2D, FrameGraph::getTexture(transparentReads[0])->getNativeHandle());
+			glActiveTexture(GL_TEXTURE0);
+		}
+	};
+
+	// The transparents draw into the scene colour, or a reduced resolution target cleared to
+	// transmittance 1 and tested against the nearest depth of each block
+	bool offscreen = transparencyDownscale > 0;
+	FrameGraphResource transparentColour = sceneColour;
+	FrameGraphResource transparentDepth = sceneDepth;
+	transparencyResolution = size;
+	if (offscreen)
+	{
+		int downscale = transparencyDownscale;
+		transparencyResolution = glm::max(size >> (unsigned int)downscale, glm::uvec2(1));
+		transparentColour = FrameGraph::createTarget("Transparency colour", RenderTargetDesc::colour(transparencyResolution, ColourFormat::RGBA_16F, TextureFilterMode::NEAREST));
+		transparentDepth = FrameGraph::createTarget("Transparency depth", RenderTargetDesc::depth(transparencyResolution, DepthFormat::FLOAT24));
+		FrameGraph::setClearColour(transparentColour, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+
+		FrameGraphResource fullDepth = sceneDepth;
+		FrameGraph::addPass("Transparency Depth", { fullDepth }, {}, transparentDepth,
+			[fullDepth, downscale]() { downsampleDepth(fullDepth, downscale); });
+	}
+
+	if (enableOIT)
+	{
+		// GL 3.3 has one blend function for all targets: the accumulation alpha multiplies
+		// (revealage) and the weight sum needs its own additive target
+		FrameGraphResource accumulation = FrameGraph::createTarget("OIT accumulation", RenderTargetDesc::colour(transparencyResolution, ColourFormat::RGBA_16F, TextureFilterMode::NEAREST));
+		FrameGraphResource accumulationWeight = FrameGraph::createTarget("OIT weight", RenderTargetDesc::colour(transparencyResolution, ColourFormat::R_16F, TextureFilterMode::NEAREST));
+		FrameGraph::setClearColour(accumulation, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+		FrameGraph::setClearColour(accumulationWeight, glm::vec4(0.0f));
+
+		FrameGraph::addPass("OIT Transparents", transparentReads, { accumulation, accumulationWeight }, transparentDepth, [camera, bindOpaqueTexture]()
+		{
+			bindOpaqueTexture();
+			renderAlphaBlends(camera, true, false);
+		});
+		FrameGraph::addPass("OIT Composite", { accumulation, accumulationWeight }, { transparentColour }, FrameGraph::NO_RESOURCE,
+			[accumulation, accumulationWeight, offscreen]() { compositeOIT(accumulation, accumulationWeight, offscreen); });
+	}
+	else
+	{
+		FrameGraph::addPass("Transparents", transparentReads, { transparentColour }, transparentDepth, [camera, bindOpaqueTexture, offscreen]()
+		{
+			bindOpaqueTexture();
+			renderAlphaBlends(camera, false, offscreen);
+		});
+	}
+
+	if (offscreen)
+	{
+		FrameGraphResource fullDepth = sceneDepth;
+		FrameGraph::addPass("Transparency Upsample", { transparentColour, transparentDepth, fullDepth }, { sceneColour }, FrameGraph::NO_RESOURCE,
+			[camera, transparentColour, transparentDepth, fullDepth]() { upsampleTransparency(camera, transparentColour, transparentDepth, fullDepth); });
+	}
 
 	//Debug lighting
-	if(enableDebug)
-	LightDebug::draw(camera);
+	if (enableDebug)
+		FrameGraph::addPass("Light Debug", {}, { sceneColour }, sceneDepth, [camera]() { LightDebug::draw(camera); });
 }
 
 //Uniforms to tweak theme post procesing effect//
@@ -598,47 +1520,198 @@ static float filmGrainAmount = 0.4f;
 static float tvEffectStrength = 0.4f;
 static float vignettePower = 1.0f;
 
-void Scene_ASGN::postDraw(CameraBase* camera)
+// HDR resolve (tone mapping, then the grading LUT) and the screen effects in one pass
+static void renderPostProcessing(FrameGraphResource source, FrameGraphResource bloom, FrameGraphResource luminance)
 {
-	//Two ways to bind
-	if (enablePostProcessing)
-	{
-		SimpleRenderer::bindFBO_Default();
+	//Draw a quad covering fulls screen
+	//1.Create a quad
+	//Leverage C++ static local variable
+	static Mesh* fsQuad = MeshUtils::makeQuad(2.0f);
+
+	//2.Bind screen shader, grading baked into the LUT only when its params changed
+	ColourGrading::update(getColourGradingParams());
+	SimpleRenderer::bindShader(ShaderUtils::getShaderVariant(variants_screen, getScreenKeywordMask(bloom != FrameGraph::NO_RESOURCE, luminance != FrameGraph::NO_RESOURCE)));
+
+	SimpleRenderer::setShaderProp_Vec2("cursor", App::getMousePosition());
+	SimpleRenderer::setShaderProp_Vec2("resolution", App::getViewportSize());
+	SimpleRenderer::setShaderProp_Float("time", App::getTime());
 
-		//Draw a quad covering fulls screen
-		//1.Create a quad
-		//Leverage C++ static local variable
-		static Mesh* fsQuad = MeshUtils::makeQuad(2.0f);
+	SimpleRenderer::setShaderProp_Float("filmGrainAmount", filmGrainAmount);
+	SimpleRenderer::setShaderProp_Float("tvEffectStrength", tvEffectStrength);
+	SimpleRenderer::setShaderProp_Float("vignettePower", vignettePower);
 
-		//2.Bind screen shader
-		SimpleRenderer::bindShader(shader_screen);
+	ColourGrading::bindTexture();
+	ColourGrading::setShaderProps();
 
-		SimpleRenderer::setShaderProp_Vec2("cursor", App::getMousePosition());
-		SimpleRenderer::setShaderProp_Vec2("resolution", App::getViewportSize());
-		SimpleRenderer::setShaderProp_Float("time", App::getTime());
+	if (bloom != FrameGraph::NO_RESOURCE)
+	{
+		Bloom::bindTexture(bloom);
+		Bloom::setShaderProps();
+	}
 
-		SimpleRenderer::setShaderProp_Bool("enableSepia", enableSepia);
-		SimpleRenderer::setShaderProp_Bool("enableFilmGrain", enableFilmGrain);
-		SimpleRenderer::setShaderProp_Bool("enableBadTVSignal", enableBadTVSignal);
-		SimpleRenderer::setShaderProp_Bool("enableVignette", enableVignette);
+	if (luminance != FrameGraph::NO_RESOURCE)
+	{
+		AutoExposure::bindTexture(luminance);
+		AutoExposure::setShaderProps();
+	}
 
-		SimpleRenderer::setShaderProp_Float("filmGrainAmount", filmGrainAmount);
-		SimpleRenderer::setShaderProp_Float("tvEffectStrength", tvEffectStrength);
-		SimpleRenderer::setShaderProp_Float("vignettePower", vignettePower);
+	//3.Bind the scene colour to texture unit 0
+	SimpleRenderer::setTexture_0(FrameGraph::getTexture(source));
 
-		//3.Bind fbo colour texture to texture unit 0
-		SimpleRenderer::setTexture_0(fbo->getColorAttachment(0));
+	//4.Draw the quad
+	SimpleRenderer::drawMesh(fsQuad);
+}
 
-		//4.Draw the quad
-		SimpleRenderer::drawMesh(fsQuad);
+void Scene_ASGN::postDraw(CameraBase* camera)
+{
+	// Upscaled to the viewport by the temporal resolve, if enabled
+	FrameGraphResource source = TemporalAA::addPasses(camera, sceneColour, sceneDepth, renderSize, App::getViewportSize());
+	FrameGraphResource luminance = AutoExposure::addPasses(source, App::getViewportSize());
+	FrameGraphResource bloom = Bloom::addPasses(source, App::getViewportSize());
+
+	std::vector<FrameGraphResource> reads = { source };
+	for (FrameGraphResource optional : { luminance, bloom })
+	{
+		if (optional != FrameGraph::NO_RESOURCE)
+			reads.push_back(optional);
 	}
+
+	// The HDR scene colour has to be resolved anyway, so the post pass always runs and writes the backbuffer
+	FrameGraph::addPass("Post Processing", reads, { FrameGraph::BACKBUFFER }, FrameGraph::NO_RESOURCE, [source, bloom, luminance]() { renderPostProcessing(source, bloom, luminance); });
+
+	FrameGraph::execute();
 }
 
 void Scene_ASGN::onFrameBufferResized(int width, int height)
 {
+	// Targets are declared at the viewport size every frame; drop the old size's textures now
+	// instead of after RenderTargetPool::MAX_UNUSED_FRAMES
+	RenderTargetPool::trim();
 }
 
 #ifdef XBGT2094_ENABLE_IMGUI
+static void imgui_drawDeferredStats()
+{
+	// 3 colour targets at 4 bytes + DEPTH24 (stored as 4 bytes)
+	const float bytesPerPixel = 16.0f;
+
+	glm::uvec2 size = renderSize;
+	float sizeMB = size.x * size.y * bytesPerPixel / (1024.0f * 1024.0f);
+
+	// Written once by the G-buffer pass, read once by the lighting pass
+	float fps = ImGui::GetIO().Framerate;
+	float bandwidthGBs = sizeMB * 2.0f * fps / 1024.0f;
+
+	ImGui::Text("G-Buffer: %ux%u, %.0f B/px, %.2f MB", size.x, size.y, bytesPerPixel, sizeMB);
+	ImGui::Text("G-Buffer traffic: %.2f MB/frame, %.2f GB/s", sizeMB * 2.0f, bandwidthGBs);
+
+	if (enableDeferred)
+	{
+		float lightingMs = GPUProfiler::getTimeMs("Deferred Lighting");
+		unsigned int lights = LightCluster::getVisibleLightCount();
+
+		ImGui::Text("Lighting pass: %.3f ms, %u visible lights", lightingMs, lights);
+		ImGui::Text("Cost per light (upper bound): %.2f us", lights > 0 ? lightingMs * 1000.0f / lights : 0.0f);
+	}
+}
+
+// One full-screen pass, so its cost should scale with the pixel count alone
+static void imgui_drawPostStats()
+{
+	glm::uvec2 size = App::getViewportSize();
+	float pixels = (float)size.x * size.y;
+	float postMs = GPUProfiler::getTimeMs("Post Processing");
+
+	RenderTargetDesc scene = RenderTargetDesc::colour(renderSize, enableSceneRGBA16F ? ColourFormat::RGBA_16F : ColourFormat::R11G11B10_F, TextureFilterMode::LINEAR);
+	ImGui::Text("Scene colour: %ux%u %s, %.2f MB", renderSize.x, renderSize.y, enableSceneRGBA16F ? "RGBA16F" : "R11G11B10F", scene.getDataSize() / (1024.0f * 1024.0f));
+	ImGui::Text("Post pass: %.3f ms, %.2f ns/pixel", postMs, pixels > 0.0f ? postMs * 1000000.0f / pixels : 0.0f);
+}
+
+static void imgui_drawTransparencyControls()
+{
+	ImGui::Checkbox("Weighted blended OIT", &enableOIT);
+	ImGui::TextColored(ImVec4(0.0f, 0.8f, 1.0f, 1.0f), "   Benchmark transparents");
+	ImGui::SliderInt("SliderT1", &extraTransparentCount, 0, 4096);
+
+	const char* scales[] = { "Full", "Half", "Quarter" };
+	ImGui::Combo("Transparency resolution", &transparencyDownscale, scales, 3);
+
+	float gpuMs = enableOIT ? GPUProfiler::getTimeMs("OIT Transparents") + GPUProfiler::getTimeMs("OIT Composite") : GPUProfiler::getTimeMs("Transparents");
+	ImGui::Text("%s: %u transparents, sort %.3f ms CPU, %.3f ms GPU", enableOIT ? "OIT" : "Sorted",
+		transparencyStats.entities, transparencyStats.sortMs, gpuMs);
+	if (transparencyDownscale > 0)
+		ImGui::Text("Reduced %ux%u: depth %.3f ms, upsample %.3f ms", transparencyResolution.x, transparencyResolution.y,
+			GPUProfiler::getTimeMs("Transparency Depth"), GPUProfiler::getTimeMs("Transparency Upsample"));
+}
+
+static void imgui_drawOpaqueTextureControls()
+{
+	const char* scales[] = { "Full", "Half", "Quarter" };
+	ImGui::Combo("Opaque texture", &opaqueTextureDownscale, scales, 3);
+
+	if (opaqueTextureCopied)
+	{
+		glm::uvec2 size = glm::max(renderSize >> (unsigned int)opaqueTextureDownscale, glm::uvec2(1));
+		ImGui::Text("Opaque copy: %ux%u, %.3f ms", size.x, size.y, GPUProfiler::getTimeMs("Opaque Texture"));
+	}
+	else
+	{
+		ImGui::Text("Opaque copy: skipped, no visible transparent samples it");
+	}
+}
+
+static void imgui_drawShaderVariantStats()
+{
+	ShaderVariants* sets[] = { variants_combined, variants_combined_fan, variants_gbuffer, variants_gbuffer_fan, variants_deferred_lighting, variants_screen };
+	const char* names[] = { "Combined", "Combined fan", "G-buffer", "G-buffer fan", "Deferred lighting", "Screen" };
+
+	for (int i = 0; i < 6; i++)
+		ImGui::Text("%s: %u variants, %.1f ms compile", names[i], sets[i]->getVariantCount(), sets[i]->getCompileTimeMs());
+
+	ImGui::Text("Hot reload: %u files watched, %u reloads", HotReload::getWatchedFileCount(), HotReload::getReloadCount());
+	ImGui::Text("Assets: %u loaded, %u loading", AssetLoader::getLoadedCount(), AssetLoader::getPendingCount());
+	ImGui::Text("Texture streaming: %u in flight, %.1f MB uploaded", TextureUpload::getPendingCount(), TextureUpload::getUploadedBytes() / (1024.0f * 1024.0f));
+
+	CompressedTextureStats compressed = TextureUtils::getCompressedTextureStats();
+	ImGui::Text("Compressed textures: %u (%u cached), %.1f MB vs %.1f MB as RGBA8", compressed.textures, compressed.cacheHits,
+		compressed.compressedBytes / (1024.0f * 1024.0f), compressed.rgbaBytes / (1024.0f * 1024.0f));
+	ImGui::Text("  load %.1f ms vs %.1f ms decoding sources, %.1f ms encoding", compressed.loadMs, compressed.sourceDecodeMs, compressed.encodeMs);
+}
+
+static void imgui_drawBatchStats()
+{
+	ImGui::Checkbox("Texture array batching", &enableTextureArrays);
+	ImGui::Text("Batches: %u instanced draws for %u entities, %u array binds, %u arrays", batchStats.draws, batchStats.entities,
+		batchStats.arrayBinds, TextureUtils::getTextureArrayCount());
+	ImGui::Text("Materials: %u, %u program binds, %u material binds", MaterialUtils::getMaterialCount(), submitStats.programBinds, submitStats.materialBinds);
+}
+
+static void imgui_drawTextureStreamingStats()
+{
+	if (!TextureStreamer::isEnabled())
+		return;
+
+	const float MB = 1024.0f * 1024.0f;
+	ImGui::Text("Texture residency: %.1f / %.1f MB budget (%.1f MB with all mips), %u textures", TextureStreamer::getResidentBytes() / MB,
+		TextureStreamer::getBudget() / MB, TextureStreamer::getFullBytes() / MB, TextureStreamer::getTextureCount());
+
+	int budgetMB = (int)(TextureStreamer::getBudget() >> 20);
+	if (ImGui::SliderInt("Texture budget (MB)", &budgetMB, 4, 256))
+		TextureStreamer::setBudget((size_t)budgetMB << 20);
+
+	if (ImGui::TreeNode("Streamed textures"))
+	{
+		std::vector<StreamedTextureInfo> infos;
+		TextureStreamer::getTextureInfo(infos);
+		for (const StreamedTextureInfo& info : infos)
+		{
+			ImGui::Text("%s %dx%d: mip %d (wants %d) of %d, %.2f MB, unused %u frames", info.name.c_str(), info.width, info.height,
+				info.residentLevel, info.wantedLevel, info.levelCount, info.residentBytes / MB, info.framesSinceUse);
+		}
+		ImGui::TreePop();
+	}
+}
+
 void Scene_ASGN::imgui_draw()
 {
 	ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "Assignment");
@@ -696,6 +1769,28 @@ void Scene_ASGN::imgui_draw()
 	ImGui::TextColored(ImVec4(0.0f, 0.8f, 1.0f, 1.0f), "      Saturation");
 	ImGui::SliderFloat("SliderR3", &saturation, 0.0f, 3.0f);
 
+	ImGui::Checkbox("RGBA16F scene colour", &enableSceneRGBA16F);
+	imgui_drawPostStats();
+	ColourGrading::imgui_drawStats();
+
+	Bloom::imgui_drawControls();
+	Bloom::imgui_drawStats();
+
+	AutoExposure::imgui_drawControls();
+	AutoExposure::imgui_drawStats();
+
+	TemporalAA::imgui_drawControls();
+	TemporalAA::imgui_drawStats();
+
+	ImGui::Separator();
+	imgui_drawShaderVariantStats();
+	ImGui::Separator();
+	imgui_drawTextureStreamingStats();
+	ImGui::Separator();
+	imgui_drawBatchStats();
+	ImGui::Separator();
+	FrameGraph::imgui_drawStats();
+
 	ImGui::EndChild();
 	ImGui::PopStyleColor(); // Restore the previous style color
 
@@ -708,11 +1803,14 @@ void Scene_ASGN::imgui_draw()
 
 	// Directional Light section
 	ImGui::PushStyleColor(ImGuiCol_ChildBg, ImVec4(1.0f, 0.0f, 0.0f, 0.1f));
-	ImGui::BeginChild("Directional Light Section", ImVec2(0, 250), true);
+	ImGui::BeginChild("Directional Light Section", ImVec2(0, 450), true);
 	ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(0.0f, 1.0f, 0.8f, 1.0f));
 	ImGui::Checkbox("Directional Light", &enableDirectionalLight);
 	ImGui::PopStyleColor();
 	LightUtils::imgui_drawControls(dLight);
+	ImGui::Separator();
+	CascadedShadowMap::imgui_drawControls();
+	CascadedShadowMap::imgui_drawStats();
 	ImGui::EndChild();
 	ImGui::PopStyleColor(); // Restore the previous style color
 
@@ -766,6 +1864,41 @@ void Scene_ASGN::imgui_draw()
 	ImGui::EndChild();
 	ImGui::PopStyleColor(); // Restore the previous style color
 
+	//Clustered lighting section
+	ImGui::PushStyleColor(ImGuiCol_ChildBg, ImVec4(0.5f, 0.5f, 0.5f, 0.1f));
+	ImGui::BeginChild("Clustered Lighting Section", ImVec2(0, 160), true);
+	ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "Clustered Lighting");
+	ImGui::TextColored(ImVec4(0.0f, 0.8f, 1.0f, 1.0f), "   Extra Lanterns");
+	ImGui::SliderInt("SliderL1", &extraLanternCount, 0, 4096);
+	LightCluster::imgui_drawStats();
+	ImGui::EndChild();
+	ImGui::PopStyleColor(); // Restore the previous style color
+
+	//Point shadow section
+	ImGui::PushStyleColor(ImGuiCol_ChildBg, ImVec4(0.5f, 0.5f, 0.5f, 0.1f));
+	ImGui::BeginChild("Point Shadow Section", ImVec2(0, 420), true);
+	ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "Point/Spot Shadows");
+	ShadowAtlas::imgui_drawControls();
+	ShadowAtlas::imgui_drawStats();
+	ImGui::EndChild();
+	ImGui::PopStyleColor(); // Restore the previous style color
+
+	//Deferred shading section
+	ImGui::PushStyleColor(ImGuiCol_ChildBg, ImVec4(0.5f, 0.5f, 0.5f, 0.1f));
+	ImGui::BeginChild("Deferred Shading Section", ImVec2(0, 300), true);
+	ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(0.0f, 1.0f, 0.8f, 1.0f));
+	ImGui::Checkbox("Deferred Shading", &enableDeferred);
+	ImGui::PopStyleColor();
+	imgui_drawDeferredStats();
+	ImGui::Separator();
+	imgui_drawOpaqueTextureControls();
+	ImGui::Separator();
+	imgui_drawTransparencyControls();
+	ImGui::Separator();
+	GPUProfiler::imgui_drawStats();
+	ImGui::EndChild();
+	ImGui::PopStyleColor(); // Restore the previous style color
+
 	ImGui::Separator();
 
 }
@@ -0,0 +1,202 @@
+#include "program_cache.h"
+#include <glad/glad.h>
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// Not part of the 3.3 headers
+#define CACHE_GL_PROGRAM_BINARY_RETRIEVABLE_HINT	0x8257
+#define CACHE_GL_PROGRAM_BINARY_LENGTH				0x8741
+#define CACHE_GL_NUM_PROGRAM_BINARY_FORMATS			0x87FE
+
+typedef void (APIENTRYP GetProgramBinaryProc)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP ProgramBinaryProc)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP ProgramParameteriProc)(GLuint program, GLenum pname, GLint value);
+
+static GetProgramBinaryProc getProgramBinary;
+static ProgramBinaryProc programBinary;
+static ProgramParameteriProc programParameteri;
+
+static bool checked = false;
+static bool supported = false;
+static std::string driverString;
+
+// File layout: header, then 'length' bytes of driver binary
+struct CacheHeader
+{
+	char magic[4];
+	unsigned int version;
+	unsigned long long key;
+	unsigned int binaryFormat;
+	unsigned int length;
+};
+
+static const char CACHE_MAGIC[4] = { 'X', 'B', 'P', 'C' };
+static const unsigned int CACHE_VERSION = 1;
+
+const char* ProgramCache::CACHE_DIRECTORY = "../shader_cache/";
+
+static unsigned long long hashString(unsigned long long hash, const std::string& s)
+{
+	// FNV-1a, with a terminator so ("ab", "c") and ("a", "bc") differ
+	for (unsigned char c : s)
+	{
+		hash ^= c;
+		hash *= 1099511628211ull;
+	}
+	hash ^= 0xff;
+	hash *= 1099511628211ull;
+	return hash;
+}
+
+static std::string getCachePath(unsigned long long key)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bin", key);
+	return std::string(ProgramCache::CACHE_DIRECTORY) + name;
+}
+
+bool ProgramCache::isSupported()
+{
+	if (checked)
+		return supported;
+
+	checked = true;
+
+	int major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+
+	bool core = major > 4 || (major == 4 && minor >= 1);
+	if (!core && !glfwExtensionSupported("GL_ARB_get_program_binary"))
+	{
+		printf("Program binary cache: not supported by this driver\n");
+		return false;
+	}
+
+	getProgramBinary = (GetProgramBinaryProc)glfwGetProcAddress("glGetProgramBinary");
+	programBinary = (ProgramBinaryProc)glfwGetProcAddress("glProgramBinary");
+	programParameteri = (ProgramParameteriProc)glfwGetProcAddress("glProgramParameteri");
+
+	// Some drivers expose the functions but no formats, which means no binaries can be saved
+	int formats = 0;
+	glGetIntegerv(CACHE_GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+
+	supported = getProgramBinary != nullptr && programBinary != nullptr && programParameteri != nullptr && formats > 0;
+	if (!supported)
+	{
+		printf("Program binary cache: no binary formats available\n");
+		return false;
+	}
+
+	std::ostringstream s;
+	s << glGetString(GL_VENDOR) << '\n' << glGetString(GL_RENDERER) << '\n' << glGetString(GL_VERSION);
+	driverString = s.str();
+
+#ifdef _WIN32
+	_mkdir(CACHE_DIRECTORY);
+#else
+	mkdir(CACHE_DIRECTORY, 0755);
+#endif
+
+	return true;
+}
+
+unsigned long long ProgramCache::makeKey(const std::string& vString, const std::string& fString)
+{
+	isSupported(); // Reads the driver strings
+	unsigned long long hash = 14695981039346656037ull;
+	hash = hashString(hash, vString);
+	hash = hashString(hash, fString);
+	hash = hashString(hash, driverString);
+	return hash;
+}
+
+unsigned int ProgramCache::load(unsigned long long key, bool* rejected)
+{
+	*rejected = false;
+
+	if (!isSupported())
+		return 0;
+
+	std::string path = getCachePath(key);
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return 0;
+
+	CacheHeader header;
+	std::vector<char> binary;
+	if (file.read((char*)&header, sizeof(header))
+		&& memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0
+		&& header.version == CACHE_VERSION
+		&& header.key == key)
+	{
+		binary.resize(header.length);
+		if (!file.read(binary.data(), header.length))
+			binary.clear();
+	}
+	file.close();
+
+	if (!binary.empty())
+	{
+		unsigned int programId = glCreateProgram();
+		programBinary(programId, header.binaryFormat, binary.data(), (GLsizei)binary.size());
+
+		int success = 0;
+		glGetProgramiv(programId, GL_LINK_STATUS, &success);
+		if (success)
+			return programId;
+
+		glDeleteProgram(programId);
+	}
+
+	// Truncated, from another build, or refused by the driver
+	*rejected = true;
+	std::remove(path.c_str());
+	return 0;
+}
+
+void ProgramCache::prepare(unsigned int programId)
+{
+	if (isSupported())
+		programParameteri(programId, CACHE_GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+void ProgramCache::store(unsigned long long key, unsigned int programId)
+{
+	if (!isSupported())
+		return;
+
+	int length = 0;
+	glGetProgramiv(programId, CACHE_GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	std::vector<char> binary(length);
+	GLenum binaryFormat = 0;
+	getProgramBinary(programId, length, &length, &binaryFormat, binary.data());
+
+	CacheHeader header;
+	memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	header.version = CACHE_VERSION;
+	header.key = key;
+	header.binaryFormat = binaryFormat;
+	header.length = (unsigned int)length;
+
+	std::ofstream file(getCachePath(key), std::ios::binary | std::ios::trunc);
+	if (!file)
+		return;
+
+	file.write((const char*)&header, sizeof(header));
+	file.write(binary.data(), length);
+}
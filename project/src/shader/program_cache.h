@@ -0,0 +1,32 @@
+#pragma once
+#include <string>
+
+// On-disk cache of linked shader program binaries (glGetProgramBinary / glProgramBinary).
+//
+// Entries are keyed by a hash of the preprocessed vertex and fragment sources (includes expanded,
+// keyword defines injected) and the driver's vendor/renderer/version strings, so a driver update
+// or any source change simply misses. Binaries the driver rejects are deleted and the caller
+// compiles from source again.
+//
+// Program binaries are core in GL 4.1 and ARB_get_program_binary; the 3.3 glad loader does not
+// load them, so the entry points are fetched here. Without them every call is a no-op miss.
+class ProgramCache
+{
+public:
+	ProgramCache() = delete;
+
+	static const char* CACHE_DIRECTORY;
+
+	// Requires a current GL context. Checked once.
+	static bool isSupported();
+
+	static unsigned long long makeKey(const std::string& vString, const std::string& fString);
+
+	// Linked program for this key, or 0 on a miss. rejected is set when a cached binary
+	// existed but the driver refused it.
+	static unsigned int load(unsigned long long key, bool* rejected);
+
+	// Call on a new program before glLinkProgram so its binary can be retrieved.
+	static void prepare(unsigned int programId);
+	static void store(unsigned long long key, unsigned int programId);
+};
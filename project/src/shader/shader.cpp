@@ -10,7 +10,7 @@ Shader::Shader() : shaderName("NO-NAME"), handle(0)
 
 Shader::~Shader()
 {
-	glDeleteProgram(handle);
+	ShaderUtils::deleteProgram(handle);
 }
 
 unsigned int Shader::getNativeHandle()
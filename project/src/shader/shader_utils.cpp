@@ -1,23 +1,97 @@
 #include "shader_utils.h"
+#include "program_cache.h"
+#include "../framework/hot_reload.h"
 #include <glad/glad.h>
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
 #include <fstream>
 #include <sstream>
 #include <stdio.h>
+#include <set>
+#include <chrono>
+#include <unordered_map>
 
 static std::string errorString;
 
+// Compiled stages by hash of (stage type, source), shared by every program using the same source.
+// A stage is deleted once no program made from it (linked or still pending) is left, so the
+// stages of an old source go away when a hot reload replaces the last program using them.
+struct CachedStage
+{
+	unsigned int shaderId;
+	unsigned int programs;
+};
+static std::unordered_map<unsigned long long, CachedStage> stageCache;
+// Vertex and fragment stage keys of the programs made from cached stages
+static std::unordered_map<unsigned int, std::pair<unsigned long long, unsigned long long>> programStages;
+
+// Counters since beginLoadReport()
+struct LoadStats
+{
+	unsigned int programs;
+	unsigned int binaryHits;
+	unsigned int binaryRejects;
+	unsigned int compiledPrograms;
+	unsigned int stagesCompiled;
+	unsigned int stagesShared;
+};
+static LoadStats loadStats;
+static std::chrono::high_resolution_clock::time_point loadStart;
+static bool lastProgramCached = false;
+
+// Programs compiled and linked but not checked yet, see ShaderUtils::updatePendingPrograms()
+struct PendingProgram
+{
+	Shader* shader;
+	ShaderVariants* variants;		// Set for keyword variants
+	std::string shaderName;
+	unsigned int programId;
+	unsigned int vertexShader;
+	unsigned int fragmentShader;
+	unsigned long long key;
+	std::function<void(Shader*)> onCompiled;
+	std::chrono::high_resolution_clock::time_point submitTime;
+	unsigned long long submitFrame;
+};
+static std::vector<PendingProgram> pendingPrograms;
+static unsigned long long frame = 0;
+
+// KHR/ARB_parallel_shader_compile; not in the 3.3 headers
+#define SHADER_GL_COMPLETION_STATUS		0x91B1
+typedef void (APIENTRYP MaxShaderCompilerThreadsProc)(GLuint count);
+static int parallelCompile = -1;	// -1 until checked
+
+// Without parallel compile every status check may block, so only this many per frame
+static const unsigned int MAX_BLOCKING_CHECKS_PER_FRAME = 1;
+
+// Drawn while a variant has no compiled program yet
+static Shader* fallbackShader;
+static const char* fallbackV = "#version 330 core\nlayout(location = 0) in vec3 aPos;uniform mat4 projection, view, model;void main(){gl_Position = projection * view * model * vec4(aPos, 1.0);}";
+static const char* fallbackF = "#version 330 core\nlayout(location = 0) out vec4 FragColor;void main(){FragColor = vec4(0.5, 0.5, 0.5, 1.0);}";
+
 static unsigned int compileSourcesToShaderProgram(const std::string& vString, const std::string& fString);
 static unsigned int assembleProgram(unsigned int vShader, unsigned int fShader);
 static unsigned int compileShader(const GLenum shaderType, const char* shaderCode, const char* shaderTypeString);
+static unsigned int getStage(const GLenum shaderType, unsigned long long key, const std::string& source, const char* shaderTypeString);
+static unsigned int submitStage(const GLenum shaderType, unsigned long long key, const std::string& source);
+static unsigned long long getStageKey(const GLenum shaderType, const std::string& source);
+static void releaseStage(unsigned long long key);
+static bool hasParallelCompile();
+static void cancelPending(Shader* shader);
+static const char* getCacheNote();
 static std::string readFile(const std::string& path);
+static std::string readShaderFile(const std::string& path, std::set<std::string>* dependencies = nullptr);
+static void watchShaderFiles(const void* owner, const std::set<std::string>& dependencies, HotReload::CommitFunc reload);
 static bool checkProgramLinkingStatus(unsigned int programId, std::string* errorOut);
 static bool checkShaderCompilationStatus(unsigned int shaderId, const char* shaderTypeString, std::string* errorOut);
+static std::string injectKeywords(const std::string& source, const std::vector<std::string>& keywords, unsigned int keywordMask);
+static std::string getKeywordString(const std::vector<std::string>& keywords, unsigned int keywordMask);
 
 void ShaderUtils::injectData(Shader* shaderPtr, const unsigned int shaderId, const std::string& shaderName)
 {
 	if (shaderId == 0) return;
 
-	glDeleteProgram(shaderPtr->getNativeHandle());
+	deleteProgram(shaderPtr->getNativeHandle());
 	shaderPtr->handle = shaderId;
 	shaderPtr->shaderName = shaderName;
 }
@@ -33,7 +107,7 @@ Shader* ShaderUtils::createShaderInternal(const std::string& shaderName, const s
 		shader = new Shader();
 		unsigned int newShaderId = compileSourcesToShaderProgram(vString, fString);
 		injectData(shader, newShaderId, shaderName);
-		printf("\x1b[32mSuccess\x1b[0m\n");
+		printf("\x1b[32mSuccess\x1b[0m%s\n", getCacheNote());
 	}
 	catch (std::string err)
 	{
@@ -44,25 +118,32 @@ Shader* ShaderUtils::createShaderInternal(const std::string& shaderName, const s
 	return shader;
 }
 
-void ShaderUtils::loadShader(Shader** shaderPtr, const std::string& shaderName, const std::string& vertexFilePath, const std::string& fragmentFilePath)
+void ShaderUtils::loadShader(Shader** shaderPtr, const std::string& shaderName, const std::string& vertexFilePath, const std::string& fragmentFilePath,
+	std::function<void(Shader*)> onCompiled)
 {
 	validateShaderObject(shaderPtr);
 
 	printf("Loading '%s' shader program... ", shaderName.c_str());
 
+	std::set<std::string> dependencies = { vertexFilePath, fragmentFilePath };
+
 	try
 	{
-		std::string vString = readFile(vertexFilePath);
-		std::string fString = readFile(fragmentFilePath);
+		std::string vString = readShaderFile(vertexFilePath, &dependencies);
+		std::string fString = readShaderFile(fragmentFilePath, &dependencies);
 
-		unsigned int newShaderId = compileSourcesToShaderProgram(vString, fString);
-		injectData(*shaderPtr, newShaderId, shaderName);
-		printf("\x1b[32mSuccess\x1b[0m\n");
+		submitProgram(*shaderPtr, shaderName, vString, fString, onCompiled, nullptr);
 	}
 	catch (std::string err)
 	{
 		printf("\x1b[31mFailed\n\x1b[33m%s\x1b[0m", err.c_str());
 	}
+
+	// Watched even after a failed read, so fixing the file picks it up
+	watchShaderFiles(*shaderPtr, dependencies, [=]()
+	{
+		loadShader(shaderPtr, shaderName, vertexFilePath, fragmentFilePath, onCompiled);
+	});
 }
 
 void ShaderUtils::loadShader_String(Shader** shaderPtr, const std::string& shaderName, const std::string& vString, const std::string& fString)
@@ -75,7 +156,7 @@ void ShaderUtils::loadShader_String(Shader** shaderPtr, const std::string& shade
 	{
 		unsigned int newShaderId = compileSourcesToShaderProgram(vString, fString);
 		injectData(*shaderPtr, newShaderId, shaderName);
-		printf("\x1b[32mSuccess\x1b[0m\n");
+		printf("\x1b[32mSuccess\x1b[0m%s\n", getCacheNote());
 	}
 	catch (std::string err)
 	{
@@ -91,11 +172,11 @@ void ShaderUtils::loadShader_VFile_FString(Shader** shaderPtr, const std::string
 
 	try
 	{
-		std::string vString = readFile(vertexFilePath);
+		std::string vString = readShaderFile(vertexFilePath);
 
 		unsigned int newShaderId = compileSourcesToShaderProgram(vString, fString);
 		injectData(*shaderPtr, newShaderId, shaderName);
-		printf("\x1b[32mSuccess\x1b[0m\n");
+		printf("\x1b[32mSuccess\x1b[0m%s\n", getCacheNote());
 	}
 	catch (std::string err)
 	{
@@ -111,34 +192,463 @@ void ShaderUtils::loadShader_VString_FFile(Shader** shaderPtr, const std::string
 
 	try
 	{
-		std::string fString = readFile(fragmentFilePath);
+		std::string fString = readShaderFile(fragmentFilePath);
 
 		unsigned int newShaderId = compileSourcesToShaderProgram(vString, fString);
 		injectData(*shaderPtr, newShaderId, shaderName);
+		printf("\x1b[32mSuccess\x1b[0m%s\n", getCacheNote());
+	}
+	catch (std::string err)
+	{
+		printf("\x1b[31mFailed\n\x1b[33m%s\x1b[0m", err.c_str());
+	}
+}
+
+void ShaderUtils::loadShaderVariants(ShaderVariants** variantsPtr, const std::string& shaderName, const std::string& vertexFilePath, const std::string& fragmentFilePath,
+	const std::vector<std::string>& keywords, std::function<void(Shader*)> onCompiled)
+{
+	if (*variantsPtr == 0)
+	{
+		*variantsPtr = new ShaderVariants();
+	}
+
+	ShaderVariants* variants = *variantsPtr;
+
+	printf("Loading '%s' shader variants (%u keywords)... ", shaderName.c_str(), (unsigned int)keywords.size());
+
+	std::set<std::string> dependencies = { vertexFilePath, fragmentFilePath };
+	auto reload = [=]()
+	{
+		loadShaderVariants(variantsPtr, shaderName, vertexFilePath, fragmentFilePath, keywords, onCompiled);
+	};
+
+	try
+	{
+		std::string vString = readShaderFile(vertexFilePath, &dependencies);
+		std::string fString = readShaderFile(fragmentFilePath, &dependencies);
+		watchShaderFiles(variants, dependencies, reload);
+
+		variants->shaderName = shaderName;
+		variants->vertexSource = vString;
+		variants->fragmentSource = fString;
+		variants->keywords = keywords;
+		variants->onCompiled = onCompiled;
 		printf("\x1b[32mSuccess\x1b[0m\n");
 	}
 	catch (std::string err)
 	{
 		printf("\x1b[31mFailed\n\x1b[33m%s\x1b[0m", err.c_str());
+		watchShaderFiles(variants, dependencies, reload);
+		return;
+	}
+
+	// Variants already handed out are recompiled in place so their Shader* stay valid;
+	// they keep their current program until the new one is linked
+	variants->compileTimeMs = 0.0f;
+	for (auto& it : variants->variants)
+	{
+		compileShaderVariant(variants, it.first, it.second);
+	}
+}
+
+Shader* ShaderUtils::getShaderVariant(ShaderVariants* variants, unsigned int keywordMask)
+{
+	Shader* shader;
+
+	auto it = variants->variants.find(keywordMask);
+	if (it != variants->variants.end())
+	{
+		shader = it->second;
+	}
+	else
+	{
+		// A failed compile is cached too (handle 0), so it is not retried every frame
+		shader = new Shader();
+		variants->variants[keywordMask] = shader;
+		compileShaderVariant(variants, keywordMask, shader);
+	}
+
+	if (shader->getNativeHandle() != 0)
+	{
+		variants->lastUsed = shader;
+		return shader;
+	}
+
+	// Still compiling: keep drawing with the variant used before, or flat grey if there is none
+	if (variants->lastUsed != 0)
+		return variants->lastUsed;
+
+	if (fallbackShader == 0)
+		fallbackShader = createShaderInternal("FALLBACK", fallbackV, fallbackF);
+	return fallbackShader;
+}
+
+void ShaderUtils::compileShaderVariant(ShaderVariants* variants, unsigned int keywordMask, Shader* shader)
+{
+	std::string variantName = variants->shaderName + getKeywordString(variants->keywords, keywordMask);
+
+	printf("Compiling '%s' shader variant... ", variantName.c_str());
+
+	submitProgram(shader, variantName,
+		injectKeywords(variants->vertexSource, variants->keywords, keywordMask),
+		injectKeywords(variants->fragmentSource, variants->keywords, keywordMask),
+		variants->onCompiled, variants);
+}
+
+void ShaderUtils::submitProgram(Shader* shader, const std::string& shaderName, const std::string& vString, const std::string& fString,
+	std::function<void(Shader*)> onCompiled, ShaderVariants* variants)
+{
+	loadStats.programs++;
+	hasParallelCompile();
+
+	// An older submission for this Shader is out of date
+	cancelPending(shader);
+
+	// Linked binary from an earlier run, keyed by the exact sources and driver
+	unsigned long long key = ProgramCache::makeKey(vString, fString);
+
+	bool rejected = false;
+	unsigned int programId = ProgramCache::load(key, &rejected);
+	if (rejected)
+		loadStats.binaryRejects++;
+
+	if (programId != 0)
+	{
+		loadStats.binaryHits++;
+		injectData(shader, programId, shaderName);
+		printf("\x1b[32mSuccess\x1b[0m (binary cache)\n");
+
+		if (onCompiled)
+			onCompiled(shader);
+		return;
+	}
+
+	// Compile and link without reading any status back; that would wait for the driver
+	PendingProgram pending;
+	pending.shader = shader;
+	pending.variants = variants;
+	pending.shaderName = shaderName;
+	pending.key = key;
+	pending.onCompiled = onCompiled;
+	pending.submitTime = std::chrono::high_resolution_clock::now();
+	pending.submitFrame = frame;
+
+	unsigned long long vertexKey = getStageKey(GL_VERTEX_SHADER, vString);
+	unsigned long long fragmentKey = getStageKey(GL_FRAGMENT_SHADER, fString);
+	pending.vertexShader = submitStage(GL_VERTEX_SHADER, vertexKey, vString);
+	pending.fragmentShader = submitStage(GL_FRAGMENT_SHADER, fragmentKey, fString);
+
+	pending.programId = glCreateProgram();
+	programStages[pending.programId] = std::make_pair(vertexKey, fragmentKey);
+	glAttachShader(pending.programId, pending.vertexShader);
+	glAttachShader(pending.programId, pending.fragmentShader);
+	ProgramCache::prepare(pending.programId);
+	glLinkProgram(pending.programId);
+	glDetachShader(pending.programId, pending.vertexShader);
+	glDetachShader(pending.programId, pending.fragmentShader);
+
+	loadStats.compiledPrograms++;
+	pendingPrograms.push_back(pending);
+	printf("\x1b[36mSubmitted\x1b[0m\n");
+}
+
+// A stage that failed to compile is dropped from the stage cache so a fixed source compiles again
+static void dropFailedStage(unsigned int shaderId, const char* shaderTypeString)
+{
+	for (auto it = stageCache.begin(); it != stageCache.end(); ++it)
+	{
+		if (it->second.shaderId != shaderId)
+			continue;
+
+		if (!checkShaderCompilationStatus(shaderId, shaderTypeString, &errorString))
+		{
+			stageCache.erase(it);
+			glDeleteShader(shaderId);
+		}
+		return;
+	}
+}
+
+void ShaderUtils::finishProgram(const PendingProgram& pending)
+{
+	errorString.clear();
+
+	if (!checkProgramLinkingStatus(pending.programId, &errorString))
+	{
+		dropFailedStage(pending.vertexShader, "VERTEX");
+		dropFailedStage(pending.fragmentShader, "FRAGMENT");
+		deleteProgram(pending.programId);
+
+		// The Shader keeps whatever program it had before
+		printf("'%s' shader program \x1b[31mFailed\n\x1b[33m%s\x1b[0m", pending.shaderName.c_str(), errorString.c_str());
+		return;
+	}
+
+	float ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - pending.submitTime).count();
+
+	injectData(pending.shader, pending.programId, pending.shaderName);
+	ProgramCache::store(pending.key, pending.programId);
+
+	if (pending.variants != 0)
+	{
+		pending.variants->compileTimeMs += ms;
+		printf("'%s' shader program \x1b[32mReady\x1b[0m after %.2f ms ('%s': %u variants, %.2f ms total)\n", pending.shaderName.c_str(), ms,
+			pending.variants->shaderName.c_str(), pending.variants->getVariantCount(), pending.variants->compileTimeMs);
+	}
+	else
+	{
+		printf("'%s' shader program \x1b[32mReady\x1b[0m after %.2f ms\n", pending.shaderName.c_str(), ms);
+	}
+
+	if (pending.onCompiled)
+		pending.onCompiled(pending.shader);
+}
+
+void ShaderUtils::updatePendingPrograms()
+{
+	frame++;
+
+	unsigned int blockingChecks = 0;
+	for (size_t i = 0; i < pendingPrograms.size();)
+	{
+		bool ready = false;
+		if (hasParallelCompile())
+		{
+			int complete = 0;
+			glGetProgramiv(pendingPrograms[i].programId, SHADER_GL_COMPLETION_STATUS, &complete);
+			ready = complete != 0;
+		}
+		else if (pendingPrograms[i].submitFrame < frame && blockingChecks < MAX_BLOCKING_CHECKS_PER_FRAME)
+		{
+			// Give the driver at least a frame, then take the (possibly blocking) check
+			ready = true;
+			blockingChecks++;
+		}
+
+		if (!ready)
+		{
+			i++;
+			continue;
+		}
+
+		PendingProgram pending = pendingPrograms[i];
+		pendingPrograms.erase(pendingPrograms.begin() + i);
+		finishProgram(pending);
+	}
+}
+
+void ShaderUtils::finishPendingPrograms()
+{
+	while (!pendingPrograms.empty())
+	{
+		PendingProgram pending = pendingPrograms.front();
+		pendingPrograms.erase(pendingPrograms.begin());
+		finishProgram(pending);
+	}
+}
+
+static void cancelPending(Shader* shader)
+{
+	for (size_t i = 0; i < pendingPrograms.size();)
+	{
+		if (pendingPrograms[i].shader == shader)
+		{
+			ShaderUtils::deleteProgram(pendingPrograms[i].programId);
+			pendingPrograms.erase(pendingPrograms.begin() + i);
+		}
+		else
+		{
+			i++;
+		}
 	}
 }
 
+static bool hasParallelCompile()
+{
+	if (parallelCompile >= 0)
+		return parallelCompile == 1;
+
+	parallelCompile = 0;
+
+	const char* extensions[][2] = {
+		{ "GL_KHR_parallel_shader_compile", "glMaxShaderCompilerThreadsKHR" },
+		{ "GL_ARB_parallel_shader_compile", "glMaxShaderCompilerThreadsARB" },
+	};
+
+	for (auto& ext : extensions)
+	{
+		if (!glfwExtensionSupported(ext[0]))
+			continue;
+
+		// Let the driver pick the thread count
+		MaxShaderCompilerThreadsProc maxThreads = (MaxShaderCompilerThreadsProc)glfwGetProcAddress(ext[1]);
+		if (maxThreads != nullptr)
+			maxThreads(0xFFFFFFFF);
+
+		parallelCompile = 1;
+		break;
+	}
+
+	printf("Parallel shader compile: %s\n", parallelCompile == 1 ? "available" : "not available, status checks spread over frames");
+	return parallelCompile == 1;
+}
+
+void ShaderUtils::beginLoadReport()
+{
+	loadStats = LoadStats();
+	loadStart = std::chrono::high_resolution_clock::now();
+}
+
+void ShaderUtils::endLoadReport(const char* label)
+{
+	float ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - loadStart).count();
+
+	const char* cache = "cold";
+	if (!ProgramCache::isSupported())
+		cache = "no";
+	else if (loadStats.programs > 0 && loadStats.binaryHits == loadStats.programs)
+		cache = "warm";
+	else if (loadStats.binaryHits > 0)
+		cache = "partial";
+
+	printf("%s: %u shader programs in %.2f ms, %s binary cache (%u hits, %u rejected, %u compiled; %u stages compiled, %u shared), %u still compiling\n",
+		label, loadStats.programs, ms, cache, loadStats.binaryHits, loadStats.binaryRejects,
+		loadStats.compiledPrograms, loadStats.stagesCompiled, loadStats.stagesShared, (unsigned int)pendingPrograms.size());
+}
+
+static const char* getCacheNote()
+{
+	return lastProgramCached ? " (binary cache)" : "";
+}
+
 static unsigned int compileSourcesToShaderProgram(const std::string& vString, const std::string& fString)
 {
 	// Clear any data written to the string so we can write errors if any.
 	errorString.clear();
 
-	try
+	lastProgramCached = false;
+	loadStats.programs++;
+
+	// Linked binary from an earlier run, keyed by the exact sources and driver
+	unsigned long long key = ProgramCache::makeKey(vString, fString);
+
+	bool rejected = false;
+	unsigned int programId = ProgramCache::load(key, &rejected);
+	if (rejected)
+		loadStats.binaryRejects++;
+
+	if (programId != 0)
 	{
-		unsigned int vertexShader = compileShader(GL_VERTEX_SHADER, vString.c_str(), "VERTEX");
-		unsigned int fragmentShader = compileShader(GL_FRAGMENT_SHADER, fString.c_str(), "FRAGMENT");
+		loadStats.binaryHits++;
+		lastProgramCached = true;
+		return programId;
+	}
 
-		return assembleProgram(vertexShader, fragmentShader);
+	unsigned long long vertexKey = getStageKey(GL_VERTEX_SHADER, vString);
+	unsigned long long fragmentKey = getStageKey(GL_FRAGMENT_SHADER, fString);
+
+	// Stages taken before a failure are given back, so they do not outlive the failed program
+	unsigned int vertexShader = getStage(GL_VERTEX_SHADER, vertexKey, vString, "VERTEX");
+	try
+	{
+		unsigned int fragmentShader = getStage(GL_FRAGMENT_SHADER, fragmentKey, fString, "FRAGMENT");
+		try
+		{
+			programId = assembleProgram(vertexShader, fragmentShader);
+		}
+		catch (std::string err)
+		{
+			releaseStage(fragmentKey);
+			throw err;
+		}
 	}
 	catch (std::string err)
 	{
+		releaseStage(vertexKey);
 		throw err;
 	}
+	programStages[programId] = std::make_pair(vertexKey, fragmentKey);
+
+	loadStats.compiledPrograms++;
+	ProgramCache::store(key, programId);
+	return programId;
+}
+
+static unsigned long long getStageKey(const GLenum shaderType, const std::string& source)
+{
+	// FNV-1a over the stage type and source
+	unsigned long long key = 14695981039346656037ull ^ shaderType;
+	for (unsigned char c : source)
+	{
+		key ^= c;
+		key *= 1099511628211ull;
+	}
+	return key;
+}
+
+// The cached stage for key, compiled from source if there is none; counts one more program using it
+static unsigned int getStage(const GLenum shaderType, unsigned long long key, const std::string& source, const char* shaderTypeString)
+{
+	auto it = stageCache.find(key);
+	if (it != stageCache.end())
+	{
+		loadStats.stagesShared++;
+		it->second.programs++;
+		return it->second.shaderId;
+	}
+
+	unsigned int shaderId = compileShader(shaderType, source.c_str(), shaderTypeString);
+	stageCache[key] = { shaderId, 1 };
+	loadStats.stagesCompiled++;
+	return shaderId;
+}
+
+// Like getStage(), without waiting for the compile; errors surface when the program is checked
+static unsigned int submitStage(const GLenum shaderType, unsigned long long key, const std::string& source)
+{
+	auto it = stageCache.find(key);
+	if (it != stageCache.end())
+	{
+		loadStats.stagesShared++;
+		it->second.programs++;
+		return it->second.shaderId;
+	}
+
+	const char* shaderCode = source.c_str();
+	unsigned int shaderId = glCreateShader(shaderType);
+	glShaderSource(shaderId, 1, &shaderCode, NULL);
+	glCompileShader(shaderId);
+
+	stageCache[key] = { shaderId, 1 };
+	loadStats.stagesCompiled++;
+	return shaderId;
+}
+
+// One program fewer uses the stage; the last one deletes it. Stages dropped after a failed
+// compile are already gone from the cache.
+static void releaseStage(unsigned long long key)
+{
+	auto it = stageCache.find(key);
+	if (it == stageCache.end())
+		return;
+
+	if (--it->second.programs == 0)
+	{
+		glDeleteShader(it->second.shaderId);
+		stageCache.erase(it);
+	}
+}
+
+void ShaderUtils::deleteProgram(unsigned int programId)
+{
+	auto it = programStages.find(programId);
+	if (it != programStages.end())
+	{
+		releaseStage(it->second.first);
+		releaseStage(it->second.second);
+		programStages.erase(it);
+	}
+	glDeleteProgram(programId);
 }
 
 static unsigned int assembleProgram(unsigned int vShader, unsigned int fShader)
@@ -150,9 +660,16 @@ static unsigned int assembleProgram(unsigned int vShader, unsigned int fShader)
 	glAttachShader(programId, vShader);
 	glAttachShader(programId, fShader);
 
+	// Must be set before linking for glGetProgramBinary
+	ProgramCache::prepare(programId);
+
 	// You can also look for OpenGL documentation for proper explanation on this part.
 	glLinkProgram(programId);
 
+	// The stages stay in the stage cache for other programs
+	glDetachShader(programId, vShader);
+	glDetachShader(programId, fShader);
+
 	// if fail, then return 0 (null)
 	if (!checkProgramLinkingStatus(programId, &errorString))
 	{
@@ -210,6 +727,102 @@ static std::string readFile(const std::string& path)
 	}
 }
 
+static std::string getDirectory(const std::string& path)
+{
+	size_t slash = path.find_last_of("/\\");
+	return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+// Expands '#include "file"' lines, relative to the including file.
+// Each file is only included once per shader stage.
+static std::string expandIncludes(const std::string& source, const std::string& directory, std::set<std::string>& included)
+{
+	std::istringstream in(source);
+	std::ostringstream out;
+	std::string line;
+
+	while (std::getline(in, line))
+	{
+		size_t start = line.find_first_not_of(" \t");
+		if (start != std::string::npos && line.compare(start, 8, "#include") == 0)
+		{
+			size_t open = line.find('"', start);
+			size_t close = line.find('"', open + 1);
+			if (open == std::string::npos || close == std::string::npos)
+			{
+				std::ostringstream s;
+				s << "ERROR: Malformed #include: " << line << std::endl;
+				throw s.str();
+			}
+
+			std::string includePath = directory + line.substr(open + 1, close - open - 1);
+			if (included.insert(includePath).second)
+			{
+				out << expandIncludes(readFile(includePath), getDirectory(includePath), included) << "\n";
+			}
+			continue;
+		}
+
+		out << line << "\n";
+	}
+
+	return out.str();
+}
+
+// "#define" lines for the keywords set in the mask, inserted right after the #version line
+static std::string injectKeywords(const std::string& source, const std::vector<std::string>& keywords, unsigned int keywordMask)
+{
+	std::string defines;
+	for (size_t i = 0; i < keywords.size(); i++)
+	{
+		if (keywordMask & (1u << i))
+			defines += "#define " + keywords[i] + "\n";
+	}
+
+	size_t version = source.find("#version");
+	size_t lineEnd = version == std::string::npos ? std::string::npos : source.find('\n', version);
+	if (lineEnd == std::string::npos)
+		return defines + source;
+
+	return source.substr(0, lineEnd + 1) + defines + source.substr(lineEnd + 1);
+}
+
+// " [HDR TONEMAP]" for logging
+static std::string getKeywordString(const std::vector<std::string>& keywords, unsigned int keywordMask)
+{
+	std::string s;
+	for (size_t i = 0; i < keywords.size(); i++)
+	{
+		if (keywordMask & (1u << i))
+			s += (s.empty() ? "" : " ") + keywords[i];
+	}
+	return " [" + s + "]";
+}
+
+static std::string readShaderFile(const std::string& path, std::set<std::string>* dependencies)
+{
+	std::set<std::string> included;
+	std::string source = expandIncludes(readFile(path), getDirectory(path), included);
+
+	if (dependencies)
+		dependencies->insert(included.begin(), included.end());
+
+	return source;
+}
+
+// Maps every file a program was built from to that program, so editing a shared .glsl
+// reloads each program including it (and only those)
+static void watchShaderFiles(const void* owner, const std::set<std::string>& dependencies, HotReload::CommitFunc reload)
+{
+	// Drops files no longer included
+	HotReload::unwatch(owner);
+
+	for (auto& path : dependencies)
+	{
+		HotReload::watch(path, owner, [=]() { return reload; });
+	}
+}
+
 static bool checkProgramLinkingStatus(unsigned int programId, std::string* errorOut)
 {
 	int success;
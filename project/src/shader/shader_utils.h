@@ -1,5 +1,8 @@
 #pragma once
 #include "shader.h"
+#include "shader_variants.h"
+
+struct PendingProgram;
 
 class ShaderUtils
 {
@@ -23,6 +26,40 @@ private:
 	static void loadShader_VFile_FString(Shader** shaderPtr, const std::string& shaderName, const std::string& vertexFilePath, const std::string& fString);
 	static void loadShader_VString_FFile(Shader** shaderPtr, const std::string& shaderName, const std::string& vString, const std::string& fragmentFilePath);
 
+	static void compileShaderVariant(ShaderVariants* variants, unsigned int keywordMask, Shader* shader);
+
+	static void submitProgram(Shader* shader, const std::string& shaderName, const std::string& vString, const std::string& fString,
+		std::function<void(Shader*)> onCompiled, ShaderVariants* variants);
+	static void finishProgram(const PendingProgram& pending);
+
 public:
-	static void loadShader(Shader** shaderPtr, const std::string& shaderName, const std::string& vertexFilePath, const std::string& fragmentFilePath);
+	// Compiles in the background: the Shader keeps its previous program (none on first load)
+	// until updatePendingPrograms() finds the new one linked, then onCompiled runs with it.
+	static void loadShader(Shader** shaderPtr, const std::string& shaderName, const std::string& vertexFilePath, const std::string& fragmentFilePath,
+		std::function<void(Shader*)> onCompiled = nullptr);
+
+	// Reads the sources once; variants compile lazily in getShaderVariant().
+	// Reloading recompiles the variants already in use, in place.
+	static void loadShaderVariants(ShaderVariants** variantsPtr, const std::string& shaderName, const std::string& vertexFilePath, const std::string& fragmentFilePath,
+		const std::vector<std::string>& keywords, std::function<void(Shader*)> onCompiled = nullptr);
+
+	// Program for this keyword combination, compiled on first request. Until it is ready the
+	// variant used before is returned, or a flat fallback program.
+	static Shader* getShaderVariant(ShaderVariants* variants, unsigned int keywordMask);
+
+	// Once per frame: swaps in programs that finished linking. Uses GL_KHR_parallel_shader_compile
+	// to poll without blocking; without it at most one (possibly blocking) check is done per frame.
+	static void updatePendingPrograms();
+
+	// Blocks until everything submitted is ready, e.g. at startup
+	static void finishPendingPrograms();
+
+	// Logs the programs loaded since beginLoadReport(), the time taken and how many came
+	// from the program binary cache (see program_cache.h)
+	static void beginLoadReport();
+	static void endLoadReport(const char* label);
+
+	// Deletes a program and releases the cached stages it was made from; every program made
+	// here is deleted through this, including by ~Shader()
+	static void deleteProgram(unsigned int programId);
 };
\ No newline at end of file
@@ -0,0 +1,21 @@
+#include "shader_variants.h"
+
+ShaderVariants::ShaderVariants() : shaderName("NO-NAME"), lastUsed(0), compileTimeMs(0.0f)
+{
+}
+
+ShaderVariants::~ShaderVariants()
+{
+	for (auto& it : variants)
+		delete it.second;
+}
+
+unsigned int ShaderVariants::getVariantCount() const
+{
+	return (unsigned int)variants.size();
+}
+
+float ShaderVariants::getCompileTimeMs() const
+{
+	return compileTimeMs;
+}
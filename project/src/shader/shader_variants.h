@@ -0,0 +1,29 @@
+#pragma once
+#include "shader.h"
+#include <string>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+
+// One shader program compiled per combination of keywords.
+// Keyword i is bit (1 << i) of the mask; each set keyword is injected as "#define KEYWORD"
+// after the #version line. Variants are compiled on first use by ShaderUtils::getShaderVariant().
+class ShaderVariants
+{
+private:
+	friend class ShaderUtils;
+	std::string shaderName;
+	std::string vertexSource;				// #include already expanded
+	std::string fragmentSource;
+	std::vector<std::string> keywords;
+	std::function<void(Shader*)> onCompiled;	// Called after each compile, e.g. to set sampler units
+	std::unordered_map<unsigned int, Shader*> variants;
+	Shader* lastUsed;						// Drawn while a newly requested variant compiles
+	float compileTimeMs;
+	ShaderVariants();
+
+public:
+	~ShaderVariants();
+	unsigned int getVariantCount() const;
+	float getCompileTimeMs() const;
+};
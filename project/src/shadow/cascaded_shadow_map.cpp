@@ -0,0 +1,374 @@
+#include <glad/glad.h>
+#include "cascaded_shadow_map.h"
+#include "shadow_casters.h"
+#include "../lighting/lights.h"
+#include "../camera/camera_base.h"
+#include "../fbo/fbo_utils.h"
+#include "../framework/simplerenderer.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <string>
+#include <chrono>
+#include <cmath>
+
+#ifdef XBGT2094_ENABLE_IMGUI
+#include "../imgui/imgui.h"
+#endif
+
+struct Cascade
+{
+	glm::mat4 viewProjection;
+	glm::vec3 centre;			// Snapped world-space centre of the current box
+	float radius;				// Padded half extent of the box
+	float splitFar;				// View depth where this cascade ends
+	float texelWorldSize;
+
+	bool cacheValid;			// Static atlas holds this box
+	bool hadDynamic;			// Dynamic casters were drawn into the sampled atlas last frame
+	unsigned int staticAge;		// Frames since the static layer was rendered
+};
+
+// How far (fraction of the slice radius) the camera may move before a cascade re-centres
+static const float CACHE_MARGIN = 0.2f;
+
+// Casters up to this far towards the light beyond a cascade box still cast into it
+static const float CASTER_EXTRUSION = 50.0f;
+
+static DepthFBO* staticAtlas = nullptr;		// Static casters only, cached
+static DepthFBO* shadowAtlas = nullptr;		// Static + dynamic, sampled by the shaders
+static Cascade cascades[CascadedShadowMap::CASCADE_COUNT];
+
+static bool enabled = true;
+static float shadowDistance = 60.0f;
+static float splitLambda = 0.75f;
+
+static glm::vec3 cachedLightDirection(0.0f);
+static unsigned long long cachedStaticHash = 0;
+
+// Stats
+static unsigned int statStaticCascades = 0;
+static unsigned int statStaticDraws = 0;
+static unsigned int statDynamicDraws = 0;
+static unsigned int statComposites = 0;
+static unsigned long long statTotalStaticCascades = 0;
+static float statUpdateMs = 0.0f;
+
+static glm::ivec2 getTileOrigin(unsigned int cascade)
+{
+	return glm::ivec2(cascade % 2, cascade / 2) * (int)CascadedShadowMap::CASCADE_RESOLUTION;
+}
+
+static glm::vec3 getLightUp(const glm::vec3& direction)
+{
+	return fabsf(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+}
+
+// Bounding sphere of the camera frustum between two view depths. For a symmetric frustum
+// it does not change with camera rotation, which keeps the cascade size stable.
+static void getSliceSphere(const glm::mat4& cameraWorld, float tanX, float tanY, float zNear, float zFar, glm::vec3& centre, float& radius)
+{
+	glm::vec3 corners[8];
+	float depths[2] = { zNear, zFar };
+
+	centre = glm::vec3(0.0f);
+	for (int i = 0; i < 8; i++)
+	{
+		float z = depths[i / 4];
+		float x = ((i & 1) ? 1.0f : -1.0f) * z * tanX;
+		float y = ((i & 2) ? 1.0f : -1.0f) * z * tanY;
+
+		corners[i] = glm::vec3(cameraWorld * glm::vec4(x, y, -z, 1.0f));
+		centre += corners[i] / 8.0f;
+	}
+
+	radius = 0.0f;
+	for (int i = 0; i < 8; i++)
+		radius = glm::max(radius, glm::length(corners[i] - centre));
+
+	// Quantise so float noise cannot resize the box every frame
+	radius = ceilf(radius * 16.0f) / 16.0f;
+}
+
+static bool isInsideCascade(const glm::mat4& lightView, float radius, const ShadowCaster& caster)
+{
+	glm::vec3 p = glm::vec3(lightView * glm::vec4(caster.centre, 1.0f));
+	float r = caster.radius;
+
+	return fabsf(p.x) <= radius + r
+		&& fabsf(p.y) <= radius + r
+		&& -p.z >= -r
+		&& -p.z <= 2.0f * radius + CASTER_EXTRUSION + r;
+}
+
+static void setTileRegion(unsigned int cascade)
+{
+	glm::ivec2 origin = getTileOrigin(cascade);
+	int res = (int)CascadedShadowMap::CASCADE_RESOLUTION;
+
+	glViewport(origin.x, origin.y, res, res);
+	glScissor(origin.x, origin.y, res, res);
+}
+
+void CascadedShadowMap::init()
+{
+	if (shadowAtlas != nullptr)
+		return;
+
+	DepthFrameBufferConfig cfg;
+	cfg.size = glm::uvec2(CASCADE_RESOLUTION * 2);
+	cfg.depthFormat = DepthFormat::FLOAT24;
+
+	staticAtlas = FBOUtils::createDepthFBO(cfg);
+	shadowAtlas = FBOUtils::createDepthFBO(cfg);
+
+	// Hardware depth comparison + bilinear filtering gives 2x2 PCF per tap
+	glBindTexture(GL_TEXTURE_2D, shadowAtlas->getDepthAttachment()->getNativeHandle());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	invalidate();
+}
+
+void CascadedShadowMap::setEnabled(bool enable)
+{
+	enabled = enable;
+}
+
+bool CascadedShadowMap::isEnabled()
+{
+	return enabled;
+}
+
+void CascadedShadowMap::setShadowDistance(float distance)
+{
+	shadowDistance = glm::max(distance, 1.0f);
+}
+
+void CascadedShadowMap::setSplitLambda(float lambda)
+{
+	splitLambda = glm::clamp(lambda, 0.0f, 1.0f);
+}
+
+void CascadedShadowMap::invalidate()
+{
+	for (auto& cascade : cascades)
+	{
+		cascade.cacheValid = false;
+		cascade.hadDynamic = true;
+	}
+}
+
+void CascadedShadowMap::update(CameraBase* camera, DirectionalLight* light)
+{
+	statStaticCascades = 0;
+	statStaticDraws = 0;
+	statDynamicDraws = 0;
+	statComposites = 0;
+
+	if (!enabled)
+		return;
+
+	init();
+
+	auto timeStart = std::chrono::high_resolution_clock::now();
+
+	glm::vec3 lightDirection = glm::normalize(light->getDirection());
+	if (lightDirection != cachedLightDirection)
+	{
+		cachedLightDirection = lightDirection;
+		invalidate();
+	}
+
+	unsigned long long staticHash = ShadowCasters::getStaticHash();
+	if (staticHash != cachedStaticHash)
+	{
+		cachedStaticHash = staticHash;
+		invalidate();
+	}
+
+	glm::vec3 up = getLightUp(lightDirection);
+	glm::mat4 lightRotation = glm::lookAt(glm::vec3(0.0f), lightDirection, up);
+
+	// Camera frustum shape, read back from the projection so any CameraBase works
+	glm::mat4 projection = camera->getProjectionMatrix();
+	glm::mat4 cameraWorld = glm::inverse(camera->getViewMatrix());
+	float tanX = 1.0f / projection[0][0];
+	float tanY = 1.0f / projection[1][1];
+
+	float zNear = camera->getNearClip();
+	float zFar = glm::min(camera->getFarClip(), shadowDistance);
+
+	const auto& casters = ShadowCasters::getCasters();
+
+	ShadowCasters::beginDepthPass();
+
+	float splitNear = zNear;
+	for (unsigned int i = 0; i < CASCADE_COUNT; i++)
+	{
+		auto& cascade = cascades[i];
+
+		// Practical split scheme: blend of logarithmic and uniform
+		float t = (float)(i + 1) / CASCADE_COUNT;
+		float splitLog = zNear * powf(zFar / zNear, t);
+		float splitUniform = zNear + (zFar - zNear) * t;
+		float splitFar = splitLambda * splitLog + (1.0f - splitLambda) * splitUniform;
+
+		glm::vec3 centre;
+		float radius;
+		getSliceSphere(cameraWorld, tanX, tanY, splitNear, splitFar, centre, radius);
+
+		float paddedRadius = radius * (1.0f + CACHE_MARGIN);
+
+		bool recentre = !cascade.cacheValid
+			|| fabsf(paddedRadius - cascade.radius) > 1e-4f
+			|| glm::length(centre - cascade.centre) > radius * CACHE_MARGIN;
+
+		if (recentre)
+		{
+			// Snap the centre to whole texels in light space so static shadows do not swim
+			float texel = 2.0f * paddedRadius / CASCADE_RESOLUTION;
+			glm::vec3 centreLS = glm::vec3(lightRotation * glm::vec4(centre, 1.0f));
+			centreLS.x = floorf(centreLS.x / texel) * texel;
+			centreLS.y = floorf(centreLS.y / texel) * texel;
+
+			cascade.centre = glm::vec3(glm::inverse(lightRotation) * glm::vec4(centreLS, 1.0f));
+			cascade.radius = paddedRadius;
+			cascade.texelWorldSize = texel;
+			cascade.cacheValid = false;
+		}
+
+		cascade.splitFar = splitFar;
+		splitNear = splitFar;
+
+		glm::mat4 lightView = glm::lookAt(cascade.centre - lightDirection * (cascade.radius + CASTER_EXTRUSION), cascade.centre, up);
+		glm::mat4 lightProjection = glm::ortho(-cascade.radius, cascade.radius, -cascade.radius, cascade.radius, 0.0f, 2.0f * cascade.radius + CASTER_EXTRUSION);
+		cascade.viewProjection = lightProjection * lightView;
+
+		// 1. Static layer, only when the box or the static casters changed
+		bool staticRendered = false;
+		if (!cascade.cacheValid)
+		{
+			SimpleRenderer::bindFBO(staticAtlas);
+			setTileRegion(i);
+			glClear(GL_DEPTH_BUFFER_BIT);
+
+			for (auto& caster : casters)
+			{
+				if (caster.isStatic && isInsideCascade(lightView, cascade.radius, caster))
+				{
+					ShadowCasters::draw(caster, cascade.viewProjection);
+					statStaticDraws++;
+				}
+			}
+
+			cascade.cacheValid = true;
+			cascade.staticAge = 0;
+			staticRendered = true;
+			statStaticCascades++;
+			statTotalStaticCascades++;
+		}
+		else
+		{
+			cascade.staticAge++;
+		}
+
+		// 2. Sampled atlas = static layer + dynamic casters of this frame
+		bool hasDynamic = false;
+		for (auto& caster : casters)
+		{
+			if (!caster.isStatic && isInsideCascade(lightView, cascade.radius, caster))
+			{
+				hasDynamic = true;
+				break;
+			}
+		}
+
+		// Untouched tiles keep last frame's contents
+		if (!staticRendered && !hasDynamic && !cascade.hadDynamic)
+			continue;
+
+		setTileRegion(i);
+
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, staticAtlas->getNativeHandle());
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, shadowAtlas->getNativeHandle());
+
+		glm::ivec2 origin = getTileOrigin(i);
+		int res = (int)CASCADE_RESOLUTION;
+		glBlitFramebuffer(origin.x, origin.y, origin.x + res, origin.y + res, origin.x, origin.y, origin.x + res, origin.y + res, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, shadowAtlas->getNativeHandle());
+		statComposites++;
+
+		for (auto& caster : casters)
+		{
+			if (!caster.isStatic && isInsideCascade(lightView, cascade.radius, caster))
+			{
+				ShadowCasters::draw(caster, cascade.viewProjection);
+				statDynamicDraws++;
+			}
+		}
+
+		cascade.hadDynamic = hasDynamic;
+	}
+
+	ShadowCasters::endDepthPass();
+	SimpleRenderer::bindFBO_Default();
+
+	auto timeEnd = std::chrono::high_resolution_clock::now();
+	float ms = std::chrono::duration<float, std::milli>(timeEnd - timeStart).count();
+	statUpdateMs = statUpdateMs * 0.9f + ms * 0.1f;
+}
+
+void CascadedShadowMap::bindTexture()
+{
+	init();
+
+	glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT_SHADOW);
+	glBindTexture(GL_TEXTURE_2D, shadowAtlas->getDepthAttachment()->getNativeHandle());
+	glActiveTexture(GL_TEXTURE0);
+}
+
+void CascadedShadowMap::setShaderProps()
+{
+	SimpleRenderer::setShaderProp_Bool("enableCascadedShadows", enabled);
+	SimpleRenderer::setShaderProp_Integer("cascadeShadowMap", TEXTURE_UNIT_SHADOW);
+
+	glm::vec4 splits, texelSizes;
+	for (unsigned int i = 0; i < CASCADE_COUNT; i++)
+	{
+		SimpleRenderer::setShaderProp_Mat4("cascadeViewProjection[" + std::to_string(i) + "]", cascades[i].viewProjection);
+		splits[i] = cascades[i].splitFar;
+		texelSizes[i] = cascades[i].texelWorldSize;
+	}
+
+	SimpleRenderer::setShaderProp_Vec4("cascadeSplits", splits);
+	SimpleRenderer::setShaderProp_Vec4("cascadeTexelWorldSize", texelSizes);
+	SimpleRenderer::setShaderProp_Float("cascadeAtlasTexelSize", 1.0f / (CASCADE_RESOLUTION * 2));
+}
+
+#ifdef XBGT2094_ENABLE_IMGUI
+void CascadedShadowMap::imgui_drawControls()
+{
+	ImGui::Checkbox("Cascaded Shadows", &enabled);
+	ImGui::TextColored(ImVec4(0.0f, 0.8f, 1.0f, 1.0f), "   Shadow Distance");
+	if (ImGui::SliderFloat("SliderS1", &shadowDistance, 5.0f, 200.0f))
+		setShadowDistance(shadowDistance);
+	ImGui::TextColored(ImVec4(0.0f, 0.8f, 1.0f, 1.0f), "   Split Lambda");
+	if (ImGui::SliderFloat("SliderS2", &splitLambda, 0.0f, 1.0f))
+		setSplitLambda(splitLambda);
+}
+
+void CascadedShadowMap::imgui_drawStats()
+{
+	ImGui::Text("Shadow update: %.3f ms CPU", statUpdateMs);
+	ImGui::Text("Static cascades re-rendered: %u (total %llu)", statStaticCascades, statTotalStaticCascades);
+	ImGui::Text("Draws: %u static, %u dynamic, %u composites", statStaticDraws, statDynamicDraws, statComposites);
+
+	for (unsigned int i = 0; i < CASCADE_COUNT; i++)
+	{
+		ImGui::Text("  Cascade %u: to %.1f, %.3f/texel, static age %u", i, cascades[i].splitFar, cascades[i].texelWorldSize, cascades[i].staticAge);
+	}
+}
+#endif
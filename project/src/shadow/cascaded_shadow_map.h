@@ -0,0 +1,52 @@
+#pragma once
+#include <glm/glm.hpp>
+
+class CameraBase;
+class DirectionalLight;
+
+// Cascaded shadow maps for one DirectionalLight.
+//
+// CASCADE_COUNT cascades split the camera frustum up to the shadow distance and are
+// packed 2x2 into one depth atlas. Each cascade is a texel-snapped ortho box fitted to
+// the bounding sphere of its frustum slice, padded so it only needs to re-centre after
+// the camera has moved a fair distance.
+//
+// Static casters live in a cached atlas that is only re-rendered for a cascade when it
+// re-centres, the light changes or ShadowCasters::getStaticHash() changes. Each frame the
+// cached depth is copied to the sampled atlas and dynamic casters are drawn on top, only
+// for cascades that contain dynamic casters. A static view therefore costs no draws.
+class CascadedShadowMap
+{
+	CascadedShadowMap() = delete;
+
+public:
+	static const unsigned int CASCADE_COUNT = 4;
+	static const unsigned int CASCADE_RESOLUTION = 1024;
+
+	static const int TEXTURE_UNIT_SHADOW = 12;
+
+	static void init();
+
+	static void setEnabled(bool enabled);
+	static bool isEnabled();
+
+	// Shadows end at min(camera far clip, this)
+	static void setShadowDistance(float distance);
+	// 0 = uniform splits, 1 = logarithmic splits
+	static void setSplitLambda(float lambda);
+
+	// Forces every cached cascade to re-render next update()
+	static void invalidate();
+
+	// Fits the cascades and renders the shadow casters submitted to ShadowCasters this frame.
+	// Changes the bound framebuffer and viewport.
+	static void update(CameraBase* camera, DirectionalLight* light);
+
+	static void bindTexture();
+	static void setShaderProps();
+
+#ifdef XBGT2094_ENABLE_IMGUI
+	static void imgui_drawControls();
+	static void imgui_drawStats();
+#endif
+};
@@ -0,0 +1,627 @@
+#include <glad/glad.h>
+#include "shadow_atlas.h"
+#include "shadow_casters.h"
+#include "../lighting/lights.h"
+#include "../lighting/light_cluster.h"
+#include "../camera/camera_base.h"
+#include "../fbo/fbo_utils.h"
+#include "../framework/simplerenderer.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#ifdef XBGT2094_ENABLE_IMGUI
+#include "../imgui/imgui.h"
+#endif
+
+struct ShadowFace
+{
+	glm::ivec2 origin;
+	glm::mat4 viewProjection;
+	float texelFactor;					// World texel size per unit distance from the light
+	unsigned long long casterHash;
+	bool valid;							// Rendered at least once into its current tile
+	unsigned int lastUpdateFrame;
+};
+
+struct ShadowLight
+{
+	PointLight* light;
+	float coverage;						// Approximate on-screen radius in pixels
+	int tileSize;
+	int faceCount;
+	ShadowFace faces[6];
+	int shadowIndex;
+	bool seen;
+};
+
+// Quadtree node; children are 4 consecutive nodes starting at firstChild
+struct AtlasNode
+{
+	glm::ivec2 origin;
+	int size;
+	int firstChild;
+	bool used;
+};
+
+// Cube face directions in the order the shaders pick them (+X, -X, +Y, -Y, +Z, -Z)
+static const glm::vec3 FACE_DIRECTIONS[6] = { {1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1} };
+static const glm::vec3 FACE_UPS[6] = { {0, -1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}, {0, -1, 0}, {0, -1, 0} };
+
+static DepthFBO* atlas = nullptr;
+static unsigned int faceBuffer = 0, faceTexture = 0;
+
+static std::vector<AtlasNode> nodes;
+static std::vector<int> freeNodeGroups;
+
+static std::vector<ShadowLight> shadowLights;
+static std::unordered_map<PointLight*, int> shadowIndices;
+static std::vector<float> faceData;
+
+static bool enabled = true;
+static unsigned int updateBudget = 8;
+static unsigned int frame = 0;
+
+// Stats
+static unsigned int statFacesUpdated = 0;
+static unsigned int statFacesPending = 0;
+static unsigned int statDraws = 0;
+static unsigned int statTilesUsed = 0;
+static float statUpdateMs = 0.0f;
+
+#pragma region Allocator
+
+static void resetAllocator()
+{
+	nodes.clear();
+	freeNodeGroups.clear();
+	nodes.push_back({ glm::ivec2(0), (int)ShadowAtlas::ATLAS_SIZE, -1, false });
+}
+
+static bool allocateNode(int index, int size, glm::ivec2& origin)
+{
+	// nodes may grow during the recursion, so only indices are held
+	if (nodes[index].used || nodes[index].size < size)
+		return false;
+
+	if (nodes[index].firstChild < 0)
+	{
+		if (nodes[index].size == size)
+		{
+			nodes[index].used = true;
+			origin = nodes[index].origin;
+			return true;
+		}
+
+		int first;
+		if (!freeNodeGroups.empty())
+		{
+			first = freeNodeGroups.back();
+			freeNodeGroups.pop_back();
+		}
+		else
+		{
+			first = (int)nodes.size();
+			nodes.resize(nodes.size() + 4);
+		}
+
+		int half = nodes[index].size / 2;
+		for (int c = 0; c < 4; c++)
+		{
+			glm::ivec2 childOrigin = nodes[index].origin + glm::ivec2(c % 2, c / 2) * half;
+			nodes[first + c] = { childOrigin, half, -1, false };
+		}
+		nodes[index].firstChild = first;
+	}
+
+	int first = nodes[index].firstChild;
+	for (int c = 0; c < 4; c++)
+	{
+		if (allocateNode(first + c, size, origin))
+			return true;
+	}
+
+	return false;
+}
+
+static bool isFreeLeaf(int index)
+{
+	return nodes[index].firstChild < 0 && !nodes[index].used;
+}
+
+static void freeNode(int index, const glm::ivec2& origin, int size)
+{
+	AtlasNode& node = nodes[index];
+
+	if (node.size == size)
+	{
+		if (node.origin == origin)
+			node.used = false;
+		return;
+	}
+
+	if (node.firstChild < 0)
+		return;
+
+	int half = node.size / 2;
+	glm::ivec2 local = (origin - node.origin) / half;
+	freeNode(node.firstChild + local.x + local.y * 2, origin, size);
+
+	// Merge four free children back into one free node
+	int first = nodes[index].firstChild;
+	if (isFreeLeaf(first) && isFreeLeaf(first + 1) && isFreeLeaf(first + 2) && isFreeLeaf(first + 3))
+	{
+		freeNodeGroups.push_back(first);
+		nodes[index].firstChild = -1;
+	}
+}
+
+static bool allocateTiles(ShadowLight& sl, int size)
+{
+	for (int f = 0; f < sl.faceCount; f++)
+	{
+		if (!allocateNode(0, size, sl.faces[f].origin))
+		{
+			for (int g = 0; g < f; g++)
+				freeNode(0, sl.faces[g].origin, size);
+			return false;
+		}
+	}
+
+	sl.tileSize = size;
+	for (int f = 0; f < sl.faceCount; f++)
+	{
+		sl.faces[f].valid = false;
+		sl.faces[f].casterHash = 0;
+		sl.faces[f].lastUpdateFrame = frame;
+	}
+	return true;
+}
+
+static void freeTiles(ShadowLight& sl)
+{
+	if (sl.tileSize == 0)
+		return;
+
+	for (int f = 0; f < sl.faceCount; f++)
+		freeNode(0, sl.faces[f].origin, sl.tileSize);
+
+	sl.tileSize = 0;
+}
+
+#pragma endregion
+
+static void extractPlanes(const glm::mat4& m, glm::vec4 planes[6])
+{
+	glm::vec4 r0(m[0][0], m[1][0], m[2][0], m[3][0]);
+	glm::vec4 r1(m[0][1], m[1][1], m[2][1], m[3][1]);
+	glm::vec4 r2(m[0][2], m[1][2], m[2][2], m[3][2]);
+	glm::vec4 r3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+	planes[0] = r3 + r0; planes[1] = r3 - r0;
+	planes[2] = r3 + r1; planes[3] = r3 - r1;
+	planes[4] = r3 + r2; planes[5] = r3 - r2;
+
+	for (int i = 0; i < 6; i++)
+		planes[i] /= glm::length(glm::vec3(planes[i]));
+}
+
+static bool sphereInPlanes(const glm::vec4 planes[6], const glm::vec3& centre, float radius)
+{
+	for (int i = 0; i < 6; i++)
+	{
+		if (glm::dot(glm::vec3(planes[i]), centre) + planes[i].w < -radius)
+			return false;
+	}
+	return true;
+}
+
+static unsigned int nextPowerOfTwo(float v)
+{
+	unsigned int p = 1;
+	while ((float)p < v && p < ShadowAtlas::MAX_TILE_SIZE)
+		p <<= 1;
+	return p;
+}
+
+static void computeFace(const ShadowLight& sl, int f, glm::mat4& viewProjection, float& texelFactor)
+{
+	PointLight* light = sl.light;
+	glm::vec3 position = light->getPosition();
+	float range = light->getRange();
+	float zNear = std::max(range * 0.01f, 0.02f);
+
+	float fov;
+	glm::mat4 view;
+	if (light->getType() == LightType::SPOT)
+	{
+		SpotLight* spot = static_cast<SpotLight*>(light);
+		glm::vec3 direction = glm::normalize(spot->getDirection());
+		glm::vec3 up = fabsf(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+
+		fov = glm::radians(std::min(spot->getInput_OuterAngle() + 5.0f, 170.0f));
+		view = glm::lookAt(position, position + direction, up);
+	}
+	else
+	{
+		fov = glm::radians(90.0f);
+		view = glm::lookAt(position, position + FACE_DIRECTIONS[f], FACE_UPS[f]);
+	}
+
+	viewProjection = glm::perspective(fov, 1.0f, zNear, range) * view;
+	texelFactor = 2.0f * tanf(fov * 0.5f) / sl.tileSize;
+}
+
+static void renderFace(ShadowLight& sl, int f, const std::vector<const ShadowCaster*>& casters)
+{
+	ShadowFace& face = sl.faces[f];
+
+	glViewport(face.origin.x, face.origin.y, sl.tileSize, sl.tileSize);
+	glScissor(face.origin.x, face.origin.y, sl.tileSize, sl.tileSize);
+	glClear(GL_DEPTH_BUFFER_BIT);
+
+	for (auto caster : casters)
+	{
+		ShadowCasters::draw(*caster, face.viewProjection);
+		statDraws++;
+	}
+
+	face.valid = true;
+	face.lastUpdateFrame = frame;
+	statFacesUpdated++;
+}
+
+void ShadowAtlas::init()
+{
+	if (atlas != nullptr)
+		return;
+
+	DepthFrameBufferConfig cfg;
+	cfg.size = glm::uvec2(ATLAS_SIZE);
+	cfg.depthFormat = DepthFormat::FLOAT24;
+	atlas = FBOUtils::createDepthFBO(cfg);
+
+	glBindTexture(GL_TEXTURE_2D, atlas->getDepthAttachment()->getNativeHandle());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenBuffers(1, &faceBuffer);
+	glGenTextures(1, &faceTexture);
+
+	glBindBuffer(GL_TEXTURE_BUFFER, faceBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+	glBindTexture(GL_TEXTURE_BUFFER, faceTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, faceBuffer);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	resetAllocator();
+}
+
+void ShadowAtlas::setEnabled(bool enable)
+{
+	enabled = enable;
+}
+
+bool ShadowAtlas::isEnabled()
+{
+	return enabled;
+}
+
+void ShadowAtlas::setUpdateBudget(unsigned int faces)
+{
+	updateBudget = std::max(faces, 1u);
+}
+
+void ShadowAtlas::invalidate()
+{
+	shadowLights.clear();
+	shadowIndices.clear();
+	resetAllocator();
+}
+
+void ShadowAtlas::update(CameraBase* camera, const glm::ivec2& viewportSize)
+{
+	init();
+
+	frame++;
+	statFacesUpdated = 0;
+	statFacesPending = 0;
+	statDraws = 0;
+
+	shadowIndices.clear();
+
+	if (!enabled)
+		return;
+
+	auto timeStart = std::chrono::high_resolution_clock::now();
+
+	// 1. Rank visible shadow-casting lights by screen coverage
+	glm::vec4 cameraPlanes[6];
+	extractPlanes(camera->getMatrixVP(), cameraPlanes);
+
+	glm::vec3 cameraPosition = camera->getPosition();
+	float tanHalfFov = 1.0f / camera->getProjectionMatrix()[1][1];
+
+	struct Candidate { PointLight* light; float coverage; };
+	std::vector<Candidate> candidates;
+
+	for (PointLight* light : LightCluster::getLights())
+	{
+		if (!light->getCastShadows() || !light->isEnabled() || light->getRange() <= 0.0f)
+			continue;
+
+		glm::vec3 position = light->getPosition();
+		float range = light->getRange();
+		if (!sphereInPlanes(cameraPlanes, position, range))
+			continue;
+
+		float distance = glm::length(position - cameraPosition);
+		float coverage = distance <= range
+			? (float)MAX_TILE_SIZE
+			: range / (distance * tanHalfFov) * viewportSize.y * 0.5f;
+
+		candidates.push_back({ light, coverage });
+	}
+
+	std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.coverage > b.coverage; });
+	if (candidates.size() > MAX_SHADOWED_LIGHTS)
+		candidates.resize(MAX_SHADOWED_LIGHTS);
+
+	// 2. Drop lights that lost their place, keep the rest in rank order
+	for (auto& sl : shadowLights)
+		sl.seen = false;
+
+	std::vector<ShadowLight> ranked;
+	ranked.reserve(candidates.size());
+	for (auto& c : candidates)
+	{
+		auto it = std::find_if(shadowLights.begin(), shadowLights.end(), [&](const ShadowLight& sl) { return sl.light == c.light; });
+		if (it != shadowLights.end())
+		{
+			it->seen = true;
+			it->coverage = c.coverage;
+			ranked.push_back(*it);
+		}
+		else
+		{
+			ShadowLight sl = {};
+			sl.light = c.light;
+			sl.coverage = c.coverage;
+			sl.faceCount = c.light->getType() == LightType::SPOT ? 1 : 6;
+			ranked.push_back(sl);
+		}
+	}
+
+	for (auto& sl : shadowLights)
+	{
+		if (!sl.seen)
+			freeTiles(sl);
+	}
+
+	// 3. Size tiles from coverage. Grow as soon as needed, shrink only once well below,
+	//    so lights near a size boundary do not re-render every frame.
+	for (auto& sl : ranked)
+	{
+		int desired = (int)std::max(nextPowerOfTwo(sl.coverage), MIN_TILE_SIZE);
+		int shrinkTo = (int)std::max(nextPowerOfTwo(sl.coverage * 2.0f), MIN_TILE_SIZE);
+
+		if (sl.tileSize != 0 && desired <= sl.tileSize && shrinkTo >= sl.tileSize)
+			continue;
+
+		int previous = sl.tileSize;
+		freeTiles(sl);
+
+		bool allocated = false;
+		for (int size = desired; size >= (int)MIN_TILE_SIZE && !allocated; size /= 2)
+			allocated = allocateTiles(sl, size);
+
+		// Atlas full: keep the old tiles if they can still be had
+		if (!allocated && previous != 0)
+			allocateTiles(sl, previous);
+	}
+
+	// 4. Find faces whose matrix or casters changed
+	const auto& casters = ShadowCasters::getCasters();
+
+	struct DirtyFace
+	{
+		int light, face;
+		float priority;
+		glm::mat4 viewProjection;
+		float texelFactor;
+		unsigned long long casterHash;
+		std::vector<const ShadowCaster*> casters;
+	};
+	std::vector<DirtyFace> dirtyFaces;
+
+	for (int i = 0; i < (int)ranked.size(); i++)
+	{
+		auto& sl = ranked[i];
+		if (sl.tileSize == 0)
+			continue;
+
+		for (int f = 0; f < sl.faceCount; f++)
+		{
+			ShadowFace& face = sl.faces[f];
+
+			DirtyFace dirty;
+			dirty.light = i;
+			dirty.face = f;
+			computeFace(sl, f, dirty.viewProjection, dirty.texelFactor);
+
+			glm::vec4 planes[6];
+			extractPlanes(dirty.viewProjection, planes);
+
+			dirty.casterHash = 14695981039346656037ull;
+			for (auto& caster : casters)
+			{
+				if (!sphereInPlanes(planes, caster.centre, caster.radius))
+					continue;
+
+				dirty.casters.push_back(&caster);
+				dirty.casterHash = (dirty.casterHash ^ caster.hash) * 1099511628211ull;
+
+				// Dynamic casters can animate in their vertex shader (the fan) with the same
+				// model matrix, so faces holding one are re-rendered every frame
+				if (!caster.isStatic)
+					dirty.casterHash = (dirty.casterHash ^ frame) * 1099511628211ull;
+			}
+
+			if (face.valid && dirty.viewProjection == face.viewProjection && dirty.casterHash == face.casterHash)
+				continue;
+
+			// Faces without any shadow yet go first, then big lights that have waited longest
+			dirty.priority = (face.valid ? 0.0f : 1e9f) + sl.coverage * (1.0f + (frame - face.lastUpdateFrame));
+			dirtyFaces.push_back(dirty);
+		}
+	}
+
+	// Faces over budget keep their previous matrix and depth, which stay consistent
+	// with each other, and are scheduled again next frame.
+	std::sort(dirtyFaces.begin(), dirtyFaces.end(), [](const DirtyFace& a, const DirtyFace& b) { return a.priority > b.priority; });
+
+	// 5. Render within budget
+	if (!dirtyFaces.empty())
+	{
+		SimpleRenderer::bindFBO(atlas);
+		ShadowCasters::beginDepthPass();
+
+		for (unsigned int i = 0; i < dirtyFaces.size() && i < updateBudget; i++)
+		{
+			auto& dirty = dirtyFaces[i];
+			ShadowFace& face = ranked[dirty.light].faces[dirty.face];
+
+			face.viewProjection = dirty.viewProjection;
+			face.texelFactor = dirty.texelFactor;
+			face.casterHash = dirty.casterHash;
+			renderFace(ranked[dirty.light], dirty.face, dirty.casters);
+		}
+
+		ShadowCasters::endDepthPass();
+		SimpleRenderer::bindFBO_Default();
+	}
+	statFacesPending = dirtyFaces.size() > updateBudget ? (unsigned int)dirtyFaces.size() - updateBudget : 0;
+
+	shadowLights.swap(ranked);
+
+	// 6. Face table for the shaders; a light is shadowed once all its faces are valid
+	faceData.clear();
+	statTilesUsed = 0;
+	float atlasScale = 1.0f / ATLAS_SIZE;
+
+	for (auto& sl : shadowLights)
+	{
+		sl.shadowIndex = -1;
+		if (sl.tileSize == 0)
+			continue;
+
+		statTilesUsed += sl.faceCount;
+
+		bool ready = true;
+		for (int f = 0; f < sl.faceCount; f++)
+			ready = ready && sl.faces[f].valid;
+
+		if (!ready)
+			continue;
+
+		sl.shadowIndex = (int)(faceData.size() / (FACE_TEXELS * 4));
+		shadowIndices[sl.light] = sl.shadowIndex;
+
+		for (int f = 0; f < sl.faceCount; f++)
+		{
+			const ShadowFace& face = sl.faces[f];
+			const float* m = &face.viewProjection[0][0];
+			faceData.insert(faceData.end(), m, m + 16);
+
+			faceData.push_back(face.origin.x * atlasScale);
+			faceData.push_back(face.origin.y * atlasScale);
+			faceData.push_back(sl.tileSize * atlasScale);
+			faceData.push_back(face.texelFactor);
+		}
+	}
+
+	glBindBuffer(GL_TEXTURE_BUFFER, faceBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, std::max(faceData.size() * sizeof(float), (size_t)16), nullptr, GL_STREAM_DRAW);
+	if (!faceData.empty())
+		glBufferSubData(GL_TEXTURE_BUFFER, 0, faceData.size() * sizeof(float), faceData.data());
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	auto timeEnd = std::chrono::high_resolution_clock::now();
+	float ms = std::chrono::duration<float, std::milli>(timeEnd - timeStart).count();
+	statUpdateMs = statUpdateMs * 0.9f + ms * 0.1f;
+}
+
+int ShadowAtlas::getShadowIndex(PointLight* light)
+{
+	auto it = shadowIndices.find(light);
+	return it != shadowIndices.end() ? it->second : -1;
+}
+
+void ShadowAtlas::bindTextures()
+{
+	init();
+
+	glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT_ATLAS);
+	glBindTexture(GL_TEXTURE_2D, atlas->getDepthAttachment()->getNativeHandle());
+	glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT_FACES);
+	glBindTexture(GL_TEXTURE_BUFFER, faceTexture);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+void ShadowAtlas::setShaderProps()
+{
+	SimpleRenderer::setShaderProp_Bool("enablePointShadows", enabled);
+	SimpleRenderer::setShaderProp_Integer("pointShadowAtlas", TEXTURE_UNIT_ATLAS);
+	SimpleRenderer::setShaderProp_Integer("pointShadowFaces", TEXTURE_UNIT_FACES);
+	SimpleRenderer::setShaderProp_Float("pointShadowAtlasTexelSize", 1.0f / ATLAS_SIZE);
+}
+
+#ifdef XBGT2094_ENABLE_IMGUI
+// ImGui samples with a plain sampler2D, so depth comparison is switched off around the preview
+static void imgui_setCompareMode(const ImDrawList*, const ImDrawCmd* cmd)
+{
+	glBindTexture(GL_TEXTURE_2D, atlas->getDepthAttachment()->getNativeHandle());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, cmd->UserCallbackData ? GL_COMPARE_REF_TO_TEXTURE : GL_NONE);
+}
+
+void ShadowAtlas::imgui_drawControls()
+{
+	ImGui::Checkbox("Point/Spot Shadows", &enabled);
+
+	int budget = (int)updateBudget;
+	ImGui::TextColored(ImVec4(0.0f, 0.8f, 1.0f, 1.0f), "   Faces per frame");
+	if (ImGui::SliderInt("SliderS3", &budget, 1, 48))
+		setUpdateBudget((unsigned int)budget);
+}
+
+void ShadowAtlas::imgui_drawStats()
+{
+	ImGui::Text("Shadow atlas: %.3f ms CPU, %u tiles", statUpdateMs, statTilesUsed);
+	ImGui::Text("Faces: %u updated, %u waiting, %u draws", statFacesUpdated, statFacesPending, statDraws);
+
+	if (atlas == nullptr)
+		return;
+
+	ImDrawList* drawList = ImGui::GetWindowDrawList();
+	drawList->AddCallback(imgui_setCompareMode, nullptr);
+	ImGui::Image((ImTextureID)(size_t)atlas->getDepthAttachment()->getNativeHandle(), ImVec2(200, 200), ImVec2(0, 1), ImVec2(1, 0));
+	drawList->AddCallback(imgui_setCompareMode, (void*)1);
+	drawList->AddCallback(ImDrawCallback_ResetRenderState, nullptr);
+
+	for (auto& sl : shadowLights)
+	{
+		unsigned int oldest = 0;
+		for (int f = 0; f < sl.faceCount; f++)
+			oldest = std::max(oldest, frame - sl.faces[f].lastUpdateFrame);
+
+		ImGui::Text("  %-22s %4d px x%d  age %u%s", sl.light->getName().c_str(), sl.tileSize, sl.faceCount, oldest, sl.shadowIndex < 0 ? " (pending)" : "");
+	}
+}
+#endif
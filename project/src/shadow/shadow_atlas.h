@@ -0,0 +1,58 @@
+#pragma once
+#include <glm/glm.hpp>
+
+class CameraBase;
+class PointLight;
+
+// Shadows for point and spot lights, packed into one depth atlas.
+//
+// Every frame the visible lights with getCastShadows() are ranked by screen coverage and
+// the top MAX_SHADOWED_LIGHTS get square tiles from a quadtree allocator, sized to that
+// coverage (one tile per spot light, six cube faces per point light).
+//
+// A face is re-rendered only when its light moved or the hash of the casters inside its
+// frustum changed, and at most the update budget of faces is rendered per frame; the rest
+// keep their previous contents. Static lights over static geometry render once.
+//
+// Per-face matrices and tile rects go to a texture buffer (FACE_TEXELS RGBA32F texels per
+// face); the light cluster stores each light's first face index for the shaders.
+class ShadowAtlas
+{
+	ShadowAtlas() = delete;
+
+public:
+	static const unsigned int ATLAS_SIZE = 4096;
+	static const unsigned int MIN_TILE_SIZE = 64;
+	static const unsigned int MAX_TILE_SIZE = 1024;
+	static const unsigned int MAX_SHADOWED_LIGHTS = 32;
+	static const unsigned int FACE_TEXELS = 5;
+
+	static const int TEXTURE_UNIT_ATLAS = 10;
+	static const int TEXTURE_UNIT_FACES = 11;
+
+	static void init();
+
+	static void setEnabled(bool enabled);
+	static bool isEnabled();
+
+	// Maximum shadow faces rendered per frame
+	static void setUpdateBudget(unsigned int faces);
+
+	// Drops every tile; all shadows are re-allocated and re-rendered over the next frames
+	static void invalidate();
+
+	// Allocates tiles and renders the scheduled faces using the casters submitted to
+	// ShadowCasters this frame. Call before LightCluster::update(). Changes the bound framebuffer.
+	static void update(CameraBase* camera, const glm::ivec2& viewportSize);
+
+	// First face of this light in the face buffer, -1 if it has no usable shadow
+	static int getShadowIndex(PointLight* light);
+
+	static void bindTextures();
+	static void setShaderProps();
+
+#ifdef XBGT2094_ENABLE_IMGUI
+	static void imgui_drawControls();
+	static void imgui_drawStats();
+#endif
+};
@@ -0,0 +1,99 @@
+#include "shadow_casters.h"
+#include <glad/glad.h>
+#include "../framework/simplerenderer.h"
+#include "../framework/simpleapp.h"
+#include "../mesh/mesh.h"
+#include "../texture/texture_utils.h"
+
+static std::vector<ShadowCaster> CASTERS;
+static unsigned long long STATIC_HASH = 0;
+
+// FNV-1a
+static void hashBytes(unsigned long long& hash, const void* data, size_t size)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+}
+
+void ShadowCasters::clear()
+{
+	CASTERS.clear();
+	STATIC_HASH = 14695981039346656037ull;
+}
+
+void ShadowCasters::add(Mesh* mesh, Shader* depthShader, Texture2D* alphaTexture, const glm::mat4& model, bool isStatic)
+{
+	ShadowCaster caster;
+	caster.mesh = mesh;
+	caster.depthShader = depthShader;
+	caster.alphaTexture = alphaTexture;
+	caster.model = model;
+	caster.isStatic = isStatic;
+
+	// Sphere around the object-space box, scaled by the largest axis scale
+	glm::vec3 localCentre = (mesh->boundsMin + mesh->boundsMax) * 0.5f;
+	float localRadius = glm::length(mesh->boundsMax - mesh->boundsMin) * 0.5f;
+	float maxScale = glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+
+	caster.centre = glm::vec3(model * glm::vec4(localCentre, 1.0f));
+	caster.radius = localRadius * maxScale;
+
+	caster.hash = 14695981039346656037ull;
+	hashBytes(caster.hash, &mesh, sizeof(mesh));
+	hashBytes(caster.hash, &alphaTexture, sizeof(alphaTexture));
+	hashBytes(caster.hash, &model[0][0], sizeof(glm::mat4));
+
+	if (isStatic)
+		hashBytes(STATIC_HASH, &caster.hash, sizeof(caster.hash));
+
+	CASTERS.push_back(caster);
+}
+
+const std::vector<ShadowCaster>& ShadowCasters::getCasters()
+{
+	return CASTERS;
+}
+
+unsigned long long ShadowCasters::getStaticHash()
+{
+	return STATIC_HASH;
+}
+
+void ShadowCasters::draw(const ShadowCaster& caster, const glm::mat4& lightViewProjection)
+{
+	SimpleRenderer::bindShader(caster.depthShader);
+
+	SimpleRenderer::setShaderProp_Mat4("projection", lightViewProjection);
+	SimpleRenderer::setShaderProp_Mat4("view", glm::mat4(1.0f));
+	SimpleRenderer::setShaderProp_Mat4("model", caster.model);
+	SimpleRenderer::setShaderProp_Float("time", App::getTime());
+
+	SimpleRenderer::setTexture_0(caster.alphaTexture ? caster.alphaTexture : TextureUtils::whiteTexture2D());
+
+	SimpleRenderer::drawMesh(caster.mesh);
+}
+
+void ShadowCasters::beginDepthPass()
+{
+	glEnable(GL_DEPTH_TEST);
+	glDepthMask(GL_TRUE);
+	glDepthFunc(GL_LESS);
+
+	// Leaves and thin geometry are double sided; slope-scaled bias handles acne instead of culling
+	glDisable(GL_CULL_FACE);
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(2.0f, 4.0f);
+
+	glEnable(GL_SCISSOR_TEST);
+}
+
+void ShadowCasters::endDepthPass()
+{
+	glDisable(GL_SCISSOR_TEST);
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	glEnable(GL_CULL_FACE);
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+class Mesh;
+class Shader;
+class Texture2D;
+
+struct ShadowCaster
+{
+	Mesh* mesh;
+	Shader* depthShader;
+	Texture2D* alphaTexture;	// Alpha tested in the depth pass, may be null
+	glm::mat4 model;
+	bool isStatic;				// Static casters are cached by the shadow maps
+
+	// Filled in by ShadowCasters::add()
+	glm::vec3 centre;			// World-space bounding sphere
+	float radius;
+	unsigned long long hash;	// Of mesh, alpha texture and model matrix
+};
+
+// The shadow casters of the current frame, shared by every shadow map.
+//
+// The scene submits its casters once per frame; the shadow maps cull them per view and
+// use getStaticHash() to notice when static geometry changed and their caches are stale.
+class ShadowCasters
+{
+	ShadowCasters() = delete;
+
+public:
+	static void clear();
+	static void add(Mesh* mesh, Shader* depthShader, Texture2D* alphaTexture, const glm::mat4& model, bool isStatic);
+
+	static const std::vector<ShadowCaster>& getCasters();
+
+	// Changes whenever a static caster is added, removed, moved or swapped
+	static unsigned long long getStaticHash();
+
+	// Draws one caster with its depth shader into the currently bound target
+	static void draw(const ShadowCaster& caster, const glm::mat4& lightViewProjection);
+
+	// Per-pass render state for depth rendering
+	static void beginDepthPass();
+	static void endDepthPass();
+};
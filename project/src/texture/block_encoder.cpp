@@ -0,0 +1,209 @@
+#include "block_encoder.h"
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+
+// 4x4 texels, clamped at the image edge
+static void fetchBlock(const unsigned char* rgba, int width, int height, int bx, int by, unsigned char block[16][4])
+{
+	for (int y = 0; y < 4; y++)
+	{
+		int sy = std::min(by * 4 + y, height - 1);
+		for (int x = 0; x < 4; x++)
+		{
+			int sx = std::min(bx * 4 + x, width - 1);
+			memcpy(block[y * 4 + x], rgba + ((size_t)sy * width + sx) * 4, 4);
+		}
+	}
+}
+
+static unsigned short packRGB565(const int c[3])
+{
+	return (unsigned short)(((c[0] >> 3) << 11) | ((c[1] >> 2) << 5) | (c[2] >> 3));
+}
+
+static void unpackRGB565(unsigned short v, int c[3])
+{
+	int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+	c[0] = (r << 3) | (r >> 2);
+	c[1] = (g << 2) | (g >> 4);
+	c[2] = (b << 3) | (b >> 2);
+}
+
+static void writeLE16(unsigned char* out, unsigned int v)
+{
+	out[0] = (unsigned char)(v & 0xff);
+	out[1] = (unsigned char)((v >> 8) & 0xff);
+}
+
+// 8 bytes: two 565 endpoints, then 2-bit indices. Always 4-colour mode (colour0 > colour1).
+static void encodeColourBlock(const unsigned char block[16][4], unsigned char* out)
+{
+	int minC[3] = { 255, 255, 255 }, maxC[3] = { 0, 0, 0 };
+	int centre[3] = { 0, 0, 0 };
+	for (int i = 0; i < 16; i++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			minC[c] = std::min(minC[c], (int)block[i][c]);
+			maxC[c] = std::max(maxC[c], (int)block[i][c]);
+			centre[c] += block[i][c];
+		}
+	}
+
+	// Pick the box diagonal the colours actually lie along (covariance of G and B against R)
+	int covG = 0, covB = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		int r = block[i][0] * 16 - centre[0];
+		covG += r * (block[i][1] * 16 - centre[1]);
+		covB += r * (block[i][2] * 16 - centre[2]);
+	}
+	if (covG < 0) std::swap(minC[1], maxC[1]);
+	if (covB < 0) std::swap(minC[2], maxC[2]);
+
+	// Inset by 1/16 of the range, which lowers the error of the interpolated colours
+	for (int c = 0; c < 3; c++)
+	{
+		int inset = (maxC[c] - minC[c]) / 16;
+		minC[c] += inset;
+		maxC[c] -= inset;
+	}
+
+	unsigned short c0 = packRGB565(maxC);
+	unsigned short c1 = packRGB565(minC);
+	if (c0 < c1) std::swap(c0, c1);
+
+	writeLE16(out + 0, c0);
+	writeLE16(out + 2, c1);
+
+	unsigned int indices = 0;
+	if (c0 != c1)
+	{
+		int palette[4][3];
+		unpackRGB565(c0, palette[0]);
+		unpackRGB565(c1, palette[1]);
+		for (int c = 0; c < 3; c++)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+
+		for (int i = 0; i < 16; i++)
+		{
+			int best = 0, bestError = 1 << 30;
+			for (int p = 0; p < 4; p++)
+			{
+				int dr = block[i][0] - palette[p][0], dg = block[i][1] - palette[p][1], db = block[i][2] - palette[p][2];
+				int error = dr * dr + dg * dg + db * db;
+				if (error < bestError)
+				{
+					best = p;
+					bestError = error;
+				}
+			}
+			indices |= (unsigned int)best << (i * 2);
+		}
+	}
+
+	out[4] = (unsigned char)(indices & 0xff);
+	out[5] = (unsigned char)((indices >> 8) & 0xff);
+	out[6] = (unsigned char)((indices >> 16) & 0xff);
+	out[7] = (unsigned char)((indices >> 24) & 0xff);
+}
+
+// 8 bytes: two 8-bit endpoints, then 3-bit indices. 8-value mode (value0 > value1).
+static void encodeChannelBlock(const unsigned char block[16][4], int channel, unsigned char* out)
+{
+	int minV = 255, maxV = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		minV = std::min(minV, (int)block[i][channel]);
+		maxV = std::max(maxV, (int)block[i][channel]);
+	}
+
+	out[0] = (unsigned char)maxV;
+	out[1] = (unsigned char)minV;
+
+	unsigned long long indices = 0;
+	if (maxV != minV)
+	{
+		// Index 0 = max, 1 = min, 2..7 step from max towards min
+		int palette[8];
+		palette[0] = maxV;
+		palette[1] = minV;
+		for (int p = 1; p < 7; p++)
+			palette[p + 1] = ((7 - p) * maxV + p * minV) / 7;
+
+		for (int i = 0; i < 16; i++)
+		{
+			int best = 0, bestError = 1 << 30;
+			for (int p = 0; p < 8; p++)
+			{
+				int error = std::abs(block[i][channel] - palette[p]);
+				if (error < bestError)
+				{
+					best = p;
+					bestError = error;
+				}
+			}
+			indices |= (unsigned long long)best << (i * 3);
+		}
+	}
+
+	for (int b = 0; b < 6; b++)
+		out[2 + b] = (unsigned char)((indices >> (b * 8)) & 0xff);
+}
+
+template <typename BlockFunc>
+static std::vector<unsigned char> encodeBlocks(const unsigned char* rgba, int width, int height, size_t blockBytes, BlockFunc encodeBlock)
+{
+	int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+	std::vector<unsigned char> out((size_t)blocksX * blocksY * blockBytes);
+
+	unsigned char block[16][4];
+	for (int by = 0; by < blocksY; by++)
+	{
+		for (int bx = 0; bx < blocksX; bx++)
+		{
+			fetchBlock(rgba, width, height, bx, by, block);
+			encodeBlock(block, &out[((size_t)by * blocksX + bx) * blockBytes]);
+		}
+	}
+
+	return out;
+}
+
+std::vector<unsigned char> BlockEncoder::encodeBC1(const unsigned char* rgba, int width, int height)
+{
+	return encodeBlocks(rgba, width, height, 8, [](const unsigned char block[16][4], unsigned char* out)
+	{
+		encodeColourBlock(block, out);
+	});
+}
+
+std::vector<unsigned char> BlockEncoder::encodeBC3(const unsigned char* rgba, int width, int height)
+{
+	return encodeBlocks(rgba, width, height, 16, [](const unsigned char block[16][4], unsigned char* out)
+	{
+		encodeChannelBlock(block, 3, out);
+		encodeColourBlock(block, out + 8);
+	});
+}
+
+std::vector<unsigned char> BlockEncoder::encodeBC4(const unsigned char* rgba, int width, int height, int channel)
+{
+	return encodeBlocks(rgba, width, height, 8, [channel](const unsigned char block[16][4], unsigned char* out)
+	{
+		encodeChannelBlock(block, channel, out);
+	});
+}
+
+std::vector<unsigned char> BlockEncoder::encodeBC5(const unsigned char* rgba, int width, int height)
+{
+	return encodeBlocks(rgba, width, height, 16, [](const unsigned char block[16][4], unsigned char* out)
+	{
+		encodeChannelBlock(block, 0, out);
+		encodeChannelBlock(block, 1, out + 8);
+	});
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <vector>
+
+// CPU encoders for the desktop block compression formats, 4x4 texels per block.
+// Input is tightly packed RGBA8; edges of images that aren't a multiple of 4 repeat the
+// last row/column. Endpoints come from the block's (inset) bounding box along its main
+// diagonal, which is fast and good enough for a first-run cache.
+//
+//		BC1		RGB, 8 bytes per block (4 bpp)
+//		BC3		RGBA, BC1 colour + BC4 alpha, 16 bytes per block (8 bpp)
+//		BC4		one channel, 8 bytes per block (4 bpp)
+//		BC5		two channels, two BC4 blocks, 16 bytes per block (8 bpp)
+class BlockEncoder
+{
+public:
+	BlockEncoder() = delete;
+
+	static std::vector<unsigned char> encodeBC1(const unsigned char* rgba, int width, int height);
+	static std::vector<unsigned char> encodeBC3(const unsigned char* rgba, int width, int height);
+	// channel: 0 = R, 1 = G, 2 = B, 3 = A
+	static std::vector<unsigned char> encodeBC4(const unsigned char* rgba, int width, int height, int channel);
+	// R and G
+	static std::vector<unsigned char> encodeBC5(const unsigned char* rgba, int width, int height);
+};
@@ -0,0 +1,322 @@
+#include "mip_generator.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MIP_GENERATOR_SSE2
+#endif
+
+static const int MAX_TAPS = 8;
+
+// 2:1 filter kernel; tap t reads source texel 2 * x + offset + t
+struct MipKernel
+{
+	int offset;
+	int taps;
+	float weights[MAX_TAPS];
+};
+
+// Zeroth order modified Bessel function of the first kind, for the Kaiser window
+static double besselI0(double x)
+{
+	double sum = 1.0, term = 1.0;
+	for (int k = 1; k < 20; k++)
+	{
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+	}
+	return sum;
+}
+
+static MipKernel makeKernel(MipFilter filter)
+{
+	MipKernel kernel;
+	if (filter == MipFilter::BOX)
+	{
+		kernel.offset = 0;
+		kernel.taps = 2;
+		kernel.weights[0] = kernel.weights[1] = 0.5f;
+		return kernel;
+	}
+
+	// Sinc windowed over 2 destination texels either side; beta = 4 keeps the ringing low
+	const double PI = 3.14159265358979323846;
+	const double radius = 2.0, beta = 4.0;
+	kernel.offset = -3;
+	kernel.taps = 8;
+
+	double sum = 0.0;
+	double weights[MAX_TAPS];
+	for (int t = 0; t < kernel.taps; t++)
+	{
+		// Distance from the destination texel centre, in destination texels
+		double x = ((kernel.offset + t) - 0.5) / 2.0;
+		double sinc = std::abs(x) < 1e-6 ? 1.0 : std::sin(PI * x) / (PI * x);
+		double r = x / radius;
+		double window = std::abs(r) >= 1.0 ? 0.0 : besselI0(beta * std::sqrt(1.0 - r * r)) / besselI0(beta);
+		weights[t] = sinc * window;
+		sum += weights[t];
+	}
+
+	for (int t = 0; t < kernel.taps; t++)
+		kernel.weights[t] = (float)(weights[t] / sum);
+	return kernel;
+}
+
+struct SRGBTables
+{
+	float toLinear[256];
+	unsigned char fromLinear[4096];
+
+	SRGBTables()
+	{
+		for (int i = 0; i < 256; i++)
+		{
+			float c = i / 255.0f;
+			toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+		}
+		for (int i = 0; i < 4096; i++)
+		{
+			float l = i / 4095.0f;
+			float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+			fromLinear[i] = (unsigned char)(std::min(std::max(c, 0.0f), 1.0f) * 255.0f + 0.5f);
+		}
+	}
+};
+
+static const SRGBTables& getSRGBTables()
+{
+	static SRGBTables tables;
+	return tables;
+}
+
+// Weighted sum of whole texels (4 floats each)
+static inline void sumTexels(const float* src, const int* index, const float* weights, int taps, float* out)
+{
+#ifdef MIP_GENERATOR_SSE2
+	__m128 sum = _mm_setzero_ps();
+	for (int t = 0; t < taps; t++)
+		sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(src + index[t]), _mm_set1_ps(weights[t])));
+	_mm_storeu_ps(out, sum);
+#else
+	float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for (int t = 0; t < taps; t++)
+	{
+		for (int c = 0; c < 4; c++)
+			sum[c] += src[index[t] + c] * weights[t];
+	}
+	memcpy(out, sum, sizeof(sum));
+#endif
+}
+
+// dst += src * weight over count floats (a multiple of 4)
+static inline void addScaledRow(float* dst, const float* src, float weight, size_t count)
+{
+#ifdef MIP_GENERATOR_SSE2
+	__m128 w = _mm_set1_ps(weight);
+	for (size_t i = 0; i < count; i += 4)
+		_mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(_mm_loadu_ps(src + i), w)));
+#else
+	for (size_t i = 0; i < count; i++)
+		dst[i] += src[i] * weight;
+#endif
+}
+
+static inline int sampleIndex(int i, int size, bool wrap)
+{
+	if (wrap)
+		return ((i % size) + size) % size;
+	return std::min(std::max(i, 0), size - 1);
+}
+
+// Separable 2:1 downsample of a float RGBA image
+static void downsample(const std::vector<float>& src, int width, int height, const MipKernel& kernel, bool wrap,
+	std::vector<float>& dst, int dstWidth, int dstHeight)
+{
+	// Horizontal into rows of dstWidth texels
+	std::vector<float> rows((size_t)dstWidth * height * 4);
+	std::vector<int> index((size_t)dstWidth * kernel.taps);
+	for (int x = 0; x < dstWidth; x++)
+	{
+		for (int t = 0; t < kernel.taps; t++)
+			index[(size_t)x * kernel.taps + t] = sampleIndex(x * 2 + kernel.offset + t, width, wrap) * 4;
+	}
+
+	for (int y = 0; y < height; y++)
+	{
+		const float* srcRow = &src[(size_t)y * width * 4];
+		float* outRow = &rows[(size_t)y * dstWidth * 4];
+		for (int x = 0; x < dstWidth; x++)
+			sumTexels(srcRow, &index[(size_t)x * kernel.taps], kernel.weights, kernel.taps, outRow + x * 4);
+	}
+
+	// Vertical, whole rows at a time
+	size_t rowFloats = (size_t)dstWidth * 4;
+	dst.assign(rowFloats * dstHeight, 0.0f);
+	for (int y = 0; y < dstHeight; y++)
+	{
+		float* outRow = &dst[(size_t)y * rowFloats];
+		for (int t = 0; t < kernel.taps; t++)
+		{
+			int sy = sampleIndex(y * 2 + kernel.offset + t, height, wrap);
+			addScaledRow(outRow, &rows[(size_t)sy * rowFloats], kernel.weights[t], rowFloats);
+		}
+	}
+}
+
+static float getCoverage(const std::vector<float>& texels, float cutoff, float scale)
+{
+	size_t count = texels.size() / 4, passed = 0;
+	for (size_t i = 0; i < count; i++)
+		passed += texels[i * 4 + 3] * scale > cutoff ? 1 : 0;
+	return (float)passed / count;
+}
+
+// Alpha scale that makes this level pass the alpha test over the same share of texels as level 0
+static float getCoverageScale(const std::vector<float>& texels, float cutoff, float targetCoverage)
+{
+	float lo = 0.0f, hi = 1.0f, ref = cutoff;
+	for (int i = 0; i < 12; i++)
+	{
+		ref = (lo + hi) * 0.5f;
+		if (getCoverage(texels, ref, 1.0f) > targetCoverage)
+			lo = ref;
+		else
+			hi = ref;
+	}
+	return ref > 0.0f ? cutoff / ref : 1.0f;
+}
+
+static inline unsigned char toByte(float v)
+{
+	return (unsigned char)(std::min(std::max(v, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+static void toFloat(const unsigned char* rgba, size_t count, MipContent content, std::vector<float>& out)
+{
+	const SRGBTables& srgb = getSRGBTables();
+	out.resize(count * 4);
+	for (size_t i = 0; i < count * 4; i += 4)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			switch (content)
+			{
+			case MipContent::COLOUR_SRGB: out[i + c] = srgb.toLinear[rgba[i + c]]; break;
+			case MipContent::LINEAR: out[i + c] = rgba[i + c] / 255.0f; break;
+			case MipContent::NORMAL: out[i + c] = rgba[i + c] / 127.5f - 1.0f; break;
+			}
+		}
+		out[i + 3] = rgba[i + 3] / 255.0f;
+	}
+}
+
+static void toBytes(const std::vector<float>& texels, MipContent content, float alphaScale, std::vector<unsigned char>& out)
+{
+	const SRGBTables& srgb = getSRGBTables();
+	out.resize(texels.size());
+	for (size_t i = 0; i < texels.size(); i += 4)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			float v = texels[i + c];
+			switch (content)
+			{
+			case MipContent::COLOUR_SRGB: out[i + c] = srgb.fromLinear[(int)(std::min(std::max(v, 0.0f), 1.0f) * 4095.0f + 0.5f)]; break;
+			case MipContent::LINEAR: out[i + c] = toByte(v); break;
+			case MipContent::NORMAL: out[i + c] = toByte(v * 0.5f + 0.5f); break;
+			}
+		}
+		out[i + 3] = toByte(texels[i + 3] * alphaScale);
+	}
+}
+
+// Keeps the Kaiser filter's overshoot from building up level after level
+static void clampLevel(std::vector<float>& texels, MipContent content)
+{
+	float lo = content == MipContent::NORMAL ? -1.0f : 0.0f;
+	for (size_t i = 0; i < texels.size(); i += 4)
+	{
+		for (int c = 0; c < 3; c++)
+			texels[i + c] = std::min(std::max(texels[i + c], lo), 1.0f);
+		texels[i + 3] = std::min(std::max(texels[i + 3], 0.0f), 1.0f);
+	}
+
+	if (content != MipContent::NORMAL)
+		return;
+
+	for (size_t i = 0; i < texels.size(); i += 4)
+	{
+		float x = texels[i], y = texels[i + 1], z = texels[i + 2];
+		float length = std::sqrt(x * x + y * y + z * z);
+		if (length > 1e-6f)
+		{
+			texels[i] = x / length;
+			texels[i + 1] = y / length;
+			texels[i + 2] = z / length;
+		}
+		else
+		{
+			texels[i] = texels[i + 1] = 0.0f;
+			texels[i + 2] = 1.0f;
+		}
+	}
+}
+
+std::shared_ptr<TextureMipChain> MipGenerator::generate(const unsigned char* rgba, int width, int height, const MipSettings& settings)
+{
+	std::shared_ptr<TextureMipChain> chain = baseLevel(rgba, width, height);
+
+	MipKernel kernel = makeKernel(settings.filter);
+	bool preserveCoverage = settings.alphaCutoff > 0.0f;
+
+	std::vector<float> src, dst;
+	toFloat(rgba, (size_t)width * height, settings.content, src);
+	float targetCoverage = preserveCoverage ? getCoverage(src, settings.alphaCutoff, 1.0f) : 0.0f;
+
+	while (width > 1 || height > 1)
+	{
+		int dstWidth = std::max(width / 2, 1), dstHeight = std::max(height / 2, 1);
+		downsample(src, width, height, kernel, settings.wrap, dst, dstWidth, dstHeight);
+		clampLevel(dst, settings.content);
+
+		float alphaScale = preserveCoverage ? getCoverageScale(dst, settings.alphaCutoff, targetCoverage) : 1.0f;
+
+		TextureMipChain::Level level;
+		level.width = dstWidth;
+		level.height = dstHeight;
+		toBytes(dst, settings.content, alphaScale, level.pixels);
+		chain->levels.push_back(std::move(level));
+
+		// The next level filters the unscaled alpha
+		src.swap(dst);
+		width = dstWidth;
+		height = dstHeight;
+	}
+
+	return chain;
+}
+
+std::shared_ptr<TextureMipChain> MipGenerator::baseLevel(const unsigned char* rgba, int width, int height)
+{
+	std::shared_ptr<TextureMipChain> chain = std::make_shared<TextureMipChain>();
+
+	TextureMipChain::Level base;
+	base.width = width;
+	base.height = height;
+	base.pixels.assign(rgba, rgba + (size_t)width * height * 4);
+	chain->levels.push_back(std::move(base));
+	return chain;
+}
+
+bool MipGenerator::isSIMD()
+{
+#ifdef MIP_GENERATOR_SSE2
+	return true;
+#else
+	return false;
+#endif
+}
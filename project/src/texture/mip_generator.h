@@ -0,0 +1,46 @@
+#pragma once
+#include <memory>
+#include "texture_upload.h"
+
+enum class MipFilter
+{
+	BOX,		// 2x2 average
+	KAISER		// 8-tap Kaiser-windowed sinc; sharper distant mips without the box filter's aliasing
+};
+
+// How the texels of an image are filtered
+enum class MipContent
+{
+	COLOUR_SRGB,	// RGB filtered in linear light and stored back as sRGB, so mips don't darken
+	LINEAR,			// Masks and other data, filtered as stored
+	NORMAL			// XYZ packed into [0, 1]; every level is renormalised
+};
+
+struct MipSettings
+{
+	MipContent content;
+	MipFilter filter;
+	float alphaCutoff;		// > 0 scales each level's alpha so the same share of texels passes the alpha test
+	bool wrap;				// Filter across the edges, for repeating textures
+
+	MipSettings() : content(MipContent::COLOUR_SRGB), filter(MipFilter::KAISER), alphaCutoff(0.0f), wrap(true) {}
+};
+
+// Builds mip chains on the CPU, so the driver thread never runs glGenerateMipmap.
+//
+// Each level is filtered from the one above it in float, with SSE2 doing the four channels of
+// a texel at once (plain C++ where SSE2 isn't available). Level 0 is kept exactly as given.
+// Any thread; the async loaders run one texture per AssetLoader thread.
+class MipGenerator
+{
+public:
+	MipGenerator() = delete;
+
+	// Every level down to 1x1
+	static std::shared_ptr<TextureMipChain> generate(const unsigned char* rgba, int width, int height, const MipSettings& settings);
+
+	// Level 0 only, for textures with mipmapping off
+	static std::shared_ptr<TextureMipChain> baseLevel(const unsigned char* rgba, int width, int height);
+
+	static bool isSIMD();
+};
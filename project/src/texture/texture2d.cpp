@@ -1,5 +1,6 @@
 #include "texture2d.h"
 #include <iostream>
+#include <utility>
 
 static void getTextureConfig(unsigned int handle, TextureConfig* cfg, int* width, int* height)
 {
@@ -67,6 +68,15 @@ unsigned int Texture2D::getNativeHandle()
 	return handle;
 }
 
+void Texture2D::swapContents(Texture2D* other)
+{
+	std::swap(cfg, other->cfg);
+	std::swap(mipmap, other->mipmap);
+	std::swap(width, other->width);
+	std::swap(height, other->height);
+	std::swap(handle, other->handle);
+}
+
 Texture2D* Texture2D::createColourTexture(int width, int height, TextureConfig cfg, GLenum format, unsigned char* data)
 {
 	Texture2D* tex = new Texture2D(width, height, cfg);
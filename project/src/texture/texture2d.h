@@ -26,7 +26,7 @@ struct TextureConfig
 	bool isDepth;
 
 	TextureConfig()
-		: hWrap(GL_REPEAT), vWrap(GL_REPEAT), textureFilter(GL_LINEAR), mipmap(false), isDepth(false) {}
+		: hWrap(GL_REPEAT), vWrap(GL_REPEAT), textureFilter(GL_LINEAR), mipmap(true), isDepth(false) {}
 	TextureConfig(TextureWrapMode wrapHorizontal, TextureWrapMode wrapVertical, TextureFilterMode filter, bool enableMipmap)
 		: mipmap(enableMipmap), isDepth(false)
 	{
@@ -76,6 +76,10 @@ public:
 
 	unsigned int getNativeHandle();
 
+	// Exchanges the GL texture and its settings with other, e.g. to swap in a reloaded image
+	// while every Texture2D* to this one stays valid
+	void swapContents(Texture2D* other);
+
 	static Texture2D* createColourTexture(int width, int height, TextureConfig cfg, GLenum format, unsigned char* data);
 	static Texture2D* createDepthTexture(int width, int height, GLint bits, bool hasBorder);
 	static Texture2D* createFromNativeHandle(unsigned int handle);
@@ -0,0 +1,153 @@
+#include "texture_array.h"
+
+unsigned int TextureArraySource::getLevelCount() const
+{
+	return container ? container->getLevelCount() : (unsigned int)chain->levels.size();
+}
+
+void TextureArraySource::getSize(int* w, int* h) const
+{
+	if (container)
+	{
+		container->getSize(w, h);
+		return;
+	}
+	*w = chain->levels[0].width;
+	*h = chain->levels[0].height;
+}
+
+TextureArray::TextureArray(GLint internalFormat, int width, int height, int levelCount)
+	: internalFormat(internalFormat), width(width), height(height), levelCount(levelCount), handle(0)
+{
+}
+
+TextureArray::~TextureArray()
+{
+	if (handle != 0)
+		glDeleteTextures(1, &handle);
+}
+
+int TextureArray::addLayer(const TextureArraySource& source)
+{
+	layers.push_back(source);
+	rebuild();
+	return (int)layers.size() - 1;
+}
+
+void TextureArray::setLayer(int layer, const TextureArraySource& source)
+{
+	layers[layer] = source;
+	rebuild();
+}
+
+void TextureArray::rebuild()
+{
+	if (handle != 0)
+		glDeleteTextures(1, &handle);
+
+	glGenTextures(1, &handle);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, handle);
+
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+
+	// Containers hold the block-compressed formats, chains the uncompressed ones
+	bool compressed = layers[0].container != nullptr;
+	int layerCount = (int)layers.size();
+
+	// Single channel layers read as grey, as the Texture2D versions do
+	bool singleChannel = compressed ? internalFormat == GL_COMPRESSED_RED_RGTC1 : layers[0].chain->channels == 1;
+	if (singleChannel)
+	{
+		GLint swizzle[4] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+		glTexParameteriv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (int level = 0; level < levelCount; level++)
+	{
+		if (compressed)
+		{
+			int w, h;
+			unsigned int size;
+			layers[0].container->getLevelData(level, &w, &h, &size);
+			glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, internalFormat, w, h, layerCount, 0, size * layerCount, nullptr);
+
+			for (int layer = 0; layer < layerCount; layer++)
+			{
+				const unsigned char* data = layers[layer].container->getLevelData(level, &w, &h, &size);
+				glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, w, h, 1, internalFormat, size, data);
+			}
+		}
+		else
+		{
+			const TextureMipChain& first = *layers[0].chain;
+			const TextureMipChain::Level& size = first.levels[level];
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, level, internalFormat, size.width, size.height, layerCount, 0,
+				first.getPixelFormat(), GL_UNSIGNED_BYTE, nullptr);
+
+			for (int layer = 0; layer < layerCount; layer++)
+			{
+				const TextureMipChain::Level& data = layers[layer].chain->levels[level];
+				glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, data.width, data.height, 1,
+					first.getPixelFormat(), GL_UNSIGNED_BYTE, data.pixels.data());
+			}
+		}
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+unsigned int TextureArray::getNativeHandle() const
+{
+	return handle;
+}
+
+GLint TextureArray::getInternalFormat() const
+{
+	return internalFormat;
+}
+
+void TextureArray::getSize(int* w, int* h) const
+{
+	*w = width;
+	*h = height;
+}
+
+int TextureArray::getLevelCount() const
+{
+	return levelCount;
+}
+
+int TextureArray::getLayerCount() const
+{
+	return (int)layers.size();
+}
+
+size_t TextureArray::getDataSize() const
+{
+	size_t total = 0;
+	for (const TextureArraySource& source : layers)
+		total += source.container ? source.container->getDataSize() : source.chain->getDataSize();
+	return total;
+}
+
+bool TextureArray::accepts(GLint format, const TextureArraySource& source) const
+{
+	int w, h;
+	source.getSize(&w, &h);
+	if (format != internalFormat || w != width || h != height || (int)source.getLevelCount() != levelCount)
+		return false;
+
+	if (layers.empty())
+		return true;
+
+	// Uncompressed layers must also pack the same channels
+	if ((source.container != nullptr) != (layers[0].container != nullptr))
+		return false;
+	return source.container != nullptr || source.chain->channels == layers[0].chain->channels;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <glad/glad.h>
+#include <memory>
+#include <vector>
+#include "texture_upload.h"
+#include "texture_container.h"
+
+// The levels of one layer: a mapped cache container (block-compressed) or a decoded chain
+// (uncompressed, packed to its channels)
+struct TextureArraySource
+{
+	std::shared_ptr<TextureContainer> container;
+	std::shared_ptr<TextureMipChain> chain;
+
+	unsigned int getLevelCount() const;
+	void getSize(int* w, int* h) const;
+};
+
+// A GL_TEXTURE_2D_ARRAY whose layers share size, storage format and mip count, so one bind
+// serves every material texture in it.
+//
+// Layers can be added or replaced after creation (async loads, hot reload). GL 3.3 can't copy
+// compressed data between textures, so each change re-creates the GL texture from the sources,
+// which stay in system memory for that; the handle changes, the TextureArray* does not.
+class TextureArray
+{
+public:
+	// Render thread. No layers until addLayer().
+	TextureArray(GLint internalFormat, int width, int height, int levelCount);
+	~TextureArray();
+
+	// Render thread; returns the new layer's index
+	int addLayer(const TextureArraySource& source);
+	void setLayer(int layer, const TextureArraySource& source);
+
+	unsigned int getNativeHandle() const;
+	GLint getInternalFormat() const;
+	void getSize(int* w, int* h) const;
+	int getLevelCount() const;
+	int getLayerCount() const;
+	// VRAM, all layers and mips
+	size_t getDataSize() const;
+
+	// Same storage format, size and mip count, so the source can be a layer as is
+	bool accepts(GLint format, const TextureArraySource& source) const;
+
+private:
+	GLint internalFormat;
+	int width, height;
+	int levelCount;
+	std::vector<TextureArraySource> layers;
+	unsigned int handle;
+
+	void rebuild();
+};
+
+// A material texture as a layer of a shared TextureArray (see TextureUtils::loadTextureLayerAsync).
+// Until the texture has loaded, array is a one-layer placeholder.
+struct TextureLayer
+{
+	TextureArray* array;
+	int layer;
+};
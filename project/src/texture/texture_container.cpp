@@ -0,0 +1,290 @@
+#include "texture_container.h"
+#include <glad/glad.h>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+struct ContainerHeader
+{
+	char magic[4];
+	unsigned int version;
+	unsigned long long sourceKey;
+	unsigned int internalFormat;
+	int width, height;
+	unsigned int levelCount;
+	float sourceDecodeMs;		// How long the source image took to decode, for the load report
+	unsigned int padding;
+};
+
+struct ContainerLevel
+{
+	int width, height;
+	unsigned int offset, size;
+};
+
+static const char CONTAINER_MAGIC[4] = { 'X', 'B', 'T', 'X' };
+static const unsigned int CONTAINER_VERSION = 1;
+
+// Read-only mapping of a whole file
+struct TextureContainer::Mapping
+{
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE view = nullptr;
+#else
+	int file = -1;
+#endif
+	void* data = nullptr;
+	size_t size = 0;
+
+	bool open(const std::string& path)
+	{
+#ifdef _WIN32
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+			return false;
+		size = (size_t)fileSize.QuadPart;
+
+		view = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (view == nullptr)
+			return false;
+
+		data = MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0);
+		return data != nullptr;
+#else
+		file = ::open(path.c_str(), O_RDONLY);
+		if (file < 0)
+			return false;
+
+		struct stat info;
+		if (fstat(file, &info) != 0 || info.st_size == 0)
+			return false;
+		size = (size_t)info.st_size;
+
+		data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+		if (data == MAP_FAILED)
+		{
+			data = nullptr;
+			return false;
+		}
+		return true;
+#endif
+	}
+
+	~Mapping()
+	{
+#ifdef _WIN32
+		if (data) UnmapViewOfFile(data);
+		if (view) CloseHandle(view);
+		if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+		if (data) munmap(data, size);
+		if (file >= 0) close(file);
+#endif
+	}
+};
+
+TextureContainer::TextureContainer() : mapping(nullptr), base(nullptr), size(0)
+{
+}
+
+TextureContainer::~TextureContainer()
+{
+	delete mapping;
+}
+
+bool TextureContainer::write(const std::string& path, unsigned long long sourceKey, unsigned int internalFormat,
+	float sourceDecodeMs, const std::vector<TextureContainerLevel>& levels)
+{
+	ContainerHeader header;
+	memcpy(header.magic, CONTAINER_MAGIC, sizeof(CONTAINER_MAGIC));
+	header.version = CONTAINER_VERSION;
+	header.sourceKey = sourceKey;
+	header.internalFormat = internalFormat;
+	header.width = levels.empty() ? 0 : levels[0].width;
+	header.height = levels.empty() ? 0 : levels[0].height;
+	header.levelCount = (unsigned int)levels.size();
+	header.sourceDecodeMs = sourceDecodeMs;
+	header.padding = 0;
+
+	std::vector<ContainerLevel> table(levels.size());
+	unsigned int offset = (unsigned int)(sizeof(ContainerHeader) + sizeof(ContainerLevel) * levels.size());
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		offset = (offset + 15) & ~15u;
+		table[i] = { levels[i].width, levels[i].height, offset, (unsigned int)levels[i].data.size() };
+		offset += table[i].size;
+	}
+
+	// Written under a temporary name, so a crash mid-write never leaves a valid-looking file
+	std::string tempPath = path + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file)
+			return false;
+
+		file.write((const char*)&header, sizeof(header));
+		file.write((const char*)table.data(), sizeof(ContainerLevel) * table.size());
+
+		static const char zeros[16] = {};
+		size_t written = sizeof(ContainerHeader) + sizeof(ContainerLevel) * table.size();
+		for (size_t i = 0; i < levels.size(); i++)
+		{
+			file.write(zeros, table[i].offset - written);
+			file.write((const char*)levels[i].data.data(), table[i].size);
+			written = table[i].offset + table[i].size;
+		}
+
+		if (!file)
+			return false;
+	}
+
+	std::remove(path.c_str());
+	return std::rename(tempPath.c_str(), path.c_str()) == 0;
+}
+
+std::shared_ptr<TextureContainer> TextureContainer::map(const std::string& path, unsigned long long sourceKey)
+{
+	std::shared_ptr<TextureContainer> container(new TextureContainer());
+	container->mapping = new Mapping();
+	if (!container->mapping->open(path))
+		return nullptr;
+
+	container->base = (const unsigned char*)container->mapping->data;
+	container->size = container->mapping->size;
+
+	if (container->size < sizeof(ContainerHeader))
+		return nullptr;
+
+	const ContainerHeader* header = (const ContainerHeader*)container->base;
+	if (memcmp(header->magic, CONTAINER_MAGIC, sizeof(CONTAINER_MAGIC)) != 0
+		|| header->version != CONTAINER_VERSION
+		|| header->sourceKey != sourceKey
+		|| container->size < sizeof(ContainerHeader) + sizeof(ContainerLevel) * header->levelCount)
+		return nullptr;
+
+	const ContainerLevel* table = (const ContainerLevel*)(container->base + sizeof(ContainerHeader));
+	for (unsigned int i = 0; i < header->levelCount; i++)
+	{
+		if ((size_t)table[i].offset + table[i].size > container->size)
+			return nullptr;
+	}
+
+	return container;
+}
+
+unsigned int TextureContainer::upload(int wrapS, int wrapT, int filter, int firstLevel) const
+{
+	const ContainerHeader* header = (const ContainerHeader*)base;
+	const ContainerLevel* table = (const ContainerLevel*)(base + sizeof(ContainerHeader));
+	int levelCount = (int)header->levelCount - firstLevel;
+
+	unsigned int handle;
+	glGenTextures(1, &handle);
+	glBindTexture(GL_TEXTURE_2D, handle);
+
+	bool mipmapped = levelCount > 1;
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapS);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mipmapped ? GL_LINEAR_MIPMAP_LINEAR : filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+
+	// Single channel masks read as grey, as the RGBA8 version did
+	if (header->internalFormat == GL_COMPRESSED_RED_RGTC1)
+	{
+		GLint swizzle[4] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+		glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+	}
+
+	for (int i = 0; i < levelCount; i++)
+	{
+		const ContainerLevel& level = table[firstLevel + i];
+		glCompressedTexImage2D(GL_TEXTURE_2D, i, header->internalFormat, level.width, level.height, 0,
+			level.size, base + level.offset);
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return handle;
+}
+
+std::shared_ptr<TextureMipChain> TextureContainer::toMipChain() const
+{
+	const ContainerHeader* header = (const ContainerHeader*)base;
+	const ContainerLevel* table = (const ContainerLevel*)(base + sizeof(ContainerHeader));
+
+	std::shared_ptr<TextureMipChain> chain = std::make_shared<TextureMipChain>();
+	switch (header->internalFormat)
+	{
+	case GL_R8: chain->channels = 1; break;
+	case GL_RG8: chain->channels = 2; break;
+	case GL_RGB8: case GL_SRGB8: chain->channels = 3; break;
+	default: chain->channels = 4; break;
+	}
+
+	chain->levels.resize(header->levelCount);
+	for (unsigned int i = 0; i < header->levelCount; i++)
+	{
+		chain->levels[i].width = table[i].width;
+		chain->levels[i].height = table[i].height;
+		chain->levels[i].pixels.assign(base + table[i].offset, base + table[i].offset + table[i].size);
+	}
+	return chain;
+}
+
+unsigned int TextureContainer::getInternalFormat() const
+{
+	return ((const ContainerHeader*)base)->internalFormat;
+}
+
+unsigned int TextureContainer::getLevelCount() const
+{
+	return ((const ContainerHeader*)base)->levelCount;
+}
+
+void TextureContainer::getSize(int* w, int* h) const
+{
+	const ContainerHeader* header = (const ContainerHeader*)base;
+	*w = header->width;
+	*h = header->height;
+}
+
+size_t TextureContainer::getDataSize(int firstLevel) const
+{
+	const ContainerHeader* header = (const ContainerHeader*)base;
+	const ContainerLevel* table = (const ContainerLevel*)(base + sizeof(ContainerHeader));
+
+	size_t total = 0;
+	for (unsigned int i = firstLevel; i < header->levelCount; i++)
+		total += table[i].size;
+	return total;
+}
+
+const unsigned char* TextureContainer::getLevelData(unsigned int level, int* w, int* h, unsigned int* size) const
+{
+	const ContainerLevel& entry = ((const ContainerLevel*)(base + sizeof(ContainerHeader)))[level];
+	*w = entry.width;
+	*h = entry.height;
+	*size = entry.size;
+	return base + entry.offset;
+}
+
+float TextureContainer::getSourceDecodeMs() const
+{
+	return ((const ContainerHeader*)base)->sourceDecodeMs;
+}
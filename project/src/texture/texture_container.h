@@ -0,0 +1,57 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include "texture_upload.h"
+
+// Prebuilt-mip texture file (.xbtx), a much reduced KTX:
+//
+//		header			magic "XBTX", version, source key, GL internal format, size, level count
+//		level table		width, height, byte offset and size of each level, level 0 first
+//		level data		compressed blocks (or 8-bit texels), each level 16-byte aligned
+//
+// The file is memory-mapped and each compressed level goes straight from the mapping into
+// glCompressedTexImage2D, with no copy or decode. R8/RG8/RGB8/RGBA8 containers hold CPU-built
+// mip chains for the uncompressed loaders.
+struct TextureContainerLevel
+{
+	int width, height;
+	std::vector<unsigned char> data;
+};
+
+class TextureContainer
+{
+public:
+	~TextureContainer();
+
+	// Any thread
+	static bool write(const std::string& path, unsigned long long sourceKey, unsigned int internalFormat,
+		float sourceDecodeMs, const std::vector<TextureContainerLevel>& levels);
+
+	// Any thread. nullptr if the file is missing, truncated or was built from another source.
+	static std::shared_ptr<TextureContainer> map(const std::string& path, unsigned long long sourceKey);
+
+	// Render thread. New GL texture with levels [firstLevel, last], firstLevel becoming its
+	// level 0; returns its handle. Compressed formats only. BC4 reads as (r, r, r, 1).
+	unsigned int upload(int wrapS, int wrapT, int filter, int firstLevel = 0) const;
+
+	// Copies the levels out, for uncompressed containers that stream through TextureUpload
+	std::shared_ptr<TextureMipChain> toMipChain() const;
+
+	unsigned int getInternalFormat() const;
+	unsigned int getLevelCount() const;
+	void getSize(int* w, int* h) const;
+	// Bytes of levels [firstLevel, last]
+	size_t getDataSize(int firstLevel = 0) const;
+	// Level as stored in the mapping, for uploads elsewhere (e.g. a texture array layer)
+	const unsigned char* getLevelData(unsigned int level, int* w, int* h, unsigned int* size) const;
+	float getSourceDecodeMs() const;
+
+private:
+	TextureContainer();
+
+	struct Mapping;
+	Mapping* mapping;
+	const unsigned char* base;
+	size_t size;
+};
@@ -0,0 +1,298 @@
+#include "texture_streamer.h"
+#include <glad/glad.h>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+
+struct StreamedTexture
+{
+	Texture2D* target;
+	std::string name;
+	TextureConfig cfg;
+	std::shared_ptr<TextureContainer> container;	// One of these two holds the levels
+	std::shared_ptr<TextureMipChain> chain;
+	int width, height;
+	int levelCount;
+	int baseLevel;			// Levels from here to the last are always resident
+	int residentLevel;
+	int wantedLevel;
+	float pixelsPerUV;		// Largest request since the last update
+	unsigned long long lastUsedFrame;
+};
+
+static bool enabled = false;
+static size_t budget = 0;
+static size_t residentBytes = 0;
+static unsigned long long frame = 0;
+static std::unordered_map<Texture2D*, StreamedTexture> textures;
+
+static size_t getLevelBytes(const StreamedTexture& st, int firstLevel)
+{
+	return st.container ? st.container->getDataSize(firstLevel) : st.chain->getDataSize(firstLevel);
+}
+
+// Re-creates the GL texture with levels [level, last] and swaps it into the target
+static void setResidentLevel(StreamedTexture& st, int level)
+{
+	unsigned int handle = st.container
+		? st.container->upload(st.cfg.hWrap, st.cfg.vWrap, st.cfg.textureFilter, level)
+		: st.chain->upload(st.cfg, level);
+
+	Texture2D* fresh = Texture2D::createFromNativeHandle(handle);
+	st.target->swapContents(fresh);
+	delete fresh;	// Holds the old GL texture now
+
+	residentBytes -= getLevelBytes(st, st.residentLevel);
+	residentBytes += getLevelBytes(st, level);
+	st.residentLevel = level;
+}
+
+// Shrinks the least recently used textures until needed bytes are free. Unless forced, a
+// texture drawn last frame only gives up levels finer than it wants.
+static bool evict(size_t needed, const StreamedTexture* except, bool force)
+{
+	std::vector<StreamedTexture*> candidates;
+	for (auto& entry : textures)
+	{
+		StreamedTexture& st = entry.second;
+		if (&st != except && st.residentLevel < st.baseLevel)
+			candidates.push_back(&st);
+	}
+
+	std::sort(candidates.begin(), candidates.end(), [](const StreamedTexture* a, const StreamedTexture* b)
+	{
+		return a->lastUsedFrame < b->lastUsedFrame;
+	});
+
+	size_t freed = 0;
+	for (StreamedTexture* st : candidates)
+	{
+		if (freed >= needed)
+			break;
+
+		bool inUse = st->lastUsedFrame == frame;
+		int coarsest = inUse && !force ? std::min(st->wantedLevel, st->baseLevel) : st->baseLevel;
+		if (st->residentLevel >= coarsest)
+			continue;
+
+		// Only as far down as needed
+		size_t current = getLevelBytes(*st, st->residentLevel);
+		int level = st->residentLevel + 1;
+		while (level < coarsest && current - getLevelBytes(*st, level) < needed - freed)
+			level++;
+
+		freed += current - getLevelBytes(*st, level);
+		setResidentLevel(*st, level);
+	}
+
+	return freed >= needed;
+}
+
+static void addInternal(Texture2D* tex, const std::string& name, std::shared_ptr<TextureContainer> container,
+	std::shared_ptr<TextureMipChain> chain, const TextureConfig& cfg)
+{
+	StreamedTexture st;
+	st.target = tex;
+	st.name = name;
+	st.cfg = cfg;
+	st.container = container;
+	st.chain = chain;
+	if (container)
+	{
+		container->getSize(&st.width, &st.height);
+		st.levelCount = (int)container->getLevelCount();
+	}
+	else
+	{
+		st.width = chain->levels[0].width;
+		st.height = chain->levels[0].height;
+		st.levelCount = (int)chain->levels.size();
+	}
+
+	st.baseLevel = 0;
+	while (st.baseLevel < st.levelCount - 1 && std::max(st.width >> st.baseLevel, st.height >> st.baseLevel) > TextureStreamer::STREAMING_BASE_SIZE)
+		st.baseLevel++;
+
+	st.wantedLevel = st.baseLevel;
+	st.pixelsPerUV = 0.0f;
+	st.lastUsedFrame = 0;
+
+	// Replaced (hot reload): keep what was resident and when it was used
+	int level = st.baseLevel;
+	auto it = textures.find(tex);
+	if (it != textures.end())
+	{
+		const StreamedTexture& old = it->second;
+		level = std::min(std::max(old.residentLevel, 0), st.baseLevel);
+		st.wantedLevel = std::min(old.wantedLevel, st.baseLevel);
+		st.lastUsedFrame = old.lastUsedFrame;
+		residentBytes -= getLevelBytes(old, old.residentLevel);
+	}
+
+	// Nothing of the new levels is resident yet
+	st.residentLevel = st.levelCount;
+	StreamedTexture& entry = textures[tex] = st;
+	setResidentLevel(entry, level);
+}
+
+void TextureStreamer::init(size_t budgetBytes)
+{
+	enabled = true;
+	budget = budgetBytes;
+}
+
+void TextureStreamer::shutdown()
+{
+	// The textures belong to their loaders
+	textures.clear();
+	residentBytes = 0;
+	enabled = false;
+}
+
+bool TextureStreamer::isEnabled()
+{
+	return enabled;
+}
+
+void TextureStreamer::setBudget(size_t budgetBytes)
+{
+	budget = budgetBytes;
+}
+
+size_t TextureStreamer::getBudget()
+{
+	return budget;
+}
+
+void TextureStreamer::add(Texture2D* tex, const std::string& name, std::shared_ptr<TextureContainer> container, const TextureConfig& cfg)
+{
+	addInternal(tex, name, container, nullptr, cfg);
+}
+
+void TextureStreamer::add(Texture2D* tex, const std::string& name, std::shared_ptr<TextureMipChain> chain, const TextureConfig& cfg)
+{
+	addInternal(tex, name, nullptr, chain, cfg);
+}
+
+void TextureStreamer::remove(Texture2D* tex)
+{
+	auto it = textures.find(tex);
+	if (it == textures.end())
+		return;
+
+	residentBytes -= getLevelBytes(it->second, it->second.residentLevel);
+	textures.erase(it);
+}
+
+void TextureStreamer::request(Texture2D* tex, float pixelsPerUV)
+{
+	if (tex == nullptr)
+		return;
+
+	auto it = textures.find(tex);
+	if (it != textures.end())
+		it->second.pixelsPerUV = std::max(it->second.pixelsPerUV, pixelsPerUV);
+}
+
+void TextureStreamer::update(size_t uploadBudgetBytes)
+{
+	if (!enabled)
+		return;
+
+	frame++;
+
+	// Level 0 texels per screen pixel picks the level, as the sampler would
+	for (auto& entry : textures)
+	{
+		StreamedTexture& st = entry.second;
+		if (st.pixelsPerUV <= 0.0f)
+			continue;
+
+		float texelsPerPixel = std::max(st.width, st.height) / st.pixelsPerUV;
+		int level = texelsPerPixel <= 1.0f ? 0 : (int)std::floor(std::log2(texelsPerPixel));
+		st.wantedLevel = std::min(level, st.baseLevel);
+		st.lastUsedFrame = frame;
+		st.pixelsPerUV = 0.0f;
+	}
+
+	// Budget lowered: shrink until it fits, textures in use included
+	if (residentBytes > budget)
+		evict(residentBytes - budget, nullptr, true);
+
+	// Grow the most recently used first, then those furthest from what they want
+	std::vector<StreamedTexture*> growing;
+	for (auto& entry : textures)
+	{
+		if (entry.second.residentLevel > entry.second.wantedLevel)
+			growing.push_back(&entry.second);
+	}
+
+	std::sort(growing.begin(), growing.end(), [](const StreamedTexture* a, const StreamedTexture* b)
+	{
+		if (a->lastUsedFrame != b->lastUsedFrame)
+			return a->lastUsedFrame > b->lastUsedFrame;
+		return a->residentLevel - a->wantedLevel > b->residentLevel - b->wantedLevel;
+	});
+
+	size_t uploaded = 0;
+	for (StreamedTexture* st : growing)
+	{
+		if (uploaded > 0 && uploaded >= uploadBudgetBytes)
+			break;
+
+		// The finest level that fits, evicting what isn't in use to make room
+		for (int level = st->wantedLevel; level < st->residentLevel; level++)
+		{
+			size_t extra = getLevelBytes(*st, level) - getLevelBytes(*st, st->residentLevel);
+			if (residentBytes + extra > budget && !evict(residentBytes + extra - budget, st, false))
+				continue;
+
+			setResidentLevel(*st, level);
+			uploaded += getLevelBytes(*st, level);
+			break;
+		}
+	}
+}
+
+size_t TextureStreamer::getResidentBytes()
+{
+	return residentBytes;
+}
+
+size_t TextureStreamer::getFullBytes()
+{
+	size_t total = 0;
+	for (auto& entry : textures)
+		total += getLevelBytes(entry.second, 0);
+	return total;
+}
+
+unsigned int TextureStreamer::getTextureCount()
+{
+	return (unsigned int)textures.size();
+}
+
+void TextureStreamer::getTextureInfo(std::vector<StreamedTextureInfo>& out)
+{
+	out.clear();
+	for (auto& entry : textures)
+	{
+		const StreamedTexture& st = entry.second;
+
+		StreamedTextureInfo info;
+		info.name = st.name;
+		info.width = st.width;
+		info.height = st.height;
+		info.levelCount = st.levelCount;
+		info.residentLevel = st.residentLevel;
+		info.wantedLevel = st.wantedLevel;
+		info.residentBytes = getLevelBytes(st, st.residentLevel);
+		info.framesSinceUse = (unsigned int)(frame - st.lastUsedFrame);
+		out.push_back(info);
+	}
+
+	std::sort(out.begin(), out.end(), [](const StreamedTextureInfo& a, const StreamedTextureInfo& b)
+	{
+		return a.name < b.name;
+	});
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "texture2d.h"
+#include "texture_upload.h"
+#include "texture_container.h"
+
+// Per-texture residency, for the ImGui panel
+struct StreamedTextureInfo
+{
+	std::string name;
+	int width, height;			// Level 0
+	int levelCount;
+	int residentLevel;			// Finest level on the GPU
+	int wantedLevel;			// Finest level the last requests asked for
+	size_t residentBytes;
+	unsigned int framesSinceUse;
+};
+
+// Keeps only the mip levels that are needed on the GPU, within a memory budget.
+//
+// A streamed texture keeps its whole mip chain in system memory (the mapped cache container,
+// or the decoded chain) and only levels [residentLevel, last] in its GL texture. It starts
+// with the levels up to STREAMING_BASE_SIZE texels across. Every frame the scene reports how
+// many screen pixels one UV unit covers where each texture is drawn; update() grows textures
+// towards the level that density needs and, when the budget runs out, shrinks the least
+// recently used ones back.
+//
+// GL 3.3 has no sparse textures, so a residency change re-creates the GL texture with the new
+// level range and swaps it into the Texture2D, which keeps its pointer.
+class TextureStreamer
+{
+public:
+	TextureStreamer() = delete;
+
+	// Largest texture size that is always resident
+	static const int STREAMING_BASE_SIZE = 64;
+
+	// Render thread. Until init() the loaders upload every level as before.
+	static void init(size_t budgetBytes);
+	static void shutdown();
+	static bool isEnabled();
+
+	static void setBudget(size_t budgetBytes);
+	static size_t getBudget();
+
+	// Render thread. (Re)places tex under streaming with the given levels, keeping its current
+	// residency if it was already streamed (e.g. hot reload). cfg.internalFormat must be the
+	// chain's storage format.
+	static void add(Texture2D* tex, const std::string& name, std::shared_ptr<TextureContainer> container, const TextureConfig& cfg);
+	static void add(Texture2D* tex, const std::string& name, std::shared_ptr<TextureMipChain> chain, const TextureConfig& cfg);
+	// Call before deleting a streamed texture
+	static void remove(Texture2D* tex);
+
+	// Render thread, any number of times per frame; nullptr and unstreamed textures are ignored
+	static void request(Texture2D* tex, float pixelsPerUV);
+
+	// Once per frame. Residency changes upload at most uploadBudgetBytes (at least one change
+	// always goes through).
+	static void update(size_t uploadBudgetBytes);
+
+	static size_t getResidentBytes();
+	// Bytes with every level resident
+	static size_t getFullBytes();
+	static unsigned int getTextureCount();
+	static void getTextureInfo(std::vector<StreamedTextureInfo>& out);
+};
@@ -0,0 +1,447 @@
+#include "texture_upload.h"
+#include <glad/glad.h>
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <unordered_set>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+
+static const int RING_SLOTS = 4;
+static const size_t RING_SLOT_SIZE = 1 << 20;
+
+struct RingSlot
+{
+	unsigned int buffer;
+	size_t capacity;
+	GLsync fence;		// GPU finished reading the slot once signalled
+};
+
+// One texture being streamed
+struct UploadJob
+{
+	Texture2D* target;
+	std::shared_ptr<TextureMipChain> chain;
+	TextureConfig cfg;
+	unsigned int handle;	// Texture being filled, swapped into target after its first level
+	int level;				// Counts down to 0
+	int row;
+};
+
+// Shared context path: one finished level, waiting for its fence on the render thread
+struct Handoff
+{
+	Texture2D* target;
+	unsigned int handle;
+	int level;
+	bool first;
+	size_t bytes;
+	GLsync fence;
+};
+
+static TextureUploadMode mode = TextureUploadMode::PBO_RING;
+static std::unordered_set<Texture2D*> streaming;
+static size_t uploadedBytes = 0;
+
+// PBO ring path
+static RingSlot ring[RING_SLOTS];
+static int nextSlot = 0;
+static std::deque<UploadJob> jobs;
+
+// Shared context path
+static GLFWwindow* uploadWindow = nullptr;
+static std::thread uploadThread;
+static std::deque<UploadJob> threadJobs;
+static std::mutex threadJobsMutex;
+static std::condition_variable threadJobsCondition;
+static bool stopping = false;
+static std::deque<Handoff> handoffs;
+static std::mutex handoffsMutex;
+
+GLenum TextureMipChain::getPixelFormat() const
+{
+	static const GLenum formats[4] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+	return formats[std::min(std::max(channels, 1), 4) - 1];
+}
+
+void TextureMipChain::applySwizzle() const
+{
+	if (channels == 1)
+	{
+		GLint swizzle[4] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+		glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+	}
+}
+
+unsigned int TextureMipChain::upload(const TextureConfig& cfg, int firstLevel) const
+{
+	int levelCount = (int)levels.size() - firstLevel;
+
+	unsigned int handle;
+	glGenTextures(1, &handle);
+	glBindTexture(GL_TEXTURE_2D, handle);
+
+	bool mipmapped = levelCount > 1;
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, cfg.hWrap);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, cfg.vWrap);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mipmapped ? GL_LINEAR_MIPMAP_LINEAR : cfg.textureFilter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, cfg.textureFilter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+	applySwizzle();
+
+	// Rows of packed 1-3 channel texels aren't 4-byte aligned
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (int i = 0; i < levelCount; i++)
+	{
+		const Level& level = levels[firstLevel + i];
+		glTexImage2D(GL_TEXTURE_2D, i, cfg.internalFormat, level.width, level.height, 0, getPixelFormat(), GL_UNSIGNED_BYTE, level.pixels.data());
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return handle;
+}
+
+size_t TextureMipChain::getDataSize(int firstLevel) const
+{
+	size_t total = 0;
+	for (size_t i = firstLevel; i < levels.size(); i++)
+		total += levels[i].pixels.size();
+	return total;
+}
+
+// Storage for every level, showing only the coarsest until more is uploaded
+static unsigned int allocateTexture(const TextureConfig& cfg, const TextureMipChain& chain)
+{
+	int lastLevel = (int)chain.levels.size() - 1;
+	bool mipmapped = lastLevel > 0;
+
+	unsigned int handle;
+	glGenTextures(1, &handle);
+	glBindTexture(GL_TEXTURE_2D, handle);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, cfg.hWrap);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, cfg.vWrap);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mipmapped ? GL_LINEAR_MIPMAP_LINEAR : cfg.textureFilter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, cfg.textureFilter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, lastLevel);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, lastLevel);
+	chain.applySwizzle();
+
+	for (int i = 0; i <= lastLevel; i++)
+	{
+		const TextureMipChain::Level& level = chain.levels[i];
+		glTexImage2D(GL_TEXTURE_2D, i, cfg.internalFormat, level.width, level.height, 0, chain.getPixelFormat(), GL_UNSIGNED_BYTE, nullptr);
+	}
+
+	return handle;
+}
+
+// target keeps its pointer but takes over the streamed texture; the placeholder is deleted
+static void swapIntoTarget(Texture2D* target, unsigned int handle)
+{
+	Texture2D* fresh = Texture2D::createFromNativeHandle(handle);
+	target->swapContents(fresh);
+	delete fresh;
+}
+
+static bool isSignalled(GLsync fence)
+{
+	GLenum result = glClientWaitSync(fence, 0, 0);
+	return result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED || result == GL_WAIT_FAILED;
+}
+
+static void uploadThreadLoop()
+{
+	glfwMakeContextCurrent(uploadWindow);
+
+	// Rows of packed 1-3 channel texels aren't 4-byte aligned
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	while (true)
+	{
+		UploadJob job;
+		{
+			std::unique_lock<std::mutex> lock(threadJobsMutex);
+			threadJobsCondition.wait(lock, [] { return stopping || !threadJobs.empty(); });
+
+			if (stopping)
+				break;
+
+			job = threadJobs.front();
+			threadJobs.pop_front();
+		}
+
+		job.handle = allocateTexture(job.cfg, *job.chain);
+
+		// A fence per level, so the render thread can show each one as soon as it is in
+		int lastLevel = (int)job.chain->levels.size() - 1;
+		for (int i = lastLevel; i >= 0; i--)
+		{
+			const TextureMipChain::Level& level = job.chain->levels[i];
+			glTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, level.width, level.height, job.chain->getPixelFormat(), GL_UNSIGNED_BYTE, level.pixels.data());
+
+			Handoff handoff = { job.target, job.handle, i, i == lastLevel, level.pixels.size(), glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) };
+			glFlush();
+
+			std::lock_guard<std::mutex> lock(handoffsMutex);
+			handoffs.push_back(handoff);
+		}
+
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	glfwMakeContextCurrent(nullptr);
+}
+
+static void updateSharedContext()
+{
+	while (true)
+	{
+		Handoff handoff;
+		{
+			std::lock_guard<std::mutex> lock(handoffsMutex);
+			if (handoffs.empty() || !isSignalled(handoffs.front().fence))
+				break;
+
+			handoff = handoffs.front();
+			handoffs.pop_front();
+		}
+
+		glDeleteSync(handoff.fence);
+
+		if (handoff.first)
+			swapIntoTarget(handoff.target, handoff.handle);
+
+		// Replaced while streaming (e.g. hot reload); the handle is gone with it
+		if (handoff.target->getNativeHandle() != handoff.handle)
+		{
+			streaming.erase(handoff.target);
+			continue;
+		}
+
+		glBindTexture(GL_TEXTURE_2D, handoff.handle);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, handoff.level);
+
+		uploadedBytes += handoff.bytes;
+		if (handoff.level == 0)
+			streaming.erase(handoff.target);
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+static void updatePboRing(size_t budgetBytes)
+{
+	size_t budget = budgetBytes;
+
+	while (!jobs.empty() && budget > 0)
+	{
+		UploadJob& job = jobs.front();
+		int lastLevel = (int)job.chain->levels.size() - 1;
+
+		// Replaced while streaming (e.g. hot reload); the handle is gone with it
+		bool swapped = job.level < lastLevel;
+		if (swapped && job.target->getNativeHandle() != job.handle)
+		{
+			streaming.erase(job.target);
+			jobs.pop_front();
+			continue;
+		}
+
+		RingSlot& slot = ring[nextSlot];
+		if (slot.fence)
+		{
+			// The GPU is still reading this slot; carry on next frame
+			if (!isSignalled(slot.fence))
+				break;
+
+			glDeleteSync(slot.fence);
+			slot.fence = 0;
+		}
+
+		const TextureMipChain::Level& level = job.chain->levels[job.level];
+		size_t rowBytes = (size_t)level.width * job.chain->channels;
+		size_t maxRows = std::max<size_t>(1, std::min(RING_SLOT_SIZE, budget) / rowBytes);
+		int rows = (int)std::min<size_t>(level.height - job.row, maxRows);
+		size_t bytes = rows * rowBytes;
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+		if (bytes > slot.capacity)
+		{
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+			slot.capacity = bytes;
+		}
+
+		// The slot's fence has signalled, so nothing is reading it
+		void* dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		if (dst == nullptr)
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			break;
+		}
+		memcpy(dst, level.pixels.data() + job.row * rowBytes, bytes);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+		// Rows of packed 1-3 channel texels aren't 4-byte aligned
+		glBindTexture(GL_TEXTURE_2D, job.handle);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexSubImage2D(GL_TEXTURE_2D, job.level, 0, job.row, level.width, rows, job.chain->getPixelFormat(), GL_UNSIGNED_BYTE, (void*)0);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+		slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		nextSlot = (nextSlot + 1) % RING_SLOTS;
+
+		budget -= std::min(budget, bytes);
+		uploadedBytes += bytes;
+		job.row += rows;
+
+		if (job.row < level.height)
+			continue;
+
+		// Level complete: show it
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, job.level);
+		if (job.level == lastLevel)
+			swapIntoTarget(job.target, job.handle);
+
+		job.row = 0;
+		job.level--;
+
+		if (job.level < 0)
+		{
+			streaming.erase(job.target);
+			jobs.pop_front();
+		}
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void TextureUpload::init(TextureUploadMode uploadMode)
+{
+	mode = TextureUploadMode::PBO_RING;
+
+	for (auto& slot : ring)
+	{
+		glGenBuffers(1, &slot.buffer);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, RING_SLOT_SIZE, nullptr, GL_STREAM_DRAW);
+		slot.capacity = RING_SLOT_SIZE;
+		slot.fence = 0;
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	if (uploadMode == TextureUploadMode::SHARED_CONTEXT)
+	{
+		// Hidden 1x1 window whose context shares objects with the main one
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		uploadWindow = glfwCreateWindow(1, 1, "Texture Upload", nullptr, glfwGetCurrentContext());
+		glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+
+		if (uploadWindow)
+		{
+			mode = TextureUploadMode::SHARED_CONTEXT;
+			stopping = false;
+			uploadThread = std::thread(uploadThreadLoop);
+		}
+		else
+		{
+			printf("Texture upload: shared context not available, using the PBO ring\n");
+		}
+	}
+}
+
+void TextureUpload::shutdown()
+{
+	if (uploadThread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(threadJobsMutex);
+			stopping = true;
+		}
+		threadJobsCondition.notify_all();
+		uploadThread.join();
+	}
+
+	for (auto& handoff : handoffs)
+		glDeleteSync(handoff.fence);
+	handoffs.clear();
+
+	if (uploadWindow)
+	{
+		glfwDestroyWindow(uploadWindow);
+		uploadWindow = nullptr;
+	}
+
+	for (auto& slot : ring)
+	{
+		if (slot.fence)
+			glDeleteSync(slot.fence);
+		glDeleteBuffers(1, &slot.buffer);
+		slot.fence = 0;
+		slot.buffer = 0;
+	}
+
+	jobs.clear();
+	streaming.clear();
+}
+
+TextureUploadMode TextureUpload::getMode()
+{
+	return mode;
+}
+
+void TextureUpload::submit(Texture2D* tex, TextureConfig cfg, std::shared_ptr<TextureMipChain> chain)
+{
+	UploadJob job;
+	job.target = tex;
+	job.chain = chain;
+	job.cfg = cfg;
+	job.handle = 0;
+	job.level = (int)chain->levels.size() - 1;
+	job.row = 0;
+
+	streaming.insert(tex);
+
+	if (mode == TextureUploadMode::SHARED_CONTEXT)
+	{
+		{
+			std::lock_guard<std::mutex> lock(threadJobsMutex);
+			threadJobs.push_back(job);
+		}
+		threadJobsCondition.notify_one();
+		return;
+	}
+
+	job.handle = allocateTexture(cfg, *chain);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	jobs.push_back(job);
+}
+
+bool TextureUpload::isStreaming(Texture2D* tex)
+{
+	return streaming.count(tex) > 0;
+}
+
+void TextureUpload::update(size_t budgetBytes)
+{
+	if (mode == TextureUploadMode::SHARED_CONTEXT)
+		updateSharedContext();
+	else
+		updatePboRing(budgetBytes);
+}
+
+unsigned int TextureUpload::getPendingCount()
+{
+	return (unsigned int)streaming.size();
+}
+
+size_t TextureUpload::getUploadedBytes()
+{
+	return uploadedBytes;
+}
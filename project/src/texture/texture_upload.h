@@ -0,0 +1,65 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include "texture2d.h"
+
+// Decoded image with its mip levels, level 0 first (see mip_generator.h). Texels are 8 bits
+// per channel, tightly packed.
+struct TextureMipChain
+{
+	struct Level
+	{
+		int width, height;
+		std::vector<unsigned char> pixels;
+	};
+
+	std::vector<Level> levels;
+	int channels = 4;		// 1 = R, 2 = RG, 3 = RGB, 4 = RGBA
+
+	GLenum getPixelFormat() const;
+	// On the bound GL_TEXTURE_2D; a single channel reads as grey (r, r, r, 1)
+	void applySwizzle() const;
+
+	// Render thread. New GL texture with levels [firstLevel, last] in cfg.internalFormat, all
+	// uploaded at once; returns its handle.
+	unsigned int upload(const TextureConfig& cfg, int firstLevel = 0) const;
+	// Bytes of levels [firstLevel, last]
+	size_t getDataSize(int firstLevel = 0) const;
+};
+
+enum class TextureUploadMode
+{
+	PBO_RING,			// Render thread copies rows into a ring of pixel buffer objects and uploads from there
+	SHARED_CONTEXT		// Upload thread with its own shared GL context, handed over with fences
+};
+
+// Streams textures to the GPU over several frames, so a large texture doesn't stall the frame
+// it arrives in.
+//
+// Levels go up coarsest first and GL_TEXTURE_BASE_LEVEL follows the finest level uploaded, so
+// a texture replaces its placeholder as soon as its smallest mip is up and sharpens as the rest
+// arrives. The PBO ring path uploads at most budgetBytes per frame in row chunks; each ring slot
+// has a fence so a slot is only rewritten once the GPU has read it.
+class TextureUpload
+{
+public:
+	TextureUpload() = delete;
+
+	// Render thread, with the main context current. SHARED_CONTEXT falls back to PBO_RING if
+	// the second context can't be created.
+	static void init(TextureUploadMode mode);
+	static void shutdown();
+	static TextureUploadMode getMode();
+
+	// Render thread. Streams the chain into tex in place; tex keeps its current contents
+	// (e.g. a placeholder) until the first level is up.
+	static void submit(Texture2D* tex, TextureConfig cfg, std::shared_ptr<TextureMipChain> chain);
+	static bool isStreaming(Texture2D* tex);
+
+	// Once per frame
+	static void update(size_t budgetBytes);
+
+	static unsigned int getPendingCount();
+	static size_t getUploadedBytes();
+};
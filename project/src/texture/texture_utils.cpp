@@ -2,34 +2,370 @@
 #include <glad/glad.h>
 #include <stb_image/stb_image.h>
 #include <iostream>
+#include <memory>
+#include <sstream>
+#include <unordered_map>
+#include "../framework/hot_reload.h"
+#include "../framework/asset_loader.h"
+#include "texture_upload.h"
+#include "texture_container.h"
+#include "block_encoder.h"
+#include "mip_generator.h"
+#include "texture_streamer.h"
+#include "texture_array.h"
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+// Not part of the 3.3 headers (EXT_texture_compression_s3tc)
+#define TEXTURE_GL_COMPRESSED_RGB_S3TC_DXT1		0x83F0
+#define TEXTURE_GL_COMPRESSED_RGBA_S3TC_DXT5	0x83F3
+
+// Matches the alpha test in the surface and shadow shaders
+static const float ALPHA_TEST_CUTOFF = 0.1f;
 
 namespace TextureUtils
 {
-	Texture2D* loadTexture2D(const std::string& path, TextureConfig cfg)
+	// RGBA8, flipped for GL. Safe to call from any thread.
+	static std::shared_ptr<unsigned char> decodeImage(const std::string& path, int* width, int* height)
+	{
+		int nrChannels;
+		// Per thread: the loader workers and the hot reload thread decode at the same time
+		stbi_set_flip_vertically_on_load_thread(true);
+		unsigned char* data = stbi_load(path.c_str(), width, height, &nrChannels, 4);
+		return std::shared_ptr<unsigned char>(data, [](unsigned char* p) { stbi_image_free(p); });
+	}
+
+	const char* TEXTURE_CACHE_DIRECTORY = "../texture_cache/";
+
+	// Bump when the encoder or mip output changes, so old cache files miss
+	static const unsigned int CACHE_VERSION = 3;
+
+	static double getMsSince(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	// Path, size and modification time of the source, so editing it rebuilds the cache file.
+	// variant tells apart the files built from one source (format, mip settings).
+	static unsigned long long getSourceKey(const std::string& path, const std::string& variant)
+	{
+		struct stat info;
+		long long stamp[2] = { 0, 0 };
+		if (stat(path.c_str(), &info) == 0)
+		{
+			stamp[0] = (long long)info.st_size;
+			stamp[1] = (long long)info.st_mtime;
+		}
+
+		unsigned long long hash = 14695981039346656037ull;
+		auto hashBytes = [&hash](const void* data, size_t size)
+		{
+			for (size_t i = 0; i < size; i++)
+			{
+				hash ^= ((const unsigned char*)data)[i];
+				hash *= 1099511628211ull;
+			}
+		};
+		hashBytes(path.data(), path.size());
+		hashBytes(stamp, sizeof(stamp));
+		hashBytes(variant.data(), variant.size());
+		hashBytes(&CACHE_VERSION, sizeof(CACHE_VERSION));
+		return hash;
+	}
+
+	static std::string getCachePath(unsigned long long key)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.xbtx", key);
+		return std::string(TEXTURE_CACHE_DIRECTORY) + name;
+	}
+
+	// Any thread, before writing a cache file
+	static void createCacheDirectory()
+	{
+#ifdef _WIN32
+		_mkdir(TEXTURE_CACHE_DIRECTORY);
+#else
+		mkdir(TEXTURE_CACHE_DIRECTORY, 0755);
+#endif
+	}
+
+	// GENERIC colour is filtered as sRGB only when the texture is sampled as sRGB
+	static MipSettings getMipSettings(TextureRole role, bool srgb)
 	{
-		stbi_set_flip_vertically_on_load(true); // tell stb_image.h to flip loaded texture's on the y-axis.
+		MipSettings settings;
+		switch (role)
+		{
+		default:
+		case TextureRole::ALBEDO: break;
+		case TextureRole::ALBEDO_ALPHA: settings.alphaCutoff = ALPHA_TEST_CUTOFF; break;
+		case TextureRole::MASK: settings.content = MipContent::LINEAR; break;
+		case TextureRole::NORMAL: settings.content = MipContent::NORMAL; break;
+		case TextureRole::GENERIC: settings.content = srgb ? MipContent::COLOUR_SRGB : MipContent::LINEAR; break;
+		}
+		return settings;
+	}
+
+	static void inspectChannels(const unsigned char* rgba, size_t count, bool* hasAlpha, bool* isGrey)
+	{
+		*hasAlpha = false;
+		*isGrey = true;
+		for (size_t i = 0; i < count * 4 && (*isGrey || !*hasAlpha); i += 4)
+		{
+			*hasAlpha |= rgba[i + 3] != 255;
+			*isGrey &= rgba[i] == rgba[i + 1] && rgba[i] == rgba[i + 2];
+		}
+	}
 
+	// Channels worth storing for what the texture is used for and what the image holds.
+	// Core GL has no one or two channel sRGB format, so grey sRGB images keep RGB.
+	static int getChannelCount(const unsigned char* rgba, size_t count, TextureRole role, bool srgb)
+	{
+		switch (role)
+		{
+		case TextureRole::MASK: return 1;
+		case TextureRole::NORMAL: return 2;
+		case TextureRole::ALBEDO_ALPHA: return 4;
+		default: break;
+		}
+
+		bool hasAlpha, isGrey;
+		inspectChannels(rgba, count, &hasAlpha, &isGrey);
+		if (hasAlpha)
+			return 4;
+		return isGrey && !srgb ? 1 : 3;
+	}
+
+	static GLint getStorageFormat(int channels, bool srgb)
+	{
+		switch (channels)
+		{
+		case 1: return GL_R8;
+		case 2: return GL_RG8;
+		case 3: return srgb ? GL_SRGB8 : GL_RGB8;
+		default: return srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+		}
+	}
+
+	static const char* getStorageFormatName(GLint internalFormat)
+	{
+		switch (internalFormat)
+		{
+		case GL_R8: return "R8";
+		case GL_RG8: return "RG8";
+		case GL_RGB8: return "RGB8";
+		case GL_SRGB8: return "sRGB8";
+		case GL_SRGB8_ALPHA8: return "sRGB8_A8";
+		default: return "RGBA8";
+		}
+	}
+
+	// Keeps the first channels of every texel
+	static void packChannels(TextureMipChain& chain, int channels)
+	{
+		if (channels == chain.channels)
+			return;
+
+		for (TextureMipChain::Level& level : chain.levels)
+		{
+			size_t count = (size_t)level.width * level.height;
+			for (size_t i = 0; i < count; i++)
+			{
+				for (int c = 0; c < channels; c++)
+					level.pixels[i * channels + c] = level.pixels[i * chain.channels + c];
+			}
+			level.pixels.resize(count * channels);
+		}
+		chain.channels = channels;
+	}
+
+	// cfg as asked for (GL_RGBA or GL_SRGB_ALPHA), with the format the chain is stored in
+	static TextureConfig getStorageConfig(TextureConfig cfg, const TextureMipChain& chain)
+	{
+		cfg.internalFormat = getStorageFormat(chain.channels, cfg.internalFormat == GL_SRGB_ALPHA);
+		return cfg;
+	}
+
+	// Any thread. The decoded image packed to the channels it needs, with its mips, from the
+	// cache when the source is unchanged.
+	static std::shared_ptr<TextureMipChain> importMipChain(const std::string& path, const TextureConfig& cfg, TextureRole role)
+	{
+		bool srgb = cfg.internalFormat == GL_SRGB_ALPHA;
+		MipSettings settings = getMipSettings(role, srgb);
+		settings.wrap = cfg.hWrap != GL_CLAMP_TO_EDGE && cfg.hWrap != GL_CLAMP_TO_BORDER;
+
+		std::ostringstream variant;
+		variant << "raw|" << srgb << '|' << (int)role << '|' << cfg.mipmap << '|' << (int)settings.filter << '|' << settings.wrap;
+		unsigned long long key = getSourceKey(path, variant.str());
+		std::string cachePath = getCachePath(key);
+
+		std::shared_ptr<TextureContainer> container = TextureContainer::map(cachePath, key);
+		if (container)
+			return container->toMipChain();
+
+		auto start = std::chrono::high_resolution_clock::now();
+		int width, height;
+		std::shared_ptr<unsigned char> pixels = decodeImage(path, &width, &height);
+		if (!pixels)
+			return nullptr;
+		float decodeMs = (float)getMsSince(start);
+
+		int channels = getChannelCount(pixels.get(), (size_t)width * height, role, srgb);
+		std::shared_ptr<TextureMipChain> chain = cfg.mipmap
+			? MipGenerator::generate(pixels.get(), width, height, settings)
+			: MipGenerator::baseLevel(pixels.get(), width, height);
+		packChannels(*chain, channels);
+
+		std::vector<TextureContainerLevel> levels(chain->levels.size());
+		for (size_t i = 0; i < levels.size(); i++)
+		{
+			levels[i].width = chain->levels[i].width;
+			levels[i].height = chain->levels[i].height;
+			levels[i].data = chain->levels[i].pixels;
+		}
+
+		createCacheDirectory();
+		if (!TextureContainer::write(cachePath, key, getStorageFormat(channels, srgb), decodeMs, levels))
+			std::cout << "Texture cache: could not write " << cachePath << std::endl;
+
+		return chain;
+	}
+
+	// Uploads into a new GL texture and swaps it into tex, so pointers to tex stay valid.
+	// Mipmapped textures go to the TextureStreamer instead when it is on.
+	static void replaceContents(Texture2D* tex, const std::string& path, std::shared_ptr<TextureMipChain> chain, TextureConfig cfg)
+	{
+		if (TextureStreamer::isEnabled() && chain->levels.size() > 1)
+		{
+			TextureStreamer::add(tex, path, chain, getStorageConfig(cfg, *chain));
+			return;
+		}
+
+		Texture2D* fresh = Texture2D::createFromNativeHandle(chain->upload(getStorageConfig(cfg, *chain)));
+		tex->swapContents(fresh);
+		delete fresh;	// Holds the old GL texture now
+	}
+
+	// Decodes on the hot reload thread; the upload and swap happen on the render thread
+	static void watchTexture(Texture2D* tex, const std::string& path, TextureConfig cfg, TextureRole role)
+	{
+		HotReload::watch(path, tex, [=]() -> HotReload::CommitFunc
+		{
+			std::shared_ptr<TextureMipChain> chain = importMipChain(path, cfg, role);
+			if (!chain)
+			{
+				std::cout << "Failed to reload texture: " << path << std::endl;
+				return nullptr;
+			}
+
+			return [=]()
+			{
+				replaceContents(tex, path, chain, cfg);
+				std::cout << "Reloaded texture: " << path << std::endl;
+			};
+		});
+	}
+
+	// Render thread only
+	static std::unordered_map<std::string, Texture2D*> asyncTextures;
+
+	// Render thread; the log notes the format each texture ended up in
+	static void logLoaded(const std::string& path, const TextureMipChain& chain, const TextureConfig& cfg)
+	{
+		size_t bytes = 0;
+		for (const TextureMipChain::Level& level : chain.levels)
+			bytes += level.pixels.size();
+
+		printf("Loaded texture (%s): %s - %.2f MB vs %.2f MB as RGBA8\n", getStorageFormatName(getStorageConfig(cfg, chain).internalFormat),
+			path.c_str(), bytes / (1024.0f * 1024.0f), bytes * 4.0f / chain.channels / (1024.0f * 1024.0f));
+	}
+
+	static Texture2D* loadTexture2DInternal(const std::string& path, TextureConfig cfg, TextureRole role)
+	{
 		Texture2D* tex = 0;
 
-		static int width, height, nrChannels;
-		unsigned char* data = stbi_load(path.c_str(), &width, &height, &nrChannels, 4);
-		if (data)
+		// Mips come from the CPU generator (or the cache) instead of glGenerateMipmap
+		std::shared_ptr<TextureMipChain> chain = importMipChain(path, cfg, role);
+		if (chain)
 		{
-			cfg.internalFormat = GL_RGBA;
-			tex = Texture2D::createColourTexture(width, height, cfg, GL_RGBA, data);
-			std::cout << "Loaded texture: " << path << std::endl;
+			tex = Texture2D::copyColourTexture(checkerTexture2D());
+			replaceContents(tex, path, chain, cfg);
+			watchTexture(tex, path, cfg, role);
+			logLoaded(path, *chain, cfg);
 		}
 		else
 		{
 			std::cout << "Failed to load texture: " << path << std::endl;
 		}
 
-		// Free memory after we send the data to GPU.
-		stbi_image_free(data);
+		return tex;
+	}
+
+	static Texture2D* loadTexture2DAsyncInternal(const std::string& path, TextureConfig cfg, TextureRole role)
+	{
+		std::ostringstream key;
+		key << path << '|' << cfg.internalFormat << '|' << (int)role << '|' << cfg.hWrap << '|' << cfg.vWrap << '|' << cfg.textureFilter << '|' << cfg.mipmap;
+
+		auto it = asyncTextures.find(key.str());
+		if (it != asyncTextures.end())
+			return it->second;
+
+		Texture2D* tex = Texture2D::copyColourTexture(checkerTexture2D());
+		asyncTextures[key.str()] = tex;
+
+		AssetLoader::submit([=]() -> AssetLoader::UploadFunc
+		{
+			// Mips are built (or read from the cache) here too, so the render thread only copies
+			std::shared_ptr<TextureMipChain> chain = importMipChain(path, cfg, role);
+			if (!chain)
+			{
+				std::cout << "Failed to load texture: " << path << std::endl;
+				return nullptr;
+			}
+
+			bool submitted = false;
+			return [=]() mutable
+			{
+				// Streamed textures start small enough to go up at once
+				if (TextureStreamer::isEnabled() && chain->levels.size() > 1)
+				{
+					replaceContents(tex, path, chain, cfg);
+					logLoaded(path, *chain, cfg);
+					return true;
+				}
+
+				if (!submitted)
+				{
+					TextureUpload::submit(tex, getStorageConfig(cfg, *chain), chain);
+					submitted = true;
+				}
+
+				if (TextureUpload::isStreaming(tex))
+					return false;
 
+				logLoaded(path, *chain, cfg);
+				return true;
+			};
+		});
+
+		watchTexture(tex, path, cfg, role);
 		return tex;
 	}
 
+	Texture2D* loadTexture2D(const std::string& path, TextureConfig cfg)
+	{
+		cfg.internalFormat = GL_RGBA;
+		return loadTexture2DInternal(path, cfg, TextureRole::GENERIC);
+	}
+
 	Texture2D* loadTexture2D(const std::string& path)
 	{
 		return loadTexture2D(path, TextureConfig());
@@ -37,32 +373,424 @@ namespace TextureUtils
 
 	Texture2D* loadTexture2D_sRGBA(const std::string& path, TextureConfig cfg)
 	{
-		stbi_set_flip_vertically_on_load(true); // tell stb_image.h to flip loaded texture's on the y-axis.
+		cfg.internalFormat = GL_SRGB_ALPHA;
+		return loadTexture2DInternal(path, cfg, TextureRole::GENERIC);
+	}
 
-		Texture2D* tex = 0;
+	Texture2D* loadTexture2D_sRGBA(const std::string& path)
+	{
+		return loadTexture2D_sRGBA(path, TextureConfig());
+	}
 
-		static int width, height, nrChannels;
-		unsigned char* data = stbi_load(path.c_str(), &width, &height, &nrChannels, 4);
-		if (data)
+	Texture2D* loadTexture2DAsync(const std::string& path, TextureConfig cfg)
+	{
+		cfg.internalFormat = GL_RGBA;
+		return loadTexture2DAsyncInternal(path, cfg, TextureRole::GENERIC);
+	}
+
+	Texture2D* loadTexture2DAsync(const std::string& path)
+	{
+		return loadTexture2DAsync(path, TextureConfig());
+	}
+
+	Texture2D* loadTexture2DAsync_sRGBA(const std::string& path, TextureConfig cfg)
+	{
+		cfg.internalFormat = GL_SRGB_ALPHA;
+		return loadTexture2DAsyncInternal(path, cfg, TextureRole::GENERIC);
+	}
+
+	Texture2D* loadTexture2DAsync_sRGBA(const std::string& path)
+	{
+		return loadTexture2DAsync_sRGBA(path, TextureConfig());
+	}
+
+	static CompressedTextureStats compressedStats = {};
+
+	// A container mapped on any thread, waiting for its upload
+	struct CompressedImport
+	{
+		std::shared_ptr<TextureContainer> container;
+		TextureRole role;
+		bool cacheHit;
+		float mapMs;
+		float encodeMs;
+	};
+
+	// Render thread; checked once
+	static bool hasS3TC()
+	{
+		static int supported = -1;
+		if (supported < 0)
 		{
-			cfg.internalFormat = GL_SRGB_ALPHA;
-			tex = Texture2D::createColourTexture(width, height, cfg, GL_RGBA, data);
-			std::cout << "Loaded texture (sRGBA): " << path << std::endl;
+			supported = glfwExtensionSupported("GL_EXT_texture_compression_s3tc") ? 1 : 0;
+			if (!supported)
+				std::cout << "Texture compression: S3TC not supported, loading uncompressed" << std::endl;
+		}
+		return supported == 1;
+	}
+
+	static const char* getFormatName(unsigned int internalFormat)
+	{
+		switch (internalFormat)
+		{
+		case TEXTURE_GL_COMPRESSED_RGB_S3TC_DXT1: return "BC1";
+		case TEXTURE_GL_COMPRESSED_RGBA_S3TC_DXT5: return "BC3";
+		case GL_COMPRESSED_RED_RGTC1: return "BC4";
+		case GL_COMPRESSED_RG_RGTC2: return "BC5";
+		default: return "?";
+		}
+	}
+
+	// Any thread. Maps the cached container, encoding it first on a miss.
+	static bool importCompressed(const std::string& path, TextureRole role, CompressedImport* out)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+
+		unsigned long long key = getSourceKey(path, "bc|" + std::to_string((int)role));
+		std::string cachePath = getCachePath(key);
+
+		out->role = role;
+		out->encodeMs = 0.0f;
+		out->container = TextureContainer::map(cachePath, key);
+		out->cacheHit = out->container != nullptr;
+		if (out->cacheHit)
+		{
+			out->mapMs = (float)getMsSince(start);
+			return true;
+		}
+
+		int width, height;
+		std::shared_ptr<unsigned char> pixels = decodeImage(path, &width, &height);
+		if (!pixels)
+			return false;
+		float decodeMs = (float)getMsSince(start);
+
+		MipSettings settings = getMipSettings(role, false);
+
+		// Same channel choice as uncompressed: albedo with alpha keeps it, grey albedo is one channel
+		unsigned int internalFormat;
+		switch (getChannelCount(pixels.get(), (size_t)width * height, role, false))
+		{
+		case 1: internalFormat = GL_COMPRESSED_RED_RGTC1; break;
+		case 2: internalFormat = GL_COMPRESSED_RG_RGTC2; break;
+		case 3: internalFormat = TEXTURE_GL_COMPRESSED_RGB_S3TC_DXT1; break;
+		default: internalFormat = TEXTURE_GL_COMPRESSED_RGBA_S3TC_DXT5; break;
+		}
+
+		std::shared_ptr<TextureMipChain> chain = MipGenerator::generate(pixels.get(), width, height, settings);
+
+		std::vector<TextureContainerLevel> levels(chain->levels.size());
+		for (size_t i = 0; i < levels.size(); i++)
+		{
+			const TextureMipChain::Level& level = chain->levels[i];
+			levels[i].width = level.width;
+			levels[i].height = level.height;
+
+			switch (internalFormat)
+			{
+			case GL_COMPRESSED_RED_RGTC1: levels[i].data = BlockEncoder::encodeBC4(level.pixels.data(), level.width, level.height, 0); break;
+			case GL_COMPRESSED_RG_RGTC2: levels[i].data = BlockEncoder::encodeBC5(level.pixels.data(), level.width, level.height); break;
+			case TEXTURE_GL_COMPRESSED_RGB_S3TC_DXT1: levels[i].data = BlockEncoder::encodeBC1(level.pixels.data(), level.width, level.height); break;
+			default: levels[i].data = BlockEncoder::encodeBC3(level.pixels.data(), level.width, level.height); break;
+			}
+		}
+
+		createCacheDirectory();
+		if (!TextureContainer::write(cachePath, key, internalFormat, decodeMs, levels))
+			std::cout << "Texture compression: could not write " << cachePath << std::endl;
+
+		out->encodeMs = (float)getMsSince(start) - decodeMs;
+
+		auto mapStart = std::chrono::high_resolution_clock::now();
+		out->container = TextureContainer::map(cachePath, key);
+		out->mapMs = (float)getMsSince(mapStart);
+		return out->container != nullptr;
+	}
+
+	// Render thread. Fills tex (a placeholder, or the previous version on hot reload), through
+	// the TextureStreamer when it is on.
+	static void setFromImport(Texture2D* tex, const std::string& path, const CompressedImport& import, TextureConfig cfg)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		const TextureContainer& container = *import.container;
+
+		if (TextureStreamer::isEnabled() && container.getLevelCount() > 1)
+		{
+			TextureStreamer::add(tex, path, import.container, cfg);
 		}
 		else
 		{
-			std::cout << "Failed to load texture (sRGBA): " << path << std::endl;
+			Texture2D* fresh = Texture2D::createFromNativeHandle(container.upload(cfg.hWrap, cfg.vWrap, cfg.textureFilter));
+			tex->swapContents(fresh);
+			delete fresh;	// Holds the old GL texture now
+		}
+
+		float loadMs = import.mapMs + (float)getMsSince(start);
+
+		int width, height;
+		container.getSize(&width, &height);
+		size_t rgbaBytes = 0;
+		for (int w = width, h = height; ; w = std::max(w / 2, 1), h = std::max(h / 2, 1))
+		{
+			rgbaBytes += (size_t)w * h * 4;
+			if (w == 1 && h == 1) break;
 		}
 
-		// Free memory after we send the data to GPU.
-		stbi_image_free(data);
+		compressedStats.textures++;
+		compressedStats.cacheHits += import.cacheHit ? 1 : 0;
+		compressedStats.compressedBytes += container.getDataSize();
+		compressedStats.rgbaBytes += rgbaBytes;
+		compressedStats.loadMs += loadMs;
+		compressedStats.sourceDecodeMs += container.getSourceDecodeMs();
+		compressedStats.encodeMs += import.encodeMs;
 
+		printf("Loaded texture (%s, %s, %.1f ms vs %.1f ms to decode the source): %s - %.2f MB vs %.2f MB as RGBA8\n",
+			getFormatName(container.getInternalFormat()), import.cacheHit ? "cached" : "encoded", loadMs, container.getSourceDecodeMs(),
+			path.c_str(), container.getDataSize() / (1024.0f * 1024.0f), rgbaBytes / (1024.0f * 1024.0f));
+	}
+
+	// Re-encodes on the hot reload thread when the source changes
+	static void watchCompressedTexture(Texture2D* tex, const std::string& path, TextureRole role, TextureConfig cfg)
+	{
+		HotReload::watch(path, tex, [=]() -> HotReload::CommitFunc
+		{
+			std::shared_ptr<CompressedImport> import = std::make_shared<CompressedImport>();
+			if (!importCompressed(path, role, import.get()))
+				return nullptr;
+
+			return [=]()
+			{
+				setFromImport(tex, path, *import, cfg);
+			};
+		});
+	}
+
+	Texture2D* loadTexture2DCompressed(const std::string& path, TextureRole role, TextureConfig cfg)
+	{
+		if (!hasS3TC())
+		{
+			cfg.internalFormat = GL_RGBA;
+			return loadTexture2DInternal(path, cfg, role);
+		}
+
+		CompressedImport import;
+		if (!importCompressed(path, role, &import))
+		{
+			std::cout << "Failed to load texture: " << path << std::endl;
+			return 0;
+		}
+
+		Texture2D* tex = Texture2D::copyColourTexture(checkerTexture2D());
+		setFromImport(tex, path, import, cfg);
+		watchCompressedTexture(tex, path, role, cfg);
 		return tex;
 	}
 
-	Texture2D* loadTexture2D_sRGBA(const std::string& path)
+	Texture2D* loadTexture2DCompressed(const std::string& path, TextureRole role)
 	{
-		return loadTexture2D_sRGBA(path, TextureConfig());
+		return loadTexture2DCompressed(path, role, TextureConfig());
+	}
+
+	Texture2D* loadTexture2DCompressedAsync(const std::string& path, TextureRole role, TextureConfig cfg)
+	{
+		if (!hasS3TC())
+		{
+			cfg.internalFormat = GL_RGBA;
+			return loadTexture2DAsyncInternal(path, cfg, role);
+		}
+
+		std::ostringstream key;
+		key << path << "|compressed|" << (int)role << '|' << cfg.hWrap << '|' << cfg.vWrap << '|' << cfg.textureFilter;
+
+		auto it = asyncTextures.find(key.str());
+		if (it != asyncTextures.end())
+			return it->second;
+
+		Texture2D* tex = Texture2D::copyColourTexture(checkerTexture2D());
+		asyncTextures[key.str()] = tex;
+
+		AssetLoader::submit([=]() -> AssetLoader::UploadFunc
+		{
+			std::shared_ptr<CompressedImport> import = std::make_shared<CompressedImport>();
+			if (!importCompressed(path, role, import.get()))
+			{
+				std::cout << "Failed to load texture: " << path << std::endl;
+				return nullptr;
+			}
+
+			return [=]()
+			{
+				setFromImport(tex, path, *import, cfg);
+				return true;
+			};
+		});
+
+		watchCompressedTexture(tex, path, role, cfg);
+		return tex;
+	}
+
+	Texture2D* loadTexture2DCompressedAsync(const std::string& path, TextureRole role)
+	{
+		return loadTexture2DCompressedAsync(path, role, TextureConfig());
+	}
+
+	// Material texture arrays, one per storage format, size and mip count
+	static std::vector<TextureArray*> textureArrays;
+	static std::unordered_map<std::string, TextureLayer*> textureLayers;
+
+	// Any thread. Block-compressed through the container cache, as loadTexture2DCompressed(),
+	// or packed RGBA8 without S3TC.
+	static bool importLayerSource(const std::string& path, TextureRole role, bool compressed, TextureArraySource* out, GLint* format)
+	{
+		if (compressed)
+		{
+			CompressedImport import;
+			if (!importCompressed(path, role, &import))
+				return false;
+
+			out->container = import.container;
+			*format = import.container->getInternalFormat();
+			return true;
+		}
+
+		TextureConfig cfg;
+		cfg.internalFormat = GL_RGBA;
+		out->chain = importMipChain(path, cfg, role);
+		if (!out->chain)
+			return false;
+
+		*format = getStorageConfig(cfg, *out->chain).internalFormat;
+		return true;
+	}
+
+	// Render thread. Replaces the layer in place if its array still fits (hot reload), otherwise
+	// moves it to the array that does; the old layer is left unused.
+	static void setLayerSource(TextureLayer* layer, const std::string& path, GLint format, const TextureArraySource& source)
+	{
+		bool placeholder = std::find(textureArrays.begin(), textureArrays.end(), layer->array) == textureArrays.end();
+		if (!placeholder && layer->array->accepts(format, source))
+		{
+			layer->array->setLayer(layer->layer, source);
+		}
+		else
+		{
+			auto it = std::find_if(textureArrays.begin(), textureArrays.end(), [&](const TextureArray* array)
+			{
+				return array->accepts(format, source);
+			});
+
+			TextureArray* array;
+			if (it != textureArrays.end())
+			{
+				array = *it;
+			}
+			else
+			{
+				int w, h;
+				source.getSize(&w, &h);
+				array = new TextureArray(format, w, h, (int)source.getLevelCount());
+				textureArrays.push_back(array);
+			}
+
+			layer->layer = array->addLayer(source);
+			layer->array = array;
+		}
+
+		int w, h;
+		layer->array->getSize(&w, &h);
+		printf("Loaded texture layer %d of %d (%dx%d, %s): %s\n", layer->layer, layer->array->getLayerCount(), w, h,
+			source.container ? getFormatName(format) : getStorageFormatName(format), path.c_str());
+	}
+
+	TextureLayer* loadTextureLayerAsync(const std::string& path, TextureRole role)
+	{
+		std::ostringstream key;
+		key << path << '|' << (int)role;
+
+		auto it = textureLayers.find(key.str());
+		if (it != textureLayers.end())
+			return it->second;
+
+		TextureLayer* layer = new TextureLayer();
+		layer->array = checkerTextureLayer()->array;
+		layer->layer = 0;
+		textureLayers[key.str()] = layer;
+
+		bool compressed = hasS3TC();
+		auto import = [=]() -> std::function<void()>
+		{
+			std::shared_ptr<TextureArraySource> source = std::make_shared<TextureArraySource>();
+			GLint format;
+			if (!importLayerSource(path, role, compressed, source.get(), &format))
+			{
+				std::cout << "Failed to load texture: " << path << std::endl;
+				return nullptr;
+			}
+
+			return [=]()
+			{
+				setLayerSource(layer, path, format, *source);
+			};
+		};
+
+		AssetLoader::submit([=]() -> AssetLoader::UploadFunc
+		{
+			std::function<void()> commit = import();
+			if (!commit)
+				return nullptr;
+
+			return [=]()
+			{
+				commit();
+				return true;
+			};
+		});
+
+		HotReload::watch(path, layer, [=]() -> HotReload::CommitFunc
+		{
+			return import();
+		});
+		return layer;
+	}
+
+	static TextureLayer* createSolidLayer(int size, const unsigned char* rgba)
+	{
+		std::shared_ptr<TextureMipChain> chain = MipGenerator::baseLevel(rgba, size, size);
+
+		TextureArraySource source;
+		source.chain = chain;
+
+		TextureLayer* layer = new TextureLayer();
+		layer->array = new TextureArray(GL_RGBA8, size, size, 1);
+		layer->layer = layer->array->addLayer(source);
+		return layer;
+	}
+
+	TextureLayer* whiteTextureLayer()
+	{
+		static unsigned char data[4] = { 0xff, 0xff, 0xff, 0xff };
+		static TextureLayer* layer = createSolidLayer(1, data);
+		return layer;
+	}
+
+	TextureLayer* checkerTextureLayer()
+	{
+		static unsigned char data[16] = {
+			0xff, 0x00, 0xff, 0xff, 0x70, 0x00, 0x70, 0xff,
+			0x70, 0x00, 0x70, 0xff, 0xff, 0x00, 0xff, 0xff
+		};
+		static TextureLayer* layer = createSolidLayer(2, data);
+		return layer;
+	}
+
+	unsigned int getTextureArrayCount()
+	{
+		return (unsigned int)textureArrays.size();
+	}
+
+	CompressedTextureStats getCompressedTextureStats()
+	{
+		return compressedStats;
 	}
 
 	Texture2D* blackTexture2D()
@@ -4,14 +4,78 @@
 #include "texture2d.h"
 #include "cubemap.h"
 
+struct TextureLayer;
+
+// What a texture is used for, which picks its storage format. Uncompressed, the channels the
+// image actually uses are checked too: an opaque image drops alpha, a grey one keeps just R.
+enum class TextureRole
+{
+	ALBEDO,			// BC1 (RGB8), BC3 (RGBA8) if the image has alpha, BC4 (R8) if it is grey
+	ALBEDO_ALPHA,	// BC3 (RGBA8), e.g. cut-out foliage
+	MASK,			// BC4 (R8) of the red channel, e.g. specular or AO
+	NORMAL,			// BC5 (RG8) of XY; the shader rebuilds Z
+	GENERIC			// As ALBEDO, but filtered as stored rather than as sRGB colour
+};
+
+// Single channel textures read as (r, r, r, 1) through GL_TEXTURE_SWIZZLE_RGBA, so shaders
+// sampling .r or .rgb see the same values as with RGBA8.
+
+// Totals over every texture loaded through the compressed loaders
+struct CompressedTextureStats
+{
+	unsigned int textures;
+	unsigned int cacheHits;
+	size_t compressedBytes;		// VRAM, all mips
+	size_t rgbaBytes;			// The same textures as RGBA8 with mips
+	float loadMs;				// Mapping and uploading the cached containers
+	float sourceDecodeMs;		// Decoding the source images instead (timed when they were encoded)
+	float encodeMs;				// Spent encoding on cache misses
+};
+
 namespace TextureUtils
 {
+	// With cfg.mipmap (the default) the mips are built on the CPU by MipGenerator and cached
+	// under TEXTURE_CACHE_DIRECTORY, so later runs skip both the decode and the filtering.
+	// Stored as TextureRole::GENERIC in the smallest of R8/RG8/RGB8/RGBA8 (sRGB8/sRGB8_A8 for
+	// the _sRGBA versions) that holds the image.
 	Texture2D* loadTexture2D(const std::string& path, TextureConfig cfg);
 	Texture2D* loadTexture2D(const std::string& path);
 
 	Texture2D* loadTexture2D_sRGBA(const std::string& path, TextureConfig cfg);
 	Texture2D* loadTexture2D_sRGBA(const std::string& path);
 
+	// Return at once with a copy of checkerTexture2D(); the file is decoded on the AssetLoader
+	// threads and uploaded into the same Texture2D later. Repeated requests share one texture.
+	Texture2D* loadTexture2DAsync(const std::string& path, TextureConfig cfg);
+	Texture2D* loadTexture2DAsync(const std::string& path);
+
+	Texture2D* loadTexture2DAsync_sRGBA(const std::string& path, TextureConfig cfg);
+	Texture2D* loadTexture2DAsync_sRGBA(const std::string& path);
+
+	// Block-compressed with a full mip chain. The first load encodes the image into a container
+	// under TEXTURE_CACHE_DIRECTORY (see texture_container.h); later loads map that file and
+	// upload it as is. Falls back to the uncompressed loaders without S3TC support.
+	Texture2D* loadTexture2DCompressed(const std::string& path, TextureRole role, TextureConfig cfg);
+	Texture2D* loadTexture2DCompressed(const std::string& path, TextureRole role);
+
+	// As loadTexture2DAsync(), with the mapping (and any encode) on the AssetLoader threads
+	Texture2D* loadTexture2DCompressedAsync(const std::string& path, TextureRole role, TextureConfig cfg);
+	Texture2D* loadTexture2DCompressedAsync(const std::string& path, TextureRole role);
+
+	CompressedTextureStats getCompressedTextureStats();
+
+	// A layer of a shared texture array (see texture_array.h). Textures that end up in the same
+	// storage format (picked as by the compressed loaders), size and mip count share one
+	// GL_TEXTURE_2D_ARRAY, so entities with different textures draw with a single bind.
+	// Returns at once holding checkerTextureLayer(); repeated requests share one layer.
+	TextureLayer* loadTextureLayerAsync(const std::string& path, TextureRole role);
+	unsigned int getTextureArrayCount();
+
+	TextureLayer* whiteTextureLayer();
+	TextureLayer* checkerTextureLayer();
+
+	extern const char* TEXTURE_CACHE_DIRECTORY;
+
 	Texture2D* blackTexture2D();
 	Texture2D* whiteTexture2D();
 	Texture2D* checkerTexture2D();